@@ -1,5 +1,6 @@
 //==============================================================================
 // Canopy - A Minimal Windowing & Input Library for macOS
+//          (with a headless backend for running without a display)
 //
 // Author: Andreas Nore (github.com/abnore)
 //==============================================================================
@@ -280,6 +281,28 @@ framebuffer get_framebuffer_size(Window *window);
 void present_buffer(Window* window);
 void swap_backbuffer(Window* window, framebuffer* bf);
 
+/* A region of the framebuffer, in pixels */
+typedef struct {
+    int x, y, width, height;
+} canopy_rect;
+
+/* Presents only the parts of the framebuffer that changed since the last
+ * present. The backends use this to upload less: the headless backend only
+ * copies the damaged rows, Cocoa still hands over the whole frame. With no
+ * rects at all nothing changed, and the present is skipped. */
+void present_buffer_damage(Window *window, const canopy_rect *rects, int count);
+
+/* Present capture, for the headless backend (build with BACKEND=headless).
+ * When enabled, present_buffer() copies the framebuffer into a capture buffer
+ * that can be read back with get_present_capture(), e.g. to save or compare a
+ * frame. The capture has the same size and pitch as the window framebuffer.
+ * get_present_count() is the number of presents since the window was created.
+ * On the Cocoa backend capture is not supported and NULL is returned, but the
+ * present count is still tracked. */
+void set_present_capture(Window *window, bool enable);
+const uint32_t *get_present_capture(Window *window);
+uint64_t get_present_count(Window *window);
+
 /*==============================================================================
  * The event system for Canopy.
  * Supports polling and pushing input events.
@@ -384,6 +407,12 @@ void wait_events_timeout(double timeout_seconds);
  * allows for "fake" events to be queued for the user */
 void push_event(canopy_event event);
 
+/* For the backends. events_pending() tells whether poll_event() has anything,
+ * and push_event() calls wake_event_waiters() after queueing, so a backend
+ * blocked in wait_events() can return for the new event */
+bool events_pending(void);
+void wake_event_waiters(void);
+
 //------------------------------------------------------------------------------
 // Timer Section
 //------------------------------------------------------------------------------
@@ -407,6 +436,51 @@ int get_fps(void);
  * internal frame timing and delta time are updated */
 int should_render_frame(void);
 
+//------------------------------------------------------------------------------
+// Job Section
+//------------------------------------------------------------------------------
+/* A small work-stealing thread pool, shared by everything built on Canopy. It
+ * starts on first use with one thread per online core. The thread waiting on
+ * work counts as one of them: it runs jobs too until its own are done, so
+ * jobs can start and wait on more jobs themselves. */
+
+/* Threads running jobs, the waiting one included. 0 or less picks one per
+ * online core, 1 runs every job on the calling thread. Setting it, or the
+ * affinity, stops the pool and it starts again on next use, so only do it
+ * while no jobs are running. */
+void set_job_threads(int count);
+int get_job_threads(void);
+
+/* Pins the worker threads to CPUs: worker threads 1 to n - 1 run on
+ * cpus[(i - 1) % count], and the calling thread, which counts as thread 0, is
+ * never pinned. NULL or 0 lets them run anywhere again. On macOS this is only
+ * a hint, threads with the same CPU share a cache where the system can manage */
+void set_job_affinity(const int *cpus, int count);
+
+/* Stops and joins the worker threads. Calling anything here starts them again */
+void shutdown_jobs(void);
+
+/* A group of jobs that can be waited on together. Jobs run in any order on
+ * any thread, and the group can be reused once waited on */
+typedef struct job_group job_group;
+typedef void (*job_func)(void *arg);
+
+job_group *create_job_group(void);
+void job_group_run(job_group *group, job_func fn, void *arg);
+void job_group_wait(job_group *group);
+// Waits for what is left before freeing
+void free_job_group(job_group *group);
+
+/* Calls fn over [begin, end) split into contiguous ranges of at least grain,
+ * in parallel, and returns when every range is done */
+typedef void (*job_range_func)(int begin, int end, void *arg);
+void parallel_for(int begin, int end, int grain, job_range_func fn, void *arg);
+
+/* Calls fn for every tile_w by tile_h tile of a width by height area, in
+ * parallel. Tiles along the right and bottom edges are cut to the area */
+typedef void (*job_tile_func)(int x0, int y0, int x1, int y1, void *arg);
+void parallel_for_tiles(int width, int height, int tile_w, int tile_h, job_tile_func fn, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
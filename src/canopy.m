@@ -17,6 +17,7 @@ struct canopy_window {
     bool should_close;
     bool is_opaque;
     void *user_data; // support for passing data for callbacks
+    uint64_t present_count; // number of presents since creation
 
     void (*callback_key)(Window *, canopy_event_key*);
     void (*callback_text)(Window *, canopy_event_text*);
@@ -464,6 +465,7 @@ Window* create_window(char* title, int width, int height, window_style flags)
         window->mouse_x = 0;
         window->mouse_y = 0;
         window->user_data = NULL;
+        window->present_count = 0;
         window->fb.pixels = NULL;
         window->fb.width = 0;
         window->fb.height = 0;
@@ -677,8 +679,17 @@ void present_buffer(Window *window)
 
         [image addRepresentation: rep];
         [(NSView*)window->view layer].contents = image;
+        window->present_count++;
     }
 }
+/* The layer takes the frame as one image, so there is no partial upload here.
+ * What we can do is skip frames where nothing changed */
+void present_buffer_damage(Window *window, const canopy_rect *rects, int count)
+{
+    (void)rects;
+    if (count <= 0) return;
+    present_buffer(window);
+}
 void swap_backbuffer(Window *window, framebuffer *backbuffer)
 {
     if( !backbuffer || !backbuffer->pixels ) {
@@ -695,6 +706,23 @@ void swap_backbuffer(Window *window, framebuffer *backbuffer)
     backbuffer->pixels = temp;
 }
 
+/* Present capture is only implemented by the headless backend. The layer
+ * owns what is on screen here, so there is nothing to hand back */
+void set_present_capture(Window *window, bool enable)
+{
+    (void)window;
+    if (enable) WARN("Present capture is only supported by the headless backend");
+}
+const uint32_t *get_present_capture(Window *window)
+{
+    (void)window;
+    return NULL;
+}
+uint64_t get_present_count(Window *window)
+{
+    return window ? window->present_count : 0;
+}
+
 /* Event system */
 
 void dispatch_events(Window *w)
@@ -748,6 +776,13 @@ void post_empty_event(void)
     } // autoreleasepool
 }
 
+/* Events are pushed from the AppKit handlers that wait_events() dispatches,
+ * so it has already returned by then. post_empty_event() wakes it from other
+ * threads */
+void wake_event_waiters(void)
+{
+}
+
 void wait_events(void)
 {
     @autoreleasepool {
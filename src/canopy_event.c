@@ -22,9 +22,15 @@ void push_event(canopy_event ev)
     if (next != event_head) { // only add if queue not full
         event_queue[event_tail] = ev;
         event_tail = next;
+        wake_event_waiters();
     }
 }
 
+bool events_pending(void)
+{
+    return event_head != event_tail;
+}
+
 bool poll_event(canopy_event* out_event)
 {
     if (event_head == event_tail) return false;
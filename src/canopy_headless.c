@@ -0,0 +1,385 @@
+#include "canopy.h"
+
+#include <blackbox.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/* Headless backend. Implements the same public API as the Cocoa backend in
+ * canopy.m, but without a display: the window is just an in-memory
+ * framebuffer, present_buffer() optionally copies the frame aside so it can be
+ * inspected, and events only enter the queue through push_event(). Everything
+ * runs at full CPU speed, which is what we want on build machines and render
+ * nodes. */
+
+//------------------------------------------------------------------------------
+// Struct to hold the headless window internals
+//------------------------------------------------------------------------------
+struct canopy_window {
+    framebuffer fb;
+    double pixel_ratio; // always 1.0, there is no screen to scale to
+    uint32_t width_points, height_points;
+    double mouse_x, mouse_y;
+    bool should_close;
+    bool is_opaque;
+    void *user_data; // support for passing data for callbacks
+
+    bool capture_enabled;   // copy the framebuffer on present_buffer()
+    uint32_t *capture;      // last presented frame, same layout as fb
+    uint64_t present_count; // number of presents since creation
+
+    void (*callback_key)(Window *, canopy_event_key*);
+    void (*callback_text)(Window *, canopy_event_text*);
+    void (*callback_mouse)(Window *, canopy_event_mouse*);
+};
+
+/* wait_events() has nothing to block on but itself. post_empty_event() and
+ * push_event() from another thread wake it by bumping wake_count under this
+ * condition */
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  wake_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t        wake_count = 0;
+
+static bool init_framebuffer(Window *window);
+
+//--------------------------------------------------------------------------------
+// Public API Implementation
+//--------------------------------------------------------------------------------
+Window* create_window(char* title, int width, int height, window_style flags)
+{
+    (void)flags; // Styles only make sense with a window server
+
+    TRACE("Creating headless window: %dx%d \"%s\"", width, height, title);
+
+    if (width <= 0 || height <= 0) {
+        ERROR("Invalid window size: %dx%d", width, height);
+        return NULL;
+    }
+
+    Window* window = canopy_calloc(1, sizeof(Window));
+
+    if(!window) {
+        FATAL("Failed to allocate Window");
+        return NULL;
+    }
+
+    window->width_points = width;
+    window->height_points = height;
+    window->pixel_ratio = 1.0;
+    window->is_opaque = true;
+    window->should_close = false;
+    window->capture_enabled = false;
+
+    if (!init_framebuffer(window)) {
+        free_window(window);
+        return NULL;
+    }
+
+    INFO("Created headless window: \"%s\" (%dx%d)", title, width, height);
+
+    return window;
+}
+
+void set_icon(const char* filepath)
+{
+    if (!filepath) {
+        WARN("No icon filepath provided");
+        return;
+    };
+    TRACE("Ignoring icon in headless mode: %s", filepath);
+}
+
+void free_window(Window* window)
+{
+    if( !window ) {
+        WARN("Tried to free a NULL window");
+        return;
+    }
+
+    TRACE("Freeing headless canopy window");
+    if (window->fb.pixels) {
+        canopy_free(window->fb.pixels);
+        window->fb.pixels = NULL;
+    }
+    if (window->capture) {
+        canopy_free(window->capture);
+        window->capture = NULL;
+    }
+    canopy_free(window);
+}
+
+/* There is no OS queue to drain. Events are pushed straight into the canopy
+ * queue by push_event(), so this only exists to keep the API identical */
+void pump_messages(void)
+{
+}
+
+double get_window_scale(Window *window)
+{
+    return window->pixel_ratio;
+}
+void get_window_size(Window *window, int *w, int *h)
+{
+    if (!window) return;
+    *w = window->width_points;
+    *h = window->height_points;
+}
+void set_window_user_data(Window *window, void *user_data)
+{
+    window->user_data = user_data;
+}
+void *get_window_user_data(Window *window)
+{
+    return window->user_data;
+}
+bool window_should_close(Window *window)
+{
+    return window->should_close;
+}
+void set_window_should_close(Window *window)
+{
+    window->should_close = true;
+}
+bool is_window_opaque(Window *window)
+{
+    return window->is_opaque;
+}
+void set_window_transparent(Window *window, bool enable)
+{
+    window->is_opaque = !enable;
+}
+framebuffer *get_framebuffer(Window *window)
+{
+    return &window->fb;
+}
+framebuffer get_framebuffer_size(Window *window)
+{
+    if (!window) return (framebuffer){0};
+
+    return (framebuffer){
+        .width = window->fb.width,
+        .height = window->fb.height, // pixels
+        .pixels = NULL,
+        .num_pixels = window->fb.num_pixels,
+        .buffer_size = window->fb.buffer_size,
+        .pitch = window->fb.pitch
+    };
+}
+/* Nothing to show the frame on. Unless capture is enabled this is a no-op, so
+ * the render loop is measured without any presentation cost */
+void present_buffer(Window *window)
+{
+    if( !window->fb.pixels ) {
+        ERROR("Tried to present a NULL framebuffer");
+        return;
+    }
+
+    window->present_count++;
+    if (!window->capture_enabled) return;
+
+    if (!window->capture) {
+        window->capture = canopy_malloc(window->fb.buffer_size);
+        if (!window->capture) {
+            ERROR("Failed to allocate present capture buffer");
+            return;
+        }
+    }
+    memcpy(window->capture, window->fb.pixels, window->fb.buffer_size);
+}
+/* Only the damaged rows are copied into the capture, the rest of it still
+ * holds the previous frame. Without a capture yet it has to be a full copy */
+void present_buffer_damage(Window *window, const canopy_rect *rects, int count)
+{
+    if( !window->fb.pixels ) {
+        ERROR("Tried to present a NULL framebuffer");
+        return;
+    }
+    if (count <= 0) return; // nothing changed, nothing to present
+
+    if (!window->capture_enabled || !window->capture) {
+        present_buffer(window);
+        return;
+    }
+    window->present_count++;
+
+    uint32_t stride = window->fb.width;
+    for (int i = 0; i < count; ++i) {
+        // Clamp, the rects come from the caller
+        int x0 = rects[i].x < 0 ? 0 : rects[i].x;
+        int y0 = rects[i].y < 0 ? 0 : rects[i].y;
+        int x1 = rects[i].x + rects[i].width;
+        int y1 = rects[i].y + rects[i].height;
+        if (x1 > (int)window->fb.width)  x1 = window->fb.width;
+        if (y1 > (int)window->fb.height) y1 = window->fb.height;
+        if (x0 >= x1 || y0 >= y1) continue;
+
+        for (int y = y0; y < y1; ++y)
+            memcpy(&window->capture[y * stride + x0], &window->fb.pixels[y * stride + x0],
+                   (size_t)(x1 - x0) * CANOPY_BYTES_PER_PIXEL);
+    }
+}
+void swap_backbuffer(Window *window, framebuffer *backbuffer)
+{
+    if( !backbuffer || !backbuffer->pixels ) {
+        ERROR("Backbuffer is NULL");
+        return;
+    }
+
+    if( !window->fb.pixels ) {
+        ERROR("Framebuffer in window is NULL");
+        return;
+    }
+    uint32_t *temp = window->fb.pixels;
+    window->fb.pixels = backbuffer->pixels;
+    backbuffer->pixels = temp;
+}
+
+void set_present_capture(Window *window, bool enable)
+{
+    if (!window) return;
+    window->capture_enabled = enable;
+    if (!enable && window->capture) {
+        canopy_free(window->capture);
+        window->capture = NULL;
+    }
+}
+const uint32_t *get_present_capture(Window *window)
+{
+    if (!window || !window->capture_enabled) return NULL;
+    return window->capture;
+}
+uint64_t get_present_count(Window *window)
+{
+    return window ? window->present_count : 0;
+}
+
+/* Event system */
+
+void dispatch_events(Window *w)
+{
+    canopy_event e;
+
+    while (poll_event(&e))
+    {
+        switch (e.type) {
+        case CANOPY_EVENT_NONE: break;
+
+        case CANOPY_EVENT_KEY:
+            if (w->callback_key) w->callback_key(w, &e.key);
+            break;
+
+        case CANOPY_EVENT_TEXT:
+            if (w->callback_text) w->callback_text(w, &e.text);
+            break;
+
+        case CANOPY_EVENT_MOUSE:
+            // Keep the cached position in sync like the view does on macOS
+            w->mouse_x = e.mouse.x;
+            w->mouse_y = e.mouse.y;
+            if (w->callback_mouse) w->callback_mouse(w, &e.mouse);
+            break;
+        }
+    }
+}
+
+void set_callback_key(Window *w, callback_key cb) { w->callback_key = cb; }
+void set_callback_text(Window *w, callback_text cb) { w->callback_text = cb; }
+void set_callback_mouse(Window *w, callback_mouse cb) { w->callback_mouse = cb; }
+
+void get_mouse_pos(Window *window, double *x, double *y)
+{
+    if( !window || !x || !y ) return;
+    *x = window->mouse_x;
+    *y = window->mouse_y;
+}
+
+void wake_event_waiters(void)
+{
+    pthread_mutex_lock(&wake_lock);
+    wake_count++;
+    pthread_cond_broadcast(&wake_cond);
+    pthread_mutex_unlock(&wake_lock);
+}
+
+void post_empty_event(void)
+{
+    wake_event_waiters();
+}
+
+/* Without a window server the only things that end the wait are an event
+ * already sitting in the queue, which returns right away, or a wake from
+ * push_event() or post_empty_event() */
+static void wait_until(const struct timespec *deadline)
+{
+    pthread_mutex_lock(&wake_lock);
+    uint64_t seen = wake_count;
+    while (seen == wake_count && !events_pending()) {
+        if (!deadline) {
+            pthread_cond_wait(&wake_cond, &wake_lock);
+        } else if (pthread_cond_timedwait(&wake_cond, &wake_lock,
+                                          deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&wake_lock);
+}
+
+void wait_events(void)
+{
+    wait_until(NULL);
+}
+void wait_events_timeout(double timeout_seconds)
+{
+    if (timeout_seconds < 0.0) timeout_seconds = 0.0;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    time_t secs = (time_t)timeout_seconds;
+    long nsecs = (long)((timeout_seconds - (double)secs) * 1e9);
+    deadline.tv_sec += secs;
+    deadline.tv_nsec += nsecs;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    wait_until(&deadline);
+}
+
+/* static helper function */
+
+/* Same bookkeeping as the Cocoa backend, with a fixed 1:1 point to pixel ratio
+ * since there is no backing store to query */
+static bool init_framebuffer(Window *window)
+{
+    if (!window)
+        return false;
+
+    if (window->fb.pixels == NULL) {
+        window->fb.width = (uint16_t)(window->width_points * window->pixel_ratio);
+        window->fb.height = (uint16_t)(window->height_points * window->pixel_ratio);
+        window->fb.pitch = window->fb.width * CANOPY_BYTES_PER_PIXEL;
+        window->fb.num_pixels = window->fb.width * window->fb.height;
+        window->fb.buffer_size = window->fb.pitch * window->fb.height;
+
+        if ( window->fb.num_pixels == 0 ) {
+            ERROR("Invalid framebuffer size: %ux%u",
+                  window->fb.width, window->fb.height);
+            return false;
+        }
+
+        window->fb.pixels = canopy_calloc(1, window->fb.buffer_size);
+
+        if (!window->fb.pixels) {
+            FATAL("Failed to allocate framebuffer");
+            return false;
+        }
+
+        TRACE("Initialized headless framebuffer: %ux%u (pitch %u)",
+              window->fb.width, window->fb.height, window->fb.pitch);
+    }
+
+    return true;
+}
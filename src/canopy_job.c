@@ -0,0 +1,405 @@
+#ifdef __linux__
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
+
+#include "canopy.h"
+
+#include <blackbox.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+/* A small work-stealing thread pool. Every worker owns a queue of jobs: it
+ * pushes and pops its own at the newest end, so nested work stays hot in its
+ * cache, and when it runs dry it steals the oldest job of another queue,
+ * which is the biggest piece of work left there. Threads outside the pool
+ * share one more queue. A thread waiting on a group runs jobs in the
+ * meantime instead of blocking, so groups can be waited on from inside jobs.
+ *
+ * Queues are a ring buffer under a mutex each. Jobs here are row ranges and
+ * tiles of whole images, so a lock per job is noise, and it keeps stealing
+ * obviously correct. Idle threads sleep on one condition, woken whenever jobs
+ * are pushed or a group finishes.
+ *
+ * The pool starts on first use with one thread per online core, counting the
+ * thread that waits, so that many minus one workers are started. */
+
+#define JOB_MAX_THREADS 64
+#define JOB_QUEUE_START 64
+// parallel_for splits into up to this many chunks per thread, so threads that
+// finish early have something left to steal
+#define JOB_CHUNKS_PER_THREAD 4
+
+typedef struct {
+    job_func fn;
+    void *arg;
+    job_group *group;
+} job;
+
+typedef struct {
+    pthread_mutex_t lock;
+    job *jobs;
+    int head, count, capacity; // head is the oldest job
+} job_queue;
+
+struct job_group {
+    atomic_int pending;
+};
+
+static struct {
+    pthread_mutex_t lock;   // starting and stopping, and sleeping
+    pthread_cond_t wake;
+    atomic_bool started;
+    bool stopping;
+
+    int requested;          // set_job_threads, 0 = one per online core
+    int threads;            // running jobs, the waiting thread included
+    int queue_count;        // fixed before any worker starts
+    int affinity[JOB_MAX_THREADS];
+    int affinity_count;
+
+    pthread_t workers[JOB_MAX_THREADS];
+    job_queue queues[JOB_MAX_THREADS]; // 0 is shared by threads outside the pool
+    atomic_int queued;      // jobs in all queues together
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+// Queue of the calling thread, 0 outside the pool
+static _Thread_local int job_queue_index = 0;
+
+//------------------------------------------------------------------------------
+// Queues
+//------------------------------------------------------------------------------
+static bool queue_push(job_queue *q, job j)
+{
+    pthread_mutex_lock(&q->lock);
+    if (q->count == q->capacity) {
+        int capacity = q->capacity ? q->capacity * 2 : JOB_QUEUE_START;
+        job *jobs = canopy_malloc((size_t)capacity * sizeof(job));
+        if (!jobs) {
+            pthread_mutex_unlock(&q->lock);
+            return false;
+        }
+        // Unwrapped, oldest first
+        for (int i = 0; i < q->count; ++i)
+            jobs[i] = q->jobs[(q->head + i) % q->capacity];
+        canopy_free(q->jobs);
+        q->jobs = jobs;
+        q->head = 0;
+        q->capacity = capacity;
+    }
+    q->jobs[(q->head + q->count) % q->capacity] = j;
+    q->count++;
+    pthread_mutex_unlock(&q->lock);
+    atomic_fetch_add(&pool.queued, 1);
+    return true;
+}
+
+// The newest job for the owner, the oldest for everyone else
+static bool queue_pop(job_queue *q, bool newest, job *out)
+{
+    if (atomic_load_explicit(&pool.queued, memory_order_relaxed) == 0) return false;
+
+    pthread_mutex_lock(&q->lock);
+    bool found = q->count > 0;
+    if (found) {
+        if (newest) {
+            *out = q->jobs[(q->head + q->count - 1) % q->capacity];
+        } else {
+            *out = q->jobs[q->head];
+            q->head = (q->head + 1) % q->capacity;
+        }
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+    if (found) atomic_fetch_sub(&pool.queued, 1);
+    return found;
+}
+
+// Wakes every sleeping thread, there may be work for them or a group is done
+static void wake_all(void)
+{
+    pthread_mutex_lock(&pool.lock);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void run_job(job j)
+{
+    j.fn(j.arg);
+    if (atomic_fetch_sub(&j.group->pending, 1) == 1) wake_all();
+}
+
+/* Runs one job, from the caller's own queue if it has any, then the shared
+ * one, then whichever other queue has some. False when there was nothing */
+static bool run_one(void)
+{
+    int self = job_queue_index;
+    job j;
+    if (queue_pop(&pool.queues[self], self != 0, &j)) {
+        run_job(j);
+        return true;
+    }
+    for (int i = 1; i < pool.queue_count; ++i) {
+        int victim = (self + i) % pool.queue_count;
+        if (queue_pop(&pool.queues[victim], false, &j)) {
+            run_job(j);
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Workers
+//------------------------------------------------------------------------------
+static void set_thread_affinity(pthread_t thread, int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err) WARN("Failed to pin job thread to CPU %d: %s", cpu, strerror(err));
+#elif defined(__APPLE__)
+    // Only a hint: threads with the same tag share a cache where possible
+    thread_affinity_policy_data_t policy = { cpu + 1 };
+    thread_policy_set(pthread_mach_thread_np(thread), THREAD_AFFINITY_POLICY,
+                      (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#else
+    (void)thread;
+    (void)cpu;
+#endif
+}
+
+static void *worker_main(void *arg)
+{
+    job_queue_index = (int)(intptr_t)arg;
+
+    for (;;) {
+        if (run_one()) continue;
+
+        pthread_mutex_lock(&pool.lock);
+        while (!pool.stopping && atomic_load(&pool.queued) == 0)
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        bool stop = pool.stopping;
+        pthread_mutex_unlock(&pool.lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+static int online_cores(void)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online < 1 ? 1 : (int)online;
+}
+
+// Called with pool.lock held
+static void start_pool(void)
+{
+    int threads = pool.requested > 0 ? pool.requested : online_cores();
+    if (threads > JOB_MAX_THREADS) threads = JOB_MAX_THREADS;
+
+    pool.stopping = false;
+    pool.threads = 1;
+    pool.queue_count = threads;
+    for (int i = 0; i < threads; ++i)
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+    for (int i = 1; i < threads; ++i) {
+        if (pthread_create(&pool.workers[i], NULL, worker_main, (void *)(intptr_t)i) != 0) {
+            WARN("Failed to start job thread, continuing with %d", pool.threads);
+            break;
+        }
+        // Thread 0 is whoever calls in, only the ones started here are pinned
+        if (pool.affinity_count > 0)
+            set_thread_affinity(pool.workers[i], pool.affinity[(i - 1) % pool.affinity_count]);
+        pool.threads++;
+    }
+    atomic_store(&pool.started, true);
+    TRACE("Job system started with %d threads", pool.threads);
+}
+
+static void ensure_pool_started(void)
+{
+    if (atomic_load(&pool.started)) return;
+    pthread_mutex_lock(&pool.lock);
+    if (!atomic_load(&pool.started)) start_pool();
+    pthread_mutex_unlock(&pool.lock);
+}
+
+//------------------------------------------------------------------------------
+// Public API Implementation
+//------------------------------------------------------------------------------
+void shutdown_jobs(void)
+{
+    pthread_mutex_lock(&pool.lock);
+    if (!atomic_load(&pool.started)) {
+        pthread_mutex_unlock(&pool.lock);
+        return;
+    }
+    pool.stopping = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 1; i < pool.threads; ++i)
+        pthread_join(pool.workers[i], NULL);
+    for (int i = 0; i < pool.queue_count; ++i) {
+        canopy_free(pool.queues[i].jobs);
+        pthread_mutex_destroy(&pool.queues[i].lock);
+        memset(&pool.queues[i], 0, sizeof(pool.queues[i]));
+    }
+    atomic_store(&pool.queued, 0);
+    pool.threads = 0;
+    pool.queue_count = 0;
+    atomic_store(&pool.started, false);
+    TRACE("Job system stopped");
+}
+
+void set_job_threads(int count)
+{
+    shutdown_jobs();
+    pool.requested = count > 0 ? count : 0;
+}
+
+int get_job_threads(void)
+{
+    ensure_pool_started();
+    return pool.threads;
+}
+
+void set_job_affinity(const int *cpus, int count)
+{
+    shutdown_jobs();
+    if (!cpus || count < 0) count = 0;
+    if (count > JOB_MAX_THREADS) count = JOB_MAX_THREADS;
+    if (count > 0) memcpy(pool.affinity, cpus, (size_t)count * sizeof(int));
+    pool.affinity_count = count;
+}
+
+job_group *create_job_group(void)
+{
+    job_group *group = canopy_malloc(sizeof(job_group));
+    if (!group) return NULL;
+    atomic_init(&group->pending, 0);
+    return group;
+}
+
+void free_job_group(job_group *group)
+{
+    if (!group) return;
+    job_group_wait(group);
+    canopy_free(group);
+}
+
+void job_group_run(job_group *group, job_func fn, void *arg)
+{
+    if (!group || !fn) return;
+    ensure_pool_started();
+
+    atomic_fetch_add(&group->pending, 1);
+    job j = { fn, arg, group };
+    if (pool.threads == 1 || !queue_push(&pool.queues[job_queue_index], j)) {
+        run_job(j);
+        return;
+    }
+    wake_all();
+}
+
+void job_group_wait(job_group *group)
+{
+    if (!group) return;
+
+    while (atomic_load(&group->pending) > 0) {
+        if (run_one()) continue;
+
+        pthread_mutex_lock(&pool.lock);
+        while (atomic_load(&group->pending) > 0 && atomic_load(&pool.queued) == 0)
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+    }
+}
+
+typedef struct {
+    job_range_func fn;
+    void *arg;
+    int begin, end;
+} range_job;
+
+static void run_range(void *arg)
+{
+    range_job *r = arg;
+    r->fn(r->begin, r->end, r->arg);
+}
+
+void parallel_for(int begin, int end, int grain, job_range_func fn, void *arg)
+{
+    if (!fn || end <= begin) return;
+    if (grain < 1) grain = 1;
+    ensure_pool_started();
+
+    int64_t n = (int64_t)end - begin;
+    int64_t chunks = (n + grain - 1) / grain;
+    if (chunks > (int64_t)pool.threads * JOB_CHUNKS_PER_THREAD)
+        chunks = (int64_t)pool.threads * JOB_CHUNKS_PER_THREAD;
+    if (chunks <= 1 || pool.threads == 1) {
+        fn(begin, end, arg);
+        return;
+    }
+
+    // Even chunks, the first n % chunks one longer. The caller takes the
+    // first one itself
+    range_job ranges[JOB_MAX_THREADS * JOB_CHUNKS_PER_THREAD];
+    struct job_group group;
+    atomic_init(&group.pending, 0);
+    int at = begin;
+    for (int i = 0; i < (int)chunks; ++i) {
+        int len = (int)(n / chunks + (i < n % chunks));
+        ranges[i] = (range_job){ fn, arg, at, at + len };
+        at += len;
+        if (i > 0) {
+            atomic_fetch_add(&group.pending, 1);
+            job j = { run_range, &ranges[i], &group };
+            if (!queue_push(&pool.queues[job_queue_index], j)) run_job(j);
+        }
+    }
+    wake_all();
+    run_range(&ranges[0]);
+    job_group_wait(&group);
+}
+
+typedef struct {
+    job_tile_func fn;
+    void *arg;
+    int width, height, tile_w, tile_h, tiles_x;
+} tile_job;
+
+static void run_tiles(int begin, int end, void *arg)
+{
+    tile_job *t = arg;
+    for (int i = begin; i < end; ++i) {
+        int x0 = (i % t->tiles_x) * t->tile_w, y0 = (i / t->tiles_x) * t->tile_h;
+        int x1 = x0 + t->tile_w < t->width ? x0 + t->tile_w : t->width;
+        int y1 = y0 + t->tile_h < t->height ? y0 + t->tile_h : t->height;
+        t->fn(x0, y0, x1, y1, t->arg);
+    }
+}
+
+void parallel_for_tiles(int width, int height, int tile_w, int tile_h, job_tile_func fn, void *arg)
+{
+    if (!fn || width <= 0 || height <= 0 || tile_w <= 0 || tile_h <= 0) return;
+
+    tile_job t = { fn, arg, width, height, tile_w, tile_h, (width + tile_w - 1) / tile_w };
+    int tiles_y = (height + tile_h - 1) / tile_h;
+    parallel_for(0, t.tiles_x * tiles_y, 1, run_tiles, &t);
+}
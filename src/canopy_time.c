@@ -1,14 +1,25 @@
 #include "canopy.h"
 
 #include <blackbox.h>
-#include <mach/mach_time.h>
 #include <math.h>
 
+/* The monotonic clock is the only platform specific part of the timer. macOS
+ * uses mach_absolute_time with its timebase, everything else (the headless
+ * backend on Linux) uses clock_gettime(CLOCK_MONOTONIC) which is already in
+ * nanoseconds */
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
 #define DEFAULT_FPS 60
 #define MAX_FRAME_DELTA 0.25   // Clamp huge pauses (debugger, app stall, etc.)
 
 static struct {
+#ifdef __APPLE__
     mach_timebase_info_data_t timebase;
+#endif
     double to_seconds;
 
     double target_frame_time;   // Desired seconds per frame
@@ -19,8 +30,21 @@ static struct {
     int initialized;
 } canopy_timer;
 
+/* Raw monotonic ticks, converted with to_seconds or the timebase */
+static inline uint64_t read_ticks(void)
+{
+#ifdef __APPLE__
+    return mach_absolute_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
 static void init_timer(void)
 {
+#ifdef __APPLE__
     kern_return_t result = mach_timebase_info(&canopy_timer.timebase);
     if (result != KERN_SUCCESS) {
         FATAL("Failed to initialize mach timebase");
@@ -30,10 +54,18 @@ static void init_timer(void)
     canopy_timer.to_seconds =
         ((double)canopy_timer.timebase.numer /
          (double)canopy_timer.timebase.denom) / 1e9;
+#else
+    struct timespec res;
+    if (clock_getres(CLOCK_MONOTONIC, &res) != 0) {
+        FATAL("Monotonic clock not available");
+        return;
+    }
+    canopy_timer.to_seconds = 1e-9; // ticks are already nanoseconds
+#endif
 
     canopy_timer.target_frame_time = 1.0 / DEFAULT_FPS;
 
-    double now = (double)mach_absolute_time() * canopy_timer.to_seconds;
+    double now = (double)read_ticks() * canopy_timer.to_seconds;
 
     canopy_timer.last_tick_time = now;
     canopy_timer.last_frame_time = now;
@@ -53,14 +85,18 @@ static void ensure_timer_initialized(void)
 double get_time(void)
 {
     ensure_timer_initialized();
-    return (double)mach_absolute_time() * canopy_timer.to_seconds;
+    return (double)read_ticks() * canopy_timer.to_seconds;
 }
 
 uint64_t get_time_ns(void)
 {
     ensure_timer_initialized();
-    uint64_t ticks = mach_absolute_time();
+    uint64_t ticks = read_ticks();
+#ifdef __APPLE__
     return ticks * canopy_timer.timebase.numer / canopy_timer.timebase.denom;
+#else
+    return ticks;
+#endif
 }
 
 /* Users can normalize themselves, this is raw time since last frame
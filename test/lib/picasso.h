@@ -3,19 +3,85 @@
 /* Will support BMP, PPM, PNG and eventually JPG
  * */
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <canopy.h> // I have decided to make picasso canopy-aware
 
 /* -------------------- Picasso Objects -------------------- */
-typedef struct {
+/* What the alpha of an image holds, so blits of images without translucency
+ * can copy instead of blend. Unknown (zero) is always safe, it blends. */
+typedef enum {
+    PICASSO_ALPHA_UNKNOWN = 0,
+    PICASSO_ALPHA_OPAQUE,   // every alpha is 255, or there is no alpha channel
+    PICASSO_ALPHA_MASK,     // every alpha is either 0 or 255
+    PICASSO_ALPHA_BLEND,    // anything in between
+} picasso_alpha;
+
+/* How the texels of an image are laid out. Linear is rows one after the
+ * other. Tiled is 8x8 blocks, each one contiguous, in rows of blocks, so a
+ * texture sampled across rows (rotated, or down a tall triangle) stays in the
+ * same few cache lines. Rows of a tiled image are padded to whole blocks */
+typedef enum {
+    PICASSO_LAYOUT_LINEAR = 0,
+    PICASSO_LAYOUT_TILED,
+} picasso_layout;
+
+typedef struct picasso_image {
     int width;
     int height;
     int channels; // 3 = RGB, 4 = RGBA
-    int row_stride;
+    int row_stride; // bytes of a row, padded to whole blocks when tiled
     uint8_t *pixels;
+    picasso_layout layout;
+    picasso_alpha alpha; // see picasso_image_update_alpha
+    bool premultiplied;  // color is already times alpha, loaded images are
+    struct picasso_image *mip; // half the size, see picasso_image_build_mips
 } picasso_image;
 
+typedef struct {
+    int x0, y0, x1, y1;
+} picasso_draw_bounds;
+
+// Recorded draw commands, see the Command Recording section below
+struct picasso_cmdlist;
+
+// Changed areas of a backbuffer, see the Damage Tracking section below
+#define PICASSO_MAX_DAMAGE 16
+typedef struct {
+    picasso_draw_bounds rects[PICASSO_MAX_DAMAGE]; // pixels, never overlapping
+    int count;
+} picasso_damage;
+
+/* How what a primitive draws (the source) is combined with the backbuffer
+ * (the destination). Source-over is the default and the fastest. The
+ * Porter-Duff operators take the source and destination where the other is
+ * inside (in), outside (out) or both (atop). Add, multiply, screen, darken and
+ * lighten mix the colors where both are.
+ *
+ * A primitive only ever touches the pixels it covers, anti-aliased edges mix
+ * the result with what was there. So a rect drawn with SRC_IN only changes
+ * the pixels under the rect, nothing outside of it is cleared. */
+typedef enum {
+    PICASSO_BLEND_SRC_OVER = 0, // source on top
+    PICASSO_BLEND_SRC,          // source replaces the destination
+    PICASSO_BLEND_CLEAR,        // transparent, whatever the source
+    PICASSO_BLEND_SRC_IN,       // source where the destination is
+    PICASSO_BLEND_SRC_OUT,      // source where the destination isn't
+    PICASSO_BLEND_SRC_ATOP,     // source on top, only where the destination is
+    PICASSO_BLEND_DST_OVER,     // source behind the destination
+    PICASSO_BLEND_DST_IN,       // destination where the source is, a mask
+    PICASSO_BLEND_DST_OUT,      // destination where the source isn't, an eraser
+    PICASSO_BLEND_DST_ATOP,     // destination on top, only where the source is
+    PICASSO_BLEND_XOR,          // each where the other isn't
+    PICASSO_BLEND_ADD,          // sum, saturated. Glows and light
+    PICASSO_BLEND_MULTIPLY,     // product, darkens. Shadows and tints
+    PICASSO_BLEND_SCREEN,       // inverted product, lightens
+    PICASSO_BLEND_DARKEN,       // the darker of both per channel
+    PICASSO_BLEND_LIGHTEN,      // the lighter of both per channel
+    PICASSO_BLEND_COUNT,
+} picasso_blend_mode;
+
 typedef struct {
     uint32_t* pixels;
     uint32_t width, height, pitch; // actual framebuffer pixels
@@ -26,6 +92,19 @@ typedef struct {
 
     float scale_x;
     float scale_y;
+
+    // Everything below is picasso state, the fields above have to stay first
+    // since canopy swaps the pixels through a framebuffer pointer.
+    picasso_draw_bounds clip;        // pixels, an empty clip means everything
+    picasso_blend_mode blend;        // for everything drawn from now on but clears
+    struct picasso_cmdlist *cmdlist; // recorded commands, kept between frames
+
+    bool track_damage;          // union everything drawn into damage, default on
+    picasso_damage damage;      // changed since the last present
+    picasso_damage prev_damage; // changed in the frame before that
+
+    void *depth;    // optional depth buffer, see the 3D section below
+    int depth_bits; // 16 (uint16_t per pixel), 32 (float) or 0 for none
 } picasso_backbuffer;
 
 typedef struct {
@@ -61,8 +140,10 @@ typedef struct {
 } picasso_point3;
 
 typedef struct {
-    int x0, y0, x1, y1;
-} picasso_draw_bounds;
+    float x, y;  // logical coordinates, like every other primitive
+    color c;     // interpolated across the triangle (Gouraud)
+    float u, v;  // texture coordinates, 0..1 across the whole image
+} picasso_vertex;
 
 typedef struct {
     uint8_t *fp;   // Pointer to start of file buffer
@@ -93,9 +174,24 @@ typedef struct {
         (1 - (_t)) * (_v0) + (_t) * (_v1)       \
         })
 
+/* Byte offsets of column x and of row y, which add up to the offset of the
+ * texel at (x, y) in either layout. Tiled, 8 texels of a row are contiguous
+ * from every column that is a multiple of 8 */
+static inline size_t picasso__col_offset(const picasso_image *img, int x)
+{
+    if (img->layout == PICASSO_LAYOUT_LINEAR) return (size_t)x * img->channels;
+    return ((size_t)(x >> 3) * 64 + (x & 7)) * img->channels;
+}
+
+static inline size_t picasso__row_offset(const picasso_image *img, int y)
+{
+    if (img->layout == PICASSO_LAYOUT_LINEAR) return (size_t)y * img->row_stride;
+    return (size_t)(y >> 3) * 8 * img->row_stride + (size_t)(y & 7) * 8 * img->channels;
+}
+
 static inline uint8_t *picasso__get_pixel_u8(picasso_image *img, int x, int y)
 {
-    return &img->pixels[y * img->row_stride + x * img->channels];
+    return &img->pixels[picasso__row_offset(img, y) + picasso__col_offset(img, x)];
 }
 // Goes over every pixel and lets you define a function body, where
 // you can manipulate each pixel individually
@@ -251,9 +347,36 @@ int picasso_write_file(const char *path, const void *data, size_t size);
 
 picasso_image *picasso_alloc_image(int width, int height, int channels);
 void picasso_free_image(picasso_image *img);
+// Looks at every alpha once and sets img->alpha. Loaders do it, call it after
+// writing the pixels of an image with an alpha channel yourself
+void picasso_image_update_alpha(picasso_image *img);
+/* The backbuffer is premultiplied, and so are images picasso loads, which
+ * blits then use as they are. Images you fill yourself are straight and get
+ * premultiplied a row at a time while blitting, unless you do it once here.
+ * Unpremultiply before saving. Both are no-ops when already done */
+void picasso_image_premultiply(picasso_image *img);
+void picasso_image_unpremultiply(picasso_image *img);
+/* Mip levels are copies of an image halved again and again down to 1x1,
+ * each a 2x2 average of the one before, premultiplied RGBA. Shrinking blits
+ * and picasso_copy build them the first time they need them. They are not
+ * kept in sync with the pixels: drop them after changing the image, or build
+ * them again. Building them ahead of time keeps that work out of a frame */
+void picasso_image_build_mips(picasso_image *img);
+void picasso_image_drop_mips(picasso_image *img);
+/* Lays the pixels out again, see picasso_layout. Blits, sprites, meshes and
+ * copies read either layout. Pixel data handed to the savers has to be
+ * linear, so set that back first. False when out of memory */
+bool picasso_image_set_layout(picasso_image *img, picasso_layout layout);
 void picasso_reader_free(picasso_reader *r);
 
-
+/* An 8 bit coverage mask (a glyph, an antialiased shape, a stencil) times a
+ * color, with its top left corner at pixel x, y of the backbuffer. Each byte
+ * scales the color's alpha, 0 leaves the pixel alone. stride is the bytes
+ * from one row of the mask to the next. Recorded commands keep the pointer,
+ * so the mask has to live until they are submitted */
+void picasso_draw_mask(picasso_backbuffer *bf, const uint8_t *mask, int w, int h, int stride,
+                       int x, int y, color c);
+// picasso_draw_mask of a w by h bitmap with no padding between rows
 void draw_bitmap_to_backbuffer(picasso_backbuffer *bf, uint8_t *bitmap, int w, int h, int xoff, int yoff, color c);
 
 /* -------------------- Backbuffer Section -------------------- */
@@ -262,26 +385,114 @@ void draw_bitmap_to_backbuffer(picasso_backbuffer *bf, uint8_t *bitmap, int w, i
 // backbuffer manually is no big deal if you want to anyway.
 picasso_backbuffer* picasso_create_backbuffer(Window *window);
 void picasso_destroy_backbuffer(picasso_backbuffer *bf);
+// A straight alpha copy of the backbuffer, ready to save
 picasso_image *picasso_image_from_backbuffer(picasso_backbuffer *bf);
 void picasso_clear_backbuffer(picasso_backbuffer *bf);
 
+/* How a scaled blit samples its source. Nearest takes the one texel under
+ * each pixel, which is the fastest and keeps pixel art sharp. Bilinear mixes
+ * the four around it, for smooth magnification. Shrunk by 2 or more, it
+ * samples the mip level closest to the destination size instead of the image.
+ * Trilinear also mixes in the next smaller level, so the blur follows the
+ * scale smoothly instead of stepping at every halving. Box averages the
+ * texels a pixel covers by area, exact at any scale but slower. Magnified, it
+ * keeps texels sharp with only their edges mixed. */
+typedef enum {
+    PICASSO_FILTER_NEAREST,
+    PICASSO_FILTER_BILINEAR,
+    PICASSO_FILTER_BOX,
+    PICASSO_FILTER_TRILINEAR,
+} picasso_filter;
+
 /* Draws a region from a source image into a destination backbuffer.
  *        Handles cropping, scaling, and blending.
- *        This is the core pixel blitter in Picasso. */
+ *        This is the core pixel blitter in Picasso. Nearest sampling */
 void picasso_blit(picasso_backbuffer *dst, picasso_image *src, picasso_rect src_rect, picasso_rect dst_rect);
+void picasso_blit_ex(picasso_backbuffer *dst, picasso_image *src, picasso_rect src_rect,
+                     picasso_rect dst_rect, picasso_filter filter);
 void picasso_blit_bitmap(picasso_backbuffer *dst, picasso_image *src, int offset_x, int offset_y);
+
+/* A 2D affine transform from image texels to logical backbuffer coordinates:
+ * the point (u, v) of the image, 0..width and 0..height, lands on
+ *     x = a * u + c * v + tx
+ *     y = b * u + d * v + ty
+ * Angles turn clockwise on screen, y points down. */
+typedef struct {
+    float a, b, c, d;
+    float tx, ty;
+} picasso_affine;
+
+picasso_affine picasso_affine_identity(void);
+picasso_affine picasso_affine_mul(picasso_affine m, picasso_affine n); // m * n, n applies first
+picasso_affine picasso_affine_translate(float x, float y);
+picasso_affine picasso_affine_scale(float x, float y);
+picasso_affine picasso_affine_rotate(float radians);
+
+/* Draws the whole image transformed by m: rotated, scaled, sheared or
+ * mirrored. The edges of the image are anti-aliased, nearest keeps the texels
+ * sharp inside them and bilinear mixes the four around every pixel. Shrunk by
+ * 2 or more, bilinear samples a mip level. Box and trilinear sample like
+ * bilinear here. */
+void picasso_blit_affine(picasso_backbuffer *bf, picasso_image *src, const picasso_affine *m,
+                         picasso_filter filter);
 void* picasso_backbuffer_pixels(picasso_backbuffer *bf);
 
 /* -------------------- Picasso Image Section -------------------- */
 void picasso_copy(picasso_image *src, picasso_image *dst);
 
+/* -------------------- Color Conversion -------------------- */
+/* Packed RGB or RGBA images to other color models and back, a few hundred
+ * pixels at a time through SIMD kernels. Planar results are one 1 channel
+ * image per component, each the size of the packed image. Every conversion
+ * has a _rows form that does rows y0 up to y1 only, for callers that split
+ * frames up themselves; the whole image forms spread the rows over the job
+ * system and then set the alpha and premultiplied of what they wrote, which
+ * the _rows forms leave to the caller. Color is converted as stored, so
+ * unpremultiply translucent images first. Images have to be linear. False
+ * when the sizes, channels or layouts don't fit, or the rows are out of range */
+typedef enum {
+    PICASSO_YCBCR_BT601 = 0,        // JPEG, full range
+    PICASSO_YCBCR_BT601_LIMITED,    // SD video, Y in 16-235 and Cb, Cr in 16-240
+    PICASSO_YCBCR_BT709,            // full range
+    PICASSO_YCBCR_BT709_LIMITED,    // HD video
+} picasso_ycbcr;
+
+// Y, Cb and Cr planes of an RGB(A) image, alpha is dropped
+bool picasso_rgb_to_ycbcr(picasso_image *src, picasso_image *const planes[3], picasso_ycbcr space);
+bool picasso_rgb_to_ycbcr_rows(picasso_image *src, picasso_image *const planes[3],
+                               picasso_ycbcr space, int y0, int y1);
+// Back to RGB(A), opaque
+bool picasso_ycbcr_to_rgb(picasso_image *const planes[3], picasso_image *dst, picasso_ycbcr space);
+bool picasso_ycbcr_to_rgb_rows(picasso_image *const planes[3], picasso_image *dst,
+                               picasso_ycbcr space, int y0, int y1);
+// Only the Y, into a 1 channel image
+bool picasso_luma(picasso_image *src, picasso_image *dst, picasso_ycbcr space);
+bool picasso_luma_rows(picasso_image *src, picasso_image *dst, picasso_ycbcr space, int y0, int y1);
+
+/* RGB(A) to packed HSV(A) with the same channels and back, alpha kept. All
+ * three are 0-255, hue going all the way round: red at 0, green at 85 and
+ * blue at 171 */
+bool picasso_rgb_to_hsv(picasso_image *src, picasso_image *dst);
+bool picasso_rgb_to_hsv_rows(picasso_image *src, picasso_image *dst, int y0, int y1);
+bool picasso_hsv_to_rgb(picasso_image *src, picasso_image *dst);
+bool picasso_hsv_to_rgb_rows(picasso_image *src, picasso_image *dst, int y0, int y1);
+
+// A plane per channel of src, src->channels of them
+bool picasso_split_planes(picasso_image *src, picasso_image *const planes[]);
+bool picasso_split_planes_rows(picasso_image *src, picasso_image *const planes[], int y0, int y1);
+// dst->channels planes interleaved into dst
+bool picasso_merge_planes(picasso_image *const planes[], picasso_image *dst);
+bool picasso_merge_planes_rows(picasso_image *const planes[], picasso_image *dst, int y0, int y1);
+
 /* -------------------- Graphical Raster Section -------------------- */
 
 void picasso_fill_rect(picasso_backbuffer *bf, picasso_rect *r, color c);
 void picasso_draw_rect(picasso_backbuffer *bf, picasso_rect *outer, int thickness, color c);
 void picasso_draw_line(picasso_backbuffer *bf, int x0, int y0, int x1, int y1, color c);
 void picasso_draw_line_aa(picasso_backbuffer *bf, float x0, float y0, float x1, float y1, color c);
+// Stroked through the pixel centers with round caps, thickness wide
 void picasso_draw_line_thick(picasso_backbuffer *bf, int x0, int y0, int x1, int y1, int thickness, color c);
+// A ring one pixel wide at radius r, anti-aliased on both sides
 void picasso_draw_circle_aa(picasso_backbuffer *bf, int cx, int cy, int r, color c);
 void picasso_fill_circle_aa(picasso_backbuffer *bf, int cx, int cy, int radius, color c);
 void picasso_draw_circle(picasso_backbuffer *bf, int x0, int y0, int radius,int thickness, color c);
@@ -289,6 +500,281 @@ void picasso_fill_circle(picasso_backbuffer *bf, int x0, int y0, int radius, col
 void picasso_fill_triangle(picasso_backbuffer *bf, picasso_point3 p, color c);
 void picasso_draw_triangle_aa(picasso_backbuffer *bf, picasso_point3 pts, color fill_color, color edge_color);
 
+/* Draws index_count / 3 triangles, each three indices into vertices. With
+ * indices NULL the vertices are used in order. Vertex colors are blended
+ * across each triangle, and with a texture every pixel is the nearest texel
+ * at the interpolated uv, tinted by the vertex color (white leaves it as is).
+ * Triangles that share an edge never overlap or leave a gap. */
+void picasso_draw_mesh(picasso_backbuffer *bf, const picasso_vertex *vertices, int vertex_count,
+                       const uint32_t *indices, int index_count, picasso_image *texture);
+
+/* -------------------- Paths -------------------- */
+/* Arbitrary shapes out of lines, quadratic and cubic Béziers, in logical
+ * coordinates. A path is one or more contours, each starting with a move,
+ * and every contour is closed when filled. Curves are flattened into lines
+ * fine enough that the error stays well under a pixel, and the lines are
+ * rasterized with exact area coverage, so edges are anti-aliased and a shape
+ * is filled in one pass, every pixel blended once. */
+typedef enum {
+    PICASSO_FILL_NONZERO,   // inside where the contours wind around it at all
+    PICASSO_FILL_EVEN_ODD,  // inside where an odd number of contours cross over it
+} picasso_fill_rule;
+
+typedef enum {
+    PICASSO_PATH_MOVE,   // 1 point
+    PICASSO_PATH_LINE,   // 1 point
+    PICASSO_PATH_QUAD,   // control, end
+    PICASSO_PATH_CUBIC,  // control, control, end
+    PICASSO_PATH_CLOSE,  // no points
+} picasso_path_verb;
+
+typedef struct {
+    uint8_t *verbs;          // picasso_path_verb
+    float *points;           // x, y pairs, as many as the verbs take
+    int verb_count, verb_capacity;
+    int point_count, point_capacity;
+
+    float x0, y0, x1, y1;    // bounds of every point, control points included
+    float start_x, start_y;  // where the current contour started
+    bool has_current;        // false until the first move
+} picasso_path;
+
+picasso_path *picasso_create_path(void);
+void picasso_destroy_path(picasso_path *path);
+// Drops every contour, keeps the memory
+void picasso_path_reset(picasso_path *path);
+
+// Drawing without a move first starts the contour at that point
+void picasso_path_move_to(picasso_path *path, float x, float y);
+void picasso_path_line_to(picasso_path *path, float x, float y);
+void picasso_path_quad_to(picasso_path *path, float cx, float cy, float x, float y);
+void picasso_path_cubic_to(picasso_path *path, float c1x, float c1y,
+                           float c2x, float c2y, float x, float y);
+void picasso_path_close(picasso_path *path);
+
+void picasso_fill_path(picasso_backbuffer *bf, const picasso_path *path,
+                       picasso_fill_rule rule, color c);
+
+/* A stroke runs along every contour of a path, width wide and centered on
+ * it. The outline of the whole stroke, joins and caps included, is built
+ * first and then filled like a path, so where the stroke overlaps itself
+ * nothing is blended twice. */
+typedef enum {
+    PICASSO_JOIN_MITER,  // sharp corner, beveled past the miter limit
+    PICASSO_JOIN_ROUND,
+    PICASSO_JOIN_BEVEL,
+} picasso_line_join;
+
+typedef enum {
+    PICASSO_CAP_BUTT,    // ends flat at the end point
+    PICASSO_CAP_ROUND,
+    PICASSO_CAP_SQUARE,  // ends flat, half the width past the end point
+} picasso_line_cap;
+
+typedef struct {
+    float width;             // logical
+    picasso_line_join join;
+    picasso_line_cap cap;    // both ends of contours that aren't closed
+    float miter_limit;       // miters longer than this many widths are beveled, 0 picks 4
+} picasso_stroke_style;
+
+void picasso_stroke_path(picasso_backbuffer *bf, const picasso_path *path,
+                         const picasso_stroke_style *style, color c);
+
+/* -------------------- Sprites -------------------- */
+/* Many small images packed into one, so thousands of them can be drawn from
+ * it in a single call. The atlas image is premultiplied RGBA, and its alpha
+ * kind describes the sprites, not the transparent gaps between them. */
+typedef struct {
+    picasso_image *image;
+    picasso_rect *rects;   // where images[i] of picasso_create_atlas ended up
+    int count;
+} picasso_atlas;
+
+// Copies the images into a new atlas, they can be freed afterwards
+picasso_atlas *picasso_create_atlas(picasso_image *const *images, int count);
+void picasso_destroy_atlas(picasso_atlas *atlas);
+
+enum {
+    PICASSO_SPRITE_FLIP_X = 1 << 0, // mirrored left to right
+    PICASSO_SPRITE_FLIP_Y = 1 << 1, // upside down
+};
+
+typedef struct {
+    float x, y;        // logical top left, snapped to the nearest pixel
+    picasso_rect src;  // in the atlas image, usually one of atlas->rects
+    float scale;       // of the source size, 0 is 1
+    int flags;         // PICASSO_SPRITE_FLIP_X and _Y
+    color tint;        // multiplies the texels, WHITE leaves them as they are
+} picasso_sprite;
+
+/* Draws count sprites in order, each like a nearest sampled blit of its
+ * source rect. The clip and every sprite's bounds are worked out once, and
+ * sprites outside of the clip cost next to nothing */
+void picasso_draw_sprites(picasso_backbuffer *bf, const picasso_atlas *atlas,
+                          const picasso_sprite *sprites, int count);
+
+/* -------------------- Text -------------------- */
+/* TrueType fonts, through stb_truetype. Glyphs are rasterized the first time
+ * they are drawn and kept in a glyph cache all fonts share, an A8 atlas keyed
+ * by font, pixel size, codepoint and quarter pixel offset. Drawing text only
+ * blends coverage out of it. When the atlas is full, the glyphs drawn longest
+ * ago make room. Text is laid out (decoded, kerned and wrapped) once per
+ * string, font size and wrap width, and kept in a layout cache keyed by the
+ * contents of the string, so drawing or measuring the same text again only
+ * hashes it. */
+typedef struct picasso_font picasso_font;
+
+typedef struct {
+    float ascent;    // above the baseline, logical pixels
+    float descent;   // below it, negative
+    float line_gap;  // between the descent of a line and the ascent of the next
+} picasso_font_metrics;
+
+typedef struct {
+    float width;     // of the longest line, logical pixels
+    float height;    // lines times the distance between baselines
+    int lines;
+} picasso_text_extent;
+
+// Drawn around distance field text, under it
+typedef struct {
+    color outline;
+    float outline_width;  // logical pixels out from the glyphs, 0 for none
+    color glow;
+    float glow_width;     // logical pixels it fades out over, 0 for none
+} picasso_text_effects;
+
+/* The font file is copied. index picks a font out of a collection, 0 for a
+ * plain font file. pixel_height is from the lowest descender to the highest
+ * ascender, in logical pixels */
+picasso_font *picasso_create_font(const uint8_t *data, size_t size, int index, float pixel_height);
+picasso_font *picasso_load_font(const char *path, float pixel_height);
+void picasso_destroy_font(picasso_font *font);
+void picasso_font_set_size(picasso_font *font, float pixel_height);
+picasso_font_metrics picasso_font_get_metrics(const picasso_font *font);
+// Advance of the longest line, kerned, in logical pixels
+float picasso_text_width(const picasso_font *font, const char *utf8);
+// The size of text as picasso_draw_text_wrapped lays it out
+picasso_text_extent picasso_measure_text(const picasso_font *font, const char *utf8, float wrap_width);
+
+/* Draws UTF-8 text with the pen starting at x on the baseline y, in logical
+ * coordinates. Kerned, and a newline starts the next line at x. Recorded,
+ * the font and the string are referenced like images */
+void picasso_draw_text(picasso_backbuffer *bf, const picasso_font *font, const char *utf8,
+                       float x, float y, color c);
+/* Like picasso_draw_text, but a word that would end past x + wrap_width goes
+ * down a line, and a word longer than that is broken where it reaches it.
+ * Spaces hang past the end of a line. 0 doesn't wrap */
+void picasso_draw_text_wrapped(picasso_backbuffer *bf, const picasso_font *font, const char *utf8,
+                               float x, float y, float wrap_width, color c);
+/* Like picasso_draw_text, from signed distance fields baked once per glyph
+ * at 48 pixels and scaled to any size, so zooming or animating the size
+ * rasterizes nothing. Edges are a little softer than picasso_draw_text's,
+ * most at small sizes. Outline and glow reach at most a sixth of the font
+ * size past the glyphs. effects may be NULL */
+void picasso_draw_text_sdf(picasso_backbuffer *bf, const picasso_font *font, const char *utf8,
+                           float x, float y, color c, const picasso_text_effects *effects);
+
+/* -------------------- Command Recording -------------------- */
+/* Between begin and submit the drawing functions above don't touch any pixels,
+ * they are recorded instead. Submitting replays them, either straight through
+ * or binned into PICASSO_TILE_SIZE tiles that are rasterized in parallel. Each
+ * tile replays its commands in the order they were issued, so both ways give
+ * exactly the same pixels as drawing immediately.
+ *
+ * Images, bitmaps, meshes, paths, atlases, sprite lists, fonts and strings
+ * are referenced, not copied, so they must stay alive and unchanged until the
+ * submit.
+ *
+ * With PICASSO_SUBMIT_CULL the frame is analyzed first: consecutive fills of
+ * the same color are merged, and anything underneath a later opaque fill,
+ * clear or opaque blit is skipped, in whole or in part. The pixels are still
+ * the same as drawing immediately. */
+#define PICASSO_TILE_SIZE 64
+
+enum {
+    PICASSO_SUBMIT_IMMEDIATE = 0,      // replay in order on the calling thread
+    PICASSO_SUBMIT_TILED     = 1 << 0, // bin into tiles, one tile per worker
+    PICASSO_SUBMIT_CULL      = 1 << 1, // merge fills, skip what opaque rects hide
+    PICASSO_SUBMIT_DAMAGED   = 1 << 2, // only redraw the damaged area
+};
+
+void picasso_begin_commands(picasso_backbuffer *bf);
+void picasso_submit_commands(picasso_backbuffer *bf, int flags);
+// Number of threads rasterizing tiles, taken from Canopy's job system (see
+// set_job_threads). 0 or less uses all of its threads
+void picasso_set_render_threads(int count);
+
+/* -------------------- Damage Tracking -------------------- */
+/* Every primitive unions the pixels it may touch into bf->damage, and
+ * picasso_present_damage() only presents that. Since presenting swaps the
+ * buffers, the backbuffer we get back is two frames old, so the area to
+ * redraw is this frame's damage plus the previous frame's.
+ *
+ * For a mostly static frame, mark what changed (where a cursor was and where
+ * it is now), record the whole scene, and submit it with
+ * PICASSO_SUBMIT_DAMAGED: only the damaged area gets rasterized, and nothing
+ * gets presented when nothing changed. */
+
+// Marks a logical rect as changed, NULL marks the whole backbuffer
+void picasso_damage_rect(picasso_backbuffer *bf, picasso_rect *r);
+// Clears only the area that needs a redraw, instead of the whole backbuffer
+void picasso_clear_damage(picasso_backbuffer *bf);
+// Forgets all damage, current and previous
+void picasso_reset_damage(picasso_backbuffer *bf);
+// Swaps the backbuffer into the window and presents only the damage
+void picasso_present_damage(Window *window, picasso_backbuffer *bf);
+
+/* -------------------- 3D -------------------- */
+/* An optional 3D stage on top of the triangle rasterizer. Vertices are
+ * transformed by a 4x4 matrix (model, view and projection in one) into clip
+ * space, clipped against the near plane, projected onto the whole backbuffer
+ * and rasterized with a depth test. Colors and texture coordinates are
+ * interpolated perspective correct.
+ *
+ * Matrices are column major and transform column vectors, the clip space is
+ * the usual one: visible points have -w <= x, y, z <= w. Front faces are
+ * counter-clockwise on screen.
+ *
+ * The depth buffer lives on the backbuffer, attach one before drawing. Depth
+ * is written even where a pixel's color ends up transparent. */
+typedef struct {
+    float m[16]; // m[column * 4 + row]
+} picasso_mat4;
+
+typedef struct {
+    float x, y, z;  // model space
+    color c;
+    float u, v;     // texture coordinates, 0..1 across the whole image
+} picasso_vertex3d;
+
+enum {
+    PICASSO_3D_CULL_BACK  = 1 << 0, // skip triangles facing away
+    PICASSO_3D_NO_DEPTH   = 1 << 1, // draw without testing or writing depth
+};
+
+picasso_mat4 picasso_mat4_identity(void);
+picasso_mat4 picasso_mat4_mul(picasso_mat4 a, picasso_mat4 b); // a * b, b applies first
+picasso_mat4 picasso_mat4_translate(float x, float y, float z);
+picasso_mat4 picasso_mat4_scale(float x, float y, float z);
+picasso_mat4 picasso_mat4_rotate_x(float radians);
+picasso_mat4 picasso_mat4_rotate_y(float radians);
+picasso_mat4 picasso_mat4_rotate_z(float radians);
+// Right handed, the camera looks down -z. fov_y in radians
+picasso_mat4 picasso_mat4_perspective(float fov_y, float aspect, float z_near, float z_far);
+
+// Attaches (or replaces) a 16 or 32 bit depth buffer, cleared to the far plane
+bool picasso_attach_depth(picasso_backbuffer *bf, int bits);
+void picasso_clear_depth(picasso_backbuffer *bf);
+
+/* Same layout as picasso_draw_mesh(). The matrix is copied when recording,
+ * the vertices, indices and texture are referenced */
+void picasso_draw_mesh3d(picasso_backbuffer *bf, const picasso_mat4 *mvp,
+                         const picasso_vertex3d *vertices, int vertex_count,
+                         const uint32_t *indices, int index_count,
+                         picasso_image *texture, int flags);
+
 /* -------------------- Format Section -------------------- */
 // Define BMP file header structures
 #pragma pack(push,1) //https://www.ibm.com/docs/no/zos/2.4.0?topic=descriptions-pragma-pack
@@ -369,6 +855,8 @@ picasso_vec2 vector_sub(picasso_vec2 v1, picasso_vec2 v2);
 picasso_vec2 vector_scale(picasso_vec2 v1, float scale);
 picasso_vec2 lerp_vec2(picasso_vec2 v1, picasso_vec2 v2, float t);
 picasso_vec2 bezier_lerp(picasso_vec2 p0, picasso_vec2 p1, picasso_vec2 p2, float t);
+// A 4 wide red stroke along the quadratic curve. The curve is flattened as
+// finely as it needs, resolution is no longer used
 void draw_bezier(picasso_backbuffer *bf, picasso_vec2 p0, picasso_vec2 p1, picasso_vec2 p2, int resolution);
 
 
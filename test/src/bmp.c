@@ -1,8 +1,10 @@
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <blackbox.h>
 
 #include "picasso.h"
+#include "picasso_internal.h"
 #include "picasso_icc_profiles.h"
 
 #define LCS_GM_BUSINESS          (1<<0) // 0x00000001  // Saturation
@@ -184,6 +186,27 @@ static bool picasso_embed_icc_profile(bmp *image, picasso_icc_profile profile, F
     return true;
 }
 
+typedef struct {
+    uint8_t *buffer;
+    int height, row_size;
+} picasso_flip_job;
+
+// Swaps rows y0 to y1 of the top half with their mirror in the bottom half
+static void picasso__flip_rows(int y0, int y1, void *arg)
+{
+    picasso_flip_job *job = arg;
+    uint8_t temp_row[job->row_size];
+
+    for (int y = y0; y < y1; y++) {
+        uint8_t *top = &job->buffer[(size_t)y * job->row_size];
+        uint8_t *bottom = &job->buffer[(size_t)(job->height - y - 1) * job->row_size];
+
+        memcpy(temp_row, top, job->row_size);
+        memcpy(top, bottom, job->row_size);
+        memcpy(bottom, temp_row, job->row_size);
+    }
+}
+
 void picasso_flip_buffer_vertical(uint8_t *buffer, int width, int height, int channels)
 {
     int row_size = ((width * channels + 3) / 4) * 4; // include padding!
@@ -191,16 +214,8 @@ void picasso_flip_buffer_vertical(uint8_t *buffer, int width, int height, int ch
     TRACE("Flipping buffer vertically (%dx%d) channels: %d, row_size: %d",
             width, height, channels, row_size);
 
-    uint8_t temp_row[row_size];
-
-    for (int y = 0; y < height / 2; y++) {
-        int top_index = y * row_size;
-        int bottom_index = (height - y - 1) * row_size;
-
-        memcpy(temp_row, &buffer[top_index], row_size);
-        memcpy(&buffer[top_index], &buffer[bottom_index], row_size);
-        memcpy(&buffer[bottom_index], temp_row, row_size);
-    }
+    picasso_flip_job job = { buffer, height, row_size };
+    picasso__parallel_rows(height / 2, width, picasso__flip_rows, &job);
 
     TRACE("Finished vertical flip");
 }
@@ -282,6 +297,58 @@ int picasso_save_to_bmp(bmp *image, const char *file_path, picasso_icc_profile p
     return 0;
 }
 
+typedef struct {
+    const uint8_t *src;
+    uint8_t *dst;
+    int width, channels, row_stride, row_size;
+    atomic_bool any_alpha;
+} picasso_bmp_encode;
+
+static void picasso__bmp_encode_rows(int y0, int y1, void *arg)
+{
+    picasso_bmp_encode *job = arg;
+    int width = job->width, channels = job->channels;
+    bool any_alpha = false;
+
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t *src_row = &job->src[(size_t)y * job->row_stride];
+        uint8_t *dst_row = &job->dst[(size_t)y * job->row_size];
+
+        for (int x = 0; x < width; ++x) {
+            const uint8_t *src = &src_row[x * channels];
+            uint8_t *dst = &dst_row[x * channels];
+
+            // Two operations in once, writing to, and
+            // swapping RGBA -> BGRA
+            if(channels >= 1)
+            dst[0] = src[2]; // B
+            dst[1] = src[1]; // G
+            dst[2] = src[0]; // R
+            if (channels == 4) {
+                dst[3] = src[3]; // Respect original alpha
+                if(src[3] != 0) any_alpha = true;
+            }
+        }
+        // Fill padding bytes with zeros
+        int padding = job->row_size - job->row_stride;
+        if (padding > 0) {
+            memset(dst_row + job->row_stride, 0, padding);
+        }
+    }
+    if (any_alpha) atomic_store(&job->any_alpha, true);
+}
+
+static void picasso__bmp_opaque_rows(int y0, int y1, void *arg)
+{
+    picasso_bmp_encode *job = arg;
+    for (int y = y0; y < y1; ++y) {
+        uint8_t *dst_row = job->dst + (size_t)y * job->row_size;
+        for (int x = 0; x < job->width; ++x) {
+            dst_row[x * 4 + 3] = 0xFF;
+        }
+    }
+}
+
 bmp *picasso_create_bmp_from_rgba(uint8_t *pixel_data, int width, int height, int channels)
 {
     if (width <= 0 || height == 0 || !pixel_data) {
@@ -333,40 +400,14 @@ bmp *picasso_create_bmp_from_rgba(uint8_t *pixel_data, int width, int height, in
     }
 
     // --- Fill each row ---
-    for (int y = 0; y < abs_height; ++y) {
-        const uint8_t *src_row = &pixel_data[y * row_stride];
-        uint8_t *dst_row = &b->pixels[y * row_size];
-
-        for (int x = 0; x < width; ++x) {
-            const uint8_t *src = &src_row[x * channels];
-            uint8_t *dst = &dst_row[x * channels];
-
-            // Two operations in once, writing to, and
-            // swapping RGBA -> BGRA
-            if(channels >= 1)
-            dst[0] = src[2]; // B
-            dst[1] = src[1]; // G
-            dst[2] = src[0]; // R
-            if (channels == 4) {
-                dst[3] = src[3]; // Respect original alpha
-                if(src[3] != 0) all_alpha_zero = false;
-            }
-        }
-        // Fill padding bytes with zeros
-        int padding = row_size - row_stride;
-        if (padding > 0) {
-            memset(dst_row + row_stride, 0, padding);
-        }
-    }
+    picasso_bmp_encode job = { pixel_data, b->pixels, width, channels, row_stride, row_size, false };
+    atomic_init(&job.any_alpha, false);
+    picasso__parallel_rows(abs_height, width, picasso__bmp_encode_rows, &job);
+    if (channels == 4 && atomic_load(&job.any_alpha)) all_alpha_zero = false;
 
     if (channels == 4 && all_alpha_zero) {
         TRACE("All alpha values were zero — replacing with opaque alpha");
-        for (int y = 0; y < abs_height; ++y) {
-            uint8_t *dst_row = b->pixels + y * row_size;
-            for (int x = 0; x < width; ++x) {
-                dst_row[x * 4 + 3] = 0xFF;
-            }
-        }
+        picasso__parallel_rows(abs_height, width, picasso__bmp_opaque_rows, &job);
     }
 
     TRACE("BMP created (%dx%d @ %d-bit, padded rows)", width, abs_height, channels * 8);
@@ -580,6 +621,43 @@ static void picasso__parse_v5_fields(_bmp_load_info *bmp)
         }
     }
 }
+typedef struct {
+    picasso_image *img;
+    const _bmp_load_info *bmp;
+    atomic_bool any_alpha;
+} picasso_bmp_decode;
+
+static void picasso__bmp_decode_rows(int y0, int y1, void *arg)
+{
+    picasso_bmp_decode *job = arg;
+    picasso_image *img = job->img;
+    _bmp_load_info bmp = *job->bmp;
+    bool any_alpha = false;
+
+    color c;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = 0; x < img->width; ++x) {
+            uint8_t *pixel = picasso__get_pixel_u8(img, x, y);
+            if (bmp.comp == BI_BITFIELDS && bmp.channels == 4) {
+                // Decode from 32-bit pixel using bitmasks
+                decode_and_write_pixel_32bit(c, pixel);
+                if (pixel[3] != 0) any_alpha = true;
+            } else {
+                PICASSO_SWAP(pixel[0], pixel[2]); // BGR → RGB
+            }
+        }
+    }
+    if (any_alpha) atomic_store(&job->any_alpha, true);
+}
+
+static void picasso__bmp_opaque_alpha_rows(int y0, int y1, void *arg)
+{
+    picasso_bmp_decode *job = arg;
+    for (int y = y0; y < y1; ++y)
+        for (int x = 0; x < job->img->width; ++x)
+            picasso__get_pixel_u8(job->img, x, y)[3] = 0xFF;
+}
+
 /* Robust, and should handle all format now.. */
 picasso_image *picasso_load_bmp(const char *filename)
 {
@@ -623,6 +701,10 @@ picasso_image *picasso_load_bmp(const char *filename)
         img->channels   = bmp.channels;
         img->row_stride = bmp.row_stride;
         img->pixels     = picasso_malloc(bmp.row_stride * bmp.height);
+        img->alpha      = PICASSO_ALPHA_UNKNOWN;
+        img->premultiplied = false;
+        img->mip        = NULL;
+        img->layout     = PICASSO_LAYOUT_LINEAR;
     }
 
     uint8_t *row_buf = picasso_malloc(bmp.row_size);
@@ -645,25 +727,17 @@ picasso_image *picasso_load_bmp(const char *filename)
     /* Finally done reading the file */
     fclose(fp);
 
-    bmp.set_all_alpha = true;
-
-    color c;
-    foreach_pixel_u8(img, {
-        if (bmp.comp == BI_BITFIELDS && bmp.channels == 4) {
-            // Decode from 32-bit pixel using bitmasks
-            decode_and_write_pixel_32bit(c, pixel);
-            if (pixel[3] != 0) bmp.set_all_alpha = false;
-        } else {
-            PICASSO_SWAP(pixel[0], pixel[2]); // BGR → RGB
-        }
-    });
+    picasso_bmp_decode job = { img, &bmp, false };
+    atomic_init(&job.any_alpha, false);
+    picasso__parallel_rows(img->height, img->width, picasso__bmp_decode_rows, &job);
+    bmp.set_all_alpha = !atomic_load(&job.any_alpha);
 
     if (bmp.set_all_alpha && img->channels == 4)
     {
         TRACE("All alpha values were zero — setting to 0xff");
-        foreach_pixel_u8(img, {
-            pixel[3] = 0xFF;
-        });
+        picasso__parallel_rows(img->height, img->width, picasso__bmp_opaque_alpha_rows, &job);
     }
+    picasso_image_update_alpha(img);
+    picasso_image_premultiply(img);
     return img;
 }
@@ -3,11 +3,13 @@
 #include <stdint.h>
 #include <string.h>
 #include <math.h>
+#include <stdatomic.h>
 #include <blackbox.h>
 
 #include <canopy.h>
 
 #include "picasso.h"
+#include "picasso_internal.h"
 
 
 void* picasso_calloc(size_t count, size_t size){
@@ -302,138 +304,196 @@ picasso_image *picasso_alloc_image(int width, int height, int channels)
     img->height = height;
     img->channels = channels;
     img->row_stride = channels * width;
-    img->pixels = picasso_calloc(sizeof(uint8_t), img->width * img->row_stride);
+    img->pixels = picasso_calloc(sizeof(uint8_t), (size_t)img->height * img->row_stride);
+    img->layout = PICASSO_LAYOUT_LINEAR;
     if (!img->pixels) {
-        free(img);
+        picasso_free(img);
         return NULL;
     }
+    // The pixels are about to be written by the caller, so with an alpha
+    // channel nothing is known yet
+    img->alpha = (channels == 2 || channels == 4) ? PICASSO_ALPHA_UNKNOWN : PICASSO_ALPHA_OPAQUE;
+    img->premultiplied = false;
+    img->mip = NULL;
 
     return img;
 }
 
-void picasso_free_image(picasso_image *img)
+typedef struct {
+    const picasso_image *img;
+    atomic_bool zero, blend; // alpha 0 seen, anything in between seen
+} picasso_alpha_scan;
+
+static void picasso__scan_alpha_rows(int y0, int y1, void *arg)
 {
-    if (img) {
-        free(img->pixels);
-        free(img);
+    picasso_alpha_scan *scan = arg;
+    const picasso_image *img = scan->img;
+    bool zero = false;
+
+    for (int y = y0; y < y1 && !atomic_load_explicit(&scan->blend, memory_order_relaxed); ++y) {
+        const uint8_t *row = &img->pixels[picasso__row_offset(img, y) + img->channels - 1];
+        for (int x = 0, run; x < img->width; x += run) {
+            run = picasso__row_run(img, x, img->width - x);
+            const uint8_t *a = row + picasso__col_offset(img, x);
+            for (int i = 0; i < run; ++i, a += img->channels) {
+                if (*a == 255) continue;
+                if (*a != 0) {
+                    atomic_store(&scan->blend, true);
+                    return;
+                }
+                zero = true;
+            }
+        }
     }
+    if (zero) atomic_store(&scan->zero, true);
 }
 
-// --------------------------------------------------------
-// Graphical functions and utilities
-// --------------------------------------------------------
-/* Here we are supporting negative width and height, drawing
- * in all directions! */
-static void picasso__normalize_rect(picasso_rect *r)
+void picasso_image_update_alpha(picasso_image *img)
 {
-    if(!r) {WARN("Tried to normalize a NULL object");return;}
-    if (r->width < 0) {
-        r->x += r->width;
-        r->width = -r->width;
-    }
-    if (r->height < 0) {
-        r->y += r->height;
-        r->height = -r->height;
+    if (!img || !img->pixels) return;
+    if (img->channels != 2 && img->channels != 4) {
+        img->alpha = PICASSO_ALPHA_OPAQUE;
+        return;
     }
-}
-/* Creating the bounds for looping over, removing the logic from the draw
- * functions */
-static bool picasso__clip_rect_to_bounds(picasso_backbuffer *bf,
-        const picasso_rect *r, picasso_draw_bounds *db)
-{
-    if (!r || r->width == 0 || r->height == 0)
-        return false;
-
-    if (r->x >= (int)bf->width || r->y >= (int)bf->height ||
-        r->x + r->width <= 0 || r->y + r->height <= 0)
-        return false;
 
-    // Simple logic to force the rect inside the backbuffer
-    db->x0 = (r->x > 0) ? r->x : 0;
-    db->y0 = (r->y > 0) ? r->y : 0;
-    db->x1 = (r->x + r->width  < (int)bf->width)  ?
-        r->x + r->width  : (int)bf->width;
-    db->y1 = (r->y + r->height < (int)bf->height) ?
-        r->y + r->height : (int)bf->height;
-
-    return true;
+    picasso_alpha_scan scan = { .img = img };
+    atomic_init(&scan.zero, false);
+    atomic_init(&scan.blend, false);
+    picasso__parallel_rows(img->height, img->width, picasso__scan_alpha_rows, &scan);
+    img->alpha = atomic_load(&scan.blend) ? PICASSO_ALPHA_BLEND
+               : atomic_load(&scan.zero)  ? PICASSO_ALPHA_MASK : PICASSO_ALPHA_OPAQUE;
 }
 
-static inline uint32_t picasso__blend_pixel(uint32_t dst, uint32_t src)
-{
-    color back  = u32_to_color(dst);
-    color front = u32_to_color(src);
-
-    uint8_t sa = front.a;
-    if (sa == 255) return src;
-    if (sa == 0)   return dst;
-
-    uint8_t r = (front.r * sa + back.r * (255 - sa)) / 255;
-    uint8_t g = (front.g * sa + back.g * (255 - sa)) / 255;
-    uint8_t b = (front.b * sa + back.b * (255 - sa)) / 255;
-    uint8_t a = (front.a * 255 + back.a * (255 - sa)) / 255;
+typedef struct {
+    picasso_image *img;
+    uint32_t (*convert)(uint32_t);
+} picasso_alpha_convert;
 
-    color blended = { r, g, b, a };
-    return color_to_u32(blended);
-}
-void draw_bitmap_to_backbuffer(picasso_backbuffer *bf, uint8_t *bitmap, int w,
-                                int h, int xoff, int yoff, color c)
+static void picasso__convert_alpha_rows(int y0, int y1, void *arg)
 {
-    for (int j = 0; j < h; ++j) {
-        for (int i = 0; i < w; ++i) {
-            int x = xoff + i;
-            int y = yoff + j;
-            if (x < 0 || x >= (int)bf->width || y < 0 || y >= (int)bf->height)
-                continue;
-
-            uint8_t value = bitmap[j * w + i];
-            if (value == 0) continue;  //Optional: skip fully transparent pixels
-
-            uint32_t dst = *picasso__get_pixel_u32(bf, x, y);
-            *picasso__get_pixel_u32(bf, x, y) =
-                                picasso__blend_pixel(dst, color_to_u32(c));
+    picasso_alpha_convert *job = arg;
+    picasso_image *img = job->img;
+
+    for (int y = y0; y < y1; ++y) {
+        uint8_t *row = &img->pixels[picasso__row_offset(img, y)];
+        for (int x = 0, run; x < img->width; x += run) {
+            run = picasso__row_run(img, x, img->width - x);
+            uint8_t *p = row + picasso__col_offset(img, x);
+            for (int i = 0; i < run; ++i, p += img->channels) {
+                if (img->channels == 4) {
+                    uint32_t v;
+                    memcpy(&v, p, sizeof(v));
+                    v = job->convert(v);
+                    memcpy(p, &v, sizeof(v));
+                } else {
+                    // Gray and alpha, the gray stands in for all three colors
+                    p[0] = (uint8_t)job->convert((uint32_t)p[1] << 24 | p[0]);
+                }
+            }
         }
     }
 }
 
-// --------------------------------------------------------
-// Scaling helpers for support of high dpi and points
-// --------------------------------------------------------
-static inline int picasso__to_px_x(const picasso_backbuffer *bf, int x)
+// Color channels of every pixel times (or divided by) its alpha
+static void picasso__image_convert_alpha(picasso_image *img, uint32_t (*convert)(uint32_t))
 {
-    return (int)lroundf((float)x * bf->scale_x);
+    picasso_alpha_convert job = { img, convert };
+    picasso__parallel_rows(img->height, img->width, picasso__convert_alpha_rows, &job);
 }
 
-static inline int picasso__to_px_y(const picasso_backbuffer *bf, int y)
+void picasso_image_premultiply(picasso_image *img)
 {
-    return (int)lroundf((float)y * bf->scale_y);
+    if (!img || !img->pixels || img->premultiplied) return;
+    if ((img->channels == 2 || img->channels == 4) && img->alpha != PICASSO_ALPHA_OPAQUE)
+        picasso__image_convert_alpha(img, picasso__premultiply);
+    img->premultiplied = true;
 }
 
-static inline int picasso__to_px_w(const picasso_backbuffer *bf, int w)
+bool picasso_image_set_layout(picasso_image *img, picasso_layout layout)
 {
-    return (int)lroundf((float)w * bf->scale_x);
+    if (!img || !img->pixels) return false;
+    if (img->layout == layout) return true;
+
+    // Tiled, both sides are padded to whole blocks
+    picasso_image to = *img;
+    to.layout = layout;
+    int w = layout == PICASSO_LAYOUT_TILED ? (img->width + 7) & ~7 : img->width;
+    int h = layout == PICASSO_LAYOUT_TILED ? (img->height + 7) & ~7 : img->height;
+    to.row_stride = w * img->channels;
+    to.pixels = picasso_calloc(sizeof(uint8_t), (size_t)h * to.row_stride);
+    if (!to.pixels) {
+        ERROR("Out of memory laying out a %dx%d image again", img->width, img->height);
+        return false;
+    }
+
+    // Runs of the tiled side are contiguous in the linear one too
+    const picasso_image *tiled = layout == PICASSO_LAYOUT_TILED ? &to : img;
+    for (int y = 0; y < img->height; ++y) {
+        const uint8_t *src = &img->pixels[picasso__row_offset(img, y)];
+        uint8_t *dst = &to.pixels[picasso__row_offset(&to, y)];
+        for (int x = 0, run; x < img->width; x += run) {
+            run = picasso__row_run(tiled, x, img->width - x);
+            memcpy(dst + picasso__col_offset(&to, x), src + picasso__col_offset(img, x),
+                   (size_t)run * img->channels);
+        }
+    }
+
+    picasso_free(img->pixels);
+    img->pixels = to.pixels;
+    img->row_stride = to.row_stride;
+    img->layout = layout;
+    return true;
 }
 
-static inline int picasso__to_px_h(const picasso_backbuffer *bf, int h)
+void picasso_image_unpremultiply(picasso_image *img)
 {
-    return (int)lroundf((float)h * bf->scale_y);
+    if (!img || !img->pixels || !img->premultiplied) return;
+    if ((img->channels == 2 || img->channels == 4) && img->alpha != PICASSO_ALPHA_OPAQUE)
+        picasso__image_convert_alpha(img, picasso__unpremultiply);
+    img->premultiplied = false;
 }
 
-static inline int picasso__to_px_uniform(const picasso_backbuffer *bf, int v)
+void picasso_free_image(picasso_image *img)
 {
-    float s = (bf->scale_x + bf->scale_y) * 0.5f;
-    return (int)lroundf((float)v * s);
+    if (img) {
+        picasso_free_image(img->mip);
+        free(img->pixels);
+        free(img);
+    }
+}
+
+void picasso__draw_mask(picasso_backbuffer *bf, const uint8_t *mask, int w, int h, int stride,
+                        int x, int y, uint32_t src)
+{
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    int x0 = PICASSO_MAX(x, cb.x0), x1 = PICASSO_MIN(x + w, cb.x1);
+    int y0 = PICASSO_MAX(y, cb.y0), y1 = PICASSO_MIN(y + h, cb.y1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    void (*kernel)(uint32_t *, const uint8_t *, int, uint32_t) = picasso__kernels(bf)->mask;
+    const uint8_t *row = &mask[(size_t)(y0 - y) * stride + (x0 - x)];
+    uint32_t *dst = &bf->pixels[(size_t)y0 * bf->width + x0];
+    for (int py = y0; py < y1; ++py, row += stride, dst += bf->width)
+        kernel(dst, row, x1 - x0, src);
 }
 
-static inline float picasso__to_px_xf(const picasso_backbuffer *bf, float x)
+void picasso_draw_mask(picasso_backbuffer *bf, const uint8_t *mask, int w, int h, int stride,
+                       int x, int y, color c)
 {
-    return x * bf->scale_x;
+    if (!bf || !bf->pixels || !mask || w <= 0 || h <= 0 || stride < w) return;
+
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_BITMAP, .c = c,
+                   .bitmap = { mask, w, h, stride, x, y });
+
+    picasso__draw_mask(bf, mask, w, h, stride, x, y, color_to_u32(c));
 }
 
-static inline float picasso__to_px_yf(const picasso_backbuffer *bf, float y)
+void draw_bitmap_to_backbuffer(picasso_backbuffer *bf, uint8_t *bitmap, int w,
+                                int h, int xoff, int yoff, color c)
 {
-    return y * bf->scale_y;
+    picasso_draw_mask(bf, bitmap, w, h, w, xoff, yoff, c);
 }
+
 // --------------------------------------------------------
 // Backbuffer operations
 // --------------------------------------------------------
@@ -466,6 +526,15 @@ picasso_backbuffer *picasso_create_backbuffer(Window *window)
     bf->scale_x = (float)fb_w / (float)logical_w;
     bf->scale_y = (float)fb_h / (float)logical_h;
 
+    bf->clip = (picasso_draw_bounds){0};
+    bf->blend = PICASSO_BLEND_SRC_OVER;
+    bf->cmdlist = NULL;
+    bf->track_damage = true;
+    bf->damage = (picasso_damage){0};
+    bf->prev_damage = (picasso_damage){0};
+    bf->depth = NULL;
+    bf->depth_bits = 0;
+
     bf->pixels = picasso_calloc((size_t)fb_w * (size_t)fb_h, sizeof(uint32_t));
     if (!bf->pixels) {
         picasso_free(bf);
@@ -482,10 +551,28 @@ void picasso_destroy_backbuffer(picasso_backbuffer* bf)
         picasso_free(bf->pixels);
         bf->pixels = NULL;
     }
+    picasso__free_cmdlist(bf->cmdlist);
+    picasso_free(bf->depth);
     picasso_free(bf);
 }
 
 
+typedef struct {
+    picasso_backbuffer *bf;
+    picasso_image *img;
+} picasso_backbuffer_copy;
+
+static void picasso__unpremultiply_rows(int y0, int y1, void *arg)
+{
+    picasso_backbuffer_copy *job = arg;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = 0; x < job->img->width; ++x) {
+            uint32_t pixel = picasso__unpremultiply(*picasso__get_pixel_u32(job->bf, x, y));
+            picasso__put_pixel_u8(job->img, x, y, &pixel);
+        }
+    }
+}
+
 picasso_image *picasso_image_from_backbuffer(picasso_backbuffer *bf)
 {
     if (!bf || !bf->pixels) return NULL;
@@ -493,12 +580,9 @@ picasso_image *picasso_image_from_backbuffer(picasso_backbuffer *bf)
     picasso_image *img = picasso_alloc_image(bf->width, bf->height, 4);
     if (!img) return NULL;
 
-    for (int y = 0; y < (int)bf->height; ++y) {
-        for (int x = 0; x < (int)bf->width; ++x) {
-            uint32_t *pixel = picasso__get_pixel_u32(bf, x, y);
-            picasso__put_pixel_u8(img, x, y, pixel);
-        }
-    }
+    picasso_backbuffer_copy job = { bf, img };
+    picasso__parallel_rows(img->height, img->width, picasso__unpremultiply_rows, &job);
+    picasso_image_update_alpha(img);
 
     return img;
 }
@@ -537,100 +621,49 @@ void picasso_blit_bitmap(
     picasso_blit(dst, src, full, at);
 }
 
-// This became a powerhouse function, handles all blit actions now to the backbuffer
-void picasso_blit(
-        picasso_backbuffer *dst,
-        picasso_image *src,
-        picasso_rect src_r,
-        picasso_rect dst_r)
-{
-    // Early sanity checks to bail out early if anything is invalid
-    if (!dst || !src || !dst->pixels || !src->pixels) return;
-    if (src_r.width <= 0 || src_r.height <= 0) return;
-
-    picasso__normalize_rect(&src_r);
-    picasso__normalize_rect(&dst_r);
-
-    // Destination rectangle is given in logical coords, so convert it to actual
-    // framebuffer pixels before clipping and rasterizing.
-    picasso_rect dst_px = {
-        .x = picasso__to_px_x(dst, dst_r.x),
-        .y = picasso__to_px_y(dst, dst_r.y),
-        .width = picasso__to_px_w(dst, dst_r.width),
-        .height = picasso__to_px_h(dst, dst_r.height),
-    };
-    picasso__normalize_rect(&dst_px);
-
-    if (dst_px.width <= 0 || dst_px.height <= 0) return;
-
-    // Clamp src_r to source image bounds (safe blit)
-    if (src_r.x < 0) src_r.x = 0;
-    if (src_r.y < 0) src_r.y = 0;
-    // if you draw at an x value, this compensates from the width so the total
-    // width never exceed actual image width - same for y below
-    if (src_r.x + src_r.width > src->width) {
-        src_r.width = src->width - src_r.x;
-    }
-    if (src_r.y + src_r.height > src->height) {
-        src_r.height = src->height - src_r.y;
-    }
-
-    if (src_r.width <= 0 || src_r.height <= 0) return;
-
-    // Bounds of the destination
-    picasso_draw_bounds bounds;
-    if (!picasso__clip_rect_to_bounds(dst, &dst_px, &bounds)) return;
-
-    // Extracting the scaling factor, how fast we sample from the src to the dst.
-    // Maybe 2 pixels per pixel
-    float scale_x = (float)src_r.width  / dst_px.width;
-    float scale_y = (float)src_r.height / dst_px.height;
-
-
-    // For every row of destination (dy) and dest col (dx)
-    for (int dst_y = bounds.y0; dst_y < bounds.y1; ++dst_y)
-    {
-        int relative_dst_y = dst_y - dst_px.y;
-        int src_y = src_r.y + (int)(relative_dst_y * scale_y);
-
-        if( src_y < 0 || src_y >= src->height ) continue;
-
-        for (int dst_x = bounds.x0; dst_x < bounds.x1; ++dst_x)
-        {
-            int relative_dst_x = dst_x - dst_px.x;
-            int src_x = src_r.x + (int)(relative_dst_x * scale_x);
-
-            if( src_x < 0 || src_x >= src->width ) continue;
-
-            uint8_t  *src_pixel = picasso__get_pixel_u8(src, src_x, src_y);
-            uint32_t *dst_pixel = picasso__get_pixel_u32(dst, dst_x, dst_y);
-
-            color c = get_color_u8(src_pixel, src->channels);
-            uint32_t rgba = color_to_u32(c);
+typedef struct {
+    picasso_image *from, *dst;
+    bool unpremultiply;
+} picasso_copy_job;
 
-            *dst_pixel = picasso__blend_pixel(*dst_pixel, rgba);
+static void picasso__copy_rows(int y0, int y1, void *arg)
+{
+    picasso_copy_job *job = arg;
+    picasso_image *from = job->from, *dst = job->dst;
+
+    // Color to gray at the same width is a row of luma for the color kernels
+    if (dst->channels == 1 && from->channels >= 3 && from->width == dst->width &&
+        from->layout == PICASSO_LAYOUT_LINEAR && dst->layout == PICASSO_LAYOUT_LINEAR &&
+        !job->unpremultiply) {
+        for (int y = y0; y < y1; ++y) {
+            size_t ny = (size_t)y * from->height / dst->height;
+            picasso__color_luma_row(dst->pixels + (size_t)y * dst->row_stride,
+                                    from->pixels + ny * from->row_stride, from->channels,
+                                    dst->width, PICASSO_YCBCR_BT601);
         }
+        return;
     }
-}
-// get_color takes into account channels of src, color is always 4 channel valid
-void picasso_copy(picasso_image *src, picasso_image *dst)
-{
-    for (int y = 0; y < dst->height; ++y) {
+
+    for (int y = y0; y < y1; ++y) {
         for (int x = 0; x < dst->width; ++x) {
-            size_t nx = x * src->width / dst->width;
-            size_t ny = y * src->height / dst->height;
+            size_t nx = x * from->width / dst->width;
+            size_t ny = y * from->height / dst->height;
 
             uint8_t *dst_pixel = picasso__get_pixel_u8(dst, x, y);
-            uint8_t *src_pixel = picasso__get_pixel_u8(src, nx, ny);
+            uint8_t *src_pixel = picasso__get_pixel_u8(from, nx, ny);
 
-            color c = get_color_u8(src_pixel, src->channels);
+            color c = get_color_u8(src_pixel, from->channels);
+            if (job->unpremultiply) {
+                uint32_t v = picasso__unpremultiply(color_to_u32(c));
+                c = u32_to_color(v);
+            }
 
             switch (dst->channels) {
                 case 1:
-                    dst_pixel[0] = (76 * c.r + 150 * c.g + 29 * c.b) >> 8;
+                    dst_pixel[0] = picasso__luma(c.r, c.g, c.b);
                     break;
                 case 2:
-                    dst_pixel[0] = (76 * c.r + 150 * c.g + 29 * c.b) >> 8;
+                    dst_pixel[0] = picasso__luma(c.r, c.g, c.b);
                     dst_pixel[1] = c.a;
                     break;
                 case 3:
@@ -649,12 +682,61 @@ void picasso_copy(picasso_image *src, picasso_image *dst)
     }
 }
 
+// get_color takes into account channels of src, color is always 4 channel valid
+void picasso_copy(picasso_image *src, picasso_image *dst)
+{
+    // Nothing to copy into, or from, and no scale between them
+    if (dst->width <= 0 || dst->height <= 0 || src->width <= 0 || src->height <= 0) return;
+
+    // Shrinking by 2 or more picks from the mip level about the size of dst,
+    // picking every so many texels of the image itself would alias
+    float lambda = picasso__mip_lambda(src->width, src->height, dst->width, dst->height);
+    int level = lambda >= 1 ? (int)lambda : 0;
+    picasso_image *from = level ? picasso__image_mip(src, &level, true) : src;
+    // Levels are premultiplied, the copy is what the source is
+    bool unpremultiply = from != src && !src->premultiplied;
+
+    picasso_copy_job job = { from, dst, unpremultiply };
+    picasso__parallel_rows(dst->height, dst->width, picasso__copy_rows, &job);
+
+    // Every alpha comes from the source, and the colors are as they were.
+    // Averaged alpha can be in between where the source had only 0 and 255
+    if (from != src && from->alpha != PICASSO_ALPHA_OPAQUE && (dst->channels == 2 || dst->channels == 4))
+        picasso_image_update_alpha(dst);
+    else if (dst->channels == 2 || dst->channels == 4)
+        dst->alpha = (src->channels == 2 || src->channels == 4) ? src->alpha : PICASSO_ALPHA_OPAQUE;
+    dst->premultiplied = src->premultiplied;
+}
+
 void* picasso_backbuffer_pixels(picasso_backbuffer* bf)
 {
     if (!bf) return NULL;
     return (void*)bf->pixels;
 }
 
+typedef struct {
+    picasso_backbuffer *bf;
+    picasso_draw_bounds cb;
+    uint32_t clear;
+} picasso_clear_job;
+
+// Rows y0 to y1 of the clip
+static void picasso__clear_rows(int y0, int y1, void *arg)
+{
+    picasso_clear_job *job = arg;
+    picasso_backbuffer *bf = job->bf;
+    picasso_draw_bounds cb = job->cb;
+
+    // Without a clip the rows are contiguous, so it is all one span
+    if (cb.x0 == 0 && cb.x1 == (int)bf->width) {
+        picasso__span_fill(picasso__get_pixel_u32(bf, 0, cb.y0 + y0),
+                           (y1 - y0) * (int)bf->width, job->clear);
+        return;
+    }
+    for (int y = cb.y0 + y0; y < cb.y0 + y1; ++y)
+        picasso__span_fill(picasso__get_pixel_u32(bf, cb.x0, y), cb.x1 - cb.x0, job->clear);
+}
+
 void picasso_clear_backbuffer(picasso_backbuffer* bf)
 {
     if (!bf || !bf->pixels) {
@@ -662,9 +744,10 @@ void picasso_clear_backbuffer(picasso_backbuffer* bf)
         return;
     }
 
-    for (size_t i = 0; i <  bf->width * bf->height; ++i) {
-        bf->pixels[i] = color_to_u32(CLEAR_BACKGROUND);
-    }
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_CLEAR);
+
+    picasso_clear_job job = { bf, picasso__clip_bounds(bf), color_to_u32(CLEAR_BACKGROUND) };
+    picasso__parallel_rows(job.cb.y1 - job.cb.y0, job.cb.x1 - job.cb.x0, picasso__clear_rows, &job);
 }
 
 // --------------------------------------------------------
@@ -673,6 +756,8 @@ void picasso_clear_backbuffer(picasso_backbuffer* bf)
 
 void picasso_fill_rect(picasso_backbuffer *bf, picasso_rect *r, color c)
 {
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_FILL_RECT, .c = c, .rect = { *r, 0 });
+
     picasso_rect sr = {
         .x = picasso__to_px_x(bf, r->x),
         .y = picasso__to_px_y(bf, r->y),
@@ -685,28 +770,24 @@ void picasso_fill_rect(picasso_backbuffer *bf, picasso_rect *r, color c)
 
     uint32_t new_pixel = color_to_u32(c);
 
-    for (int y = bounds.y0; y < bounds.y1; ++y) {
-        for (int x = bounds.x0; x < bounds.x1; ++x) {
-            uint32_t *cur_pixel = picasso__get_pixel_u32(bf, x, y);
-            *cur_pixel = picasso__blend_pixel(*cur_pixel, new_pixel);
-        }
-    }
+    for (int y = bounds.y0; y < bounds.y1; ++y)
+        picasso__fill_span(bf, y, bounds.x0, bounds.x1, new_pixel);
 }
 
 
 /*
- * FIX: This approach might be slightly wasteful, but it works!
  * I calculate the whole rectangle and set outer bounds, and then i calculate an inner
- * rectangle which is the thickness less in - i then set that to be skipped.
- * So in practive i am going over every pixel of the larger rect, and skipping the inside
- *
- * I might be able to do a 4-slice instead
+ * rectangle which is the thickness less in. Rows outside the inner rect are one
+ * full span, rows crossing it are the two spans on either side of it.
  * */
 
 void picasso_draw_rect(picasso_backbuffer *bf, picasso_rect *outer, int thickness, color c)
 {
     if (!outer || !bf || thickness <= 0) return;
 
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_DRAW_RECT, .c = c,
+                   .rect = { *outer, thickness });
+
     picasso_rect outer_px = {
         .x = picasso__to_px_x(bf, outer->x),
         .y = picasso__to_px_y(bf, outer->y),
@@ -735,24 +816,23 @@ void picasso_draw_rect(picasso_backbuffer *bf, picasso_rect *outer, int thicknes
     if (!picasso__clip_rect_to_bounds(bf, &outer_px, &outer_bounds)) return;
 
     // if inner bounds doesnt make sense we just null it out making it a full rect
-    if (!picasso__clip_rect_to_bounds(bf, &inner, &inner_bounds)) {
+    // (thick enough to cross over itself counts as a full rect too)
+    if (!picasso__clip_rect_to_bounds(bf, &inner, &inner_bounds) ||
+        inner_bounds.x1 <= inner_bounds.x0 || inner_bounds.y1 <= inner_bounds.y0) {
         inner_bounds = (picasso_draw_bounds){0};
     }
 
     uint32_t new_pixel = color_to_u32(c);
 
     for (int y = outer_bounds.y0; y < outer_bounds.y1; ++y) {
-        for (int x = outer_bounds.x0; x < outer_bounds.x1; ++x) {
-            bool inside_inner = (
-                y >= inner_bounds.y0 && y < inner_bounds.y1 &&
-                x >= inner_bounds.x0 && x < inner_bounds.x1
-            );
-
-            if (inside_inner) continue;
+        bool crosses_inner = (y >= inner_bounds.y0 && y < inner_bounds.y1);
 
-            uint32_t *cur_pixel = picasso__get_pixel_u32(bf, x, y);
-            *cur_pixel = picasso__blend_pixel(*cur_pixel, new_pixel);
+        if (!crosses_inner) {
+            picasso__fill_span(bf, y, outer_bounds.x0, outer_bounds.x1, new_pixel);
+            continue;
         }
+        picasso__fill_span(bf, y, outer_bounds.x0, inner_bounds.x0, new_pixel);
+        picasso__fill_span(bf, y, inner_bounds.x1, outer_bounds.x1, new_pixel);
     }
 }
 
@@ -772,6 +852,9 @@ static inline picasso_rect picasso__make_circle_bounds(int x0, int y0, int radiu
 
 void picasso_fill_circle(picasso_backbuffer *bf, int x0, int y0, int radius, color c)
 {
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_FILL_CIRCLE, .c = c,
+                   .circle = { x0, y0, radius, 0 });
+
     x0 = picasso__to_px_x(bf, x0);
     y0 = picasso__to_px_y(bf, y0);
     radius = picasso__to_px_uniform(bf, radius);
@@ -785,21 +868,23 @@ void picasso_fill_circle(picasso_backbuffer *bf, int x0, int y0, int radius, col
 
     uint32_t new_pixel = color_to_u32(c);
 
-    // a^2 + b^2 = c^2
+    // a^2 + b^2 = c^2, solved for the x extent of every row
     for (int y = bounds.y0; y < bounds.y1; ++y) {
-        for (int x = bounds.x0; x < bounds.x1; ++x) {
-            int dx = x - x0;
-            int dy = y - y0;
-            if ((dx * dx + dy * dy <= radius * radius + radius)) {
-                uint32_t *cur_pixel = picasso__get_pixel_u32(bf, x, y);
-                *cur_pixel = picasso__blend_pixel(*cur_pixel, new_pixel);
-            }
-        }
+        int dy = y - y0;
+        int half = picasso__isqrt(radius * radius + radius - dy * dy);
+        if (half < 0) continue;
+
+        int xa = PICASSO_MAX(x0 - half, bounds.x0);
+        int xb = PICASSO_MIN(x0 + half + 1, bounds.x1);
+        picasso__fill_span(bf, y, xa, xb, new_pixel);
     }
 }
 
 void picasso_draw_circle(picasso_backbuffer *bf, int x0, int y0, int radius, int thickness, color c)
 {
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_CIRCLE, .c = c,
+                   .circle = { x0, y0, radius, thickness });
+
     x0 = picasso__to_px_x(bf, x0);
     y0 = picasso__to_px_y(bf, y0);
     radius = picasso__to_px_uniform(bf, radius);
@@ -819,61 +904,133 @@ void picasso_draw_circle(picasso_backbuffer *bf, int x0, int y0, int radius, int
     int inner_r = radius - thickness;
     int inner = inner_r * inner_r;
 
+    // Per row the ring is the outer extent minus the hole, so at most two
+    // spans: dist2 <= outer + radius, and not dist2 < inner + radius
     for (int y = bounds.y0; y < bounds.y1; ++y) {
-        for (int x = bounds.x0; x < bounds.x1; ++x) {
-            int dx = x - x0;
-            int dy = y - y0;
-            int dist2 = dx * dx + dy * dy;
-
-            if (dist2 >= inner + radius && dist2 <= outer + radius) {
-                uint32_t *cur_pixel = picasso__get_pixel_u32(bf, x, y);
-                *cur_pixel = picasso__blend_pixel(*cur_pixel, new_pixel);
-            }
+        int dy = y - y0;
+        int out_half = picasso__isqrt(outer + radius - dy * dy);
+        if (out_half < 0) continue;
+        int in_half = picasso__isqrt(inner + radius - dy * dy - 1);
+
+        if (in_half < 0) {
+            picasso__fill_span(bf, y, PICASSO_MAX(x0 - out_half, bounds.x0),
+                    PICASSO_MIN(x0 + out_half + 1, bounds.x1), new_pixel);
+            continue;
         }
+        picasso__fill_span(bf, y, PICASSO_MAX(x0 - out_half, bounds.x0),
+                PICASSO_MIN(x0 - in_half, bounds.x1), new_pixel);
+        picasso__fill_span(bf, y, PICASSO_MAX(x0 + in_half + 1, bounds.x0),
+                PICASSO_MIN(x0 + out_half + 1, bounds.x1), new_pixel);
     }
 }
 // Helper: blend a pixel into the backbuffer using alpha (0–1)
 static inline void picasso__plot_aa(picasso_backbuffer *bf, int x, int y, color c, float alpha)
 {
-    if (x < 0 || x >= (int)bf->width || y < 0 || y >= (int)bf->height) return;
-
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    if (!picasso__in_clip(&cb, x, y)) return;
+
+    uint32_t *dst_pixel = picasso__get_pixel_u32(bf, x, y);
+    if (bf->blend != PICASSO_BLEND_SRC_OVER) {
+        // The other modes mix with what was there by coverage
+        uint8_t coverage = (uint8_t)(255.0f * alpha);
+        picasso__kernels(bf)->mask(dst_pixel, &coverage, 1, color_to_u32(c));
+        return;
+    }
     c.a = (uint8_t)(c.a * alpha);
-    uint32_t src = color_to_u32(c);
-    uint32_t *dst_pixel = &bf->pixels[y * bf->width + x];
-    *dst_pixel = picasso__blend_pixel(*dst_pixel, src);
+    *dst_pixel = picasso__blend_pixel(*dst_pixel, color_to_u32(c));
 }
-// Draws an anti-aliased circle centered at (cx, cy) with radius r
-void picasso_draw_circle_aa(picasso_backbuffer *bf, int cx, int cy, int r, color c)
+
+/* Anti-aliased ring between radii inner and outer around pixel (cx, cy).
+ * A pixel at distance d from the center is covered by
+ *     clamp(outer - d) - clamp(inner - d)
+ * so it fades in over the pixel inside outer and out over the pixel inside
+ * inner. Per row that splits into runs mirrored around cx: the outer edge,
+ * the solid part, the inner edge and the hole. Their ends come from exact
+ * integer square roots, so only the edge pixels need a distance. An inner
+ * radius of 0 makes a disc */
+static void picasso__ring_aa(picasso_backbuffer *bf, int cx, int cy, int outer, int inner, color c)
 {
-    int x = r;
-    int y = 0;
-
-    while (x >= y)
-    {
-        for (int i = -1; i <= 1; ++i) // Simple approximation of AA with offset
-        {
-            float fx = x + i * 0.5f;
-            float fy = y + i * 0.5f;
-            float d = fabsf(sqrtf(fx * fx + fy * fy) - r);
-            float alpha = 1.0f - fminf(d, 1.0f); // Blend alpha based on distance
-
-            // Symmetrical 8-way plotting with anti-aliasing
-            picasso__plot_aa(bf, cx + x, cy + y, c, alpha);
-            picasso__plot_aa(bf, cx + y, cy + x, c, alpha);
-            picasso__plot_aa(bf, cx - y, cy + x, c, alpha);
-            picasso__plot_aa(bf, cx - x, cy + y, c, alpha);
-            picasso__plot_aa(bf, cx - x, cy - y, c, alpha);
-            picasso__plot_aa(bf, cx - y, cy - x, c, alpha);
-            picasso__plot_aa(bf, cx + y, cy - x, c, alpha);
-            picasso__plot_aa(bf, cx + x, cy - y, c, alpha);
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    int y0 = PICASSO_MAX(cy - outer, cb.y0);
+    int y1 = PICASSO_MIN(cy + outer + 1, cb.y1);
+    if (y0 >= y1 || cx - outer >= cb.x1 || cx + outer < cb.x0) return;
+
+    uint32_t src = color_to_u32(c);
+    uint8_t coverage[PICASSO_SPAN_CHUNK];
+    const picasso_blend_kernels *kernels = picasso__kernels(bf);
+
+    for (int py = y0; py < y1; ++py) {
+        // In 64 bits, radii past 46340 pixels square out of an int
+        int64_t y2 = (int64_t)(py - cy) * (py - cy);
+        int64_t ro = outer, ri = inner;
+
+        // Largest |x| with d < outer, with d <= outer - 1, with d < inner
+        // and with d <= inner - 1
+        int x_out = picasso__isqrt(ro * ro - y2 - 1);
+        if (x_out < 0) continue;
+        int x_full = picasso__isqrt((ro - 1) * (ro - 1) - y2);
+        int x_in = picasso__isqrt(ri * ri - y2 - 1);
+        int x_hole = inner > 0 ? picasso__isqrt((ri - 1) * (ri - 1) - y2) : -1;
+
+        // Runs of |x| in (from, to], outside in
+        struct { int from, to; bool solid; } runs[3] = {
+            { x_full, x_out, false }, { x_in, x_full, true }, { x_hole, x_in, false },
+        };
+        int run_count = 3;
+        if (x_in >= x_full) {
+            // Too thin for a solid part, the edges meet
+            runs[0].from = x_hole;
+            run_count = 1;
         }
 
-        y++;
-        if ((x * x + y * y) > r * r)
-            x--;
+        for (int i = 0; i < run_count; ++i) {
+            int from = runs[i].from, to = runs[i].to;
+            if (from >= to) continue;
+
+            // Left and right of the center, or one span through it
+            int spans[2][2] = { { cx - to, cx - from }, { cx + from + 1, cx + to + 1 } };
+            int span_count = 2;
+            if (from < 0) {
+                spans[0][1] = cx + to + 1;
+                span_count = 1;
+            }
+
+            for (int k = 0; k < span_count; ++k) {
+                int xa = PICASSO_MAX(spans[k][0], cb.x0);
+                int xb = PICASSO_MIN(spans[k][1], cb.x1);
+                if (xa >= xb) continue;
+                if (runs[i].solid) {
+                    picasso__fill_span(bf, py, xa, xb, src);
+                    continue;
+                }
+
+                for (int px = xa; px < xb; px += PICASSO_SPAN_CHUNK) {
+                    int n = PICASSO_MIN(xb - px, PICASSO_SPAN_CHUNK);
+                    for (int j = 0; j < n; ++j) {
+                        int64_t x = px + j - cx;
+                        float d = sqrtf((float)(x * x + y2));
+                        float in = fminf((float)outer - d, 1.0f);
+                        float hole = PICASSO_CLAMP((float)inner - d, 0.0f, 1.0f);
+                        coverage[j] = in > hole ? (uint8_t)((in - hole) * 255.0f) : 0;
+                    }
+                    kernels->mask(picasso__get_pixel_u32(bf, px, py), coverage, n, src);
+                }
+            }
+        }
     }
 }
 
+// A one pixel wide anti-aliased ring around radius r
+void picasso_draw_circle_aa(picasso_backbuffer *bf, int cx, int cy, int r, color c)
+{
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_CIRCLE_AA, .c = c,
+                   .circle = { cx, cy, r, 0 });
+
+    if (r < 0) return;
+    r = picasso__to_px_uniform(bf, r);
+    picasso__ring_aa(bf, picasso__to_px_x(bf, cx), picasso__to_px_y(bf, cy), r + 1, r, c);
+}
+
 // Full version of the bresenham line algorithm, works in all quadrants
 // Bresenham’s algorithm keeps track of an accumulated error value that
 // represents how far off the current pixel is from the actual line. It uses
@@ -881,6 +1038,9 @@ void picasso_draw_circle_aa(picasso_backbuffer *bf, int cx, int cy, int r, color
 // resulting path closely follows the desired straight line.
 void picasso_draw_line(picasso_backbuffer *bf, int x0, int y0, int x1, int y1, color c)
 {
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_LINE, .c = c,
+                   .line = { x0, y0, x1, y1, 0 });
+
     x0 = picasso__to_px_x(bf, x0);
     y0 = picasso__to_px_y(bf, y0);
     x1 = picasso__to_px_x(bf, x1);
@@ -898,12 +1058,12 @@ void picasso_draw_line(picasso_backbuffer *bf, int x0, int y0, int x1, int y1, c
     // This hits at when to step in the y-direction vs x-direction.
     int err = dx - dy;
     uint32_t new_pixel = color_to_u32(c);
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
 
     while (true) {
         // (basic clipping)
-        if (x0 >= 0 && x0 < (int)bf->width && y0 >= 0 && y0 < (int)bf->height) {
-            uint32_t *dst = &bf->pixels[y0 * bf->width + x0];
-            *dst = picasso__blend_pixel(*dst, new_pixel);
+        if (picasso__in_clip(&cb, x0, y0)) {
+            picasso__plot(bf, picasso__get_pixel_u32(bf, x0, y0), new_pixel);
         }
 
         if (x0 == x1 && y0 == y1)
@@ -947,6 +1107,9 @@ void picasso_draw_line(picasso_backbuffer *bf, int x0, int y0, int x1, int y1, c
 // https://en.wikipedia.org/wiki/Xiaolin_Wu%27s_line_algorithm
 void picasso_draw_line_aa(picasso_backbuffer *bf, float x0, float y0, float x1, float y1, color c)
 {
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_LINE_AA, .c = c,
+                   .line_f = { x0, y0, x1, y1 });
+
     x0 = picasso__to_px_xf(bf, x0);
     y0 = picasso__to_px_yf(bf, y0);
     x1 = picasso__to_px_xf(bf, x1);
@@ -992,75 +1155,113 @@ void picasso_draw_line_aa(picasso_backbuffer *bf, float x0, float y0, float x1,
         y += gradient; // Move to next y
     }
 }
+// Recorded as one command, and stroked as one round capped line when replayed
 void picasso_draw_line_thick(picasso_backbuffer *bf, int x0, int y0, int x1, int y1, int thickness, color c)
 {
-    int steps = (int)sqrtf((float)((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0)));
-    if (steps < 1) steps = 1;
-
-    for (int i = 0; i <= steps; ++i) {
-        float t = (float)i / (float)steps;
-        int x = (int)(x0 + t * (x1 - x0));
-        int y = (int)(y0 + t * (y1 - y0));
-        picasso_fill_circle_aa(bf, x, y, thickness / 2, c);
-    }
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_LINE_THICK, .c = c,
+                   .line = { x0, y0, x1, y1, thickness });
+
+    // One stroke through the pixel centers, so every pixel is blended once
+    float s = (bf->scale_x + bf->scale_y) * 0.5f;
+    float pts[4] = {
+        (float)picasso__to_px_x(bf, x0) + 0.5f, (float)picasso__to_px_y(bf, y0) + 0.5f,
+        (float)picasso__to_px_x(bf, x1) + 0.5f, (float)picasso__to_px_y(bf, y1) + 0.5f,
+    };
+    picasso_path line = {
+        .verbs = (uint8_t[]){ PICASSO_PATH_MOVE, PICASSO_PATH_LINE },
+        .points = pts, .verb_count = 2, .point_count = 2,
+    };
+    picasso_stroke_style style = { .cap = PICASSO_CAP_ROUND, .join = PICASSO_JOIN_ROUND };
+    picasso__stroke(bf, &line, 1.0f, 1.0f, fmaxf((float)thickness * s * 0.5f, 0.5f), &style, c);
 }
 
 void picasso_fill_circle_aa(picasso_backbuffer *bf, int cx, int cy, int radius, color c)
 {
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_FILL_CIRCLE_AA, .c = c,
+                   .circle = { cx, cy, radius, 0 });
+
     cx = picasso__to_px_x(bf, cx);
     cy = picasso__to_px_y(bf, cy);
     radius = picasso__to_px_uniform(bf, radius);
     if (radius < 1) radius = 1;
 
-    for (int y = -radius; y <= radius; ++y) {
-        for (int x = -radius; x <= radius; ++x) {
-            int px = cx + x;
-            int py = cy + y;
+    picasso__ring_aa(bf, cx, cy, radius, 0, c);
+}
 
-            float dist = sqrtf((float)(x * x + y * y));
+/* Fixed point edge function rasterizer. The vertices are snapped to
+ * 1/PICASSO_SUBPIXEL_SCALE of a pixel and pixels are sampled at their
+ * centers. The edge functions are stepped one row at a time, and since they
+ * are linear along a row, the inside of each row is solved for directly
+ * instead of testing pixels, so every row is exactly one span. Thin and long
+ * triangles cost one span per row, no matter how big their bounding box is. */
+bool picasso__setup_triangle(picasso_tri_setup *t, const int64_t vx_in[3],
+                             const int64_t vy_in[3], picasso_draw_bounds cb)
+{
+    int64_t vx[3] = { vx_in[0], vx_in[1], vx_in[2] };
+    int64_t vy[3] = { vy_in[0], vy_in[1], vy_in[2] };
+
+    // Wind it so the inside is positive for all three edges
+    int64_t area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+    if (area == 0) return false;
+    if (area < 0) {
+        PICASSO_SWAP(vx[1], vx[2]);
+        PICASSO_SWAP(vy[1], vy[2]);
+    }
 
-            if (dist < radius - 1.0f) {
-                picasso__plot_aa(bf, px, py, c, 1.0f);
-            } else if (dist <= radius) {
-                float alpha = radius - dist;
-                picasso__plot_aa(bf, px, py, c, alpha);
-            }
-        }
+    picasso_edge edges[3] = {
+        picasso__make_edge(vx[1], vy[1], vx[2], vy[2]),
+        picasso__make_edge(vx[2], vy[2], vx[0], vy[0]),
+        picasso__make_edge(vx[0], vy[0], vx[1], vy[1]),
+    };
+
+    // Rows whose centers are inside the vertical extent, clipped
+    const int64_t half = PICASSO_SUBPIXEL_SCALE / 2;
+    int64_t min_vy = PICASSO_MIN3(vy[0], vy[1], vy[2]);
+    int64_t max_vy = PICASSO_MAX3(vy[0], vy[1], vy[2]);
+    t->y0 = (int)PICASSO_MAX(picasso__ceil_div(min_vy - half, PICASSO_SUBPIXEL_SCALE), (int64_t)cb.y0);
+    t->y1 = (int)PICASSO_MIN(picasso__floor_div(max_vy - half, PICASSO_SUBPIXEL_SCALE) + 1, (int64_t)cb.y1);
+    if (t->y0 >= t->y1) return false;
+
+    // Per edge: the value at the center of pixel (0, y0), and the steps per
+    // pixel in x and per row in y. Edges that don't own their boundary are
+    // biased by one so that exactly zero counts as outside
+    for (int i = 0; i < 3; ++i) {
+        picasso_edge e = edges[i];
+        int64_t py = (int64_t)t->y0 * PICASSO_SUBPIXEL_SCALE + half;
+        t->row[i]    = e.A * half + e.B * py + e.C - (picasso__is_top_left(e) ? 0 : 1);
+        t->step_x[i] = e.A * PICASSO_SUBPIXEL_SCALE;
+        t->step_y[i] = e.B * PICASSO_SUBPIXEL_SCALE;
     }
+    return true;
 }
 
 void picasso_fill_triangle(picasso_backbuffer *bf, picasso_point3 pts, color c)
 {
-    // Unpack input and convert from logical coords to framebuffer pixels
-    int x0 = picasso__to_px_x(bf, pts.x1);
-    int y0 = picasso__to_px_y(bf, pts.y1);
-    int x1 = picasso__to_px_x(bf, pts.x2);
-    int y1 = picasso__to_px_y(bf, pts.y2);
-    int x2 = picasso__to_px_x(bf, pts.x3);
-    int y2 = picasso__to_px_y(bf, pts.y3);
-
-    // Clamp with proper types to avoid warnings
-    int min_x = PICASSO_CLAMP(PICASSO_MIN3(x0, x1, x2), 0, (int)bf->width - 1);
-    int max_x = PICASSO_CLAMP(PICASSO_MAX3(x0, x1, x2), 0, (int)bf->width - 1);
-    int min_y = PICASSO_CLAMP(PICASSO_MIN3(y0, y1, y2), 0, (int)bf->height - 1);
-    int max_y = PICASSO_CLAMP(PICASSO_MAX3(y0, y1, y2), 0, (int)bf->height - 1);
-
-    float denom = (float)((y1 - y2) * (x0 - x2) + (x2 - x1) * (y0 - y2));
-    if (denom == 0.0f) return;
-
-    for (int y = min_y; y <= max_y; y++) {
-        for (int x = min_x; x <= max_x; x++) {
-            float w0 = ((y1 - y2)*(x - x2) + (x2 - x1)*(y - y2)) / denom;
-            float w1 = ((y2 - y0)*(x - x2) + (x0 - x2)*(y - y2)) / denom;
-            float w2 = 1.0f - w0 - w1;
-
-            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                uint32_t src = color_to_u32(c);
-                uint32_t *dst = &bf->pixels[y * bf->width + x];
-                *dst = picasso__blend_pixel(*dst, src);
-            }
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_FILL_TRIANGLE, .c = c, .tri = pts);
+
+    // Logical coords straight to subpixels, so no precision is lost to
+    // rounding to whole pixels first
+    int64_t vx[3], vy[3];
+    const int lx[3] = { pts.x1, pts.x2, pts.x3 };
+    const int ly[3] = { pts.y1, pts.y2, pts.y3 };
+    for (int i = 0; i < 3; ++i) {
+        if (!picasso__to_subpixel(picasso__to_px_xf(bf, (float)lx[i]),
+                                  picasso__to_px_yf(bf, (float)ly[i]), &vx[i], &vy[i])) {
+            TRACE("Triangle vertex out of range, skipping");
+            return;
         }
     }
+
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    picasso_tri_setup t;
+    if (!picasso__setup_triangle(&t, vx, vy, cb)) return;
+
+    uint32_t src = color_to_u32(c);
+    for (int y = t.y0; y < t.y1; ++y) {
+        int x0, x1;
+        if (picasso__triangle_span(&t, cb, &x0, &x1))
+            picasso__fill_span(bf, y, x0, x1, src);
+    }
 }
 
 void picasso_draw_triangle_aa(picasso_backbuffer *bf, picasso_point3 pts, color fill_color, color edge_color)
@@ -1103,15 +1304,19 @@ void draw_bezier(picasso_backbuffer *bf,
                         picasso_vec2 p0, picasso_vec2 p1, picasso_vec2 p2,
                         int resolution)
 {
-   picasso_vec2 prev_point = p0;
-
-   for (int i = 0; i < resolution; ++i)
-   {
-       float t = (i + 1.f) / resolution;
-       picasso_vec2 next_point = bezier_lerp(p0, p1, p2, t);
-//       picasso_draw_thick_line_soft(bf, 100, 100, 400, 400,4, PINK);
-       //picasso_draw_line_aa(bf, prev_point.x, prev_point.y, next_point.x, next_point.y, RED);
-       picasso_draw_line_thick(bf, prev_point.x, prev_point.y, next_point.x, next_point.y, 4,RED);
-       prev_point = next_point;
-   }
+    (void)resolution;
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_BEZIER, .c = RED,
+                   .bezier = { p0, p1, p2 });
+
+    float pts[6] = {
+        picasso__to_px_xf(bf, p0.x), picasso__to_px_yf(bf, p0.y),
+        picasso__to_px_xf(bf, p1.x), picasso__to_px_yf(bf, p1.y),
+        picasso__to_px_xf(bf, p2.x), picasso__to_px_yf(bf, p2.y),
+    };
+    picasso_path curve = {
+        .verbs = (uint8_t[]){ PICASSO_PATH_MOVE, PICASSO_PATH_QUAD },
+        .points = pts, .verb_count = 2, .point_count = 3,
+    };
+    picasso_stroke_style style = { .cap = PICASSO_CAP_ROUND, .join = PICASSO_JOIN_ROUND };
+    picasso__stroke(bf, &curve, 1.0f, 1.0f, 2.0f * (bf->scale_x + bf->scale_y) * 0.5f, &style, RED);
 }
@@ -0,0 +1,498 @@
+#include <stdint.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* The 3D stage. A draw runs in passes over the whole mesh:
+ *
+ *  1. Transform. Every vertex goes through the matrix once, four lanes at a
+ *     time: the four matrix columns stay in registers and each vertex is
+ *     x * c0 + y * c1 + z * c2 + c3.
+ *  2. Project. Vertices are classified against the frustum planes, and the
+ *     ones in front of the near plane are projected onto the backbuffer and
+ *     snapped to subpixels, once, however many triangles share them.
+ *  3. Triangles. A triangle with all three vertices outside the same plane is
+ *     dropped. One that crosses the near plane is clipped against it in clip
+ *     space, which leaves a triangle or a quad. Back faces are dropped if
+ *     asked for, and the rest is rasterized with the shared triangle setup.
+ *
+ * The rasterizer walks the same spans as picasso_fill_triangle(). Depth (z/w)
+ * is linear on screen, so it is a plane like in 2D. Colors and texture
+ * coordinates are not: they are interpolated as attr/w along with 1/w, and
+ * divided per pixel. Every pixel is evaluated straight from the planes, so
+ * tiles come out exactly like a full screen draw. */
+
+#if !defined(PICASSO_NO_SIMD)
+#  if defined(__SSE__) || defined(__SSE2__)
+#    define PICASSO_3D_SSE 1
+#    include <xmmintrin.h>
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define PICASSO_3D_NEON 1
+#    include <arm_neon.h>
+#  endif
+#endif
+
+// Interpolated per vertex: r, g, b, a, then u, v in texels
+#define PICASSO_3D_ATTRS 6
+
+// Frustum planes a clip space vertex is outside of
+enum {
+    PICASSO_CLIP_NEAR   = 1 << 0,
+    PICASSO_CLIP_FAR    = 1 << 1,
+    PICASSO_CLIP_LEFT   = 1 << 2,
+    PICASSO_CLIP_RIGHT  = 1 << 3,
+    PICASSO_CLIP_BOTTOM = 1 << 4,
+    PICASSO_CLIP_TOP    = 1 << 5,
+};
+
+typedef struct {
+    float x, y, z, w;
+} picasso_vec4;
+
+typedef struct {
+    picasso_vec4 p;                // clip space
+    float attr[PICASSO_3D_ATTRS];
+} picasso_clip_vertex;
+
+typedef struct {
+    int64_t sx, sy;                // subpixels
+    float z;                       // depth, 0 at the near plane and 1 at the far
+    float q;                       // 1 / w
+    float attr[PICASSO_3D_ATTRS];  // divided by w
+    bool ok;                       // projected, and inside the subpixel range
+} picasso_screen_vertex;
+
+// --------------------------------------------------------
+// Matrices
+// --------------------------------------------------------
+
+picasso_mat4 picasso_mat4_identity(void)
+{
+    return (picasso_mat4){ .m = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } };
+}
+
+picasso_mat4 picasso_mat4_mul(picasso_mat4 a, picasso_mat4 b)
+{
+    picasso_mat4 r;
+    for (int c = 0; c < 4; ++c) {
+        for (int row = 0; row < 4; ++row) {
+            r.m[c * 4 + row] = a.m[0 * 4 + row] * b.m[c * 4 + 0] +
+                               a.m[1 * 4 + row] * b.m[c * 4 + 1] +
+                               a.m[2 * 4 + row] * b.m[c * 4 + 2] +
+                               a.m[3 * 4 + row] * b.m[c * 4 + 3];
+        }
+    }
+    return r;
+}
+
+picasso_mat4 picasso_mat4_translate(float x, float y, float z)
+{
+    picasso_mat4 r = picasso_mat4_identity();
+    r.m[12] = x;
+    r.m[13] = y;
+    r.m[14] = z;
+    return r;
+}
+
+picasso_mat4 picasso_mat4_scale(float x, float y, float z)
+{
+    picasso_mat4 r = picasso_mat4_identity();
+    r.m[0] = x;
+    r.m[5] = y;
+    r.m[10] = z;
+    return r;
+}
+
+picasso_mat4 picasso_mat4_rotate_x(float radians)
+{
+    float c = cosf(radians), s = sinf(radians);
+    picasso_mat4 r = picasso_mat4_identity();
+    r.m[5] = c;  r.m[9]  = -s;
+    r.m[6] = s;  r.m[10] = c;
+    return r;
+}
+
+picasso_mat4 picasso_mat4_rotate_y(float radians)
+{
+    float c = cosf(radians), s = sinf(radians);
+    picasso_mat4 r = picasso_mat4_identity();
+    r.m[0] = c;  r.m[8]  = s;
+    r.m[2] = -s; r.m[10] = c;
+    return r;
+}
+
+picasso_mat4 picasso_mat4_rotate_z(float radians)
+{
+    float c = cosf(radians), s = sinf(radians);
+    picasso_mat4 r = picasso_mat4_identity();
+    r.m[0] = c;  r.m[4] = -s;
+    r.m[1] = s;  r.m[5] = c;
+    return r;
+}
+
+picasso_mat4 picasso_mat4_perspective(float fov_y, float aspect, float z_near, float z_far)
+{
+    float f = 1.0f / tanf(fov_y * 0.5f);
+    picasso_mat4 r = {0};
+    r.m[0]  = f / aspect;
+    r.m[5]  = f;
+    r.m[10] = (z_far + z_near) / (z_near - z_far);
+    r.m[11] = -1.0f;
+    r.m[14] = 2.0f * z_far * z_near / (z_near - z_far);
+    return r;
+}
+
+// --------------------------------------------------------
+// Depth buffer
+// --------------------------------------------------------
+
+// Depth buffer to the far plane over cb
+static void picasso__clear_depth_area(picasso_backbuffer *bf, picasso_draw_bounds cb)
+{
+    for (int y = cb.y0; y < cb.y1; ++y) {
+        size_t row = (size_t)y * bf->width;
+        if (bf->depth_bits == 16) {
+            uint16_t *d = (uint16_t *)bf->depth + row;
+            for (int x = cb.x0; x < cb.x1; ++x) d[x] = UINT16_MAX;
+        } else {
+            float *d = (float *)bf->depth + row;
+            for (int x = cb.x0; x < cb.x1; ++x) d[x] = 1.0f;
+        }
+    }
+}
+
+bool picasso_attach_depth(picasso_backbuffer *bf, int bits)
+{
+    if (!bf) return false;
+    if (bits != 16 && bits != 32) {
+        ERROR("Depth buffers are 16 or 32 bits, not %d", bits);
+        return false;
+    }
+
+    size_t size = (size_t)bf->width * bf->height * (bits == 16 ? sizeof(uint16_t) : sizeof(float));
+    void *depth = picasso_malloc(size);
+    if (!depth) {
+        ERROR("Failed to allocate a %d bit depth buffer", bits);
+        return false;
+    }
+
+    picasso_free(bf->depth);
+    bf->depth = depth;
+    bf->depth_bits = bits;
+
+    // Straight away, even while recording: a new buffer has nothing in it
+    picasso__clear_depth_area(bf, (picasso_draw_bounds){ 0, 0, (int)bf->width, (int)bf->height });
+    return true;
+}
+
+void picasso_clear_depth(picasso_backbuffer *bf)
+{
+    if (!bf) return;
+
+    // Recorded so it stays in order with the draws, but no damage, no
+    // pixel changes
+    if (bf->cmdlist && bf->cmdlist->recording) {
+        picasso__record(bf, &(picasso_cmd){ .type = PICASSO_CMD_CLEAR_DEPTH });
+        return;
+    }
+    if (bf->depth) picasso__clear_depth_area(bf, picasso__clip_bounds(bf));
+}
+
+// --------------------------------------------------------
+// Vertex transform and projection
+// --------------------------------------------------------
+
+static void picasso__transform_vertices(const picasso_mat4 *m, const picasso_vertex3d *in,
+                                        int count, picasso_vec4 *out)
+{
+#if defined(PICASSO_3D_SSE)
+    __m128 c0 = _mm_loadu_ps(&m->m[0]);
+    __m128 c1 = _mm_loadu_ps(&m->m[4]);
+    __m128 c2 = _mm_loadu_ps(&m->m[8]);
+    __m128 c3 = _mm_loadu_ps(&m->m[12]);
+    for (int i = 0; i < count; ++i) {
+        __m128 xy = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[i].x)),
+                               _mm_mul_ps(c1, _mm_set1_ps(in[i].y)));
+        __m128 zw = _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(in[i].z)), c3);
+        _mm_storeu_ps(&out[i].x, _mm_add_ps(xy, zw));
+    }
+#elif defined(PICASSO_3D_NEON)
+    float32x4_t c0 = vld1q_f32(&m->m[0]);
+    float32x4_t c1 = vld1q_f32(&m->m[4]);
+    float32x4_t c2 = vld1q_f32(&m->m[8]);
+    float32x4_t c3 = vld1q_f32(&m->m[12]);
+    for (int i = 0; i < count; ++i) {
+        float32x4_t r = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(c3, c0, in[i].x), c1, in[i].y), c2, in[i].z);
+        vst1q_f32(&out[i].x, r);
+    }
+#else
+    const float *c = m->m;
+    for (int i = 0; i < count; ++i) {
+        float x = in[i].x, y = in[i].y, z = in[i].z;
+        out[i] = (picasso_vec4){
+            (c[0] * x + c[4] * y) + (c[8]  * z + c[12]),
+            (c[1] * x + c[5] * y) + (c[9]  * z + c[13]),
+            (c[2] * x + c[6] * y) + (c[10] * z + c[14]),
+            (c[3] * x + c[7] * y) + (c[11] * z + c[15]) };
+    }
+#endif
+}
+
+static inline uint32_t picasso__clip_code(picasso_vec4 p)
+{
+    return (p.z < -p.w ? PICASSO_CLIP_NEAR   : 0) | (p.z > p.w ? PICASSO_CLIP_FAR   : 0) |
+           (p.x < -p.w ? PICASSO_CLIP_LEFT   : 0) | (p.x > p.w ? PICASSO_CLIP_RIGHT : 0) |
+           (p.y < -p.w ? PICASSO_CLIP_BOTTOM : 0) | (p.y > p.w ? PICASSO_CLIP_TOP   : 0);
+}
+
+// Clip space to backbuffer pixels, y down, and depth to 0..1
+static picasso_screen_vertex picasso__project(const picasso_backbuffer *bf,
+                                              const picasso_clip_vertex *v)
+{
+    picasso_screen_vertex s = { .ok = false };
+    if (!(v->p.w > 0.0f)) return s;
+
+    s.q = 1.0f / v->p.w;
+    float px = (v->p.x * s.q * 0.5f + 0.5f) * (float)bf->width;
+    float py = (0.5f - v->p.y * s.q * 0.5f) * (float)bf->height;
+    if (!picasso__to_subpixel(px, py, &s.sx, &s.sy)) return s;
+
+    s.z = v->p.z * s.q * 0.5f + 0.5f;
+    for (int k = 0; k < PICASSO_3D_ATTRS; ++k)
+        s.attr[k] = v->attr[k] * s.q;
+    s.ok = true;
+    return s;
+}
+
+/* Cuts a triangle with the near plane, z + w = 0. Keeps the part in front,
+ * which has 3 or 4 corners, and returns how many */
+static int picasso__clip_near(const picasso_clip_vertex *in[3], picasso_clip_vertex out[4])
+{
+    int n = 0;
+    for (int i = 0; i < 3; ++i) {
+        const picasso_clip_vertex *a = in[i], *b = in[(i + 1) % 3];
+        float da = a->p.z + a->p.w, db = b->p.z + b->p.w;
+
+        if (da >= 0.0f) out[n++] = *a;
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            float t = da / (da - db);
+            picasso_clip_vertex *v = &out[n++];
+            v->p.x = a->p.x + (b->p.x - a->p.x) * t;
+            v->p.y = a->p.y + (b->p.y - a->p.y) * t;
+            v->p.z = a->p.z + (b->p.z - a->p.z) * t;
+            v->p.w = a->p.w + (b->p.w - a->p.w) * t;
+            for (int k = 0; k < PICASSO_3D_ATTRS; ++k)
+                v->attr[k] = a->attr[k] + (b->attr[k] - a->attr[k]) * t;
+        }
+    }
+    return n;
+}
+
+// --------------------------------------------------------
+// Rasterizing
+// --------------------------------------------------------
+
+typedef struct {
+    picasso_backbuffer *bf;
+    picasso_draw_bounds cb;
+    picasso_image *tex;
+    int flags;
+} picasso_raster3d;
+
+static void picasso__raster_triangle(const picasso_raster3d *r, const picasso_screen_vertex *v[3])
+{
+    if (!v[0]->ok || !v[1]->ok || !v[2]->ok) return;
+
+    int64_t vx[3] = { v[0]->sx, v[1]->sx, v[2]->sx };
+    int64_t vy[3] = { v[0]->sy, v[1]->sy, v[2]->sy };
+
+    // Counter-clockwise on screen is negative with y pointing down
+    int64_t area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+    if (area == 0) return;
+    if (area > 0 && (r->flags & PICASSO_3D_CULL_BACK)) return;
+
+    picasso_tri_setup t;
+    if (!picasso__setup_triangle(&t, vx, vy, r->cb)) return;
+
+    picasso_plane_setup ps = picasso__plane_setup(vx, vy);
+    picasso_plane pz = picasso__make_plane(&ps, v[0]->z, v[1]->z, v[2]->z);
+    picasso_plane pq = picasso__make_plane(&ps, v[0]->q, v[1]->q, v[2]->q);
+    picasso_plane pa[PICASSO_3D_ATTRS];
+    int attrs = r->tex ? PICASSO_3D_ATTRS : 4;
+    for (int k = 0; k < attrs; ++k)
+        pa[k] = picasso__make_plane(&ps, v[0]->attr[k], v[1]->attr[k], v[2]->attr[k]);
+
+    picasso_backbuffer *bf = r->bf;
+    picasso_image *tex = r->tex;
+    bool use_depth = bf->depth && !(r->flags & PICASSO_3D_NO_DEPTH);
+    uint16_t *depth16 = bf->depth_bits == 16 ? bf->depth : NULL;
+    float *depth32 = bf->depth_bits == 32 ? bf->depth : NULL;
+    float u_max = tex ? (float)(tex->width - 1) : 0.0f;
+    float v_max = tex ? (float)(tex->height - 1) : 0.0f;
+    uint32_t row[PICASSO_SPAN_CHUNK];
+    uint8_t passed[PICASSO_SPAN_CHUNK]; // coverage, for blend modes other than over
+
+    for (int y = t.y0; y < t.y1; ++y) {
+        int x0, x1;
+        if (!picasso__triangle_span(&t, r->cb, &x0, &x1)) continue;
+
+        float fy = (float)y;
+        float z_row = pz.base + pz.dy * fy;
+        float q_row = pq.base + pq.dy * fy;
+        float a_row[PICASSO_3D_ATTRS];
+        for (int k = 0; k < attrs; ++k)
+            a_row[k] = pa[k].base + pa[k].dy * fy;
+        size_t line = (size_t)y * bf->width;
+
+        for (int px = x0; px < x1; px += PICASSO_SPAN_CHUNK) {
+            int n = PICASSO_MIN(x1 - px, PICASSO_SPAN_CHUNK);
+
+            for (int i = 0; i < n; ++i) {
+                int x = px + i;
+                float fx = (float)x;
+
+                // Depth test. Failing pixels are left fully transparent,
+                // which the span blend leaves alone, and uncovered for the
+                // other blend modes
+                float z = z_row + pz.dx * fx;
+                row[i] = 0;
+                passed[i] = 0;
+                if (z < 0.0f || z > 1.0f) continue;
+                if (use_depth) {
+                    if (depth16) {
+                        uint16_t d = (uint16_t)(z * 65535.0f + 0.5f);
+                        if (d >= depth16[line + x]) continue;
+                        depth16[line + x] = d;
+                    } else {
+                        if (z >= depth32[line + x]) continue;
+                        depth32[line + x] = z;
+                    }
+                }
+
+                // Perspective correct: attr/w and 1/w are linear on screen
+                float w = 1.0f / (q_row + pq.dx * fx);
+                float a[PICASSO_3D_ATTRS];
+                for (int k = 0; k < attrs; ++k)
+                    a[k] = (a_row[k] + pa[k].dx * fx) * w;
+
+                uint32_t red   = (uint32_t)(PICASSO_CLAMP(a[0], 0.0f, 255.0f) + 0.5f);
+                uint32_t green = (uint32_t)(PICASSO_CLAMP(a[1], 0.0f, 255.0f) + 0.5f);
+                uint32_t blue  = (uint32_t)(PICASSO_CLAMP(a[2], 0.0f, 255.0f) + 0.5f);
+                uint32_t alpha = (uint32_t)(PICASSO_CLAMP(a[3], 0.0f, 255.0f) + 0.5f);
+
+                uint32_t c = red | (green << 8) | (blue << 16) | (alpha << 24);
+                passed[i] = 255;
+                if (tex) {
+                    // Nearest texel, clamped to the edge, tinted by the color
+                    int tx = (int)PICASSO_CLAMP(a[4], 0.0f, u_max);
+                    int ty = (int)PICASSO_CLAMP(a[5], 0.0f, v_max);
+                    color texel = get_color_u8(picasso__get_pixel_u8(tex, tx, ty), tex->channels);
+                    row[i] = picasso__tint_texel(tex, color_to_u32(texel), c);
+                } else {
+                    row[i] = picasso__premultiply(c);
+                }
+            }
+            if (bf->blend == PICASSO_BLEND_SRC_OVER)
+                picasso__span_blend(&bf->pixels[line + px], row, n);
+            else
+                picasso__span_composite(&bf->pixels[line + px], row, passed, n, bf->blend);
+        }
+    }
+}
+
+// --------------------------------------------------------
+// Public API
+// --------------------------------------------------------
+
+void picasso_draw_mesh3d(picasso_backbuffer *bf, const picasso_mat4 *mvp,
+                         const picasso_vertex3d *vertices, int vertex_count,
+                         const uint32_t *indices, int index_count,
+                         picasso_image *texture, int flags)
+{
+    if (!bf || !mvp || !vertices || vertex_count <= 0 || index_count < 3) return;
+
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_MESH3D, .mesh3d = {
+        mvp, vertices, indices, texture, vertex_count, index_count, flags, 0 });
+
+    if (texture && (!texture->pixels || texture->width <= 0 || texture->height <= 0)) {
+        WARN("Mesh texture has no pixels, drawing vertex colors only");
+        texture = NULL;
+    }
+
+    size_t n = (size_t)vertex_count;
+    uint8_t *scratch = picasso_malloc(n * (sizeof(picasso_vec4) + sizeof(picasso_clip_vertex) +
+                                           sizeof(picasso_screen_vertex) + sizeof(uint32_t)));
+    if (!scratch) {
+        ERROR("Out of memory setting up a 3D mesh of %d vertices", vertex_count);
+        return;
+    }
+    picasso_clip_vertex *clip = (picasso_clip_vertex *)scratch;
+    picasso_screen_vertex *screen = (picasso_screen_vertex *)(clip + n);
+    picasso_vec4 *pos = (picasso_vec4 *)(screen + n);
+    uint32_t *codes = (uint32_t *)(pos + n);
+
+    // 1. Transform
+    picasso__transform_vertices(mvp, vertices, vertex_count, pos);
+
+    // 2. Classify and project
+    float tw = texture ? (float)texture->width : 0.0f;
+    float th = texture ? (float)texture->height : 0.0f;
+    for (int i = 0; i < vertex_count; ++i) {
+        picasso_clip_vertex *c = &clip[i];
+        c->p = pos[i];
+        c->attr[0] = vertices[i].c.r;
+        c->attr[1] = vertices[i].c.g;
+        c->attr[2] = vertices[i].c.b;
+        c->attr[3] = vertices[i].c.a;
+        c->attr[4] = vertices[i].u * tw;
+        c->attr[5] = vertices[i].v * th;
+
+        codes[i] = picasso__clip_code(c->p);
+        screen[i] = (codes[i] & PICASSO_CLIP_NEAR)
+                  ? (picasso_screen_vertex){ .ok = false }
+                  : picasso__project(bf, c);
+    }
+
+    // 3. Triangles
+    picasso_raster3d r = { bf, picasso__clip_bounds(bf), texture, flags };
+    int culled = 0, clipped = 0;
+
+    for (int first = 0; first + 2 < index_count; first += 3) {
+        uint32_t idx[3];
+        for (int k = 0; k < 3; ++k)
+            idx[k] = indices ? indices[first + k] : (uint32_t)(first + k);
+        if (idx[0] >= n || idx[1] >= n || idx[2] >= n) {
+            TRACE("3D mesh triangle %d has an index out of range, skipping", first / 3);
+            continue;
+        }
+
+        uint32_t all = codes[idx[0]] & codes[idx[1]] & codes[idx[2]];
+        uint32_t any = codes[idx[0]] | codes[idx[1]] | codes[idx[2]];
+        if (all) { culled++; continue; }
+
+        if (!(any & PICASSO_CLIP_NEAR)) {
+            const picasso_screen_vertex *tri[3] = { &screen[idx[0]], &screen[idx[1]], &screen[idx[2]] };
+            picasso__raster_triangle(&r, tri);
+            continue;
+        }
+
+        // Crosses the near plane: clip, project the corners, draw as a fan
+        clipped++;
+        const picasso_clip_vertex *in[3] = { &clip[idx[0]], &clip[idx[1]], &clip[idx[2]] };
+        picasso_clip_vertex poly[4];
+        int corners = picasso__clip_near(in, poly);
+
+        picasso_screen_vertex proj[4];
+        for (int k = 0; k < corners; ++k)
+            proj[k] = picasso__project(bf, &poly[k]);
+        for (int k = 1; k + 1 < corners; ++k) {
+            const picasso_screen_vertex *tri[3] = { &proj[0], &proj[k], &proj[k + 1] };
+            picasso__raster_triangle(&r, tri);
+        }
+    }
+
+    TRACE("3D mesh: %d triangles, %d outside the frustum, %d clipped at the near plane",
+          index_count / 3, culled, clipped);
+    picasso_free(scratch);
+}
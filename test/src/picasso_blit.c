@@ -0,0 +1,1122 @@
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Scaled blits.
+ *
+ * The source is stepped in 16.16 fixed point, and since the mapping of
+ * columns is the same for every row, it is worked out once per blit: the
+ * source column (or the two bilinear taps and their weight, or the box
+ * footprint) of every destination column of the clipped area. Rows then only
+ * look those up.
+ *
+ * Reading the source and writing the destination are kernels picked once per
+ * blit. Every channel count has its own loops to convert a row to backbuffer
+ * pixels, and the row is then written one of three ways depending on what the
+ * alpha of the image holds: copied when it is opaque, copied where alpha is
+ * set when it only has 0 and 255 (which is exactly what blending gives), and
+ * blended otherwise. Blend modes other than source-over always blend.
+ * Unscaled opaque rows are converted straight into the backbuffer, as a
+ * memcpy for RGBA and a swizzle for RGB. Blended rows have to be
+ * premultiplied like the backbuffer, which loaded images already are, and
+ * they are filtered that way too so texels with no alpha don't bleed their
+ * color in.
+ *
+ * Pixels are sampled at their centers, so a destination pixel maps to the
+ * source point (x + 0.5) * src_w / dst_w. Nearest takes the texel that point
+ * falls in, bilinear mixes the four texels around it and box averages the
+ * texels the destination pixel covers, each by how much of it they cover.
+ * Taps never leave the source rect, so blitting one cell of an atlas doesn't
+ * bleed in its neighbors.
+ *
+ * Bilinear only ever mixes four texels, so shrunk by much it skips most of
+ * them and aliases. Shrunk by 2 or more, bilinear and trilinear sample a mip
+ * level of the image instead, where every texel already averages the ones it
+ * stands for, and the steps are worked out against that level's rect. Levels
+ * are built the first time one is needed, and a rect only goes as far down as
+ * its edges fall between texels of the level, so cells of an atlas still
+ * don't bleed. */
+
+// Converts n contiguous source pixels, or n at the given byte offsets
+typedef void (*picasso_fetch_fn)(const uint8_t *p, int n, uint32_t *out);
+typedef void (*picasso_gather_fn)(const uint8_t *p, const int32_t *offset, int n, uint32_t *out);
+
+typedef enum {
+    PICASSO_BLIT_COPY,  // opaque source
+    PICASSO_BLIT_TEST,  // alpha is 0 or 255, only the 255 ones are written
+    PICASSO_BLIT_OVER,  // blended, source-over or any other blend mode
+} picasso_blit_op;
+
+typedef struct {
+    picasso_image *src;
+    picasso_rect src_r;       // clamped to the image, pixels of the source
+    picasso_rect dst_px;      // the whole destination rect, in pixels
+    picasso_draw_bounds b;    // the part of it inside the clip
+    int64_t step_x, step_y;   // source pixels per destination pixel, 16.16
+
+    picasso_blit_op op;
+    bool premultiply;         // rows are straight alpha and get blended
+    picasso_fetch_fn fetch;
+    picasso_gather_fn gather;
+    picasso_write_fn write;
+} picasso_blit_setup;
+
+// --------------------------------------------------------
+// Source formats
+// --------------------------------------------------------
+
+static inline uint32_t picasso__load_1(const uint8_t *q)
+{
+    return 0xFF000000u | (uint32_t)q[0] * 0x010101u;
+}
+
+static inline uint32_t picasso__load_2(const uint8_t *q)
+{
+    return ((uint32_t)q[1] << 24) | (uint32_t)q[0] * 0x010101u;
+}
+
+static inline uint32_t picasso__load_3(const uint8_t *q)
+{
+    return 0xFF000000u | ((uint32_t)q[2] << 16) | ((uint32_t)q[1] << 8) | q[0];
+}
+
+static inline uint32_t picasso__load_4(const uint8_t *q)
+{
+    uint32_t v;
+    memcpy(&v, q, sizeof(v));
+    return v;
+}
+
+// Loops per channel count with the load inlined. RGB and RGBA rows have a
+// faster way to be fetched than a loop of loads
+#define PICASSO_FETCH(ch)                                                             \
+    static void picasso__fetch_##ch(const uint8_t *p, int n, uint32_t *out)           \
+    {                                                                                 \
+        for (int i = 0; i < n; ++i) out[i] = picasso__load_##ch(p + (ch) * i);        \
+    }
+#define PICASSO_GATHER(ch)                                                            \
+    static void picasso__gather_##ch(const uint8_t *p, const int32_t *offset, int n,  \
+                                     uint32_t *out)                                   \
+    {                                                                                 \
+        for (int i = 0; i < n; ++i) out[i] = picasso__load_##ch(p + offset[i]);       \
+    }
+
+PICASSO_FETCH(1)
+PICASSO_FETCH(2)
+PICASSO_GATHER(1)
+PICASSO_GATHER(2)
+PICASSO_GATHER(3)
+PICASSO_GATHER(4)
+#undef PICASSO_FETCH
+#undef PICASSO_GATHER
+
+static void picasso__fetch_3(const uint8_t *p, int n, uint32_t *out)
+{
+    picasso__span_rgb_to_rgba(out, p, n);
+}
+
+static void picasso__fetch_4(const uint8_t *p, int n, uint32_t *out)
+{
+    memcpy(out, p, (size_t)n * sizeof(uint32_t));
+}
+
+static const picasso_fetch_fn picasso__fetch[5] = {
+    NULL, picasso__fetch_1, picasso__fetch_2, picasso__fetch_3, picasso__fetch_4,
+};
+static const picasso_gather_fn picasso__gather[5] = {
+    NULL, picasso__gather_1, picasso__gather_2, picasso__gather_3, picasso__gather_4,
+};
+
+// n texels of row y from column x on, converted a contiguous run at a time
+static inline void picasso__fetch_texels(const picasso_image *img, int x, int y, int n, uint32_t *out)
+{
+    const uint8_t *row = &img->pixels[picasso__row_offset(img, y)];
+    for (int i = 0, run; i < n; i += run) {
+        run = picasso__row_run(img, x + i, n - i);
+        picasso__fetch[img->channels](row + picasso__col_offset(img, x + i), run, out + i);
+    }
+}
+
+// n pixels of row y from column x on, in backbuffer layout
+static inline void picasso__fetch_row(const picasso_blit_setup *s, int x, int y, int n, uint32_t *out)
+{
+    picasso__fetch_texels(s->src, x, y, n, out);
+    if (s->premultiply) picasso__span_premultiply(out, n);
+}
+
+// RGBA rows that can be read as backbuffer pixels where they are
+static inline bool picasso__rows_in_place(const picasso_blit_setup *s)
+{
+    const picasso_image *img = s->src;
+    return img->channels == 4 && !s->premultiply && img->layout == PICASSO_LAYOUT_LINEAR &&
+           ((uintptr_t)img->pixels % sizeof(uint32_t)) == 0 &&
+           img->row_stride % (int)sizeof(uint32_t) == 0;
+}
+
+// --------------------------------------------------------
+// Writing rows
+// --------------------------------------------------------
+
+// Blended rows go through the blend kernels of the backbuffer's mode
+static const picasso_write_fn picasso__write[2] = {
+    [PICASSO_BLIT_COPY] = picasso__write_copy,
+    [PICASSO_BLIT_TEST] = picasso__write_test,
+};
+
+// Writes a row that starts at the left of the clipped area
+static inline void picasso__write_row(picasso_backbuffer *bf, const picasso_blit_setup *s, int y,
+                                      const uint32_t *row)
+{
+    s->write(picasso__get_pixel_u32(bf, s->b.x0, y), row, s->b.x1 - s->b.x0);
+}
+
+// --------------------------------------------------------
+// Sampling positions
+// --------------------------------------------------------
+
+// Source position of the center of destination pixel i, 16.16
+static inline int64_t picasso__center(int i, int64_t step)
+{
+    return (int64_t)i * step + step / 2;
+}
+
+// Nearest texel, in [0, size)
+static inline int picasso__nearest(int i, int64_t step, int size)
+{
+    int64_t t = picasso__center(i, step) >> 16;
+    return t < size ? (int)t : size - 1;
+}
+
+/* First bilinear tap and the weight of the second, out of 256. The first
+ * tap is never the last texel, there the weight is all on the second one.
+ * A source one texel wide has both taps on it with no weight on the second */
+static inline void picasso__taps(int i, int64_t step, int size, int32_t *t0, uint16_t *w)
+{
+    int64_t u = picasso__center(i, step) - 0x8000;
+    if (u < 0) u = 0;
+    int64_t t = u >> 16;
+    if (size < 2) {
+        *t0 = 0;
+        *w = 0;
+    } else if (t >= size - 1) {
+        *t0 = size - 2;
+        *w = 256;
+    } else {
+        *t0 = (int32_t)t;
+        *w = (uint16_t)((u & 0xFFFF) >> 8);
+    }
+}
+
+/* Texels under destination pixel i, [t0, t1), and how much of the first and
+ * the last one it covers, out of 256 (the ones between are covered fully).
+ * There is always at least one texel, even when magnifying past 65536x
+ * leaves a step of 0, and a weight is never 0, so neither is the total */
+typedef struct { int t0, t1; uint32_t w0, w1; } picasso_footprint;
+
+static inline picasso_footprint picasso__footprint(int i, int64_t step)
+{
+    int64_t a = (int64_t)i * step, b = a + step;
+    picasso_footprint f = { (int)(a >> 16), (int)((b + 0xFFFF) >> 16), 0, 0 };
+    if (f.t1 <= f.t0) f.t1 = f.t0 + 1;
+
+    int64_t first_end = (int64_t)(f.t0 + 1) << 16;
+    f.w0 = (uint32_t)(((b < first_end ? b : first_end) - a) >> 8);
+    f.w1 = f.t1 - f.t0 > 1 ? (uint32_t)((b - ((int64_t)(f.t1 - 1) << 16)) >> 8) : f.w0;
+    if (f.w0 == 0) f.w0 = 1;
+    if (f.w1 == 0) f.w1 = 1;
+    return f;
+}
+
+static inline uint32_t picasso__footprint_weight(const picasso_footprint *f, int t)
+{
+    return t == f->t0 ? f->w0 : (t == f->t1 - 1 ? f->w1 : 256);
+}
+
+// --------------------------------------------------------
+// Filters
+// --------------------------------------------------------
+
+static void picasso__blit_nearest(picasso_backbuffer *bf, const picasso_blit_setup *s)
+{
+    const picasso_image *img = s->src;
+    int cols = s->b.x1 - s->b.x0;
+
+    // Unscaled, the columns are contiguous from x0 on and RGBA rows can be
+    // written from where they are. Copies are converted straight into the
+    // backbuffer, anything else goes through a row first. Tiled rows aren't
+    // contiguous, they take the column table like scaled ones
+    bool unscaled = s->step_x == 1 << 16 && img->layout == PICASSO_LAYOUT_LINEAR;
+    int x0 = s->src_r.x + (s->b.x0 - s->dst_px.x);
+    bool in_place = unscaled && picasso__rows_in_place(s);
+    bool need_row = !in_place && s->op != PICASSO_BLIT_COPY;
+
+    size_t size = (unscaled ? 0 : (size_t)cols * sizeof(int32_t)) +
+                  (need_row ? (size_t)cols * sizeof(uint32_t) : 0);
+    void *scratch = size ? picasso_malloc(size) : NULL;
+    if (size && !scratch) {
+        ERROR("Out of memory blitting %d columns", cols);
+        return;
+    }
+    int32_t *offset = scratch;
+    uint32_t *row = unscaled ? scratch : (uint32_t *)(offset + cols);
+
+    if (!unscaled) {
+        for (int i = 0; i < cols; ++i) {
+            int sx = picasso__nearest(s->b.x0 - s->dst_px.x + i, s->step_x, s->src_r.width);
+            offset[i] = (int32_t)picasso__col_offset(img, s->src_r.x + sx);
+        }
+    }
+
+    // Magnified rows repeat, they are converted once
+    int last = -1;
+    uint32_t *last_dst = NULL;
+    for (int y = s->b.y0; y < s->b.y1; ++y) {
+        int sy = s->src_r.y + picasso__nearest(y - s->dst_px.y, s->step_y, s->src_r.height);
+        uint32_t *dst = picasso__get_pixel_u32(bf, s->b.x0, y);
+        const uint8_t *p = &img->pixels[picasso__row_offset(img, sy)];
+
+        if (in_place) {
+            s->write(dst, (const uint32_t *)p + x0, cols);
+        } else if (s->op == PICASSO_BLIT_COPY) {
+            if (sy == last)      memcpy(dst, last_dst, (size_t)cols * sizeof(uint32_t));
+            else if (unscaled)   s->fetch(p + x0 * img->channels, cols, dst);
+            else                 s->gather(p, offset, cols, dst);
+        } else {
+            if (sy != last) {
+                if (unscaled) s->fetch(p + x0 * img->channels, cols, row);
+                else          s->gather(p, offset, cols, row);
+                if (s->premultiply) picasso__span_premultiply(row, cols);
+            }
+            s->write(dst, row, cols);
+        }
+        last = sy;
+        last_dst = dst;
+    }
+
+    picasso_free(scratch);
+}
+
+/* Bilinear sampling a row at a time. The taps of every column are worked out
+ * once, and the last two source rows kept converted */
+typedef struct {
+    const picasso_blit_setup *s;
+    int32_t *tap;
+    uint16_t *weight;
+    uint32_t *out;      // the sampled row, with one spare pixel
+    uint32_t *rows[2];
+    int cached[2];
+    bool direct;
+} picasso_bilinear;
+
+static bool picasso__bilinear_init(picasso_bilinear *bl, const picasso_blit_setup *s)
+{
+    int cols = s->b.x1 - s->b.x0, sw = s->src_r.width;
+
+    // RGBA rows are sampled in place, anything else is converted a row at a
+    // time, with the last texel repeated for the second tap of a one texel
+    // wide source
+    bl->s = s;
+    bl->direct = sw >= 2 && picasso__rows_in_place(s);
+    size_t scratch = bl->direct ? 0 : 2 * (size_t)(sw + 1);
+
+    size_t size = (size_t)cols * (sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint16_t)) +
+                  (scratch + 1) * sizeof(uint32_t);
+    bl->tap = picasso_malloc(size);
+    if (!bl->tap) {
+        ERROR("Out of memory blitting %d columns", cols);
+        return false;
+    }
+    bl->out = (uint32_t *)(bl->tap + cols);
+    bl->rows[0] = bl->out + cols + 1;
+    bl->rows[1] = bl->rows[0] + sw + 1;
+    bl->weight = (uint16_t *)(bl->rows[0] + scratch);
+    bl->cached[0] = bl->cached[1] = -1;
+
+    for (int i = 0; i < cols; ++i)
+        picasso__taps(s->b.x0 - s->dst_px.x + i, s->step_x, sw, &bl->tap[i], &bl->weight[i]);
+    return true;
+}
+
+// Destination row y, from the left of the clipped area
+static uint32_t *picasso__bilinear_row(picasso_bilinear *bl, int y)
+{
+    const picasso_blit_setup *s = bl->s;
+    const picasso_image *img = s->src;
+    int sw = s->src_r.width;
+
+    int32_t ty;
+    uint16_t fy;
+    picasso__taps(y - s->dst_px.y, s->step_y, s->src_r.height, &ty, &fy);
+    int sy[2] = { s->src_r.y + ty, s->src_r.y + ty + (s->src_r.height > 1) };
+
+    const uint32_t *r[2];
+    for (int k = 0; k < 2; ++k) {
+        if (bl->direct) {
+            r[k] = (const uint32_t *)&img->pixels[sy[k] * img->row_stride] + s->src_r.x;
+            continue;
+        }
+        // Going down, the second row of the last pixel is often the first now
+        if (bl->cached[k] != sy[k]) {
+            if (bl->cached[1 - k] == sy[k]) {
+                uint32_t *t = bl->rows[k];
+                bl->rows[k] = bl->rows[1 - k];
+                bl->rows[1 - k] = t;
+                bl->cached[1 - k] = bl->cached[k];
+            } else {
+                picasso__fetch_row(s, s->src_r.x, sy[k], sw, bl->rows[k]);
+                bl->rows[k][sw] = bl->rows[k][sw - 1];
+            }
+            bl->cached[k] = sy[k];
+        }
+        r[k] = bl->rows[k];
+    }
+
+    picasso__span_bilinear(bl->out, r[0], r[1], bl->tap, bl->weight, s->b.x1 - s->b.x0, fy);
+    return bl->out;
+}
+
+static void picasso__blit_bilinear(picasso_backbuffer *bf, const picasso_blit_setup *s)
+{
+    picasso_bilinear bl;
+    if (!picasso__bilinear_init(&bl, s)) return;
+
+    for (int y = s->b.y0; y < s->b.y1; ++y)
+        picasso__write_row(bf, s, y, picasso__bilinear_row(&bl, y));
+
+    picasso_free(bl.tap);
+}
+
+/* Both levels sampled bilinearly, then mixed by how far the scale is from
+ * the first to the second. That is span_bilinear with every pixel tapping
+ * itself and no weight across, only down */
+static void picasso__blit_trilinear(picasso_backbuffer *bf, const picasso_blit_setup *s0,
+                                    const picasso_blit_setup *s1, uint32_t mix)
+{
+    int cols = s0->b.x1 - s0->b.x0;
+
+    picasso_bilinear bl[2];
+    if (!picasso__bilinear_init(&bl[0], s0)) return;
+    if (!picasso__bilinear_init(&bl[1], s1)) {
+        picasso_free(bl[0].tap);
+        return;
+    }
+    size_t size = (size_t)cols * (sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint16_t));
+    int32_t *tap = picasso_malloc(size);
+    if (!tap) {
+        ERROR("Out of memory blitting %d columns", cols);
+        picasso_free(bl[0].tap);
+        picasso_free(bl[1].tap);
+        return;
+    }
+    uint32_t *out = (uint32_t *)(tap + cols);
+    uint16_t *weight = (uint16_t *)(out + cols);
+    for (int i = 0; i < cols; ++i) {
+        tap[i] = i;
+        weight[i] = 0;
+    }
+
+    for (int y = s0->b.y0; y < s0->b.y1; ++y) {
+        uint32_t *a = picasso__bilinear_row(&bl[0], y), *b = picasso__bilinear_row(&bl[1], y);
+        a[cols] = b[cols] = 0; // the second tap of the last pixel, weighted 0
+        picasso__span_bilinear(out, a, b, tap, weight, cols, mix);
+        picasso__write_row(bf, s0, y, out);
+    }
+
+    picasso_free(tap);
+    picasso_free(bl[0].tap);
+    picasso_free(bl[1].tap);
+}
+
+/* Every texel counts by how much of the destination pixel it covers. Per row
+ * of the destination, the source rows under it are summed per column first,
+ * then each pixel adds up the columns of its footprint */
+static void picasso__blit_box(picasso_backbuffer *bf, const picasso_blit_setup *s)
+{
+    int cols = s->b.x1 - s->b.x0;
+
+    int first = picasso__footprint(s->b.x0 - s->dst_px.x, s->step_x).t0;
+    int span = picasso__footprint(s->b.x1 - 1 - s->dst_px.x, s->step_x).t1 - first;
+
+    size_t size = (size_t)cols * (sizeof(picasso_footprint) + sizeof(uint32_t)) +
+                  (size_t)span * 5 * sizeof(uint32_t);
+    picasso_footprint *fx = picasso_malloc(size);
+    if (!fx) {
+        ERROR("Out of memory blitting %d columns", cols);
+        return;
+    }
+    uint32_t *out = (uint32_t *)(fx + cols);
+    uint32_t *texels = out + cols;
+    uint32_t *sums = texels + span; // 4 channels per column
+
+    for (int i = 0; i < cols; ++i) {
+        fx[i] = picasso__footprint(s->b.x0 - s->dst_px.x + i, s->step_x);
+        fx[i].t0 -= first;
+        fx[i].t1 -= first;
+    }
+
+    for (int y = s->b.y0; y < s->b.y1; ++y) {
+        picasso_footprint fy = picasso__footprint(y - s->dst_px.y, s->step_y);
+
+        // Sums stay below 255 * 256 per source row, so 32 bits hold 65k rows
+        memset(sums, 0, (size_t)span * 4 * sizeof(uint32_t));
+        uint32_t wy_total = 0;
+        for (int sy = fy.t0; sy < fy.t1; ++sy) {
+            uint32_t wy = picasso__footprint_weight(&fy, sy);
+            wy_total += wy;
+            picasso__fetch_row(s, s->src_r.x + first, s->src_r.y + sy, span, texels);
+            for (int i = 0; i < span; ++i) {
+                uint32_t p = texels[i];
+                sums[4 * i + 0] += (p & 0xFF) * wy;
+                sums[4 * i + 1] += ((p >> 8) & 0xFF) * wy;
+                sums[4 * i + 2] += ((p >> 16) & 0xFF) * wy;
+                sums[4 * i + 3] += (p >> 24) * wy;
+            }
+        }
+
+        for (int i = 0; i < cols; ++i) {
+            const picasso_footprint *f = &fx[i];
+            const uint32_t *first_sum = &sums[4 * f->t0], *last_sum = &sums[4 * (f->t1 - 1)];
+            uint64_t c[4], wx_total = f->w0;
+            for (int ch = 0; ch < 4; ++ch) c[ch] = (uint64_t)first_sum[ch] * f->w0;
+            if (f->t1 - f->t0 > 1) {
+                // Columns between the first and the last count fully
+                uint64_t mid[4] = {0};
+                for (int k = f->t0 + 1; k < f->t1 - 1; ++k) {
+                    mid[0] += sums[4 * k + 0];
+                    mid[1] += sums[4 * k + 1];
+                    mid[2] += sums[4 * k + 2];
+                    mid[3] += sums[4 * k + 3];
+                }
+                for (int ch = 0; ch < 4; ++ch)
+                    c[ch] += (mid[ch] << 8) + (uint64_t)last_sum[ch] * f->w1;
+                wx_total += 256u * (uint32_t)(f->t1 - f->t0 - 2) + f->w1;
+            }
+            // One divide per pixel, not one per channel
+            double inv = 1.0 / (double)(wx_total * wy_total);
+            uint32_t p = 0;
+            for (int ch = 0; ch < 4; ++ch)
+                p |= (uint32_t)((double)c[ch] * inv + 0.5) << (8 * ch);
+            out[i] = p;
+        }
+        picasso__write_row(bf, s, y, out);
+    }
+
+    picasso_free(fx);
+}
+
+// --------------------------------------------------------
+// Mip levels
+// --------------------------------------------------------
+
+/* The level below img, premultiplied RGBA whatever img is. An odd last
+ * column or row is left out, except of an image one texel across, which is
+ * averaged with itself */
+static picasso_image *picasso__build_mip(const picasso_image *img)
+{
+    int w = img->width > 1 ? img->width / 2 : 1, h = img->height > 1 ? img->height / 2 : 1;
+    picasso_image *mip = picasso_alloc_image(w, h, 4);
+    if (!mip) return NULL;
+
+    bool opaque = img->channels == 1 || img->channels == 3 || img->alpha == PICASSO_ALPHA_OPAQUE;
+    bool premultiply = !opaque && !img->premultiplied;
+    // Premultiplied RGBA, which every level after the first is, is read in place
+    bool in_place = img->channels == 4 && !premultiply && img->width > 1 &&
+                    img->layout == PICASSO_LAYOUT_LINEAR &&
+                    ((uintptr_t)img->pixels % sizeof(uint32_t)) == 0 &&
+                    img->row_stride % (int)sizeof(uint32_t) == 0;
+    int n = img->width > 1 ? 2 * w : 1;
+    uint32_t *rows = in_place ? NULL : picasso_malloc(4 * (size_t)w * sizeof(uint32_t));
+    if (!in_place && !rows) {
+        picasso_free_image(mip);
+        return NULL;
+    }
+
+    for (int y = 0; y < h; ++y) {
+        int sy[2] = { img->height > 1 ? 2 * y : 0, img->height > 1 ? 2 * y + 1 : 0 };
+        const uint32_t *r[2];
+        for (int k = 0; k < 2; ++k) {
+            if (in_place) {
+                r[k] = (const uint32_t *)&img->pixels[sy[k] * img->row_stride];
+                continue;
+            }
+            uint32_t *row = rows + 2 * (size_t)w * k;
+            picasso__fetch_texels(img, 0, sy[k], n, row);
+            if (premultiply) picasso__span_premultiply(row, n);
+            if (n == 1) row[1] = row[0];
+            r[k] = row;
+        }
+        picasso__span_downsample((uint32_t *)&mip->pixels[y * mip->row_stride], r[0], r[1], w);
+    }
+    picasso_free(rows);
+
+    mip->premultiplied = true;
+    if (opaque) mip->alpha = PICASSO_ALPHA_OPAQUE;
+    else        picasso_image_update_alpha(mip);
+    return mip;
+}
+
+picasso_image *picasso__image_mip(picasso_image *img, int *level, bool build)
+{
+    int got = 0;
+    for (; got < *level && (img->width > 1 || img->height > 1); ++got) {
+        if (!img->mip) {
+            if (!build) break;
+            img->mip = picasso__build_mip(img);
+            if (!img->mip) {
+                ERROR("Out of memory building the mip level of a %dx%d image", img->width, img->height);
+                break;
+            }
+        }
+        img = img->mip;
+    }
+    *level = got;
+    return img;
+}
+
+void picasso_image_build_mips(picasso_image *img)
+{
+    if (!img || !img->pixels || img->channels < 1 || img->channels > 4) return;
+
+    picasso_image_drop_mips(img);
+    int level = INT_MAX;
+    picasso__image_mip(img, &level, true);
+    TRACE("Built %d mip levels of a %dx%d image", level, img->width, img->height);
+}
+
+void picasso_image_drop_mips(picasso_image *img)
+{
+    if (!img) return;
+    picasso_free_image(img->mip);
+    img->mip = NULL;
+}
+
+// The rect on a level, where an edge on the edge of the image stays on it
+static picasso_rect picasso__level_rect(const picasso_image *img, picasso_rect r, int level)
+{
+    int w = img->width >> level, h = img->height >> level;
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+
+    int x0 = r.x >> level, y0 = r.y >> level;
+    int x1 = r.x + r.width == img->width ? w : (r.x + r.width) >> level;
+    int y1 = r.y + r.height == img->height ? h : (r.y + r.height) >> level;
+    return (picasso_rect){ x0, y0, x1 - x0, y1 - y0 };
+}
+
+/* The deepest level the rect lines up with, where every edge of it is
+ * between two texels or on the edge of the image. Below that, texels along
+ * its edges would mix in some from outside */
+static int picasso__aligned_level(const picasso_image *img, picasso_rect r)
+{
+    int level = 0;
+    for (; (img->width >> level) > 1 || (img->height >> level) > 1; ++level) {
+        int m = (2 << level) - 1;
+        bool x = !(r.x & m) && (!((r.x + r.width) & m) || r.x + r.width == img->width);
+        bool y = !(r.y & m) && (!((r.y + r.height) & m) || r.y + r.height == img->height);
+        picasso_rect next = picasso__level_rect(img, r, level + 1);
+        if (!x || !y || next.width <= 0 || next.height <= 0) break;
+    }
+    return level;
+}
+
+// What a blit samples: one level, or two mixed by trilinear
+typedef struct {
+    picasso_image *img[2];
+    picasso_rect r[2];
+    uint32_t mix; // weight of the second level, out of 256, 0 for one level
+} picasso_blit_levels;
+
+static picasso_blit_levels picasso__blit_levels(picasso_image *src, picasso_rect src_r,
+                                                picasso_rect dst_px, picasso_filter filter,
+                                                bool build)
+{
+    picasso_blit_levels l = { { src, NULL }, { src_r, src_r }, 0 };
+    if (filter != PICASSO_FILTER_BILINEAR && filter != PICASSO_FILTER_TRILINEAR) return l;
+
+    float lambda = picasso__mip_lambda(src_r.width, src_r.height, dst_px.width, dst_px.height);
+    if (!(lambda > 0)) return l;
+
+    int level = (int)lambda, aligned = picasso__aligned_level(src, src_r);
+    float frac = filter == PICASSO_FILTER_TRILINEAR ? lambda - (float)level : 0;
+    if (level >= aligned) {
+        level = aligned;
+        frac = 0;
+    }
+    uint32_t mix = (uint32_t)lroundf(frac * 256);
+    if (mix == 256) {
+        ++level;
+        mix = 0;
+    }
+    if (level == 0 && mix == 0) return l;
+
+    int got = level;
+    l.img[0] = picasso__image_mip(src, &got, build);
+    l.r[0] = picasso__level_rect(src, src_r, got);
+    if (mix && got == level) {
+        int next = level + 1;
+        picasso_image *img = picasso__image_mip(src, &next, build);
+        if (next == level + 1) {
+            l.img[1] = img;
+            l.r[1] = picasso__level_rect(src, src_r, next);
+            l.mix = mix;
+        }
+    }
+    return l;
+}
+
+// --------------------------------------------------------
+// Blitting
+// --------------------------------------------------------
+
+static picasso_blit_op picasso__blit_op(const picasso_backbuffer *bf, const picasso_image *img,
+                                        picasso_filter filter)
+{
+    // Copying is what source-over does with opaque texels, other modes blend
+    if (bf->blend != PICASSO_BLEND_SRC_OVER) return PICASSO_BLIT_OVER;
+    if (img->channels == 1 || img->channels == 3) return PICASSO_BLIT_COPY;
+
+    switch (img->alpha) {
+    case PICASSO_ALPHA_OPAQUE:
+        return PICASSO_BLIT_COPY;
+    case PICASSO_ALPHA_MASK:
+        // Filtering mixes set and unset texels into alpha in between
+        return filter == PICASSO_FILTER_NEAREST ? PICASSO_BLIT_TEST : PICASSO_BLIT_OVER;
+    default:
+        return PICASSO_BLIT_OVER;
+    }
+}
+
+// Normalized and in pixels, the source clamped to the image. False if empty
+static bool picasso__blit_rects(const picasso_backbuffer *dst, const picasso_image *src,
+                                picasso_rect *src_r, picasso_rect dst_r, picasso_rect *dst_px)
+{
+    picasso__normalize_rect(src_r);
+    picasso__normalize_rect(&dst_r);
+
+    // Destination rectangle is given in logical coords, so convert it to actual
+    // framebuffer pixels before clipping and rasterizing.
+    *dst_px = (picasso_rect){
+        .x = picasso__to_px_x(dst, dst_r.x),
+        .y = picasso__to_px_y(dst, dst_r.y),
+        .width = picasso__to_px_w(dst, dst_r.width),
+        .height = picasso__to_px_h(dst, dst_r.height),
+    };
+    picasso__normalize_rect(dst_px);
+    if (dst_px->width <= 0 || dst_px->height <= 0) return false;
+
+    // Clamp src_r to source image bounds (safe blit)
+    if (src_r->x < 0) src_r->x = 0;
+    if (src_r->y < 0) src_r->y = 0;
+    if (src_r->x + src_r->width > src->width) src_r->width = src->width - src_r->x;
+    if (src_r->y + src_r->height > src->height) src_r->height = src->height - src_r->y;
+    return src_r->width > 0 && src_r->height > 0;
+}
+
+// Points the setup at the level it samples, and picks the kernels for it
+static void picasso__blit_source(const picasso_backbuffer *dst, picasso_blit_setup *s,
+                                 picasso_image *src, picasso_rect src_r, picasso_filter filter)
+{
+    s->src = src;
+    s->src_r = src_r;
+    s->step_x = ((int64_t)src_r.width << 16) / s->dst_px.width;
+    s->step_y = ((int64_t)src_r.height << 16) / s->dst_px.height;
+
+    s->op = picasso__blit_op(dst, src, filter);
+    // Copies don't blend, and alpha tested texels are opaque or skipped
+    s->premultiply = s->op == PICASSO_BLIT_OVER && !src->premultiplied;
+    s->fetch = picasso__fetch[src->channels];
+    s->gather = picasso__gather[src->channels];
+    s->write = s->op == PICASSO_BLIT_OVER ? picasso__kernels(dst)->blend : picasso__write[s->op];
+}
+
+void picasso__blit(picasso_backbuffer *dst, picasso_image *src, picasso_rect src_r,
+                   picasso_rect dst_r, picasso_filter filter, bool build_mips)
+{
+    // Early sanity checks to bail out early if anything is invalid
+    if (!dst || !src || !dst->pixels || !src->pixels) return;
+    if (src_r.width <= 0 || src_r.height <= 0) return;
+    if (src->channels < 1 || src->channels > 4) return;
+
+    // Replays run on the render threads, which only read the mip levels, so
+    // a recorded blit builds the ones it is going to sample now
+    if (build_mips && dst->cmdlist && dst->cmdlist->recording) {
+        picasso_rect r = src_r, px;
+        if (picasso__blit_rects(dst, src, &r, dst_r, &px))
+            picasso__blit_levels(src, r, px, filter, true);
+    }
+
+    PICASSO_RECORD(dst, .type = PICASSO_CMD_BLIT,
+                   .blit = { src, src_r, dst_r, filter });
+
+    picasso_blit_setup s = { 0 };
+    if (!picasso__blit_rects(dst, src, &src_r, dst_r, &s.dst_px)) return;
+    if (!picasso__clip_rect_to_bounds(dst, &s.dst_px, &s.b)) return;
+
+    picasso_blit_levels l = picasso__blit_levels(src, src_r, s.dst_px, filter, build_mips);
+    picasso__blit_source(dst, &s, l.img[0], l.r[0], filter);
+
+    if (l.mix) {
+        picasso_blit_setup s1 = s;
+        picasso__blit_source(dst, &s1, l.img[1], l.r[1], filter);
+        // Where one level is opaque and the other not, the mix blends
+        if (s1.op != s.op) {
+            s.op = PICASSO_BLIT_OVER;
+            s.write = picasso__kernels(dst)->blend;
+        }
+        picasso__blit_trilinear(dst, &s, &s1, l.mix);
+        return;
+    }
+
+    switch (filter) {
+    case PICASSO_FILTER_BILINEAR:
+    case PICASSO_FILTER_TRILINEAR: picasso__blit_bilinear(dst, &s); break;
+    case PICASSO_FILTER_BOX:       picasso__blit_box(dst, &s);      break;
+    case PICASSO_FILTER_NEAREST:
+    default:                       picasso__blit_nearest(dst, &s);  break;
+    }
+}
+
+void picasso_blit_ex(picasso_backbuffer *dst, picasso_image *src, picasso_rect src_r,
+                     picasso_rect dst_r, picasso_filter filter)
+{
+    picasso__blit(dst, src, src_r, dst_r, filter, true);
+}
+
+void picasso_blit(picasso_backbuffer *dst, picasso_image *src, picasso_rect src_r,
+                  picasso_rect dst_r)
+{
+    picasso_blit_ex(dst, src, src_r, dst_r, PICASSO_FILTER_NEAREST);
+}
+
+// --------------------------------------------------------
+// Affine blits
+// --------------------------------------------------------
+
+/* A transformed image covers a parallelogram, which is the rect
+ * 0 <= u <= w, 0 <= v <= h of the image. Every pixel is mapped back into the
+ * image, and since the inverse of the transform is linear, along a row the
+ * source position moves by the same du, dv from one pixel to the next: the
+ * first pixel of a span is worked out in double and the rest stepped from it
+ * in 16.16.
+ *
+ * A pixel center is u / |grad u| pixels away from the edge u = 0, and likewise
+ * for the other three edges. The span of a row is where all four distances are
+ * over -0.5, and a pixel is covered by the product of the distances plus 0.5,
+ * clamped, to the nearer edge of each pair. Fully covered pixels are written
+ * like the rows of a blit, the ones along the edges composited by coverage.
+ * Spans and positions only depend on the row, never on the clip, so tiled
+ * replays come out the same. */
+typedef struct {
+    picasso_image *src;         // the level sampled
+    int level;
+    double u_org, v_org;        // source position at pixel (0, 0)
+    double dudx, dudy, dvdx, dvdy;
+    double dxdu, dxdv;          // 1 / dudx and 1 / dvdx, 0 where those are
+    double u_lo, u_hi, v_lo, v_hi; // where the span of a row ends
+    float w, h;                 // of the image, level 0
+    float inv_gu, inv_gv;       // pixels per texel across the edges
+    int64_t du, dv;             // per pixel along a row, 16.16
+    picasso_draw_bounds b;      // every pixel it may touch, not clipped
+
+    bool bilinear;
+    picasso_blit_op op;
+    bool premultiply;
+    picasso_gather_fn gather;
+    picasso_write_fn write;
+} picasso_affine_setup;
+
+picasso_affine picasso_affine_identity(void)
+{
+    return (picasso_affine){ 1, 0, 0, 1, 0, 0 };
+}
+
+picasso_affine picasso_affine_mul(picasso_affine m, picasso_affine n)
+{
+    return (picasso_affine){
+        .a = m.a * n.a + m.c * n.b,
+        .b = m.b * n.a + m.d * n.b,
+        .c = m.a * n.c + m.c * n.d,
+        .d = m.b * n.c + m.d * n.d,
+        .tx = m.a * n.tx + m.c * n.ty + m.tx,
+        .ty = m.b * n.tx + m.d * n.ty + m.ty,
+    };
+}
+
+picasso_affine picasso_affine_translate(float x, float y)
+{
+    return (picasso_affine){ 1, 0, 0, 1, x, y };
+}
+
+picasso_affine picasso_affine_scale(float x, float y)
+{
+    return (picasso_affine){ x, 0, 0, y, 0, 0 };
+}
+
+picasso_affine picasso_affine_rotate(float radians)
+{
+    float c = cosf(radians), s = sinf(radians);
+    return (picasso_affine){ c, s, -s, c, 0, 0 };
+}
+
+/* The inverse of the transform in pixels, and the bounds of the parallelogram
+ * grown by the half pixel its span reaches out. False if it is degenerate or
+ * out of range */
+static bool picasso__affine_map(const picasso_backbuffer *bf, const picasso_image *src,
+                                const picasso_affine *m, picasso_affine_setup *s)
+{
+    double A = (double)m->a * bf->scale_x, C = (double)m->c * bf->scale_x;
+    double B = (double)m->b * bf->scale_y, D = (double)m->d * bf->scale_y;
+    double TX = (double)m->tx * bf->scale_x, TY = (double)m->ty * bf->scale_y;
+    double det = A * D - B * C;
+    if (!isfinite(det) || !isfinite(TX) || !isfinite(TY) || fabs(det) < 1e-12) return false;
+
+    s->dudx = D / det;
+    s->dudy = -C / det;
+    s->dvdx = -B / det;
+    s->dvdy = A / det;
+    s->dxdu = s->dudx != 0 ? 1 / s->dudx : 0;
+    s->dxdv = s->dvdx != 0 ? 1 / s->dvdx : 0;
+    s->u_org = (C * TY - D * TX) / det;
+    s->v_org = (B * TX - A * TY) / det;
+
+    double gu = hypot(s->dudx, s->dudy), gv = hypot(s->dvdx, s->dvdy);
+    if (!(gu < PICASSO_SUBPIXEL_LIMIT && gv < PICASSO_SUBPIXEL_LIMIT)) return false;
+    s->w = (float)src->width;
+    s->h = (float)src->height;
+    s->inv_gu = (float)(1 / gu);
+    s->inv_gv = (float)(1 / gv);
+    s->u_lo = -0.5 * gu;
+    s->u_hi = src->width + 0.5 * gu;
+    s->v_lo = -0.5 * gv;
+    s->v_hi = src->height + 0.5 * gv;
+    s->du = llround(s->dudx * 65536);
+    s->dv = llround(s->dvdx * 65536);
+
+    double x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+    for (int i = 0; i < 4; ++i) {
+        double u = i & 1 ? s->u_hi : s->u_lo, v = i & 2 ? s->v_hi : s->v_lo;
+        double x = A * u + C * v + TX, y = B * u + D * v + TY;
+        x0 = fmin(x0, x);
+        y0 = fmin(y0, y);
+        x1 = fmax(x1, x);
+        y1 = fmax(y1, y);
+    }
+    if (!(x0 >= -PICASSO_SUBPIXEL_LIMIT && y0 >= -PICASSO_SUBPIXEL_LIMIT &&
+          x1 <= PICASSO_SUBPIXEL_LIMIT && y1 <= PICASSO_SUBPIXEL_LIMIT))
+        return false;
+    s->b = (picasso_draw_bounds){ (int)floor(x0), (int)floor(y0), (int)ceil(x1), (int)ceil(y1) };
+    return true;
+}
+
+picasso_draw_bounds picasso__affine_bounds(const picasso_backbuffer *bf, const picasso_image *src,
+                                           const picasso_affine *m)
+{
+    picasso_affine_setup s;
+    if (!picasso__affine_map(bf, src, m, &s)) return (picasso_draw_bounds){0};
+    return s.b;
+}
+
+// The mip level bilinear samples, by how many texels a pixel steps over
+static int picasso__affine_level(const picasso_affine_setup *s)
+{
+    double rho = fmax(hypot(s->dudx, s->dvdx), hypot(s->dudy, s->dvdy));
+    return rho >= 2 ? (int)log2(rho) : 0;
+}
+
+/* Narrows the pixel centers (*a, *b) of a row to where p + dp * x is
+ * between lo and hi, inv_dp is 1 / dp. Rows are cut with no division */
+static void picasso__affine_span(double p, double dp, double inv_dp, double lo, double hi,
+                                 double *a, double *b)
+{
+    if (dp == 0) {
+        if (!(p >= lo && p <= hi)) *b = -INFINITY;
+        return;
+    }
+    double t0 = (lo - p) * inv_dp, t1 = (hi - p) * inv_dp;
+    if (t0 > t1) {
+        double t = t0;
+        t0 = t1;
+        t1 = t;
+    }
+    *a = fmax(*a, t0);
+    *b = fmin(*b, t1);
+}
+
+// Both 8 bit lanes pairs of a and b mixed by f out of 256, rounded like
+// span_bilinear does channel by channel
+static inline uint32_t picasso__lerp_px(uint32_t a, uint32_t b, uint32_t f)
+{
+    uint32_t g = 256 - f;
+    uint32_t rb = (((a & 0x00FF00FFu) * g + (b & 0x00FF00FFu) * f + 0x00800080u) >> 8) & 0x00FF00FFu;
+    uint32_t ag = ((((a >> 8) & 0x00FF00FFu) * g + ((b >> 8) & 0x00FF00FFu) * f + 0x00800080u) >> 8) &
+                  0x00FF00FFu;
+    return rb | (ag << 8);
+}
+
+// n pixels of a row sampled from source position u, v on, 16.16 at level 0
+static void picasso__affine_sample(const picasso_affine_setup *s, int64_t u, int64_t v, int n,
+                                   uint32_t *out)
+{
+    const picasso_image *img = s->src;
+    int last_x = img->width - 1, last_y = img->height - 1;
+    int32_t off[4][PICASSO_SPAN_CHUNK];
+
+    if (!s->bilinear) {
+        for (int i = 0; i < n; ++i, u += s->du, v += s->dv) {
+            int64_t tx = u < 0 ? 0 : u >> 16, ty = v < 0 ? 0 : v >> 16;
+            if (tx > last_x) tx = last_x;
+            if (ty > last_y) ty = last_y;
+            off[0][i] = (int32_t)(picasso__row_offset(img, (int)ty) + picasso__col_offset(img, (int)tx));
+        }
+        s->gather(img->pixels, off[0], n, out);
+        if (s->premultiply) picasso__span_premultiply(out, n);
+        return;
+    }
+
+    // The four texels around the position on the level, clamped at the edges
+    uint8_t fx[PICASSO_SPAN_CHUNK], fy[PICASSO_SPAN_CHUNK];
+    uint32_t q[4][PICASSO_SPAN_CHUNK];
+    for (int i = 0; i < n; ++i, u += s->du, v += s->dv) {
+        int64_t pu = (u >> s->level) - 0x8000, pv = (v >> s->level) - 0x8000;
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        fx[i] = fy[i] = 0;
+        if (pu >= 0) {
+            x0 = pu >> 16 < last_x ? (int)(pu >> 16) : last_x;
+            x1 = x0 < last_x ? x0 + 1 : x0;
+            fx[i] = (uint8_t)((pu & 0xFFFF) >> 8);
+        }
+        if (pv >= 0) {
+            y0 = pv >> 16 < last_y ? (int)(pv >> 16) : last_y;
+            y1 = y0 < last_y ? y0 + 1 : y0;
+            fy[i] = (uint8_t)((pv & 0xFFFF) >> 8);
+        }
+        size_t r0 = picasso__row_offset(img, y0), r1 = picasso__row_offset(img, y1);
+        size_t c0 = picasso__col_offset(img, x0), c1 = picasso__col_offset(img, x1);
+        off[0][i] = (int32_t)(r0 + c0);
+        off[1][i] = (int32_t)(r0 + c1);
+        off[2][i] = (int32_t)(r1 + c0);
+        off[3][i] = (int32_t)(r1 + c1);
+    }
+    for (int k = 0; k < 4; ++k) {
+        s->gather(img->pixels, off[k], n, q[k]);
+        if (s->premultiply) picasso__span_premultiply(q[k], n);
+    }
+    for (int i = 0; i < n; ++i) {
+        uint32_t l = picasso__lerp_px(q[0][i], q[2][i], fy[i]);
+        uint32_t r = picasso__lerp_px(q[1][i], q[3][i], fy[i]);
+        out[i] = picasso__lerp_px(l, r, fx[i]);
+    }
+}
+
+// How much of every pixel the parallelogram covers, out of 255
+static void picasso__affine_coverage(const picasso_affine_setup *s, int64_t u, int64_t v, int n,
+                                     uint8_t *cov)
+{
+    for (int i = 0; i < n; ++i, u += s->du, v += s->dv) {
+        float fu = (float)u * (1.0f / 65536), fv = (float)v * (1.0f / 65536);
+        float eu = fminf(fu, s->w - fu) * s->inv_gu + 0.5f;
+        float ev = fminf(fv, s->h - fv) * s->inv_gv + 0.5f;
+        eu = eu < 0 ? 0 : (eu > 1 ? 1 : eu);
+        ev = ev < 0 ? 0 : (ev > 1 ? 1 : ev);
+        cov[i] = (uint8_t)(eu * ev * 255 + 0.5f);
+    }
+}
+
+/* Pixels [x, end) of row y from source position u, v on. The ones in
+ * [in0, in1) are inside all four edges by half a pixel or more */
+static void picasso__affine_row(picasso_backbuffer *bf, const picasso_affine_setup *s, int y,
+                                int x, int end, int in0, int in1, int64_t u, int64_t v)
+{
+    uint32_t px[PICASSO_SPAN_CHUNK];
+    uint8_t cov[PICASSO_SPAN_CHUNK];
+
+    for (int n; x < end; x += n, u += n * s->du, v += n * s->dv) {
+        n = end - x < PICASSO_SPAN_CHUNK ? end - x : PICASSO_SPAN_CHUNK;
+        picasso__affine_sample(s, u, v, n, px);
+
+        // Left edge, inside, right edge
+        int cut[4] = { 0, PICASSO_CLAMP(in0 - x, 0, n), PICASSO_CLAMP(in1 - x, 0, n), n };
+        if (cut[2] < cut[1]) cut[2] = cut[1];
+        for (int k = 0; k < 3; ++k) {
+            int i = cut[k], len = cut[k + 1] - i;
+            if (len <= 0) continue;
+            uint32_t *dst = picasso__get_pixel_u32(bf, x + i, y);
+            if (k == 1) {
+                s->write(dst, px + i, len);
+            } else {
+                picasso__affine_coverage(s, u + i * s->du, v + i * s->dv, len, cov);
+                picasso__span_composite(dst, px + i, cov, len, bf->blend);
+            }
+        }
+    }
+}
+
+void picasso__blit_affine(picasso_backbuffer *bf, picasso_image *src, const picasso_affine *m,
+                          picasso_filter filter, bool build_mips)
+{
+    if (!bf || !src || !m || !bf->pixels || !src->pixels) return;
+    if (src->channels < 1 || src->channels > 4 || src->width <= 0 || src->height <= 0) return;
+
+    picasso_affine_setup s;
+    if (!picasso__affine_map(bf, src, m, &s)) return;
+
+    // Box and trilinear are bilinear here
+    s.bilinear = filter != PICASSO_FILTER_NEAREST;
+    s.level = s.bilinear ? picasso__affine_level(&s) : 0;
+
+    // Replays only read mip levels, recording builds them like blits do
+    if (s.level && build_mips && bf->cmdlist && bf->cmdlist->recording) {
+        int level = s.level;
+        picasso__image_mip(src, &level, true);
+    }
+
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_AFFINE,
+                   .affine = { src, *m, filter });
+
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    int y0 = PICASSO_MAX(s.b.y0, cb.y0), y1 = PICASSO_MIN(s.b.y1, cb.y1);
+    if (y0 >= y1) return;
+
+    s.src = picasso__image_mip(src, &s.level, build_mips);
+    s.op = picasso__blit_op(bf, s.src, s.bilinear ? PICASSO_FILTER_BILINEAR : PICASSO_FILTER_NEAREST);
+    // The edges are composited, so anything with alpha is premultiplied
+    s.premultiply = s.op != PICASSO_BLIT_COPY && !s.src->premultiplied;
+    s.gather = picasso__gather[s.src->channels];
+    s.write = s.op == PICASSO_BLIT_OVER ? picasso__kernels(bf)->blend : picasso__write[s.op];
+
+    for (int y = y0; y < y1; ++y) {
+        double yc = y + 0.5;
+        double ur = s.u_org + s.dudy * yc, vr = s.v_org + s.dvdy * yc;
+        double a = -PICASSO_SUBPIXEL_LIMIT, b = PICASSO_SUBPIXEL_LIMIT;
+        picasso__affine_span(ur, s.dudx, s.dxdu, s.u_lo, s.u_hi, &a, &b);
+        picasso__affine_span(vr, s.dvdx, s.dxdv, s.v_lo, s.v_hi, &a, &b);
+        if (!(a < b)) continue;
+
+        // Pixels with a < x + 0.5 < b, stepped from the first of them
+        int xs = (int)floor(a - 0.5) + 1, xe = (int)ceil(b - 0.5);
+        int x0 = PICASSO_MAX(xs, cb.x0), x1 = PICASSO_MIN(xe, cb.x1);
+        if (x0 >= x1) continue;
+        int64_t u = llround((ur + s.dudx * (xs + 0.5)) * 65536) + (int64_t)(x0 - xs) * s.du;
+        int64_t v = llround((vr + s.dvdx * (xs + 0.5)) * 65536) + (int64_t)(x0 - xs) * s.dv;
+
+        // Pixels covered fully, with a <= x + 0.5 <= b
+        int in0 = 0, in1 = 0;
+        a = -PICASSO_SUBPIXEL_LIMIT, b = PICASSO_SUBPIXEL_LIMIT;
+        picasso__affine_span(ur, s.dudx, s.dxdu, -s.u_lo, s.w + s.u_lo, &a, &b);
+        picasso__affine_span(vr, s.dvdx, s.dxdv, -s.v_lo, s.h + s.v_lo, &a, &b);
+        if (a <= b) {
+            in0 = (int)ceil(a - 0.5);
+            in1 = (int)floor(b - 0.5) + 1;
+        }
+        picasso__affine_row(bf, &s, y, x0, x1, in0, in1, u, v);
+    }
+}
+
+void picasso_blit_affine(picasso_backbuffer *bf, picasso_image *src, const picasso_affine *m,
+                         picasso_filter filter)
+{
+    picasso__blit_affine(bf, src, m, filter, true);
+}
@@ -0,0 +1,951 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "picasso_internal.h"
+
+/* Color conversion. Images go through in chunks of PICASSO_SPAN_CHUNK pixels
+ * of a row: packed pixels are split into a plane per channel on the stack,
+ * converted plane to plane, and merged back where the result is packed. The
+ * kernels only ever see planes, 16 or 32 pixels at a time.
+ *
+ * YCbCr both ways and luma are fixed point weighted sums of three planes (see
+ * picasso_color_weights), 16 bit weights and 32 bit sums, which is one
+ * madd_epi16 per pair of planes on x86 and a multiply-accumulate on NEON. HSV
+ * divides, in single precision floats rounded to nearest, and the scalar
+ * kernels do the exact same divisions, so every kernel set gives the same
+ * bytes. Kernel sets are picked like the span kernels: AVX2, SSE2 or NEON,
+ * scalar otherwise. */
+
+#if !defined(PICASSO_NO_SIMD)
+#  if defined(__AVX2__)
+#    define PICASSO_COLOR_AVX2 1
+#    include <immintrin.h>
+#  elif defined(__SSE2__)
+#    define PICASSO_COLOR_SSE2 1
+#    include <emmintrin.h>
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define PICASSO_COLOR_NEON 1
+#    include <arm_neon.h>
+#  endif
+#endif
+
+// --------------------------------------------------------
+// Weights
+// --------------------------------------------------------
+#define PICASSO_Q(x)    ((int)((x) * (1 << PICASSO_COLOR_SHIFT) + ((x) < 0 ? -0.5 : 0.5)))
+#define PICASSO_HALF    (1 << (PICASSO_COLOR_SHIFT - 1))
+
+/* Y, Cb, Cr from R, G, B for the luma weights kr and kb, with Y scaled by sy
+ * and offset by yo, and Cb and Cr scaled by sc around 128. G takes what the
+ * rounding left, so Y's weights add up to exactly sy (white stays white) and
+ * Cb's and Cr's to 0 (grays have no chroma) */
+#define PICASSO_TO_YCBCR(kr, kb, sy, sc, yo)                                            \
+    { { { PICASSO_Q((kr) * (sy)),                                                      \
+          PICASSO_Q(sy) - PICASSO_Q((kr) * (sy)) - PICASSO_Q((kb) * (sy)),             \
+          PICASSO_Q((kb) * (sy)) }, ((yo) << PICASSO_COLOR_SHIFT) + PICASSO_HALF },   \
+      { { PICASSO_Q(-(kr) / (2 * (1 - (kb))) * (sc)),                                 \
+          -PICASSO_Q(-(kr) / (2 * (1 - (kb))) * (sc)) - PICASSO_Q(0.5 * (sc)),         \
+          PICASSO_Q(0.5 * (sc)) }, (128 << PICASSO_COLOR_SHIFT) + PICASSO_HALF },      \
+      { { PICASSO_Q(0.5 * (sc)),                                                       \
+          -PICASSO_Q(0.5 * (sc)) - PICASSO_Q(-(kb) / (2 * (1 - (kr))) * (sc)),         \
+          PICASSO_Q(-(kb) / (2 * (1 - (kr))) * (sc)) },                               \
+        (128 << PICASSO_COLOR_SHIFT) + PICASSO_HALF } }
+
+// And back, the offsets of Y, Cb and Cr folded into the bias
+#define PICASSO_TO_RGB(kr, kb, sy, sc, yo)                                              \
+    { { { PICASSO_Q(1 / (sy)), 0, PICASSO_Q(2 * (1 - (kr)) / (sc)) },                  \
+        -PICASSO_Q(1 / (sy)) * (yo) - PICASSO_Q(2 * (1 - (kr)) / (sc)) * 128 + PICASSO_HALF }, \
+      { { PICASSO_Q(1 / (sy)),                                                         \
+          -PICASSO_Q(2 * (1 - (kb)) * (kb) / (1 - (kr) - (kb)) / (sc)),                \
+          -PICASSO_Q(2 * (1 - (kr)) * (kr) / (1 - (kr) - (kb)) / (sc)) },              \
+        -PICASSO_Q(1 / (sy)) * (yo) +                                                  \
+        (PICASSO_Q(2 * (1 - (kb)) * (kb) / (1 - (kr) - (kb)) / (sc)) +                 \
+         PICASSO_Q(2 * (1 - (kr)) * (kr) / (1 - (kr) - (kb)) / (sc))) * 128 + PICASSO_HALF }, \
+      { { PICASSO_Q(1 / (sy)), PICASSO_Q(2 * (1 - (kb)) / (sc)), 0 },                  \
+        -PICASSO_Q(1 / (sy)) * (yo) - PICASSO_Q(2 * (1 - (kb)) / (sc)) * 128 + PICASSO_HALF } }
+
+// Limited range: Y in 16-235, Cb and Cr in 16-240
+#define PICASSO_LIMITED_Y (219.0 / 255.0)
+#define PICASSO_LIMITED_C (224.0 / 255.0)
+
+const picasso_color_weights picasso__ycbcr_weights[4][3] = {
+    [PICASSO_YCBCR_BT601]         = PICASSO_TO_YCBCR(0.299, 0.114, 1.0, 1.0, 0),
+    [PICASSO_YCBCR_BT601_LIMITED] = PICASSO_TO_YCBCR(0.299, 0.114, PICASSO_LIMITED_Y,
+                                                     PICASSO_LIMITED_C, 16),
+    [PICASSO_YCBCR_BT709]         = PICASSO_TO_YCBCR(0.2126, 0.0722, 1.0, 1.0, 0),
+    [PICASSO_YCBCR_BT709_LIMITED] = PICASSO_TO_YCBCR(0.2126, 0.0722, PICASSO_LIMITED_Y,
+                                                     PICASSO_LIMITED_C, 16),
+};
+
+const picasso_color_weights picasso__rgb_weights[4][3] = {
+    [PICASSO_YCBCR_BT601]         = PICASSO_TO_RGB(0.299, 0.114, 1.0, 1.0, 0),
+    [PICASSO_YCBCR_BT601_LIMITED] = PICASSO_TO_RGB(0.299, 0.114, PICASSO_LIMITED_Y,
+                                                   PICASSO_LIMITED_C, 16),
+    [PICASSO_YCBCR_BT709]         = PICASSO_TO_RGB(0.2126, 0.0722, 1.0, 1.0, 0),
+    [PICASSO_YCBCR_BT709_LIMITED] = PICASSO_TO_RGB(0.2126, 0.0722, PICASSO_LIMITED_Y,
+                                                   PICASSO_LIMITED_C, 16),
+};
+
+// --------------------------------------------------------
+// Scalar reference kernels
+// --------------------------------------------------------
+void picasso__color_dot3_scalar(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *c,
+                                int n, const picasso_color_weights *w)
+{
+    for (int i = 0; i < n; ++i) {
+        int32_t v = (w->k[0] * a[i] + w->k[1] * b[i] + w->k[2] * c[i] + w->bias) >>
+                    PICASSO_COLOR_SHIFT;
+        out[i] = (uint8_t)PICASSO_CLAMP(v, 0, 255);
+    }
+}
+
+/* The hue is the side of the hexagon the color is on, counted from the
+ * largest channel: 256 * (sixths around) / (6 * (max - min)) */
+void picasso__color_rgb_to_hsv_scalar(uint8_t *h, uint8_t *s, uint8_t *v, const uint8_t *r,
+                                      const uint8_t *g, const uint8_t *b, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        int hi = PICASSO_MAX(r[i], PICASSO_MAX(g[i], b[i]));
+        int lo = PICASSO_MIN(r[i], PICASSO_MIN(g[i], b[i]));
+        int d = hi - lo;
+
+        int around = hi == r[i] ? g[i] - b[i] :
+                     hi == g[i] ? b[i] - r[i] + 2 * d : r[i] - g[i] + 4 * d;
+        h[i] = d ? (uint8_t)(lrintf((float)(around * 256) / (float)(6 * d)) & 255) : 0;
+        s[i] = hi ? (uint8_t)lrintf((float)(255 * d) / (float)hi) : 0;
+        v[i] = (uint8_t)hi;
+    }
+}
+
+void picasso__color_hsv_to_rgb_scalar(uint8_t *r, uint8_t *g, uint8_t *b, const uint8_t *h,
+                                      const uint8_t *s, const uint8_t *v, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        uint32_t h6 = h[i] * 6u, side = h6 >> 8, f = h6 & 255;
+        uint32_t p = picasso__mul255(v[i], 255 - s[i]);
+        uint32_t q = picasso__mul255(v[i], 255 - picasso__mul255(s[i], f));
+        uint32_t t = picasso__mul255(v[i], 255 - picasso__mul255(s[i], 255 - f));
+        uint32_t x = v[i];
+
+        switch (side) {
+            case 0:  r[i] = x; g[i] = t; b[i] = p; break;
+            case 1:  r[i] = q; g[i] = x; b[i] = p; break;
+            case 2:  r[i] = p; g[i] = x; b[i] = t; break;
+            case 3:  r[i] = p; g[i] = q; b[i] = x; break;
+            case 4:  r[i] = t; g[i] = p; b[i] = x; break;
+            default: r[i] = x; g[i] = p; b[i] = q; break;
+        }
+    }
+}
+
+void picasso__color_split_scalar(uint8_t *const *planes, const uint8_t *packed, int channels, int n)
+{
+    for (int i = 0; i < n; ++i)
+        for (int c = 0; c < channels; ++c) planes[c][i] = packed[i * channels + c];
+}
+
+void picasso__color_merge_scalar(uint8_t *packed, int channels, const uint8_t *const *planes, int n)
+{
+    for (int i = 0; i < n; ++i)
+        for (int c = 0; c < channels; ++c) packed[i * channels + c] = planes[c][i];
+}
+
+// Tails of the SIMD kernels, past the last whole step
+static inline void picasso__color_split_tail(uint8_t *const *planes, const uint8_t *packed,
+                                             int channels, int i, int n)
+{
+    uint8_t *rest[4];
+    for (int c = 0; c < channels; ++c) rest[c] = planes[c] + i;
+    picasso__color_split_scalar(rest, packed + i * channels, channels, n - i);
+}
+
+static inline void picasso__color_merge_tail(uint8_t *packed, int channels,
+                                             const uint8_t *const *planes, int i, int n)
+{
+    const uint8_t *rest[4];
+    for (int c = 0; c < channels; ++c) rest[c] = planes[c] + i;
+    picasso__color_merge_scalar(packed + i * channels, channels, rest, n - i);
+}
+
+// --------------------------------------------------------
+// SSE2 / AVX2 kernels
+// --------------------------------------------------------
+#if defined(PICASSO_COLOR_SSE2) || defined(PICASSO_COLOR_AVX2)
+
+/* Eight 16 bit lanes of each plane: pairs of a and b go through one madd,
+ * c with a 0 next to it through another */
+static inline __m128i picasso__dot3_sse2(__m128i a, __m128i b, __m128i c, __m128i kab, __m128i kc,
+                                         __m128i bias)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), kab),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(c, zero), kc));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), kab),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(c, zero), kc));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, bias), PICASSO_COLOR_SHIFT);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, bias), PICASSO_COLOR_SHIFT);
+    return _mm_packs_epi32(lo, hi);
+}
+
+#if defined(PICASSO_COLOR_AVX2)
+/* The same on sixteen lanes. Unpacking and packing both go by 128 bit lane,
+ * so the pixels come out in order */
+static inline __m256i picasso__dot3_avx2(__m256i a, __m256i b, __m256i c, __m256i kab, __m256i kc,
+                                         __m256i bias)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), kab),
+                                  _mm256_madd_epi16(_mm256_unpacklo_epi16(c, zero), kc));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), kab),
+                                  _mm256_madd_epi16(_mm256_unpackhi_epi16(c, zero), kc));
+    lo = _mm256_srai_epi32(_mm256_add_epi32(lo, bias), PICASSO_COLOR_SHIFT);
+    hi = _mm256_srai_epi32(_mm256_add_epi32(hi, bias), PICASSO_COLOR_SHIFT);
+    return _mm256_packs_epi32(lo, hi);
+}
+#endif
+
+void picasso__color_dot3(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *c,
+                         int n, const picasso_color_weights *w)
+{
+    int32_t ab = (int32_t)((uint32_t)(uint16_t)w->k[1] << 16 | (uint16_t)w->k[0]);
+    int32_t cc = (uint16_t)w->k[2];
+
+    int i = 0;
+#if defined(PICASSO_COLOR_AVX2)
+    const __m256i kab8 = _mm256_set1_epi32(ab), kc8 = _mm256_set1_epi32(cc);
+    const __m256i bias8 = _mm256_set1_epi32(w->bias);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v[2];
+        for (int h = 0; h < 2; ++h) {
+            __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + i + 16 * h)));
+            __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(b + i + 16 * h)));
+            __m256i vc = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(c + i + 16 * h)));
+            v[h] = picasso__dot3_avx2(va, vb, vc, kab8, kc8, bias8);
+        }
+        // packus interleaves the halves by 128 bit lane, the permute puts them back
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(v[0], v[1]),
+                                                 _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(out + i), bytes);
+    }
+#endif
+    const __m128i kab = _mm_set1_epi32(ab), kc = _mm_set1_epi32(cc), bias = _mm_set1_epi32(w->bias);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i vc = _mm_loadu_si128((const __m128i *)(c + i));
+        __m128i lo = picasso__dot3_sse2(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero),
+                                        _mm_unpacklo_epi8(vc, zero), kab, kc, bias);
+        __m128i hi = picasso__dot3_sse2(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero),
+                                        _mm_unpackhi_epi8(vc, zero), kab, kc, bias);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+    }
+    if (i < n) picasso__color_dot3_scalar(out + i, a + i, b + i, c + i, n - i, w);
+}
+
+/* Eight pixels at a time, max, min and the numerators in 16 bit lanes, the
+ * divisions in two sets of four floats. Where max - min or max is 0 the
+ * division was 0 / 0, and the lanes are masked to 0 like the scalar kernel */
+void picasso__color_rgb_to_hsv(uint8_t *h, uint8_t *s, uint8_t *v, const uint8_t *r,
+                               const uint8_t *g, const uint8_t *b, int n)
+{
+    const __m128i zero = _mm_setzero_si128(), six = _mm_set1_epi16(6), x255 = _mm_set1_epi16(255);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i vr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r + i)), zero);
+        __m128i vg = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(g + i)), zero);
+        __m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(b + i)), zero);
+        __m128i hi = _mm_max_epi16(vr, _mm_max_epi16(vg, vb));
+        __m128i d = _mm_sub_epi16(hi, _mm_min_epi16(vr, _mm_min_epi16(vg, vb)));
+        __m128i d2 = _mm_add_epi16(d, d);
+
+        __m128i at_r = _mm_cmpeq_epi16(hi, vr);
+        __m128i at_g = _mm_andnot_si128(at_r, _mm_cmpeq_epi16(hi, vg));
+        __m128i at_b = _mm_andnot_si128(_mm_or_si128(at_r, at_g), _mm_set1_epi16(-1));
+        __m128i around = _mm_or_si128(
+            _mm_and_si128(at_r, _mm_sub_epi16(vg, vb)),
+            _mm_or_si128(_mm_and_si128(at_g, _mm_add_epi16(_mm_sub_epi16(vb, vr), d2)),
+                         _mm_and_si128(at_b, _mm_add_epi16(_mm_sub_epi16(vr, vg),
+                                                           _mm_add_epi16(d2, d2)))));
+        __m128i sixths = _mm_mullo_epi16(d, six);
+        __m128i sat = _mm_mullo_epi16(d, x255); // up to 65025, unsigned
+
+        __m128i hue32[2], sat32[2];
+        for (int half = 0; half < 2; ++half) {
+            __m128i a = half ? _mm_unpackhi_epi16(around, around)
+                             : _mm_unpacklo_epi16(around, around);
+            __m128i den = half ? _mm_unpackhi_epi16(sixths, zero)
+                               : _mm_unpacklo_epi16(sixths, zero);
+            __m128i num = half ? _mm_unpackhi_epi16(sat, zero) : _mm_unpacklo_epi16(sat, zero);
+            __m128i top = half ? _mm_unpackhi_epi16(hi, zero) : _mm_unpacklo_epi16(hi, zero);
+            // The numerator is signed, its high half is a copy: shifting it
+            // down sign extends, shifting by 8 less also scales it by 256
+            a = _mm_slli_epi32(_mm_srai_epi32(a, 16), 8);
+            hue32[half] = _mm_cvtps_epi32(_mm_div_ps(_mm_cvtepi32_ps(a), _mm_cvtepi32_ps(den)));
+            sat32[half] = _mm_cvtps_epi32(_mm_div_ps(_mm_cvtepi32_ps(num), _mm_cvtepi32_ps(top)));
+        }
+        __m128i hue = _mm_and_si128(_mm_packs_epi32(hue32[0], hue32[1]), x255);
+        __m128i sats = _mm_packs_epi32(sat32[0], sat32[1]);
+        hue = _mm_andnot_si128(_mm_cmpeq_epi16(d, zero), hue);
+        sats = _mm_andnot_si128(_mm_cmpeq_epi16(hi, zero), sats);
+
+        _mm_storel_epi64((__m128i *)(h + i), _mm_packus_epi16(hue, zero));
+        _mm_storel_epi64((__m128i *)(s + i), _mm_packus_epi16(sats, zero));
+        _mm_storel_epi64((__m128i *)(v + i), _mm_packus_epi16(hi, zero));
+    }
+    if (i < n) picasso__color_rgb_to_hsv_scalar(h + i, s + i, v + i, r + i, g + i, b + i, n - i);
+}
+
+// picasso__mul255 on eight unsigned 16 bit lanes, x * y + 128 fits them
+static inline __m128i picasso__mul255_sse2(__m128i x, __m128i y)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+void picasso__color_hsv_to_rgb(uint8_t *r, uint8_t *g, uint8_t *b, const uint8_t *h,
+                               const uint8_t *s, const uint8_t *v, int n)
+{
+    const __m128i zero = _mm_setzero_si128(), x255 = _mm_set1_epi16(255);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i vh = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(h + i)), zero);
+        __m128i vs = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(s + i)), zero);
+        __m128i x  = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v + i)), zero);
+        __m128i h6 = _mm_mullo_epi16(vh, _mm_set1_epi16(6));
+        __m128i side = _mm_srli_epi16(h6, 8), f = _mm_and_si128(h6, x255);
+
+        __m128i p = picasso__mul255_sse2(x, _mm_sub_epi16(x255, vs));
+        __m128i q = picasso__mul255_sse2(x, _mm_sub_epi16(x255, picasso__mul255_sse2(vs, f)));
+        __m128i t = picasso__mul255_sse2(x, _mm_sub_epi16(x255,
+                                         picasso__mul255_sse2(vs, _mm_sub_epi16(x255, f))));
+
+        __m128i at[6];
+        for (int k = 0; k < 6; ++k) at[k] = _mm_cmpeq_epi16(side, _mm_set1_epi16((short)k));
+        #define PICK(c0, c1, c2, c3, c4, c5)                                                \
+            _mm_or_si128(_mm_or_si128(_mm_or_si128(_mm_and_si128(at[0], c0),                \
+                                                   _mm_and_si128(at[1], c1)),               \
+                                      _mm_or_si128(_mm_and_si128(at[2], c2),                \
+                                                   _mm_and_si128(at[3], c3))),              \
+                         _mm_or_si128(_mm_and_si128(at[4], c4), _mm_and_si128(at[5], c5)))
+        __m128i vr = PICK(x, q, p, p, t, x);
+        __m128i vg = PICK(t, x, x, q, p, p);
+        __m128i vb = PICK(p, p, t, x, x, q);
+        #undef PICK
+
+        _mm_storel_epi64((__m128i *)(r + i), _mm_packus_epi16(vr, zero));
+        _mm_storel_epi64((__m128i *)(g + i), _mm_packus_epi16(vg, zero));
+        _mm_storel_epi64((__m128i *)(b + i), _mm_packus_epi16(vb, zero));
+    }
+    if (i < n) picasso__color_hsv_to_rgb_scalar(r + i, g + i, b + i, h + i, s + i, v + i, n - i);
+}
+
+/* Sixteen 3 byte pixels in three vectors, split into 16 bytes of each plane
+ * with nothing but unpacks: every round interleaves the first half of each
+ * vector with the second half of the next one, and after four rounds the
+ * bytes are sorted by channel. Merging does the rounds backwards, picking the
+ * even and odd bytes apart again */
+static inline void picasso__split3_round(__m128i v[3])
+{
+    __m128i a = _mm_unpacklo_epi8(v[0], _mm_unpackhi_epi64(v[1], v[1]));
+    __m128i b = _mm_unpacklo_epi8(_mm_unpackhi_epi64(v[0], v[0]), v[2]);
+    __m128i c = _mm_unpacklo_epi8(v[1], _mm_unpackhi_epi64(v[2], v[2]));
+    v[0] = a;
+    v[1] = b;
+    v[2] = c;
+}
+
+static inline void picasso__merge3_round(__m128i v[3])
+{
+    const __m128i even = _mm_set1_epi16(0xFF);
+    __m128i a = _mm_packus_epi16(_mm_and_si128(v[0], even), _mm_and_si128(v[1], even));
+    __m128i b = _mm_packus_epi16(_mm_and_si128(v[2], even), _mm_srli_epi16(v[0], 8));
+    __m128i c = _mm_packus_epi16(_mm_srli_epi16(v[1], 8), _mm_srli_epi16(v[2], 8));
+    v[0] = a;
+    v[1] = b;
+    v[2] = c;
+}
+
+/* Sixteen pixels at a time. Four channels are 32 bit lanes shifted and packed
+ * down, two are 16 bit lanes, three go through the rounds above */
+void picasso__color_split(uint8_t *const *planes, const uint8_t *packed, int channels, int n)
+{
+    int i = 0;
+    if (channels == 1) {
+        memcpy(planes[0], packed, (size_t)n);
+        return;
+    } else if (channels == 4) {
+        const __m128i low = _mm_set1_epi32(0xFF);
+        for (; i + 16 <= n; i += 16) {
+            __m128i px[4];
+            for (int k = 0; k < 4; ++k)
+                px[k] = _mm_loadu_si128((const __m128i *)(packed + 4 * i + 16 * k));
+            for (int c = 0; c < 4; ++c) {
+                __m128i w[4];
+                for (int k = 0; k < 4; ++k) w[k] = _mm_and_si128(_mm_srli_epi32(px[k], 8 * c), low);
+                __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(w[0], w[1]),
+                                                 _mm_packs_epi32(w[2], w[3]));
+                _mm_storeu_si128((__m128i *)(planes[c] + i), bytes);
+            }
+        }
+    } else if (channels == 2) {
+        const __m128i low = _mm_set1_epi16(0xFF);
+        for (; i + 16 <= n; i += 16) {
+            __m128i p0 = _mm_loadu_si128((const __m128i *)(packed + 2 * i));
+            __m128i p1 = _mm_loadu_si128((const __m128i *)(packed + 2 * i + 16));
+            _mm_storeu_si128((__m128i *)(planes[0] + i),
+                             _mm_packus_epi16(_mm_and_si128(p0, low), _mm_and_si128(p1, low)));
+            _mm_storeu_si128((__m128i *)(planes[1] + i),
+                             _mm_packus_epi16(_mm_srli_epi16(p0, 8), _mm_srli_epi16(p1, 8)));
+        }
+    } else if (channels == 3) {
+        for (; i + 16 <= n; i += 16) {
+            __m128i v[3];
+            for (int k = 0; k < 3; ++k)
+                v[k] = _mm_loadu_si128((const __m128i *)(packed + 3 * i + 16 * k));
+            for (int round = 0; round < 4; ++round) picasso__split3_round(v);
+            for (int c = 0; c < 3; ++c) _mm_storeu_si128((__m128i *)(planes[c] + i), v[c]);
+        }
+    }
+    if (i < n) picasso__color_split_tail(planes, packed, channels, i, n);
+}
+
+void picasso__color_merge(uint8_t *packed, int channels, const uint8_t *const *planes, int n)
+{
+    int i = 0;
+    if (channels == 1) {
+        memcpy(packed, planes[0], (size_t)n);
+        return;
+    } else if (channels == 4) {
+        for (; i + 16 <= n; i += 16) {
+            __m128i r = _mm_loadu_si128((const __m128i *)(planes[0] + i));
+            __m128i g = _mm_loadu_si128((const __m128i *)(planes[1] + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(planes[2] + i));
+            __m128i a = _mm_loadu_si128((const __m128i *)(planes[3] + i));
+            __m128i rg_lo = _mm_unpacklo_epi8(r, g), rg_hi = _mm_unpackhi_epi8(r, g);
+            __m128i ba_lo = _mm_unpacklo_epi8(b, a), ba_hi = _mm_unpackhi_epi8(b, a);
+            _mm_storeu_si128((__m128i *)(packed + 4 * i),      _mm_unpacklo_epi16(rg_lo, ba_lo));
+            _mm_storeu_si128((__m128i *)(packed + 4 * i + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+            _mm_storeu_si128((__m128i *)(packed + 4 * i + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+            _mm_storeu_si128((__m128i *)(packed + 4 * i + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+        }
+    } else if (channels == 2) {
+        for (; i + 16 <= n; i += 16) {
+            __m128i p0 = _mm_loadu_si128((const __m128i *)(planes[0] + i));
+            __m128i p1 = _mm_loadu_si128((const __m128i *)(planes[1] + i));
+            _mm_storeu_si128((__m128i *)(packed + 2 * i),      _mm_unpacklo_epi8(p0, p1));
+            _mm_storeu_si128((__m128i *)(packed + 2 * i + 16), _mm_unpackhi_epi8(p0, p1));
+        }
+    } else if (channels == 3) {
+        for (; i + 16 <= n; i += 16) {
+            __m128i v[3];
+            for (int c = 0; c < 3; ++c) v[c] = _mm_loadu_si128((const __m128i *)(planes[c] + i));
+            for (int round = 0; round < 4; ++round) picasso__merge3_round(v);
+            for (int k = 0; k < 3; ++k)
+                _mm_storeu_si128((__m128i *)(packed + 3 * i + 16 * k), v[k]);
+        }
+    }
+    if (i < n) picasso__color_merge_tail(packed, channels, planes, i, n);
+}
+
+// --------------------------------------------------------
+// NEON kernels
+// --------------------------------------------------------
+#elif defined(PICASSO_COLOR_NEON)
+
+// Eight pixels of the three planes, widened and multiply-accumulated
+static inline uint8x8_t picasso__dot3_neon(uint8x8_t a, uint8x8_t b, uint8x8_t c,
+                                           const picasso_color_weights *w)
+{
+    int16x8_t va = vreinterpretq_s16_u16(vmovl_u8(a));
+    int16x8_t vb = vreinterpretq_s16_u16(vmovl_u8(b));
+    int16x8_t vc = vreinterpretq_s16_u16(vmovl_u8(c));
+    int32x4_t lo = vdupq_n_s32(w->bias), hi = vdupq_n_s32(w->bias);
+    lo = vmlal_n_s16(lo, vget_low_s16(va), w->k[0]);
+    hi = vmlal_n_s16(hi, vget_high_s16(va), w->k[0]);
+    lo = vmlal_n_s16(lo, vget_low_s16(vb), w->k[1]);
+    hi = vmlal_n_s16(hi, vget_high_s16(vb), w->k[1]);
+    lo = vmlal_n_s16(lo, vget_low_s16(vc), w->k[2]);
+    hi = vmlal_n_s16(hi, vget_high_s16(vc), w->k[2]);
+    int16x8_t v = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, PICASSO_COLOR_SHIFT)),
+                               vqmovn_s32(vshrq_n_s32(hi, PICASSO_COLOR_SHIFT)));
+    return vqmovun_s16(v);
+}
+
+void picasso__color_dot3(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *c,
+                         int n, const picasso_color_weights *w)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i), vb = vld1q_u8(b + i), vc = vld1q_u8(c + i);
+        uint8x8_t lo = picasso__dot3_neon(vget_low_u8(va), vget_low_u8(vb), vget_low_u8(vc), w);
+        uint8x8_t hi = picasso__dot3_neon(vget_high_u8(va), vget_high_u8(vb), vget_high_u8(vc), w);
+        vst1q_u8(out + i, vcombine_u8(lo, hi));
+    }
+    if (i < n) picasso__color_dot3_scalar(out + i, a + i, b + i, c + i, n - i, w);
+}
+
+// Four lanes of a / b in floats, rounded to nearest like lrintf
+static inline int32x4_t picasso__div_neon(int32x4_t a, int32x4_t b)
+{
+    return vcvtnq_s32_f32(vdivq_f32(vcvtq_f32_s32(a), vcvtq_f32_s32(b)));
+}
+
+void picasso__color_rgb_to_hsv(uint8_t *h, uint8_t *s, uint8_t *v, const uint8_t *r,
+                               const uint8_t *g, const uint8_t *b, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t vr = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r + i)));
+        int16x8_t vg = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(g + i)));
+        int16x8_t vb = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(b + i)));
+        int16x8_t hi = vmaxq_s16(vr, vmaxq_s16(vg, vb));
+        int16x8_t d = vsubq_s16(hi, vminq_s16(vr, vminq_s16(vg, vb)));
+        int16x8_t d2 = vaddq_s16(d, d);
+
+        uint16x8_t at_r = vceqq_s16(hi, vr);
+        uint16x8_t at_g = vbicq_u16(vceqq_s16(hi, vg), at_r);
+        int16x8_t around = vbslq_s16(at_r, vsubq_s16(vg, vb),
+                                     vbslq_s16(at_g, vaddq_s16(vsubq_s16(vb, vr), d2),
+                                               vaddq_s16(vsubq_s16(vr, vg), vaddq_s16(d2, d2))));
+        int16x8_t sixths = vmulq_n_s16(d, 6);
+        int32x4_t hue_lo = picasso__div_neon(vshll_n_s16(vget_low_s16(around), 8),
+                                             vmovl_s16(vget_low_s16(sixths)));
+        int32x4_t hue_hi = picasso__div_neon(vshll_n_s16(vget_high_s16(around), 8),
+                                             vmovl_s16(vget_high_s16(sixths)));
+        int32x4_t sat_lo = picasso__div_neon(vmull_n_s16(vget_low_s16(d), 255),
+                                             vmovl_s16(vget_low_s16(hi)));
+        int32x4_t sat_hi = picasso__div_neon(vmull_n_s16(vget_high_s16(d), 255),
+                                             vmovl_s16(vget_high_s16(hi)));
+
+        // 0 / 0 where there is no hue or saturation, masked like the scalar kernel
+        int16x8_t hue = vandq_s16(vcombine_s16(vmovn_s32(hue_lo), vmovn_s32(hue_hi)),
+                                  vdupq_n_s16(255));
+        int16x8_t sat = vcombine_s16(vqmovn_s32(sat_lo), vqmovn_s32(sat_hi));
+        hue = vbslq_s16(vceqq_s16(d, vdupq_n_s16(0)), vdupq_n_s16(0), hue);
+        sat = vbslq_s16(vceqq_s16(hi, vdupq_n_s16(0)), vdupq_n_s16(0), sat);
+
+        vst1_u8(h + i, vqmovun_s16(hue));
+        vst1_u8(s + i, vqmovun_s16(sat));
+        vst1_u8(v + i, vqmovun_s16(hi));
+    }
+    if (i < n) picasso__color_rgb_to_hsv_scalar(h + i, s + i, v + i, r + i, g + i, b + i, n - i);
+}
+
+static inline uint16x8_t picasso__mul255_neon(uint16x8_t x, uint16x8_t y)
+{
+    uint16x8_t t = vaddq_u16(vmulq_u16(x, y), vdupq_n_u16(128));
+    return vshrq_n_u16(vsraq_n_u16(t, t, 8), 8);
+}
+
+void picasso__color_hsv_to_rgb(uint8_t *r, uint8_t *g, uint8_t *b, const uint8_t *h,
+                               const uint8_t *s, const uint8_t *v, int n)
+{
+    const uint16x8_t x255 = vdupq_n_u16(255);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t vs = vmovl_u8(vld1_u8(s + i)), x = vmovl_u8(vld1_u8(v + i));
+        uint16x8_t h6 = vmulq_n_u16(vmovl_u8(vld1_u8(h + i)), 6);
+        uint16x8_t side = vshrq_n_u16(h6, 8), f = vandq_u16(h6, x255);
+
+        uint16x8_t p = picasso__mul255_neon(x, vsubq_u16(x255, vs));
+        uint16x8_t q = picasso__mul255_neon(x, vsubq_u16(x255, picasso__mul255_neon(vs, f)));
+        uint16x8_t t = picasso__mul255_neon(x, vsubq_u16(x255,
+                                            picasso__mul255_neon(vs, vsubq_u16(x255, f))));
+
+        uint16x8_t at[6];
+        for (int k = 0; k < 6; ++k) at[k] = vceqq_u16(side, vdupq_n_u16((uint16_t)k));
+        #define PICK(c0, c1, c2, c3, c4, c5)                                                   \
+            vbslq_u16(at[0], c0, vbslq_u16(at[1], c1, vbslq_u16(at[2], c2,                     \
+            vbslq_u16(at[3], c3, vbslq_u16(at[4], c4, c5)))))
+        vst1_u8(r + i, vmovn_u16(PICK(x, q, p, p, t, x)));
+        vst1_u8(g + i, vmovn_u16(PICK(t, x, x, q, p, p)));
+        vst1_u8(b + i, vmovn_u16(PICK(p, p, t, x, x, q)));
+        #undef PICK
+    }
+    if (i < n) picasso__color_hsv_to_rgb_scalar(r + i, g + i, b + i, h + i, s + i, v + i, n - i);
+}
+
+// Interleaved loads and stores do all of it
+void picasso__color_split(uint8_t *const *planes, const uint8_t *packed, int channels, int n)
+{
+    int i = 0;
+    if (channels == 1) {
+        memcpy(planes[0], packed, (size_t)n);
+        return;
+    } else if (channels == 2) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x2_t px = vld2q_u8(packed + 2 * i);
+            for (int c = 0; c < 2; ++c) vst1q_u8(planes[c] + i, px.val[c]);
+        }
+    } else if (channels == 3) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x3_t px = vld3q_u8(packed + 3 * i);
+            for (int c = 0; c < 3; ++c) vst1q_u8(planes[c] + i, px.val[c]);
+        }
+    } else if (channels == 4) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x4_t px = vld4q_u8(packed + 4 * i);
+            for (int c = 0; c < 4; ++c) vst1q_u8(planes[c] + i, px.val[c]);
+        }
+    }
+    if (i < n) picasso__color_split_tail(planes, packed, channels, i, n);
+}
+
+void picasso__color_merge(uint8_t *packed, int channels, const uint8_t *const *planes, int n)
+{
+    int i = 0;
+    if (channels == 1) {
+        memcpy(packed, planes[0], (size_t)n);
+        return;
+    } else if (channels == 2) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x2_t px;
+            for (int c = 0; c < 2; ++c) px.val[c] = vld1q_u8(planes[c] + i);
+            vst2q_u8(packed + 2 * i, px);
+        }
+    } else if (channels == 3) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x3_t px;
+            for (int c = 0; c < 3; ++c) px.val[c] = vld1q_u8(planes[c] + i);
+            vst3q_u8(packed + 3 * i, px);
+        }
+    } else if (channels == 4) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x4_t px;
+            for (int c = 0; c < 4; ++c) px.val[c] = vld1q_u8(planes[c] + i);
+            vst4q_u8(packed + 4 * i, px);
+        }
+    }
+    if (i < n) picasso__color_merge_tail(packed, channels, planes, i, n);
+}
+
+// --------------------------------------------------------
+// Scalar only
+// --------------------------------------------------------
+#else
+
+void picasso__color_dot3(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *c,
+                         int n, const picasso_color_weights *w)
+{
+    picasso__color_dot3_scalar(out, a, b, c, n, w);
+}
+
+void picasso__color_rgb_to_hsv(uint8_t *h, uint8_t *s, uint8_t *v, const uint8_t *r,
+                               const uint8_t *g, const uint8_t *b, int n)
+{
+    picasso__color_rgb_to_hsv_scalar(h, s, v, r, g, b, n);
+}
+
+void picasso__color_hsv_to_rgb(uint8_t *r, uint8_t *g, uint8_t *b, const uint8_t *h,
+                               const uint8_t *s, const uint8_t *v, int n)
+{
+    picasso__color_hsv_to_rgb_scalar(r, g, b, h, s, v, n);
+}
+
+void picasso__color_split(uint8_t *const *planes, const uint8_t *packed, int channels, int n)
+{
+    picasso__color_split_scalar(planes, packed, channels, n);
+}
+
+void picasso__color_merge(uint8_t *packed, int channels, const uint8_t *const *planes, int n)
+{
+    picasso__color_merge_scalar(packed, channels, planes, n);
+}
+
+#endif
+
+// --------------------------------------------------------
+// Rows
+// --------------------------------------------------------
+void picasso__color_luma_row(uint8_t *dst, const uint8_t *packed, int channels, int n,
+                             picasso_ycbcr space)
+{
+    uint8_t rgb[4][PICASSO_SPAN_CHUNK];
+    uint8_t *planes[4] = { rgb[0], rgb[1], rgb[2], rgb[3] };
+    for (int x = 0; x < n; x += PICASSO_SPAN_CHUNK) {
+        int count = PICASSO_MIN(n - x, PICASSO_SPAN_CHUNK);
+        picasso__color_split(planes, packed + (size_t)x * channels, channels, count);
+        picasso__color_dot3(dst + x, rgb[0], rgb[1], rgb[2], count,
+                            &picasso__ycbcr_weights[space][0]);
+    }
+}
+
+typedef enum {
+    PICASSO_COLOR_TO_YCBCR,
+    PICASSO_COLOR_FROM_YCBCR,
+    PICASSO_COLOR_TO_LUMA,
+    PICASSO_COLOR_TO_HSV,
+    PICASSO_COLOR_FROM_HSV,
+    PICASSO_COLOR_SPLIT,
+    PICASSO_COLOR_MERGE,
+} picasso_color_op;
+
+typedef struct {
+    picasso_color_op op;
+    picasso_image *src, *dst;       // packed, either one may be NULL
+    picasso_image *const *planes;
+    picasso_ycbcr space;
+} picasso_color_job;
+
+static inline uint8_t *picasso__color_row(picasso_image *img, int y)
+{
+    return img->pixels + (size_t)y * img->row_stride;
+}
+
+static void picasso__color_rows(int y0, int y1, void *arg)
+{
+    picasso_color_job *job = arg;
+    picasso_image *frame = job->src ? job->src : job->dst;
+    int width = frame->width, channels = frame->channels;
+    const picasso_color_weights *to_ycbcr = picasso__ycbcr_weights[job->space];
+    const picasso_color_weights *to_rgb = picasso__rgb_weights[job->space];
+
+    // Packed pixels are split into in[], converted into out[] and merged
+    // from there. Alpha goes straight through in[3], or is opaque
+    uint8_t in[4][PICASSO_SPAN_CHUNK], out[3][PICASSO_SPAN_CHUNK];
+    uint8_t *split[4] = { in[0], in[1], in[2], in[3] };
+    const uint8_t *merge[4] = { out[0], out[1], out[2], in[3] };
+    if (job->op == PICASSO_COLOR_FROM_YCBCR) memset(in[3], 255, sizeof(in[3]));
+
+    int planes = job->op == PICASSO_COLOR_SPLIT || job->op == PICASSO_COLOR_MERGE ? channels :
+                 job->planes ? 3 : 0;
+
+    for (int y = y0; y < y1; ++y) {
+        uint8_t *row = picasso__color_row(frame, y);
+        uint8_t *plane[4] = { NULL };
+        for (int c = 0; c < planes; ++c) plane[c] = picasso__color_row(job->planes[c], y);
+
+        switch (job->op) {
+            case PICASSO_COLOR_SPLIT:
+                picasso__color_split(plane, row, channels, width);
+                continue;
+            case PICASSO_COLOR_MERGE:
+                picasso__color_merge(row, channels, (const uint8_t *const *)plane, width);
+                continue;
+            case PICASSO_COLOR_TO_LUMA:
+                picasso__color_luma_row(picasso__color_row(job->dst, y), row, channels, width,
+                                        job->space);
+                continue;
+            default:
+                break;
+        }
+
+        uint8_t *to = job->dst ? picasso__color_row(job->dst, y) : NULL;
+        for (int x = 0; x < width; x += PICASSO_SPAN_CHUNK) {
+            int n = PICASSO_MIN(width - x, PICASSO_SPAN_CHUNK);
+            const uint8_t *from = row + (size_t)x * channels;
+
+            switch (job->op) {
+                case PICASSO_COLOR_TO_YCBCR:
+                    picasso__color_split(split, from, channels, n);
+                    for (int c = 0; c < 3; ++c)
+                        picasso__color_dot3(plane[c] + x, in[0], in[1], in[2], n, &to_ycbcr[c]);
+                    break;
+                case PICASSO_COLOR_FROM_YCBCR:
+                    for (int c = 0; c < 3; ++c)
+                        picasso__color_dot3(out[c], plane[0] + x, plane[1] + x, plane[2] + x, n,
+                                            &to_rgb[c]);
+                    picasso__color_merge(to + (size_t)x * channels, channels, merge, n);
+                    break;
+                case PICASSO_COLOR_TO_HSV:
+                    picasso__color_split(split, from, channels, n);
+                    picasso__color_rgb_to_hsv(out[0], out[1], out[2], in[0], in[1], in[2], n);
+                    picasso__color_merge(to + (size_t)x * channels, channels, merge, n);
+                    break;
+                case PICASSO_COLOR_FROM_HSV:
+                    picasso__color_split(split, from, channels, n);
+                    picasso__color_hsv_to_rgb(out[0], out[1], out[2], in[0], in[1], in[2], n);
+                    picasso__color_merge(to + (size_t)x * channels, channels, merge, n);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------
+// Images
+// --------------------------------------------------------
+static bool picasso__color_linear(const picasso_image *img, int channels_min, int channels_max)
+{
+    return img && img->pixels && img->layout == PICASSO_LAYOUT_LINEAR &&
+           img->channels >= channels_min && img->channels <= channels_max;
+}
+
+static bool picasso__color_planes(picasso_image *const planes[], int count,
+                                  const picasso_image *like)
+{
+    if (!planes) return false;
+    for (int c = 0; c < count; ++c)
+        if (!picasso__color_linear(planes[c], 1, 1) || planes[c]->width != like->width ||
+            planes[c]->height != like->height) return false;
+    return true;
+}
+
+static bool picasso__color_fits(const picasso_color_job *job)
+{
+    picasso_image *src = job->src, *dst = job->dst;
+    bool space = job->space >= PICASSO_YCBCR_BT601 && job->space <= PICASSO_YCBCR_BT709_LIMITED;
+
+    switch (job->op) {
+        case PICASSO_COLOR_TO_YCBCR:
+            return space && picasso__color_linear(src, 3, 4) &&
+                   picasso__color_planes(job->planes, 3, src);
+        case PICASSO_COLOR_FROM_YCBCR:
+            return space && picasso__color_linear(dst, 3, 4) &&
+                   picasso__color_planes(job->planes, 3, dst);
+        case PICASSO_COLOR_TO_LUMA:
+            return space && picasso__color_linear(src, 3, 4) &&
+                   picasso__color_planes(&job->dst, 1, src);
+        case PICASSO_COLOR_TO_HSV:
+        case PICASSO_COLOR_FROM_HSV:
+            return picasso__color_linear(src, 3, 4) && picasso__color_linear(dst, 3, 4) &&
+                   src->channels == dst->channels && src->width == dst->width &&
+                   src->height == dst->height;
+        case PICASSO_COLOR_SPLIT:
+            return picasso__color_linear(src, 1, 4) &&
+                   picasso__color_planes(job->planes, src->channels, src);
+        case PICASSO_COLOR_MERGE:
+            return picasso__color_linear(dst, 1, 4) &&
+                   picasso__color_planes(job->planes, dst->channels, dst);
+    }
+    return false;
+}
+
+/* Rows y0 to y1, or all of them over the job system. Only whole images get
+ * their alpha and premultiplied set: the _rows forms can be running on other
+ * rows of the same image elsewhere */
+static bool picasso__color_run(picasso_color_job *job, int y0, int y1, bool whole, const char *name)
+{
+    if (!picasso__color_fits(job)) {
+        WARN("%s: the images don't fit together", name);
+        return false;
+    }
+    picasso_image *frame = job->src ? job->src : job->dst;
+    if (whole) {
+        y0 = 0;
+        y1 = frame->height;
+    } else if (y0 < 0 || y1 > frame->height || y0 > y1) {
+        WARN("%s: rows %d to %d are outside of 0 to %d", name, y0, y1, frame->height);
+        return false;
+    }
+
+    if (!whole) {
+        picasso__color_rows(y0, y1, job);
+        return true;
+    }
+    picasso__parallel_rows(y1 - y0, frame->width, picasso__color_rows, job);
+
+    picasso_image *dst = job->dst;
+    switch (job->op) {
+        case PICASSO_COLOR_FROM_YCBCR:
+            // Opaque pixels are the same premultiplied
+            dst->alpha = PICASSO_ALPHA_OPAQUE;
+            dst->premultiplied = true;
+            break;
+        case PICASSO_COLOR_TO_HSV:
+        case PICASSO_COLOR_FROM_HSV:
+            dst->alpha = job->src->alpha;
+            dst->premultiplied = job->src->premultiplied;
+            break;
+        case PICASSO_COLOR_MERGE:
+            dst->premultiplied = false;
+            picasso_image_update_alpha(dst);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool picasso_rgb_to_ycbcr(picasso_image *src, picasso_image *const planes[3], picasso_ycbcr space)
+{
+    picasso_color_job job = { PICASSO_COLOR_TO_YCBCR, src, NULL, planes, space };
+    return picasso__color_run(&job, 0, 0, true, "picasso_rgb_to_ycbcr");
+}
+
+bool picasso_rgb_to_ycbcr_rows(picasso_image *src, picasso_image *const planes[3],
+                               picasso_ycbcr space, int y0, int y1)
+{
+    picasso_color_job job = { PICASSO_COLOR_TO_YCBCR, src, NULL, planes, space };
+    return picasso__color_run(&job, y0, y1, false, "picasso_rgb_to_ycbcr_rows");
+}
+
+bool picasso_ycbcr_to_rgb(picasso_image *const planes[3], picasso_image *dst, picasso_ycbcr space)
+{
+    picasso_color_job job = { PICASSO_COLOR_FROM_YCBCR, NULL, dst, planes, space };
+    return picasso__color_run(&job, 0, 0, true, "picasso_ycbcr_to_rgb");
+}
+
+bool picasso_ycbcr_to_rgb_rows(picasso_image *const planes[3], picasso_image *dst,
+                               picasso_ycbcr space, int y0, int y1)
+{
+    picasso_color_job job = { PICASSO_COLOR_FROM_YCBCR, NULL, dst, planes, space };
+    return picasso__color_run(&job, y0, y1, false, "picasso_ycbcr_to_rgb_rows");
+}
+
+bool picasso_luma(picasso_image *src, picasso_image *dst, picasso_ycbcr space)
+{
+    picasso_color_job job = { PICASSO_COLOR_TO_LUMA, src, dst, NULL, space };
+    return picasso__color_run(&job, 0, 0, true, "picasso_luma");
+}
+
+bool picasso_luma_rows(picasso_image *src, picasso_image *dst, picasso_ycbcr space, int y0, int y1)
+{
+    picasso_color_job job = { PICASSO_COLOR_TO_LUMA, src, dst, NULL, space };
+    return picasso__color_run(&job, y0, y1, false, "picasso_luma_rows");
+}
+
+bool picasso_rgb_to_hsv(picasso_image *src, picasso_image *dst)
+{
+    picasso_color_job job = { PICASSO_COLOR_TO_HSV, src, dst, NULL, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, 0, 0, true, "picasso_rgb_to_hsv");
+}
+
+bool picasso_rgb_to_hsv_rows(picasso_image *src, picasso_image *dst, int y0, int y1)
+{
+    picasso_color_job job = { PICASSO_COLOR_TO_HSV, src, dst, NULL, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, y0, y1, false, "picasso_rgb_to_hsv_rows");
+}
+
+bool picasso_hsv_to_rgb(picasso_image *src, picasso_image *dst)
+{
+    picasso_color_job job = { PICASSO_COLOR_FROM_HSV, src, dst, NULL, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, 0, 0, true, "picasso_hsv_to_rgb");
+}
+
+bool picasso_hsv_to_rgb_rows(picasso_image *src, picasso_image *dst, int y0, int y1)
+{
+    picasso_color_job job = { PICASSO_COLOR_FROM_HSV, src, dst, NULL, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, y0, y1, false, "picasso_hsv_to_rgb_rows");
+}
+
+bool picasso_split_planes(picasso_image *src, picasso_image *const planes[])
+{
+    picasso_color_job job = { PICASSO_COLOR_SPLIT, src, NULL, planes, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, 0, 0, true, "picasso_split_planes");
+}
+
+bool picasso_split_planes_rows(picasso_image *src, picasso_image *const planes[], int y0, int y1)
+{
+    picasso_color_job job = { PICASSO_COLOR_SPLIT, src, NULL, planes, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, y0, y1, false, "picasso_split_planes_rows");
+}
+
+bool picasso_merge_planes(picasso_image *const planes[], picasso_image *dst)
+{
+    picasso_color_job job = { PICASSO_COLOR_MERGE, NULL, dst, planes, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, 0, 0, true, "picasso_merge_planes");
+}
+
+bool picasso_merge_planes_rows(picasso_image *const planes[], picasso_image *dst, int y0, int y1)
+{
+    picasso_color_job job = { PICASSO_COLOR_MERGE, NULL, dst, planes, PICASSO_YCBCR_BT601 };
+    return picasso__color_run(&job, y0, y1, false, "picasso_merge_planes_rows");
+}
@@ -0,0 +1,727 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Command recording and the tiled submit.
+ *
+ * While recording, every drawing call is stored with the pixel area it may
+ * touch. A tiled submit bins the commands into PICASSO_TILE_SIZE tiles (two
+ * passes, count then fill, so each tile's list is one contiguous run of
+ * indices in issue order) and hands out tiles to the render threads, jobs on
+ * Canopy's job system, through an atomic counter. A tile is rendered by
+ * replaying its commands on a copy of the backbuffer whose clip is the tile.
+ * Every rasterizer decides each pixel on its own and only uses the clip to
+ * skip pixels, so the tiles put together are bit-identical to an immediate
+ * draw, and no two threads ever write the same pixel.
+ *
+ * The same property is what the cull pass relies on. A command's bounds is
+ * also its clip when it is replayed, so hiding part of a command is just a
+ * matter of shrinking its bounds. */
+
+static int render_threads = 0; // 0 = every thread of the job system
+
+// --------------------------------------------------------
+// Command bounds
+// --------------------------------------------------------
+
+static inline picasso_draw_bounds picasso__bounds_of_rect(picasso_rect r)
+{
+    picasso__normalize_rect(&r);
+    return (picasso_draw_bounds){ r.x, r.y, r.x + r.width, r.y + r.height };
+}
+
+/* Conservative pixel area of a command. These mirror the px conversions each
+ * primitive does, with a pixel or two of slack where the rasterizer rounds */
+picasso_draw_bounds picasso__cmd_bounds(picasso_backbuffer *bf, const picasso_cmd *cmd)
+{
+    switch (cmd->type) {
+    case PICASSO_CMD_CLEAR:
+    case PICASSO_CMD_CLEAR_DEPTH:
+    case PICASSO_CMD_MESH3D: // only known after transforming every vertex
+        return (picasso_draw_bounds){ 0, 0, (int)bf->width, (int)bf->height };
+
+    case PICASSO_CMD_FILL_RECT:
+    case PICASSO_CMD_DRAW_RECT: {
+        const picasso_rect *r = &cmd->rect.r;
+        return picasso__bounds_of_rect((picasso_rect){
+            picasso__to_px_x(bf, r->x), picasso__to_px_y(bf, r->y),
+            picasso__to_px_w(bf, r->width), picasso__to_px_h(bf, r->height) });
+    }
+
+    case PICASSO_CMD_LINE:
+    case PICASSO_CMD_LINE_THICK: {
+        int x0 = picasso__to_px_x(bf, PICASSO_MIN(cmd->line.x0, cmd->line.x1));
+        int x1 = picasso__to_px_x(bf, PICASSO_MAX(cmd->line.x0, cmd->line.x1));
+        int y0 = picasso__to_px_y(bf, PICASSO_MIN(cmd->line.y0, cmd->line.y1));
+        int y1 = picasso__to_px_y(bf, PICASSO_MAX(cmd->line.y0, cmd->line.y1));
+
+        // The thick line is stroked with round caps, half its width out
+        int pad = 0;
+        if (cmd->type == PICASSO_CMD_LINE_THICK) {
+            float s = (bf->scale_x + bf->scale_y) * 0.5f;
+            pad = (int)ceilf(fmaxf((float)cmd->line.thickness * s * 0.5f, 0.5f)) + 2;
+        }
+
+        return (picasso_draw_bounds){ x0 - pad, y0 - pad, x1 + pad + 1, y1 + pad + 1 };
+    }
+
+    case PICASSO_CMD_LINE_AA: {
+        float x0 = picasso__to_px_xf(bf, fminf(cmd->line_f.x0, cmd->line_f.x1));
+        float x1 = picasso__to_px_xf(bf, fmaxf(cmd->line_f.x0, cmd->line_f.x1));
+        float y0 = picasso__to_px_yf(bf, fminf(cmd->line_f.y0, cmd->line_f.y1));
+        float y1 = picasso__to_px_yf(bf, fmaxf(cmd->line_f.y0, cmd->line_f.y1));
+
+        // Wu's line plots the pixel below the ideal one as well
+        return (picasso_draw_bounds){
+            (int)floorf(x0) - 2, (int)floorf(y0) - 2,
+            (int)floorf(x1) + 3, (int)floorf(y1) + 3 };
+    }
+
+    case PICASSO_CMD_CIRCLE:
+    case PICASSO_CMD_FILL_CIRCLE:
+    case PICASSO_CMD_FILL_CIRCLE_AA: {
+        int cx = picasso__to_px_x(bf, cmd->circle.cx);
+        int cy = picasso__to_px_y(bf, cmd->circle.cy);
+        int r = PICASSO_MAX(picasso__to_px_uniform(bf, cmd->circle.radius), 1);
+        int pad = r + PICASSO_CIRCLE_DEFAULT_TOLERANCE + 1;
+        return (picasso_draw_bounds){ cx - pad, cy - pad, cx + pad + 1, cy + pad + 1 };
+    }
+
+    case PICASSO_CMD_CIRCLE_AA: {
+        // The ring fades out over the pixel past the radius
+        int cx = picasso__to_px_x(bf, cmd->circle.cx);
+        int cy = picasso__to_px_y(bf, cmd->circle.cy);
+        int pad = PICASSO_MAX(picasso__to_px_uniform(bf, cmd->circle.radius), 0) + 1;
+        return (picasso_draw_bounds){ cx - pad, cy - pad, cx + pad + 1, cy + pad + 1 };
+    }
+
+    case PICASSO_CMD_FILL_TRIANGLE: {
+        const picasso_point3 *p = &cmd->tri;
+        int x0 = picasso__to_px_x(bf, PICASSO_MIN3(p->x1, p->x2, p->x3));
+        int x1 = picasso__to_px_x(bf, PICASSO_MAX3(p->x1, p->x2, p->x3));
+        int y0 = picasso__to_px_y(bf, PICASSO_MIN3(p->y1, p->y2, p->y3));
+        int y1 = picasso__to_px_y(bf, PICASSO_MAX3(p->y1, p->y2, p->y3));
+        // Vertices are subpixel, so the rounding can be off by one either way
+        return (picasso_draw_bounds){ x0 - 1, y0 - 1, x1 + 2, y1 + 2 };
+    }
+
+    case PICASSO_CMD_BLIT: {
+        picasso_rect r = cmd->blit.dst_r;
+        picasso__normalize_rect(&r);
+        return picasso__bounds_of_rect((picasso_rect){
+            picasso__to_px_x(bf, r.x), picasso__to_px_y(bf, r.y),
+            picasso__to_px_w(bf, r.width), picasso__to_px_h(bf, r.height) });
+    }
+
+    case PICASSO_CMD_BITMAP:
+        return (picasso_draw_bounds){
+            cmd->bitmap.x, cmd->bitmap.y,
+            cmd->bitmap.x + cmd->bitmap.w, cmd->bitmap.y + cmd->bitmap.h };
+
+    case PICASSO_CMD_MESH:
+        return picasso__mesh_bounds(bf, cmd->mesh.vertices, cmd->mesh.vertex_count);
+
+    case PICASSO_CMD_FILL_PATH:
+        return picasso__path_bounds(bf, cmd->path.path);
+
+    case PICASSO_CMD_STROKE_PATH: {
+        const picasso_stroke_style *style = &cmd->stroke.style;
+        float h = style->width * (bf->scale_x + bf->scale_y) * 0.25f;
+        float margin = fminf(picasso__stroke_margin(h, style), PICASSO_SUBPIXEL_LIMIT);
+        int pad = margin > 0 ? (int)ceilf(margin) : 0; // drops a NaN width too
+
+        picasso_draw_bounds b = picasso__path_bounds(bf, cmd->stroke.path);
+        return (picasso_draw_bounds){ b.x0 - pad, b.y0 - pad, b.x1 + pad, b.y1 + pad };
+    }
+
+    case PICASSO_CMD_BEZIER: {
+        // The curve stays inside its control points, stroked 4 wide
+        const picasso_vec2 *p = &cmd->bezier.p0, *q = &cmd->bezier.p1, *r = &cmd->bezier.p2;
+        float s = (bf->scale_x + bf->scale_y) * 0.5f;
+        int pad = (int)ceilf(2.0f * s) + 2;
+        int x0 = picasso__to_px_x(bf, (int)floorf(fminf(p->x, fminf(q->x, r->x))));
+        int x1 = picasso__to_px_x(bf, (int)ceilf(fmaxf(p->x, fmaxf(q->x, r->x))));
+        int y0 = picasso__to_px_y(bf, (int)floorf(fminf(p->y, fminf(q->y, r->y))));
+        int y1 = picasso__to_px_y(bf, (int)ceilf(fmaxf(p->y, fmaxf(q->y, r->y))));
+        return (picasso_draw_bounds){ x0 - pad, y0 - pad, x1 + pad + 1, y1 + pad + 1 };
+    }
+
+    case PICASSO_CMD_SPRITES:
+        return picasso__sprite_bounds(bf, cmd->sprites.atlas, cmd->sprites.sprites,
+                                      cmd->sprites.count);
+    case PICASSO_CMD_AFFINE:
+        return picasso__affine_bounds(bf, cmd->affine.src, &cmd->affine.m);
+    case PICASSO_CMD_TEXT:
+        return picasso__text_bounds(bf, cmd->text.font, cmd->text.layout, cmd->text.x, cmd->text.y);
+    case PICASSO_CMD_TEXT_SDF:
+        return picasso__text_sdf_bounds(bf, cmd->text_sdf.font, cmd->text_sdf.layout,
+                                        cmd->text_sdf.x, cmd->text_sdf.y, cmd->c,
+                                        &cmd->text_sdf.effects);
+    }
+
+    return (picasso_draw_bounds){0};
+}
+
+// --------------------------------------------------------
+// Recording
+// --------------------------------------------------------
+
+bool picasso__record(picasso_backbuffer *bf, const picasso_cmd *cmd)
+{
+    struct picasso_cmdlist *list = bf->cmdlist;
+
+    // Off screen commands can't draw anything, they are dropped right here
+    picasso_draw_bounds b = picasso__cmd_bounds(bf, cmd);
+    b.x0 = PICASSO_MAX(b.x0, 0);
+    b.y0 = PICASSO_MAX(b.y0, 0);
+    b.x1 = PICASSO_MIN(b.x1, (int)bf->width);
+    b.y1 = PICASSO_MIN(b.y1, (int)bf->height);
+    if (b.x0 >= b.x1 || b.y0 >= b.y1) return true;
+
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 1024;
+        picasso_cmd *cmds = picasso_realloc(list->cmds, (size_t)capacity * sizeof(*cmds));
+        if (!cmds) {
+            ERROR("Out of memory recording draw command %d", list->count);
+            return false;
+        }
+        list->cmds = cmds;
+        list->capacity = capacity;
+    }
+
+    picasso_cmd *dst = &list->cmds[list->count];
+    *dst = *cmd;
+    dst->bounds = b;
+    dst->blend = bf->blend;
+
+    // The matrix is copied, its pointer is set again on submit, once the
+    // copies stopped moving
+    if (cmd->type == PICASSO_CMD_MESH3D) {
+        if (list->matrix_count == list->matrix_capacity) {
+            int capacity = list->matrix_capacity ? list->matrix_capacity * 2 : 64;
+            picasso_mat4 *m = picasso_realloc(list->matrices, (size_t)capacity * sizeof(*m));
+            if (!m) {
+                ERROR("Out of memory recording 3D matrix %d", list->matrix_count);
+                return false;
+            }
+            list->matrices = m;
+            list->matrix_capacity = capacity;
+        }
+        list->matrices[list->matrix_count] = *cmd->mesh3d.mvp;
+        dst->mesh3d.matrix = list->matrix_count++;
+        dst->mesh3d.mvp = NULL;
+    }
+
+    list->count++;
+    return true;
+}
+
+void picasso__free_cmdlist(struct picasso_cmdlist *list)
+{
+    if (!list) return;
+    picasso_free(list->cmds);
+    picasso_free(list->matrices);
+    picasso_free(list->bin_cmds);
+    picasso_free(list->bin_start);
+    picasso_free(list);
+}
+
+void picasso_begin_commands(picasso_backbuffer *bf)
+{
+    if (!bf) return;
+
+    if (!bf->cmdlist) {
+        bf->cmdlist = picasso_calloc(1, sizeof(struct picasso_cmdlist));
+        if (!bf->cmdlist) {
+            ERROR("Failed to allocate command list, drawing immediately");
+            return;
+        }
+    }
+
+    if (bf->cmdlist->recording)
+        WARN("picasso_begin_commands called twice, dropping %d commands",
+             bf->cmdlist->count);
+
+    bf->cmdlist->count = 0;
+    bf->cmdlist->matrix_count = 0;
+    bf->cmdlist->recording = true;
+}
+
+void picasso_set_render_threads(int count)
+{
+    render_threads = count;
+}
+
+// --------------------------------------------------------
+// Replay
+// --------------------------------------------------------
+
+static inline picasso_draw_bounds picasso__intersect(picasso_draw_bounds a, picasso_draw_bounds b)
+{
+    return (picasso_draw_bounds){
+        PICASSO_MAX(a.x0, b.x0), PICASSO_MAX(a.y0, b.y0),
+        PICASSO_MIN(a.x1, b.x1), PICASSO_MIN(a.y1, b.y1) };
+}
+
+static inline bool picasso__is_empty(picasso_draw_bounds b)
+{
+    return b.x0 >= b.x1 || b.y0 >= b.y1;
+}
+
+/* Calls the drawing function again with the recorded arguments. The caller
+ * has already clipped bf to the command's bounds */
+static void picasso__replay(picasso_backbuffer *bf, const picasso_cmd *cmd)
+{
+    picasso_rect r = cmd->rect.r; // the rect functions take a pointer
+
+    switch (cmd->type) {
+    case PICASSO_CMD_CLEAR:
+        picasso_clear_backbuffer(bf);
+        break;
+    case PICASSO_CMD_FILL_RECT:
+        // The bounds of a fill are exact, and merged fills only exist as
+        // bounds, so this fills the clip rather than the recorded rect
+        for (int y = bf->clip.y0; y < bf->clip.y1; ++y)
+            picasso__fill_span(bf, y, bf->clip.x0, bf->clip.x1, color_to_u32(cmd->c));
+        break;
+    case PICASSO_CMD_DRAW_RECT:
+        picasso_draw_rect(bf, &r, cmd->rect.thickness, cmd->c);
+        break;
+    case PICASSO_CMD_LINE:
+        picasso_draw_line(bf, cmd->line.x0, cmd->line.y0,
+                          cmd->line.x1, cmd->line.y1, cmd->c);
+        break;
+    case PICASSO_CMD_LINE_AA:
+        picasso_draw_line_aa(bf, cmd->line_f.x0, cmd->line_f.y0,
+                             cmd->line_f.x1, cmd->line_f.y1, cmd->c);
+        break;
+    case PICASSO_CMD_LINE_THICK:
+        picasso_draw_line_thick(bf, cmd->line.x0, cmd->line.y0,
+                                cmd->line.x1, cmd->line.y1,
+                                cmd->line.thickness, cmd->c);
+        break;
+    case PICASSO_CMD_CIRCLE:
+        picasso_draw_circle(bf, cmd->circle.cx, cmd->circle.cy,
+                            cmd->circle.radius, cmd->circle.thickness, cmd->c);
+        break;
+    case PICASSO_CMD_FILL_CIRCLE:
+        picasso_fill_circle(bf, cmd->circle.cx, cmd->circle.cy,
+                            cmd->circle.radius, cmd->c);
+        break;
+    case PICASSO_CMD_CIRCLE_AA:
+        picasso_draw_circle_aa(bf, cmd->circle.cx, cmd->circle.cy,
+                               cmd->circle.radius, cmd->c);
+        break;
+    case PICASSO_CMD_FILL_CIRCLE_AA:
+        picasso_fill_circle_aa(bf, cmd->circle.cx, cmd->circle.cy,
+                               cmd->circle.radius, cmd->c);
+        break;
+    case PICASSO_CMD_FILL_TRIANGLE:
+        picasso_fill_triangle(bf, cmd->tri, cmd->c);
+        break;
+    case PICASSO_CMD_BLIT:
+        picasso__blit(bf, cmd->blit.src, cmd->blit.src_r, cmd->blit.dst_r, cmd->blit.filter, false);
+        break;
+    case PICASSO_CMD_BITMAP:
+        picasso__draw_mask(bf, cmd->bitmap.mask, cmd->bitmap.w, cmd->bitmap.h,
+                           cmd->bitmap.stride, cmd->bitmap.x, cmd->bitmap.y, color_to_u32(cmd->c));
+        break;
+    case PICASSO_CMD_MESH:
+        picasso_draw_mesh(bf, cmd->mesh.vertices, cmd->mesh.vertex_count,
+                          cmd->mesh.indices, cmd->mesh.index_count, cmd->mesh.texture);
+        break;
+    case PICASSO_CMD_CLEAR_DEPTH:
+        picasso_clear_depth(bf);
+        break;
+    case PICASSO_CMD_MESH3D:
+        picasso_draw_mesh3d(bf, cmd->mesh3d.mvp, cmd->mesh3d.vertices, cmd->mesh3d.vertex_count,
+                            cmd->mesh3d.indices, cmd->mesh3d.index_count,
+                            cmd->mesh3d.texture, cmd->mesh3d.flags);
+        break;
+    case PICASSO_CMD_FILL_PATH:
+        picasso_fill_path(bf, cmd->path.path, cmd->path.rule, cmd->c);
+        break;
+    case PICASSO_CMD_STROKE_PATH:
+        picasso_stroke_path(bf, cmd->stroke.path, &cmd->stroke.style, cmd->c);
+        break;
+    case PICASSO_CMD_BEZIER:
+        draw_bezier(bf, cmd->bezier.p0, cmd->bezier.p1, cmd->bezier.p2, 0);
+        break;
+    case PICASSO_CMD_SPRITES:
+        picasso_draw_sprites(bf, cmd->sprites.atlas, cmd->sprites.sprites, cmd->sprites.count);
+        break;
+    case PICASSO_CMD_AFFINE:
+        picasso__blit_affine(bf, cmd->affine.src, &cmd->affine.m, cmd->affine.filter, false);
+        break;
+    case PICASSO_CMD_TEXT:
+        picasso__draw_text(bf, cmd->text.font, cmd->text.layout, cmd->text.x, cmd->text.y, cmd->c,
+                           false);
+        break;
+    case PICASSO_CMD_TEXT_SDF:
+        picasso__draw_text_sdf(bf, cmd->text_sdf.font, cmd->text_sdf.layout, cmd->text_sdf.x,
+                               cmd->text_sdf.y, cmd->c, &cmd->text_sdf.effects, false);
+        break;
+    }
+}
+
+// --------------------------------------------------------
+// Frame analysis
+// --------------------------------------------------------
+
+// Only the most recent occluders are kept, a UI frame rarely has more
+// big opaque panels than this on top of each other
+#define PICASSO_MAX_OCCLUDERS 32
+
+/* Whether every pixel a blit writes ends up fully opaque. Images without an
+ * alpha channel always are, otherwise the sampled part of the source is
+ * scanned, which stops at the first translucent pixel */
+static bool picasso__blit_is_opaque(const picasso_cmd *cmd)
+{
+    const picasso_image *img = cmd->blit.src;
+    picasso_rect r = cmd->blit.src_r;
+
+    // Same clamping as picasso_blit
+    picasso__normalize_rect(&r);
+    if (r.x < 0) r.x = 0;
+    if (r.y < 0) r.y = 0;
+    if (r.x + r.width > img->width) r.width = img->width - r.x;
+    if (r.y + r.height > img->height) r.height = img->height - r.y;
+    if (r.width <= 0 || r.height <= 0) return false;
+
+    if (img->channels == 1 || img->channels == 3) return true;
+    if (img->channels != 2 && img->channels != 4) return false;
+
+    int alpha = img->channels - 1;
+    for (int y = r.y; y < r.y + r.height; ++y) {
+        const uint8_t *row = &img->pixels[picasso__row_offset(img, y) + alpha];
+        for (int x = r.x, run; x < r.x + r.width; x += run) {
+            run = picasso__row_run(img, x, r.x + r.width - x);
+            const uint8_t *a = row + picasso__col_offset(img, x);
+            for (int i = 0; i < run; ++i)
+                if (a[i * img->channels] != 255) return false;
+        }
+    }
+    return true;
+}
+
+/* Commands that touch the depth buffer. Later 3D draws test against what
+ * they wrote, even where their colors end up hidden, so they can't be culled */
+static bool picasso__uses_depth(const picasso_cmd *cmd)
+{
+    return cmd->type == PICASSO_CMD_CLEAR_DEPTH ||
+           (cmd->type == PICASSO_CMD_MESH3D && !(cmd->mesh3d.flags & PICASSO_3D_NO_DEPTH));
+}
+
+/* Whether every pixel of the command's bounds ends up the same no matter what
+ * was there. Source and clear don't look at the destination at all, source-
+ * over doesn't where the source is opaque. Clears ignore the blend mode */
+static bool picasso__is_occluder(const picasso_cmd *cmd)
+{
+    bool replaces = cmd->blend == PICASSO_BLEND_SRC || cmd->blend == PICASSO_BLEND_CLEAR;
+    bool over = cmd->blend == PICASSO_BLEND_SRC_OVER;
+
+    switch (cmd->type) {
+    case PICASSO_CMD_CLEAR:     return CLEAR_BACKGROUND.a == 255;
+    case PICASSO_CMD_FILL_RECT: return replaces || (over && cmd->c.a == 255);
+    case PICASSO_CMD_BLIT:      return cmd->blit.src_r.width > 0 &&
+                                       cmd->blit.src_r.height > 0 &&
+                                       (replaces || (over && picasso__blit_is_opaque(cmd)));
+    default:                    return false;
+    }
+}
+
+/* Two fills of the same color and blend mode can become one when together
+ * they are still a rect. They must not overlap though, unless drawing twice
+ * gives the same as drawing once */
+static bool picasso__merge_fills(picasso_cmd *into, const picasso_cmd *cmd)
+{
+    if (into->type != PICASSO_CMD_FILL_RECT || cmd->type != PICASSO_CMD_FILL_RECT)
+        return false;
+    if (color_to_u32(into->c) != color_to_u32(cmd->c) || into->blend != cmd->blend)
+        return false;
+
+    picasso_draw_bounds a = into->bounds, b = cmd->bounds;
+    bool idempotent = cmd->blend == PICASSO_BLEND_SRC || cmd->blend == PICASSO_BLEND_CLEAR ||
+                  (cmd->blend == PICASSO_BLEND_SRC_OVER && cmd->c.a == 255);
+
+    bool same_x = a.x0 == b.x0 && a.x1 == b.x1;
+    bool same_y = a.y0 == b.y0 && a.y1 == b.y1;
+    bool joins_y = idempotent ? (a.y0 <= b.y1 && b.y0 <= a.y1) : (a.y1 == b.y0 || b.y1 == a.y0);
+    bool joins_x = idempotent ? (a.x0 <= b.x1 && b.x0 <= a.x1) : (a.x1 == b.x0 || b.x1 == a.x0);
+
+    if (!(same_x && joins_y) && !(same_y && joins_x)) return false;
+
+    into->bounds = (picasso_draw_bounds){
+        PICASSO_MIN(a.x0, b.x0), PICASSO_MIN(a.y0, b.y0),
+        PICASSO_MAX(a.x1, b.x1), PICASSO_MAX(a.y1, b.y1) };
+    return true;
+}
+
+/* Shrinks b by what the occluder hides. Only whole bands along an edge can be
+ * cut off and keep b a rect, anything else is left to overdraw. Returns false
+ * when nothing is left */
+static bool picasso__trim(picasso_draw_bounds *b, picasso_draw_bounds occ)
+{
+    bool spans_x = occ.x0 <= b->x0 && occ.x1 >= b->x1;
+    bool spans_y = occ.y0 <= b->y0 && occ.y1 >= b->y1;
+
+    if (spans_x) {
+        if (occ.y0 <= b->y0 && occ.y1 > b->y0) b->y0 = PICASSO_MIN(occ.y1, b->y1);
+        if (occ.y1 >= b->y1 && occ.y0 < b->y1) b->y1 = PICASSO_MAX(occ.y0, b->y0);
+    }
+    if (spans_y) {
+        if (occ.x0 <= b->x0 && occ.x1 > b->x0) b->x0 = PICASSO_MIN(occ.x1, b->x1);
+        if (occ.x1 >= b->x1 && occ.x0 < b->x1) b->x1 = PICASSO_MAX(occ.x0, b->x0);
+    }
+    return !picasso__is_empty(*b);
+}
+
+/* Removes overdraw before anything is rasterized. Same colored fills next to
+ * each other are merged first, then the list is walked back to front, and
+ * whatever is under a later rect that hides it (an opaque fill, clear or
+ * blit, or a fill or blit in the source or clear blend mode) is trimmed or
+ * dropped. The result is exactly the same frame */
+static void picasso__cull_commands(picasso_backbuffer *bf, struct picasso_cmdlist *list)
+{
+    int before = list->count;
+
+    // Merge, front to back
+    int kept = 0;
+    for (int i = 0; i < list->count; ++i) {
+        if (kept > 0 && picasso__merge_fills(&list->cmds[kept - 1], &list->cmds[i]))
+            continue;
+        list->cmds[kept++] = list->cmds[i];
+    }
+    list->count = kept;
+
+    // Occlusion, back to front. Culled commands get empty bounds
+    picasso_draw_bounds occluders[PICASSO_MAX_OCCLUDERS];
+    int num_occluders = 0;
+    bool covered = false; // the whole backbuffer is already opaque
+    picasso_draw_bounds screen = { 0, 0, (int)bf->width, (int)bf->height };
+
+    for (int i = list->count - 1; i >= 0; --i) {
+        picasso_cmd *cmd = &list->cmds[i];
+        if (picasso__uses_depth(cmd)) continue;
+
+        bool visible = !covered;
+        for (int k = num_occluders - 1; visible && k >= 0; --k)
+            visible = picasso__trim(&cmd->bounds, occluders[k]);
+
+        if (!visible) {
+            cmd->bounds = (picasso_draw_bounds){0};
+            continue;
+        }
+
+        if (!picasso__is_occluder(cmd)) continue;
+
+        if (cmd->bounds.x0 == screen.x0 && cmd->bounds.y0 == screen.y0 &&
+            cmd->bounds.x1 == screen.x1 && cmd->bounds.y1 == screen.y1) {
+            covered = true;
+            continue;
+        }
+        if (num_occluders == PICASSO_MAX_OCCLUDERS) {
+            memmove(&occluders[0], &occluders[1],
+                    (PICASSO_MAX_OCCLUDERS - 1) * sizeof(occluders[0]));
+            num_occluders--;
+        }
+        occluders[num_occluders++] = cmd->bounds;
+    }
+
+    kept = 0;
+    for (int i = 0; i < list->count; ++i)
+        if (!picasso__is_empty(list->cmds[i].bounds))
+            list->cmds[kept++] = list->cmds[i];
+    list->count = kept;
+
+    TRACE("Culled %d of %d commands", before - kept, before);
+}
+
+// --------------------------------------------------------
+// Tiled submit
+// --------------------------------------------------------
+
+typedef struct {
+    picasso_backbuffer *bf;
+    struct picasso_cmdlist *list;
+    picasso_damage region; // disjoint rects to draw in
+    int tiles_x, tiles_y;
+    atomic_int next_tile;
+} picasso_tile_job;
+
+/* Counts how many commands touch each tile, then writes the command indices
+ * out per tile. Returns false if the bins couldn't be allocated */
+static bool picasso__bin_commands(struct picasso_cmdlist *list, int tiles_x, int tiles_y)
+{
+    int tiles = tiles_x * tiles_y;
+
+    if (list->tile_capacity < tiles + 1) {
+        int *start = picasso_realloc(list->bin_start, (size_t)(tiles + 1) * sizeof(int));
+        if (!start) return false;
+        list->bin_start = start;
+        list->tile_capacity = tiles + 1;
+    }
+    memset(list->bin_start, 0, (size_t)(tiles + 1) * sizeof(int));
+
+    // Pass 1: count, shifted by one so the prefix sum gives the start offsets
+    int total = 0;
+    for (int i = 0; i < list->count; ++i) {
+        picasso_draw_bounds b = list->cmds[i].bounds;
+        for (int ty = b.y0 / PICASSO_TILE_SIZE; ty <= (b.y1 - 1) / PICASSO_TILE_SIZE; ++ty)
+            for (int tx = b.x0 / PICASSO_TILE_SIZE; tx <= (b.x1 - 1) / PICASSO_TILE_SIZE; ++tx) {
+                list->bin_start[ty * tiles_x + tx + 1]++;
+                total++;
+            }
+    }
+    for (int t = 0; t < tiles; ++t)
+        list->bin_start[t + 1] += list->bin_start[t];
+
+    if (list->bin_capacity < total) {
+        uint32_t *bins = picasso_realloc(list->bin_cmds, (size_t)total * sizeof(uint32_t));
+        if (!bins) return false;
+        list->bin_cmds = bins;
+        list->bin_capacity = total;
+    }
+
+    // Pass 2: fill, in issue order. bin_start is advanced as a cursor and
+    // shifted back afterwards
+    for (int i = 0; i < list->count; ++i) {
+        picasso_draw_bounds b = list->cmds[i].bounds;
+        for (int ty = b.y0 / PICASSO_TILE_SIZE; ty <= (b.y1 - 1) / PICASSO_TILE_SIZE; ++ty)
+            for (int tx = b.x0 / PICASSO_TILE_SIZE; tx <= (b.x1 - 1) / PICASSO_TILE_SIZE; ++tx)
+                list->bin_cmds[list->bin_start[ty * tiles_x + tx]++] = (uint32_t)i;
+    }
+    memmove(&list->bin_start[1], &list->bin_start[0], (size_t)tiles * sizeof(int));
+    list->bin_start[0] = 0;
+
+    return true;
+}
+
+/* Replays cmds[order[first .. last)] (or first .. last without an order) on
+ * target, clipped to area */
+static void picasso__replay_range(picasso_backbuffer *target, const picasso_cmd *cmds,
+        const uint32_t *order, int first, int last, picasso_draw_bounds area)
+{
+    for (int i = first; i < last; ++i) {
+        const picasso_cmd *cmd = &cmds[order ? order[i] : (uint32_t)i];
+        target->clip = picasso__intersect(area, cmd->bounds);
+        if (picasso__is_empty(target->clip)) continue;
+        target->blend = cmd->blend;
+        picasso__replay(target, cmd);
+    }
+}
+
+static void picasso__render_tiles(picasso_tile_job *job)
+{
+    struct picasso_cmdlist *list = job->list;
+    int tiles = job->tiles_x * job->tiles_y;
+
+    for (;;) {
+        int t = atomic_fetch_add_explicit(&job->next_tile, 1, memory_order_relaxed);
+        if (t >= tiles) break;
+
+        int first = list->bin_start[t];
+        int last = list->bin_start[t + 1];
+        if (first == last) continue;
+
+        // A private copy of the backbuffer that only sees this tile
+        int tx = (t % job->tiles_x) * PICASSO_TILE_SIZE;
+        int ty = (t / job->tiles_x) * PICASSO_TILE_SIZE;
+        picasso_draw_bounds tile_area = { tx, ty, tx + PICASSO_TILE_SIZE, ty + PICASSO_TILE_SIZE };
+        picasso_backbuffer tile = *job->bf;
+        tile.cmdlist = NULL;
+        tile.track_damage = false;
+
+        for (int r = 0; r < job->region.count; ++r) {
+            picasso_draw_bounds area = picasso__intersect(tile_area, job->region.rects[r]);
+            if (picasso__is_empty(area)) continue;
+            picasso__replay_range(&tile, list->cmds, list->bin_cmds, first, last, area);
+        }
+    }
+}
+
+// Every render thread takes tiles off the counter until there are none left
+static void picasso__tile_worker(int first, int last, void *arg)
+{
+    for (int i = first; i < last; ++i)
+        picasso__render_tiles(arg);
+}
+
+static int picasso__thread_count(void)
+{
+    int threads = get_job_threads();
+    return render_threads > 0 ? PICASSO_MIN(render_threads, threads) : threads;
+}
+
+void picasso_submit_commands(picasso_backbuffer *bf, int flags)
+{
+    if (!bf || !bf->pixels) return;
+    struct picasso_cmdlist *list = bf->cmdlist;
+
+    if (!list || !list->recording) {
+        WARN("picasso_submit_commands called without picasso_begin_commands");
+        return;
+    }
+    list->recording = false;
+    // Nothing is recorded until the replay is done, evicting is safe again
+    picasso__glyphs_unpin();
+
+    for (int i = 0; i < list->count; ++i)
+        if (list->cmds[i].type == PICASSO_CMD_MESH3D)
+            list->cmds[i].mesh3d.mvp = &list->matrices[list->cmds[i].mesh3d.matrix];
+
+    if (flags & PICASSO_SUBMIT_CULL)
+        picasso__cull_commands(bf, list);
+    if (list->count == 0) return;
+
+    // Where to draw: everything, or only what needs a redraw. A damaged
+    // submit doesn't add damage, it repairs what is already there
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    picasso_damage region = { .rects = { cb }, .count = 1 };
+    if (flags & PICASSO_SUBMIT_DAMAGED) {
+        region = picasso__redraw_region(bf);
+        for (int r = 0; r < region.count; ++r)
+            region.rects[r] = picasso__intersect(region.rects[r], cb);
+    } else if (bf->track_damage) {
+        for (int i = 0; i < list->count; ++i)
+            picasso__damage_add(&bf->damage, picasso__intersect(list->cmds[i].bounds, cb));
+    }
+    if (region.count == 0) return;
+
+    int tiles_x = ((int)bf->width + PICASSO_TILE_SIZE - 1) / PICASSO_TILE_SIZE;
+    int tiles_y = ((int)bf->height + PICASSO_TILE_SIZE - 1) / PICASSO_TILE_SIZE;
+    int threads = PICASSO_MIN(picasso__thread_count(), tiles_x * tiles_y);
+
+    bool tiled = (flags & PICASSO_SUBMIT_TILED) && threads > 1;
+    if (tiled && !picasso__bin_commands(list, tiles_x, tiles_y)) {
+        ERROR("Failed to allocate tile bins, submitting immediately");
+        tiled = false;
+    }
+
+    if (!tiled) {
+        picasso_backbuffer target = *bf;
+        target.cmdlist = NULL;
+        target.track_damage = false;
+        for (int r = 0; r < region.count; ++r)
+            picasso__replay_range(&target, list->cmds, NULL, 0, list->count, region.rects[r]);
+        return;
+    }
+
+    picasso_tile_job job = {
+        .bf = bf,
+        .list = list,
+        .region = region,
+        .tiles_x = tiles_x,
+        .tiles_y = tiles_y,
+    };
+    atomic_init(&job.next_tile, 0);
+
+    // The calling thread renders tiles too, as one of them
+    parallel_for(0, threads, 1, picasso__tile_worker, &job);
+
+    TRACE("Submitted %d commands over %dx%d tiles on %d threads",
+          list->count, tiles_x, tiles_y, threads);
+}
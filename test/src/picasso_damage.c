@@ -0,0 +1,155 @@
+#include <stdint.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Damage tracking. The damage of a backbuffer is a short list of disjoint
+ * rects in pixels. Disjoint matters: a redraw replays the frame once per rect,
+ * so overlapping rects would blend the overlap twice. When a new rect overlaps
+ * some of the list it swallows them into their bounding box, and when the list
+ * is full the two rects whose bounding box wastes the least area are merged.
+ * That keeps every operation a small constant, at the price of redrawing a
+ * bit more than strictly changed. */
+
+static inline bool picasso__overlaps(picasso_draw_bounds a, picasso_draw_bounds b)
+{
+    return a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+}
+
+static inline picasso_draw_bounds picasso__union(picasso_draw_bounds a, picasso_draw_bounds b)
+{
+    return (picasso_draw_bounds){
+        PICASSO_MIN(a.x0, b.x0), PICASSO_MIN(a.y0, b.y0),
+        PICASSO_MAX(a.x1, b.x1), PICASSO_MAX(a.y1, b.y1) };
+}
+
+static inline int64_t picasso__area(picasso_draw_bounds a)
+{
+    return (int64_t)(a.x1 - a.x0) * (a.y1 - a.y0);
+}
+
+void picasso__damage_add(picasso_damage *d, picasso_draw_bounds r)
+{
+    if (r.x0 >= r.x1 || r.y0 >= r.y1) return;
+
+    for (;;) {
+        // Swallow everything the rect overlaps. The bigger rect can reach new
+        // ones, so start over after every merge
+        for (int i = 0; i < d->count; ++i) {
+            picasso_draw_bounds *e = &d->rects[i];
+            if (!picasso__overlaps(*e, r)) continue;
+
+            // Already covered, the common case for a redrawn widget
+            if (e->x0 <= r.x0 && e->y0 <= r.y0 && e->x1 >= r.x1 && e->y1 >= r.y1)
+                return;
+
+            r = picasso__union(*e, r);
+            d->rects[i] = d->rects[--d->count];
+            i = -1;
+        }
+        if (d->count < PICASSO_MAX_DAMAGE) break;
+
+        // Full, so fold the rect into the one it wastes the least area with
+        int best = 0;
+        int64_t best_waste = INT64_MAX;
+        for (int i = 0; i < d->count; ++i) {
+            int64_t waste = picasso__area(picasso__union(d->rects[i], r))
+                          - picasso__area(d->rects[i]) - picasso__area(r);
+            if (waste < best_waste) { best_waste = waste; best = i; }
+        }
+        r = picasso__union(d->rects[best], r);
+        d->rects[best] = d->rects[--d->count];
+    }
+
+    d->rects[d->count++] = r;
+}
+
+void picasso__damage_cmd(picasso_backbuffer *bf, const picasso_cmd *cmd)
+{
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    picasso_draw_bounds b = picasso__cmd_bounds(bf, cmd);
+
+    picasso__damage_add(&bf->damage, (picasso_draw_bounds){
+        PICASSO_MAX(b.x0, cb.x0), PICASSO_MAX(b.y0, cb.y0),
+        PICASSO_MIN(b.x1, cb.x1), PICASSO_MIN(b.y1, cb.y1) });
+}
+
+picasso_damage picasso__redraw_region(const picasso_backbuffer *bf)
+{
+    picasso_damage region = bf->damage;
+    for (int i = 0; i < bf->prev_damage.count; ++i)
+        picasso__damage_add(&region, bf->prev_damage.rects[i]);
+    return region;
+}
+
+// --------------------------------------------------------
+// Public API
+// --------------------------------------------------------
+
+void picasso_damage_rect(picasso_backbuffer *bf, picasso_rect *r)
+{
+    if (!bf) return;
+
+    if (!r) {
+        picasso__damage_add(&bf->damage,
+                (picasso_draw_bounds){ 0, 0, (int)bf->width, (int)bf->height });
+        return;
+    }
+
+    picasso_rect px = {
+        .x = picasso__to_px_x(bf, r->x),
+        .y = picasso__to_px_y(bf, r->y),
+        .width = picasso__to_px_w(bf, r->width),
+        .height = picasso__to_px_h(bf, r->height),
+    };
+    picasso__normalize_rect(&px);
+
+    picasso_draw_bounds db;
+    if (picasso__clip_rect_to_bounds(bf, &px, &db))
+        picasso__damage_add(&bf->damage, db);
+}
+
+void picasso_clear_damage(picasso_backbuffer *bf)
+{
+    if (!bf || !bf->pixels) {
+        WARN("Attempted to clear damage of NULL backbuffer");
+        return;
+    }
+
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    picasso_damage region = picasso__redraw_region(bf);
+    uint32_t clear = color_to_u32(CLEAR_BACKGROUND);
+
+    for (int i = 0; i < region.count; ++i) {
+        picasso_draw_bounds r = region.rects[i];
+        int x0 = PICASSO_MAX(r.x0, cb.x0), x1 = PICASSO_MIN(r.x1, cb.x1);
+        for (int y = PICASSO_MAX(r.y0, cb.y0); y < PICASSO_MIN(r.y1, cb.y1); ++y)
+            if (x1 > x0) picasso__span_fill(picasso__get_pixel_u32(bf, x0, y), x1 - x0, clear);
+    }
+}
+
+void picasso_reset_damage(picasso_backbuffer *bf)
+{
+    if (!bf) return;
+    bf->damage.count = 0;
+    bf->prev_damage.count = 0;
+}
+
+void picasso_present_damage(Window *window, picasso_backbuffer *bf)
+{
+    if (!window || !bf) return;
+
+    canopy_rect rects[PICASSO_MAX_DAMAGE];
+    for (int i = 0; i < bf->damage.count; ++i) {
+        picasso_draw_bounds d = bf->damage.rects[i];
+        rects[i] = (canopy_rect){ d.x0, d.y0, d.x1 - d.x0, d.y1 - d.y0 };
+    }
+
+    swap_backbuffer(window, (framebuffer*)bf);
+    present_buffer_damage(window, rects, bf->damage.count);
+
+    // The buffer we got back is missing this frame's changes as well
+    bf->prev_damage = bf->damage;
+    bf->damage.count = 0;
+}
@@ -0,0 +1,806 @@
+#ifndef PICASSO_INTERNAL_H
+#define PICASSO_INTERNAL_H
+/* Shared internals for the Picasso translation units. Nothing in here is part
+ * of the public API in picasso.h, it just lets the rasterizers in different
+ * files share the same low level pieces.
+ * */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <blackbox.h>
+#include "picasso.h"
+#include "stb_truetype.h"
+
+/* -------------------- Geometry Helpers -------------------- */
+/* Here we are supporting negative width and height, drawing
+ * in all directions! */
+static inline void picasso__normalize_rect(picasso_rect *r)
+{
+    if(!r) {WARN("Tried to normalize a NULL object");return;}
+    if (r->width < 0) {
+        r->x += r->width;
+        r->width = -r->width;
+    }
+    if (r->height < 0) {
+        r->y += r->height;
+        r->height = -r->height;
+    }
+}
+
+/* The area primitives may touch, in pixels. This is the whole backbuffer,
+ * unless a clip is set (the tiled renderer sets one per tile). Every
+ * rasterizer clips against this and nothing else, which is what makes a tile
+ * come out exactly like the same region of an unclipped draw. */
+static inline picasso_draw_bounds picasso__clip_bounds(const picasso_backbuffer *bf)
+{
+    picasso_draw_bounds db = { 0, 0, (int)bf->width, (int)bf->height };
+    if (bf->clip.x1 <= bf->clip.x0 || bf->clip.y1 <= bf->clip.y0)
+        return db;
+
+    db.x0 = PICASSO_MAX(bf->clip.x0, 0);
+    db.y0 = PICASSO_MAX(bf->clip.y0, 0);
+    db.x1 = PICASSO_MIN(bf->clip.x1, (int)bf->width);
+    db.y1 = PICASSO_MIN(bf->clip.y1, (int)bf->height);
+    return db;
+}
+
+static inline bool picasso__in_clip(const picasso_draw_bounds *cb, int x, int y)
+{
+    return x >= cb->x0 && x < cb->x1 && y >= cb->y0 && y < cb->y1;
+}
+
+/* Creating the bounds for looping over, removing the logic from the draw
+ * functions */
+static inline bool picasso__clip_rect_to_bounds(picasso_backbuffer *bf,
+        const picasso_rect *r, picasso_draw_bounds *db)
+{
+    if (!r || r->width == 0 || r->height == 0)
+        return false;
+
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+
+    if (r->x >= cb.x1 || r->y >= cb.y1 ||
+        r->x + r->width <= cb.x0 || r->y + r->height <= cb.y0)
+        return false;
+
+    // Simple logic to force the rect inside the clip
+    db->x0 = PICASSO_MAX(r->x, cb.x0);
+    db->y0 = PICASSO_MAX(r->y, cb.y0);
+    db->x1 = PICASSO_MIN(r->x + r->width,  cb.x1);
+    db->y1 = PICASSO_MIN(r->y + r->height, cb.y1);
+
+    return true;
+}
+
+/* -------------------- HiDPI Scaling -------------------- */
+/* Scaling helpers for support of high dpi and points */
+static inline int picasso__to_px_x(const picasso_backbuffer *bf, int x)
+{
+    return (int)lroundf((float)x * bf->scale_x);
+}
+
+static inline int picasso__to_px_y(const picasso_backbuffer *bf, int y)
+{
+    return (int)lroundf((float)y * bf->scale_y);
+}
+
+static inline int picasso__to_px_w(const picasso_backbuffer *bf, int w)
+{
+    return (int)lroundf((float)w * bf->scale_x);
+}
+
+static inline int picasso__to_px_h(const picasso_backbuffer *bf, int h)
+{
+    return (int)lroundf((float)h * bf->scale_y);
+}
+
+static inline int picasso__to_px_uniform(const picasso_backbuffer *bf, int v)
+{
+    float s = (bf->scale_x + bf->scale_y) * 0.5f;
+    return (int)lroundf((float)v * s);
+}
+
+static inline float picasso__to_px_xf(const picasso_backbuffer *bf, float x)
+{
+    return x * bf->scale_x;
+}
+
+static inline float picasso__to_px_yf(const picasso_backbuffer *bf, float y)
+{
+    return y * bf->scale_y;
+}
+
+/* -------------------- Command Recording -------------------- */
+/* One recorded drawing call. The arguments are stored exactly as they were
+ * passed (logical coordinates), and replaying calls the same public function
+ * again, so a replay can never rasterize differently than the immediate
+ * call. bounds is the conservative pixel area the call may touch, it is what
+ * the tiled submit bins on. */
+typedef enum {
+    PICASSO_CMD_CLEAR,
+    PICASSO_CMD_FILL_RECT,
+    PICASSO_CMD_DRAW_RECT,
+    PICASSO_CMD_LINE,
+    PICASSO_CMD_LINE_AA,
+    PICASSO_CMD_LINE_THICK,
+    PICASSO_CMD_CIRCLE,
+    PICASSO_CMD_FILL_CIRCLE,
+    PICASSO_CMD_CIRCLE_AA,
+    PICASSO_CMD_FILL_CIRCLE_AA,
+    PICASSO_CMD_FILL_TRIANGLE,
+    PICASSO_CMD_BLIT,
+    PICASSO_CMD_BITMAP,
+    PICASSO_CMD_MESH,
+    PICASSO_CMD_CLEAR_DEPTH,
+    PICASSO_CMD_MESH3D,
+    PICASSO_CMD_FILL_PATH,
+    PICASSO_CMD_STROKE_PATH,
+    PICASSO_CMD_BEZIER,
+    PICASSO_CMD_SPRITES,
+    PICASSO_CMD_AFFINE,
+    PICASSO_CMD_TEXT,
+    PICASSO_CMD_TEXT_SDF,
+} picasso_cmd_type;
+
+typedef struct picasso_text_layout picasso_text_layout;
+
+typedef struct {
+    picasso_cmd_type type;
+    picasso_draw_bounds bounds; // filled in by picasso__record
+    picasso_blend_mode blend;   // the backbuffer's when recorded, also filled in
+    color c;
+    union {
+        struct { picasso_rect r; int thickness; } rect;
+        struct { int x0, y0, x1, y1, thickness; } line;
+        struct { float x0, y0, x1, y1; } line_f;
+        struct { int cx, cy, radius, thickness; } circle;
+        picasso_point3 tri;
+        struct { picasso_image *src; picasso_rect src_r, dst_r; picasso_filter filter; } blit;
+        struct { const uint8_t *mask; int w, h, stride, x, y; } bitmap;
+        struct {
+            const picasso_vertex *vertices;
+            const uint32_t *indices;
+            picasso_image *texture;
+            int vertex_count, index_count;
+        } mesh;
+        struct {
+            const picasso_mat4 *mvp;  // set on submit, matrix indexes the copy
+            const picasso_vertex3d *vertices;
+            const uint32_t *indices;
+            picasso_image *texture;
+            int vertex_count, index_count, flags, matrix;
+        } mesh3d;
+        struct { const picasso_path *path; picasso_fill_rule rule; } path;
+        struct { const picasso_path *path; picasso_stroke_style style; } stroke;
+        struct { picasso_vec2 p0, p1, p2; } bezier;
+        struct { const picasso_atlas *atlas; const picasso_sprite *sprites; int count; } sprites;
+        struct { picasso_image *src; picasso_affine m; picasso_filter filter; } affine;
+        struct { const picasso_font *font; const picasso_text_layout *layout; float x, y; } text;
+        struct {
+            const picasso_font *font;
+            const picasso_text_layout *layout;
+            float x, y;
+            picasso_text_effects effects;
+        } text_sdf;
+    };
+} picasso_cmd;
+
+struct picasso_cmdlist {
+    bool recording;
+    picasso_cmd *cmds;
+    int count, capacity;
+
+    // Copies of the 3D matrices, the caller's may be gone by the submit
+    picasso_mat4 *matrices;
+    int matrix_count, matrix_capacity;
+
+    // Tile bins, rebuilt on every tiled submit but kept allocated
+    uint32_t *bin_cmds;   // command indices, grouped by tile, in issue order
+    int *bin_start;       // tile t owns bin_cmds[bin_start[t] .. bin_start[t+1])
+    int bin_capacity, tile_capacity;
+};
+
+bool picasso__record(picasso_backbuffer *bf, const picasso_cmd *cmd);
+void picasso__free_cmdlist(struct picasso_cmdlist *list);
+// Pixels a command may touch, not clipped
+picasso_draw_bounds picasso__cmd_bounds(picasso_backbuffer *bf, const picasso_cmd *cmd);
+// Bounding box of all vertices of a mesh in pixels, the mesh's command bounds
+picasso_draw_bounds picasso__mesh_bounds(picasso_backbuffer *bf, const picasso_vertex *v, int count);
+// Bounding box of a path's points in pixels
+picasso_draw_bounds picasso__path_bounds(picasso_backbuffer *bf, const picasso_path *path);
+// Pixels the sprites cover, exactly
+picasso_draw_bounds picasso__sprite_bounds(picasso_backbuffer *bf, const picasso_atlas *atlas,
+                                           const picasso_sprite *sprites, int count);
+
+/* Damage rects are kept disjoint, a rect that overlaps others absorbs them */
+void picasso__damage_add(picasso_damage *d, picasso_draw_bounds r);
+// Unions the clipped bounds of a command drawn right now into bf->damage
+void picasso__damage_cmd(picasso_backbuffer *bf, const picasso_cmd *cmd);
+// This frame's damage plus the previous frame's, what a redraw has to cover
+picasso_damage picasso__redraw_region(const picasso_backbuffer *bf);
+
+/* Put at the top of a public drawing function. While recording, it stores the
+ * call and returns instead of drawing, otherwise the call is about to draw
+ * and its area is damaged */
+#define PICASSO_RECORD(bf, ...) do {                                \
+    if ((bf)->cmdlist && (bf)->cmdlist->recording) {                \
+        picasso__record((bf), &(picasso_cmd){ __VA_ARGS__ });       \
+        return;                                                     \
+    }                                                               \
+    if ((bf)->track_damage)                                         \
+        picasso__damage_cmd((bf), &(picasso_cmd){ __VA_ARGS__ });   \
+    } while (0)
+
+/* -------------------- Image Layouts -------------------- */
+/* How many of the n texels of a row from column x on are contiguous, all of
+ * them in a linear image and up to the end of the block in a tiled one. Rows
+ * are walked in runs of this many, each from picasso__col_offset of its start */
+static inline int picasso__row_run(const picasso_image *img, int x, int n)
+{
+    if (img->layout == PICASSO_LAYOUT_LINEAR) return n;
+    int run = 8 - (x & 7);
+    return run < n ? run : n;
+}
+
+/* -------------------- Parallel Rows -------------------- */
+/* Whole-image operations hand their rows to the job system in ranges of at
+ * least this many pixels. Anything smaller than a few ranges, like the tiles
+ * of a tiled submit, stays on the calling thread where it is cheaper */
+#define PICASSO_PARALLEL_PIXELS (64 * 1024)
+
+// fn over rows [0, rows) of a width pixel wide image, in parallel if it pays
+static inline void picasso__parallel_rows(int rows, int width, job_range_func fn, void *arg)
+{
+    if (rows <= 0) return;
+    if ((int64_t)rows * width < 4 * PICASSO_PARALLEL_PIXELS) {
+        fn(0, rows, arg);
+        return;
+    }
+    int grain = PICASSO_PARALLEL_PIXELS / (width > 0 ? width : 1);
+    parallel_for(0, rows, grain > 0 ? grain : 1, fn, arg);
+}
+
+/* -------------------- Mip Levels -------------------- */
+/* Level 0 is the image itself and level n + 1 the mip of level n. Goes down
+ * to *level, or as far as levels go, and sets *level to where it got. Missing
+ * levels are built on the way unless build is false, which is what replays on
+ * the render threads pass: recording the blit built them already */
+picasso_image *picasso__image_mip(picasso_image *img, int *level, bool build);
+
+// Levels to go down to shrink a src_w x src_h image to dst_w x dst_h
+static inline float picasso__mip_lambda(int src_w, int src_h, int dst_w, int dst_h)
+{
+    float rx = (float)src_w / (float)dst_w, ry = (float)src_h / (float)dst_h;
+    return log2f(rx > ry ? rx : ry);
+}
+
+// picasso_blit_ex, replayed with build_mips false
+void picasso__blit(picasso_backbuffer *dst, picasso_image *src, picasso_rect src_r,
+                   picasso_rect dst_r, picasso_filter filter, bool build_mips);
+// picasso_blit_affine, the same way
+void picasso__blit_affine(picasso_backbuffer *bf, picasso_image *src, const picasso_affine *m,
+                          picasso_filter filter, bool build_mips);
+// Pixels a transformed image may touch, its corners' bounding box
+picasso_draw_bounds picasso__affine_bounds(const picasso_backbuffer *bf, const picasso_image *src,
+                                           const picasso_affine *m);
+
+/* -------------------- Text -------------------- */
+typedef struct {
+    int index;       // in the font
+    int advance;     // font units
+} picasso_glyph_metrics;
+
+/* Kerning of the glyph pairs looked up so far, open addressing on
+ * first << 16 | second. Walking the kern and GPOS tables for a pair is slow,
+ * and the same few hundred pairs come up over and over */
+typedef struct {
+    uint32_t *pairs;  // UINT32_MAX is an empty slot
+    int16_t *kerns;   // font units
+    int count, capacity;
+} picasso_kern_cache;
+
+struct picasso_font {
+    stbtt_fontinfo info;
+    uint8_t *data;   // the font file, owned
+    uint32_t id;     // keys the glyph and layout caches, never reused
+    float size;      // pixel height, logical
+    bool kerning;    // has a kern or GPOS table
+    int ascent, descent, line_gap;        // font units
+    picasso_glyph_metrics latin1[256];    // the first 256 codepoints
+    picasso_kern_cache *kern;             // NULL without kerning
+};
+
+// Where the layout puts a glyph, relative to the pen at the start of the text
+typedef struct {
+    uint32_t codepoint;
+    float x;         // pixels from the left
+    int line;
+} picasso_laid_glyph;
+
+/* Text laid out at a pixel size and wrap width: decoded, kerned and broken
+ * into lines. Kept in a layout cache keyed by the bytes of the string, so a
+ * string drawn again unchanged isn't laid out again */
+struct picasso_text_layout {
+    uint32_t hash, font;              // key, with the text, size and wrap
+    float size, wrap;                 // pixels, wrap 0 for none
+    char *text;
+    size_t length;
+
+    float scale;                      // font units to pixels
+    float line;                       // baseline to baseline, pixels
+    picasso_laid_glyph *glyphs;       // newlines left out
+    int count, lines;
+    float width;                      // of the longest line, pixels
+
+    uint64_t used;                    // tick it was last drawn at
+    struct picasso_text_layout *next;           // in the bucket
+    struct picasso_text_layout *older, *newer;  // least recently used first
+};
+
+// Decodes the codepoint at *s and moves past it. Malformed bytes are U+FFFD
+static inline uint32_t picasso__utf8_next(const char **s)
+{
+    const uint8_t *p = (const uint8_t *)*s;
+    uint32_t c = p[0];
+    int len = c < 0x80 ? 1 : c < 0xC2 ? 0 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : c < 0xF5 ? 4 : 0;
+    if (len <= 1) {
+        *s += 1;
+        return len ? c : 0xFFFD;
+    }
+
+    c &= 0x3Fu >> (len - 1);
+    for (int i = 1; i < len; ++i) {
+        // A missing continuation byte (the terminator too) ends it early
+        if ((p[i] & 0xC0) != 0x80) {
+            *s += i;
+            return 0xFFFD;
+        }
+        c = c << 6 | (p[i] & 0x3F);
+    }
+    *s += len;
+
+    // Overlong forms, surrogates and past the last codepoint
+    if ((len == 3 && (c < 0x800 || (c >= 0xD800 && c < 0xE000))) ||
+        (len == 4 && (c < 0x10000 || c > 0x10FFFF)))
+        return 0xFFFD;
+    return c;
+}
+
+/* Draws laid out text. Missing glyphs are rasterized into the cache first
+ * when prepare is set, replays pass false and only look them up */
+void picasso__draw_text(picasso_backbuffer *bf, const picasso_font *font,
+                        const picasso_text_layout *layout, float x, float y, color c, bool prepare);
+// Pixels the cached glyphs of the text cover
+picasso_draw_bounds picasso__text_bounds(const picasso_backbuffer *bf, const picasso_font *font,
+                                         const picasso_text_layout *layout, float x, float y);
+// The same for distance field text, effects may be NULL
+void picasso__draw_text_sdf(picasso_backbuffer *bf, const picasso_font *font,
+                            const picasso_text_layout *layout, float x, float y, color c,
+                            const picasso_text_effects *effects, bool prepare);
+picasso_draw_bounds picasso__text_sdf_bounds(const picasso_backbuffer *bf, const picasso_font *font,
+                                             const picasso_text_layout *layout, float x, float y,
+                                             color c, const picasso_text_effects *effects);
+// Lets go of the glyphs recorded text is using, submitting replays them
+void picasso__glyphs_unpin(void);
+
+/* -------------------- Span Compositing -------------------- */
+/* Every primitive ends up as horizontal runs of pixels (spans) in one row of
+ * the backbuffer. Blending happens here, a whole span at a time, so the SIMD
+ * kernels see as many pixels as possible per call.
+ *
+ * Backbuffer pixels are premultiplied: color is already times alpha. Where
+ * everything is opaque that changes nothing, and it is what the presenters
+ * take. Solid colors (color_to_u32) are passed straight and premultiplied
+ * once by the kernel. Rows of pixels passed to span_blend are premultiplied
+ * already.
+ *
+ * The fill, blend and mask kernels are source-over and give exactly the same
+ * result as picasso__over() below, the other blend modes have their own
+ * kernels further down. The _scalar versions are the reference
+ * implementation, and are always compiled so the vector paths can be
+ * validated against them. Build with -DPICASSO_NO_SIMD to use them for
+ * everything. */
+
+// Exact floor(x / 255) for 0 <= x <= 255*255, without the divide
+#define PICASSO_DIV255(x) (((x) + 1 + ((x) >> 8)) >> 8)
+
+// x * y / 255 rounded to nearest, exact for 0 <= x, y <= 255
+static inline uint32_t picasso__mul255(uint32_t x, uint32_t y)
+{
+    uint32_t t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline uint32_t picasso__premultiply(uint32_t p)
+{
+    uint32_t a = p >> 24;
+    if (a == 255) return p;
+    if (a == 0)   return 0;
+    return picasso__mul255((p >>  0) & 0xFF, a)         |
+           picasso__mul255((p >>  8) & 0xFF, a) <<  8   |
+           picasso__mul255((p >> 16) & 0xFF, a) << 16   | (a << 24);
+}
+
+// Rounded back to straight alpha, colors above their alpha saturate
+static inline uint32_t picasso__unpremultiply(uint32_t p)
+{
+    uint32_t a = p >> 24;
+    if (a == 255) return p;
+    if (a == 0)   return 0;
+    uint32_t out = a << 24;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t c = (((p >> shift) & 0xFF) * 255 + a / 2) / a;
+        out |= (c > 255 ? 255 : c) << shift;
+    }
+    return out;
+}
+
+/* A premultiplied pixel over another, the same multiply-add for every
+ * channel. Saturates like the SIMD packs do */
+static inline uint32_t picasso__over(uint32_t dst, uint32_t src)
+{
+    uint32_t sa = src >> 24;
+    if (sa == 255) return src;
+    if (sa == 0)   return dst;
+
+    uint32_t inv = 255 - sa, out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t c = ((src >> shift) & 0xFF) + picasso__mul255((dst >> shift) & 0xFF, inv);
+        out |= (c > 255 ? 255 : c) << shift;
+    }
+    return out;
+}
+
+// Channel by channel product of two pixels, for tinting texels
+static inline uint32_t picasso__modulate(uint32_t a, uint32_t b)
+{
+    return PICASSO_DIV255(((a >>  0) & 0xFF) * ((b >>  0) & 0xFF))         |
+           PICASSO_DIV255(((a >>  8) & 0xFF) * ((b >>  8) & 0xFF)) <<  8   |
+           PICASSO_DIV255(((a >> 16) & 0xFF) * ((b >> 16) & 0xFF)) << 16   |
+           PICASSO_DIV255(((a >> 24)       ) * ((b >> 24)       )) << 24;
+}
+
+/* A texel tinted by a straight color, premultiplied. A premultiplied texel is
+ * tinted by the premultiplied color, which is the same thing */
+static inline uint32_t picasso__tint_texel(const picasso_image *tex, uint32_t texel, uint32_t c)
+{
+    return tex->premultiplied ? picasso__modulate(texel, picasso__premultiply(c))
+                              : picasso__premultiply(picasso__modulate(texel, c));
+}
+
+/* Blends one straight alpha color over the backbuffer. For single pixels
+ * (line and AA plots), everything else should go through the span kernels. */
+static inline uint32_t picasso__blend_pixel(uint32_t dst, uint32_t src)
+{
+    return picasso__over(dst, picasso__premultiply(src));
+}
+
+// Solid color over a span of n pixels
+void picasso__span_fill(uint32_t *dst, int n, uint32_t src);
+// A row of premultiplied RGBA pixels (same layout as the backbuffer) over a span
+void picasso__span_blend(uint32_t *dst, const uint32_t *src, int n);
+// A8 coverage times a solid color over a span
+void picasso__span_mask(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src);
+
+/* Bilinear samples of two RGBA rows, written to dst (not blended). Pixel i
+ * mixes row[x[i]] and row[x[i] + 1] by fx[i], then row0 and row1 by fy, both
+ * weights out of 256 for the second one */
+void picasso__span_bilinear(uint32_t *dst, const uint32_t *row0, const uint32_t *row1,
+                            const int32_t *x, const uint16_t *fx, int n, uint32_t fy);
+
+// Packed 3 byte RGB to opaque backbuffer pixels, for the many 24 bit images
+void picasso__span_rgb_to_rgba(uint32_t *dst, const uint8_t *src, int n);
+// Straight alpha pixels to premultiplied, in place
+void picasso__span_premultiply(uint32_t *px, int n);
+// Every pixel times a constant one channel by channel (picasso__modulate), in place
+void picasso__span_modulate(uint32_t *px, int n, uint32_t c);
+// 2x2 box filter: pixel i is the rounded average of pixels 2i and 2i + 1 of
+// both rows, which hold 2n pixels. Builds mip levels
+void picasso__span_downsample(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int n);
+/* Distances to coverage along a linear ramp: (dist - edge) * slope, clamped
+ * to 0..255 and rounded. Draws distance field glyphs, where the distances
+ * are samples of the field with 4 bits of fraction */
+void picasso__span_distance(uint8_t *coverage, const uint16_t *dist, int n, float edge, float slope);
+
+void picasso__span_fill_scalar(uint32_t *dst, int n, uint32_t src);
+void picasso__span_blend_scalar(uint32_t *dst, const uint32_t *src, int n);
+void picasso__span_mask_scalar(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src);
+void picasso__span_bilinear_scalar(uint32_t *dst, const uint32_t *row0, const uint32_t *row1,
+                                   const int32_t *x, const uint16_t *fx, int n, uint32_t fy);
+void picasso__span_rgb_to_rgba_scalar(uint32_t *dst, const uint8_t *src, int n);
+void picasso__span_premultiply_scalar(uint32_t *px, int n);
+void picasso__span_modulate_scalar(uint32_t *px, int n, uint32_t c);
+void picasso__span_downsample_scalar(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int n);
+void picasso__span_distance_scalar(uint8_t *coverage, const uint16_t *dist, int n, float edge,
+                                   float slope);
+
+// Name of the compiled kernel set, "avx2", "sse2", "neon" or "scalar"
+const char *picasso__span_backend(void);
+
+/* Puts a row of premultiplied pixels into the backbuffer, with the signature
+ * of span_blend. Copying is what blending does with opaque rows, and the alpha
+ * test with rows whose alpha is only 0 or 255 */
+typedef void (*picasso_write_fn)(uint32_t *dst, const uint32_t *row, int n);
+
+static inline void picasso__write_copy(uint32_t *dst, const uint32_t *row, int n)
+{
+    memcpy(dst, row, (size_t)n * sizeof(uint32_t));
+}
+
+static inline void picasso__write_test(uint32_t *dst, const uint32_t *row, int n)
+{
+    for (int i = 0; i < n; ++i)
+        if (row[i] >> 24) dst[i] = row[i];
+}
+
+// Rasterizers that build a row of coverage or colors first do it in chunks
+// of this many pixels, so the scratch buffer can live on the stack
+#define PICASSO_SPAN_CHUNK 256
+
+/* -------------------- Blend Modes -------------------- */
+/* Premultiplied src combined with dst by any blend mode, one kernel per mode.
+ * Coverage (NULL is all 255) mixes the result with what dst was, so pixels a
+ * primitive only partly covers only partly change. For source-over that is
+ * close to, but not exactly, scaling the source alpha like span_mask does */
+void picasso__span_composite(uint32_t *dst, const uint32_t *src, const uint8_t *coverage,
+                             int n, picasso_blend_mode mode);
+void picasso__span_composite_scalar(uint32_t *dst, const uint32_t *src, const uint8_t *coverage,
+                                    int n, picasso_blend_mode mode);
+
+/* The span kernels of one blend mode, with the signatures of the source-over
+ * ones (which is what the SRC_OVER entry holds). Rasterizers look the set up
+ * once per primitive or span, never per pixel */
+typedef struct {
+    void (*fill)(uint32_t *dst, int n, uint32_t src);
+    void (*blend)(uint32_t *dst, const uint32_t *src, int n);
+    void (*mask)(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src);
+} picasso_blend_kernels;
+
+extern const picasso_blend_kernels picasso__blend_kernels[PICASSO_BLEND_COUNT];
+
+// The kernels of the backbuffer's blend mode, source-over for anything invalid
+static inline const picasso_blend_kernels *picasso__kernels(const picasso_backbuffer *bf)
+{
+    unsigned mode = (unsigned)bf->blend;
+    return &picasso__blend_kernels[mode < PICASSO_BLEND_COUNT ? mode : PICASSO_BLEND_SRC_OVER];
+}
+
+/* One straight alpha color into one pixel with the backbuffer's blend mode.
+ * For single pixels (line plots), everything else should go through the span
+ * kernels */
+static inline void picasso__plot(picasso_backbuffer *bf, uint32_t *dst, uint32_t src)
+{
+    if (bf->blend == PICASSO_BLEND_SRC_OVER) *dst = picasso__blend_pixel(*dst, src);
+    else picasso__kernels(bf)->fill(dst, 1, src);
+}
+
+/* Convenience for the rasterizers: draws [x0, x1) of row y with the
+ * backbuffer's blend mode. No clipping. */
+static inline void picasso__fill_span(picasso_backbuffer *bf, int y, int x0, int x1, uint32_t src)
+{
+    if (x1 > x0) picasso__kernels(bf)->fill(&bf->pixels[y * bf->width + x0], x1 - x0, src);
+}
+
+/* An A8 coverage mask times a solid color, its top left corner at pixel x, y.
+ * Clipped once, then a row at a time through the mask kernel of the
+ * backbuffer's blend mode. Not recorded, see picasso_draw_mask */
+void picasso__draw_mask(picasso_backbuffer *bf, const uint8_t *mask, int w, int h, int stride,
+                        int x, int y, uint32_t src);
+
+/* -------------------- Color Conversion -------------------- */
+/* Row kernels of picasso_color.c, over n pixels of planar 8 bit components.
+ * Every YCbCr conversion, both ways, and luma is a weighted sum of three
+ * planes with weights out of 1 << PICASSO_COLOR_SHIFT:
+ *      out = clamp((k[0] * a + k[1] * b + k[2] * c + bias) >> PICASSO_COLOR_SHIFT)
+ * The bias holds the offsets and the rounding. Weights fit 16 bits, and the
+ * sums 32 */
+#define PICASSO_COLOR_SHIFT 13
+
+typedef struct {
+    int16_t k[3];
+    int32_t bias;
+} picasso_color_weights;
+
+// Y, Cb and Cr from R, G and B, and R, G and B from Y, Cb and Cr, per space
+extern const picasso_color_weights picasso__ycbcr_weights[4][3];
+extern const picasso_color_weights picasso__rgb_weights[4][3];
+
+// picasso_copy's gray, the Y of full range BT.601
+static inline uint8_t picasso__luma(uint32_t r, uint32_t g, uint32_t b)
+{
+    const picasso_color_weights *w = &picasso__ycbcr_weights[PICASSO_YCBCR_BT601][0];
+    int32_t y = (w->k[0] * (int32_t)r + w->k[1] * (int32_t)g + w->k[2] * (int32_t)b + w->bias)
+                >> PICASSO_COLOR_SHIFT;
+    return (uint8_t)PICASSO_CLAMP(y, 0, 255);
+}
+
+void picasso__color_dot3(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *c,
+                         int n, const picasso_color_weights *w);
+/* 8 bit HSV, hue all the way round in 0-255. Divisions are single precision
+ * and rounded to nearest, the same in every kernel */
+void picasso__color_rgb_to_hsv(uint8_t *h, uint8_t *s, uint8_t *v, const uint8_t *r,
+                               const uint8_t *g, const uint8_t *b, int n);
+void picasso__color_hsv_to_rgb(uint8_t *r, uint8_t *g, uint8_t *b, const uint8_t *h,
+                               const uint8_t *s, const uint8_t *v, int n);
+// Packed pixels of 1 to 4 channels to a plane per channel and back
+void picasso__color_split(uint8_t *const *planes, const uint8_t *packed, int channels, int n);
+void picasso__color_merge(uint8_t *packed, int channels, const uint8_t *const *planes, int n);
+// Y of n packed RGB(A) pixels, through the kernels above a chunk at a time
+void picasso__color_luma_row(uint8_t *dst, const uint8_t *packed, int channels, int n,
+                             picasso_ycbcr space);
+
+void picasso__color_dot3_scalar(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *c,
+                                int n, const picasso_color_weights *w);
+void picasso__color_rgb_to_hsv_scalar(uint8_t *h, uint8_t *s, uint8_t *v, const uint8_t *r,
+                                      const uint8_t *g, const uint8_t *b, int n);
+void picasso__color_hsv_to_rgb_scalar(uint8_t *r, uint8_t *g, uint8_t *b, const uint8_t *h,
+                                      const uint8_t *s, const uint8_t *v, int n);
+void picasso__color_split_scalar(uint8_t *const *planes, const uint8_t *packed, int channels, int n);
+void picasso__color_merge_scalar(uint8_t *packed, int channels, const uint8_t *const *planes, int n);
+
+/* -------------------- Triangle Setup -------------------- */
+// Triangles are rasterized with vertices snapped to 1/16 of a pixel. Vertices
+// further out than the limit (in pixels) keep the edge math inside 64 bits
+#define PICASSO_SUBPIXEL_SCALE 16
+#define PICASSO_SUBPIXEL_LIMIT (float)(1 << 24)
+
+// Pixels to subpixels, false when the vertex is beyond the limit
+static inline bool picasso__to_subpixel(float x, float y, int64_t *sx, int64_t *sy)
+{
+    // fabsf is false for NaN, so the negated test rejects those as well
+    if (!(fabsf(x) <= PICASSO_SUBPIXEL_LIMIT && fabsf(y) <= PICASSO_SUBPIXEL_LIMIT))
+        return false;
+    *sx = llroundf(x * PICASSO_SUBPIXEL_SCALE);
+    *sy = llroundf(y * PICASSO_SUBPIXEL_SCALE);
+    return true;
+}
+
+/* Edge function of the directed edge a->b, E(p) = A*p.x + B*p.y + C, in
+ * subpixel units. It is zero on the edge and positive on its inner side */
+typedef struct {
+    int64_t A, B, C;
+} picasso_edge;
+
+static inline picasso_edge picasso__make_edge(int64_t ax, int64_t ay, int64_t bx, int64_t by)
+{
+    return (picasso_edge){ ay - by, bx - ax, ax * by - ay * bx };
+}
+
+/* Top-left fill rule: a pixel center exactly on an edge only belongs to the
+ * triangle if the edge is a top or a left edge. Two triangles sharing an edge
+ * then own every pixel on it exactly once, no gaps and no double blending */
+static inline bool picasso__is_top_left(picasso_edge e)
+{
+    return e.A < 0 || (e.A == 0 && e.B > 0);
+}
+
+// Floor and ceil of n / d for d > 0, rounding the right way for negative n
+static inline int64_t picasso__floor_div(int64_t n, int64_t d)
+{
+    return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+static inline int64_t picasso__ceil_div(int64_t n, int64_t d)
+{
+    return -picasso__floor_div(-n, d);
+}
+
+/* A triangle set up for rasterizing: its three edge functions at the center
+ * of pixel (0, y) of the current row, and how they step per pixel and per
+ * row. Every triangle rasterizer shares this, so they all follow the same
+ * fill rule and a mesh covers exactly what separate triangles would */
+typedef struct {
+    int y0, y1; // rows to rasterize, already clipped
+    int64_t row[3], step_x[3], step_y[3];
+} picasso_tri_setup;
+
+// Vertices in subpixels, either winding. False if no row is left after clipping
+bool picasso__setup_triangle(picasso_tri_setup *t, const int64_t vx[3],
+                             const int64_t vy[3], picasso_draw_bounds cb);
+
+/* Attributes that vary over a triangle are planes: the value at the center of
+ * pixel (x, y) is base + dx * x + dy * y. They are fit through the snapped
+ * vertices, so they agree with the coverage */
+typedef struct {
+    float base, dx, dy;
+} picasso_plane;
+
+typedef struct {
+    float x0, y0, e1x, e1y, e2x, e2y, inv_area;
+} picasso_plane_setup;
+
+// Vertices in subpixels, the same the triangle was set up with
+static inline picasso_plane_setup picasso__plane_setup(const int64_t vx[3], const int64_t vy[3])
+{
+    const float s = (float)PICASSO_SUBPIXEL_SCALE;
+    picasso_plane_setup p = {
+        .x0 = (float)vx[0] / s, .y0 = (float)vy[0] / s,
+        .e1x = (float)(vx[1] - vx[0]) / s, .e1y = (float)(vy[1] - vy[0]) / s,
+        .e2x = (float)(vx[2] - vx[0]) / s, .e2y = (float)(vy[2] - vy[0]) / s,
+    };
+    p.inv_area = 1.0f / (p.e1x * p.e2y - p.e2x * p.e1y);
+    return p;
+}
+
+// The plane through a0, a1, a2 at the three vertices
+static inline picasso_plane picasso__make_plane(const picasso_plane_setup *p,
+                                                float a0, float a1, float a2)
+{
+    float d1 = a1 - a0, d2 = a2 - a0;
+    float dx = (d1 * p->e2y - d2 * p->e1y) * p->inv_area;
+    float dy = (d2 * p->e1x - d1 * p->e2x) * p->inv_area;
+    return (picasso_plane){ a0 + dx * (0.5f - p->x0) + dy * (0.5f - p->y0), dx, dy };
+}
+
+/* The inside of the current row, [*x0, *x1) clipped to cb, and steps to the
+ * next row. Call it once for every row from y0 to y1. Since the edges are
+ * linear along a row, the span is solved for directly: row + step_x * x >= 0
+ * for all three edges */
+static inline bool picasso__triangle_span(picasso_tri_setup *t, picasso_draw_bounds cb,
+                                          int *x0, int *x1)
+{
+    int64_t lo = cb.x0, hi = cb.x1 - 1;
+    for (int i = 0; i < 3; ++i) {
+        if (t->step_x[i] > 0)      lo = PICASSO_MAX(lo, picasso__ceil_div(-t->row[i], t->step_x[i]));
+        else if (t->step_x[i] < 0) hi = PICASSO_MIN(hi, picasso__floor_div(t->row[i], -t->step_x[i]));
+        else if (t->row[i] < 0)    hi = lo - 1; // parallel to the row and outside
+
+        t->row[i] += t->step_y[i];
+    }
+    *x0 = (int)lo;
+    *x1 = (int)hi + 1;
+    return lo <= hi;
+}
+
+/* -------------------- Outline Rasterizer -------------------- */
+/* Shapes made of straight lines in pixels, filled with exact area coverage.
+ * Paths are flattened into one, anything else that produces outlines can
+ * build one directly and share the same fill */
+typedef struct {
+    float x0, y0, x1, y1;  // y0 < y1, horizontal lines are never stored
+    float dxdy;
+    int dir;               // +1 if the line went down, -1 if it went up
+} picasso_segment;
+
+typedef struct {
+    picasso_segment *segs;
+    int count, capacity;
+    float x0, y0, x1, y1;  // bounds of the segments
+    bool failed;           // out of memory, the outline is incomplete
+} picasso_outline;
+
+void picasso__outline_add(picasso_outline *o, float x0, float y0, float x1, float y1);
+void picasso__outline_free(picasso_outline *o);
+/* Walks a path scaled to pixels with the curves flattened into lines. A MOVE
+ * starts a contour, LINE continues it, and CLOSE (at the start point) closes
+ * it. Open contours just end at the next MOVE or the end of the path */
+typedef void (*picasso_flatten_fn)(void *ctx, picasso_path_verb verb, float x, float y);
+void picasso__flatten_path(const picasso_path *path, float scale_x, float scale_y,
+                           picasso_flatten_fn emit, void *ctx);
+// Appends the path scaled to pixels, every contour closed, for filling
+void picasso__path_outline(const picasso_path *path, float scale_x, float scale_y,
+                           picasso_outline *o);
+// Fills within the clip, sorts the segments in place
+void picasso__fill_outline(picasso_backbuffer *bf, picasso_outline *o,
+                           picasso_fill_rule rule, color c);
+
+/* Strokes a path scaled to pixels and fills the outline. The primitives that
+ * are strokes underneath (thick lines, draw_bezier) build a small path in
+ * pixels and pass a scale of 1 */
+void picasso__stroke(picasso_backbuffer *bf, const picasso_path *path, float scale_x,
+                     float scale_y, float half_width, const picasso_stroke_style *style,
+                     color c);
+// How far past the path's points a stroke may reach, in pixels
+float picasso__stroke_margin(float half_width, const picasso_stroke_style *style);
+
+// floor(sqrt(v)) for v >= 0, -1 for negative v. Exact, for span extents
+static inline int picasso__isqrt(int64_t v)
+{
+    if (v < 0) return -1;
+    int64_t r = (int64_t)sqrt((double)v);
+    while (r * r > v) --r;
+    while ((r + 1) * (r + 1) <= v) ++r;
+    return (int)r;
+}
+
+#endif // PICASSO_INTERNAL_H
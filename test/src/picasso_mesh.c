@@ -0,0 +1,283 @@
+#include <stdint.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Indexed triangle meshes with vertex colors and texture coordinates.
+ *
+ * A draw goes through three passes. Every vertex is set up once, no matter
+ * how many triangles share it: snapped to subpixels, its attributes converted
+ * to what the inner loop wants, and classified against the clip. Then the
+ * triangles are culled, dropping bad indices, degenerate triangles and
+ * triangles with all three vertices beyond the same side of the clip, so the
+ * raster pass only sees triangles that can draw something.
+ *
+ * The raster pass uses the same edge setup as picasso_fill_triangle(), one
+ * span per row. Attributes are planes over the triangle, evaluated once at the
+ * start of a span and then stepped per pixel in 16.16 fixed point. Texture
+ * coordinates are affine, there is no depth to correct for. */
+
+// Attribute planes per triangle: r, g, b, a, then u, v in texels
+#define PICASSO_MESH_ATTRS 6
+#define PICASSO_MESH_FIXED 16
+
+// Which sides of the clip a vertex is beyond, OUT_OF_RANGE can't be drawn
+enum {
+    PICASSO_OUT_LEFT   = 1 << 0,
+    PICASSO_OUT_RIGHT  = 1 << 1,
+    PICASSO_OUT_TOP    = 1 << 2,
+    PICASSO_OUT_BOTTOM = 1 << 3,
+    PICASSO_OUT_OF_RANGE = 1 << 4,
+};
+
+typedef struct {
+    int64_t sx, sy;                  // subpixels
+    float attr[PICASSO_MESH_ATTRS];
+    uint32_t c;                      // the color packed, for the flat check
+    uint32_t outcode;
+} picasso_mesh_vertex;
+
+picasso_draw_bounds picasso__mesh_bounds(picasso_backbuffer *bf, const picasso_vertex *v, int count)
+{
+    if (!v || count <= 0) return (picasso_draw_bounds){0};
+
+    const float limit = PICASSO_SUBPIXEL_LIMIT;
+    float x0 = limit, y0 = limit, x1 = -limit, y1 = -limit;
+    for (int i = 0; i < count; ++i) {
+        x0 = fminf(x0, v[i].x);
+        y0 = fminf(y0, v[i].y);
+        x1 = fmaxf(x1, v[i].x);
+        y1 = fmaxf(y1, v[i].y);
+    }
+    x0 = PICASSO_CLAMP(picasso__to_px_xf(bf, x0), -limit, limit);
+    y0 = PICASSO_CLAMP(picasso__to_px_yf(bf, y0), -limit, limit);
+    x1 = PICASSO_CLAMP(picasso__to_px_xf(bf, x1), -limit, limit);
+    y1 = PICASSO_CLAMP(picasso__to_px_yf(bf, y1), -limit, limit);
+
+    // Vertices are subpixel, pad like a single triangle
+    return (picasso_draw_bounds){
+        (int)floorf(x0) - 1, (int)floorf(y0) - 1,
+        (int)ceilf(x1) + 2, (int)ceilf(y1) + 2 };
+}
+
+// --------------------------------------------------------
+// Vertex setup and culling
+// --------------------------------------------------------
+
+static void picasso__setup_vertices(picasso_backbuffer *bf, picasso_draw_bounds cb,
+                                    const picasso_vertex *in, int count,
+                                    const picasso_image *tex, picasso_mesh_vertex *out)
+{
+    const int64_t s = PICASSO_SUBPIXEL_SCALE;
+    float tw = tex ? (float)tex->width : 0.0f;
+    float th = tex ? (float)tex->height : 0.0f;
+
+    for (int i = 0; i < count; ++i) {
+        picasso_mesh_vertex *v = &out[i];
+        if (!picasso__to_subpixel(picasso__to_px_xf(bf, in[i].x),
+                                  picasso__to_px_yf(bf, in[i].y), &v->sx, &v->sy)) {
+            v->outcode = PICASSO_OUT_OF_RANGE;
+            continue;
+        }
+
+        v->outcode = (v->sx < cb.x0 * s ? PICASSO_OUT_LEFT   : 0) |
+                     (v->sx > cb.x1 * s ? PICASSO_OUT_RIGHT  : 0) |
+                     (v->sy < cb.y0 * s ? PICASSO_OUT_TOP    : 0) |
+                     (v->sy > cb.y1 * s ? PICASSO_OUT_BOTTOM : 0);
+
+        v->attr[0] = in[i].c.r;
+        v->attr[1] = in[i].c.g;
+        v->attr[2] = in[i].c.b;
+        v->attr[3] = in[i].c.a;
+        v->attr[4] = in[i].u * tw;
+        v->attr[5] = in[i].v * th;
+        v->c = color_to_u32(in[i].c);
+    }
+}
+
+/* Writes the triangles worth rasterizing to visible, as indices of their
+ * first index, and returns how many there are */
+static int picasso__cull_triangles(const picasso_mesh_vertex *v, int vertex_count,
+                                   const uint32_t *indices, int triangle_count,
+                                   uint32_t *visible)
+{
+    int n = 0;
+    for (int t = 0; t < triangle_count; ++t) {
+        uint32_t first = (uint32_t)t * 3;
+        uint32_t i0 = indices ? indices[first + 0] : first + 0;
+        uint32_t i1 = indices ? indices[first + 1] : first + 1;
+        uint32_t i2 = indices ? indices[first + 2] : first + 2;
+        if (i0 >= (uint32_t)vertex_count || i1 >= (uint32_t)vertex_count ||
+            i2 >= (uint32_t)vertex_count) {
+            TRACE("Mesh triangle %d has an index out of range, skipping", t);
+            continue;
+        }
+
+        const picasso_mesh_vertex *a = &v[i0], *b = &v[i1], *c = &v[i2];
+        if ((a->outcode | b->outcode | c->outcode) & PICASSO_OUT_OF_RANGE) continue;
+        // All three beyond the same side of the clip
+        if (a->outcode & b->outcode & c->outcode) continue;
+        // Zero area, it covers no pixel centers
+        if ((b->sx - a->sx) * (c->sy - a->sy) == (b->sy - a->sy) * (c->sx - a->sx)) continue;
+
+        visible[n++] = first;
+    }
+    return n;
+}
+
+// --------------------------------------------------------
+// Rasterizing
+// --------------------------------------------------------
+
+// Truncates, a 1/65536 bias is invisible and a cast beats llroundf per span
+static inline int64_t picasso__to_fixed(float v)
+{
+    return (int64_t)(v * (float)(1 << PICASSO_MESH_FIXED));
+}
+
+static inline uint32_t picasso__fixed_channel(int64_t v)
+{
+    v = PICASSO_CLAMP(v, (int64_t)0, (int64_t)255 << PICASSO_MESH_FIXED);
+    return (uint32_t)((v + (1 << (PICASSO_MESH_FIXED - 1))) >> PICASSO_MESH_FIXED);
+}
+
+static inline int picasso__fixed_texel(int64_t v, int max)
+{
+    return v < 0 ? 0 : (int)PICASSO_MIN(v >> PICASSO_MESH_FIXED, (int64_t)max);
+}
+
+// Interpolated colors for n pixels, a[0..3] stepped past them
+static inline void picasso__gouraud_span(uint32_t *row, int n, int64_t a[4], const int64_t step[4])
+{
+    int64_t r = a[0], g = a[1], b = a[2], al = a[3];
+    for (int i = 0; i < n; ++i) {
+        row[i] = picasso__fixed_channel(r)         | picasso__fixed_channel(g) << 8 |
+                 picasso__fixed_channel(b) << 16   | picasso__fixed_channel(al) << 24;
+        r += step[0]; g += step[1]; b += step[2]; al += step[3];
+    }
+    a[0] = r; a[1] = g; a[2] = b; a[3] = al;
+}
+
+// Nearest texels clamped to the edge, tinted by the colors already in row,
+// premultiplied for the blend kernels
+static inline void picasso__texture_span(uint32_t *row, int n, picasso_image *tex,
+                                         int64_t uv[2], const int64_t step[2], bool tint)
+{
+    int u_max = tex->width - 1, v_max = tex->height - 1;
+    for (int i = 0; i < n; ++i) {
+        int tx = picasso__fixed_texel(uv[0], u_max);
+        int ty = picasso__fixed_texel(uv[1], v_max);
+        uv[0] += step[0];
+        uv[1] += step[1];
+
+        const uint8_t *q = &tex->pixels[picasso__row_offset(tex, ty) + picasso__col_offset(tex, tx)];
+        uint32_t texel;
+        if (tex->channels == 4) memcpy(&texel, q, sizeof(texel));
+        else                    texel = color_to_u32(get_color_u8(q, tex->channels));
+        if (tint)                    row[i] = picasso__tint_texel(tex, texel, row[i]);
+        else if (tex->premultiplied) row[i] = texel;
+        else                         row[i] = picasso__premultiply(texel);
+    }
+}
+
+static void picasso__mesh_triangle(picasso_backbuffer *bf, picasso_draw_bounds cb,
+                                   const picasso_mesh_vertex *v[3], picasso_image *tex)
+{
+    int64_t vx[3] = { v[0]->sx, v[1]->sx, v[2]->sx };
+    int64_t vy[3] = { v[0]->sy, v[1]->sy, v[2]->sy };
+    picasso_tri_setup t;
+    if (!picasso__setup_triangle(&t, vx, vy, cb)) return;
+
+    // One color and no texture is just a fill
+    if (!tex && v[0]->c == v[1]->c && v[1]->c == v[2]->c) {
+        for (int y = t.y0; y < t.y1; ++y) {
+            int x0, x1;
+            if (picasso__triangle_span(&t, cb, &x0, &x1))
+                picasso__fill_span(bf, y, x0, x1, v[0]->c);
+        }
+        return;
+    }
+
+    picasso_plane_setup ps = picasso__plane_setup(vx, vy);
+    int planes = tex ? PICASSO_MESH_ATTRS : 4;
+    picasso_plane p[PICASSO_MESH_ATTRS];
+    int64_t step[PICASSO_MESH_ATTRS];
+    for (int k = 0; k < planes; ++k) {
+        p[k] = picasso__make_plane(&ps, v[0]->attr[k], v[1]->attr[k], v[2]->attr[k]);
+        step[k] = picasso__to_fixed(p[k].dx);
+    }
+
+    bool tint = v[0]->c != 0xFFFFFFFF || v[1]->c != 0xFFFFFFFF || v[2]->c != 0xFFFFFFFF;
+
+    // The spans are solved without the horizontal clip, and the attributes
+    // start at the true start of the span. Stepping them from there to the
+    // clip is exact, so a pixel comes out the same in every tile
+    const int wide = (int)PICASSO_SUBPIXEL_LIMIT + 1;
+    picasso_draw_bounds rows = { -wide, cb.y0, wide, cb.y1 };
+    uint32_t row[PICASSO_SPAN_CHUNK];
+    void (*blend)(uint32_t *, const uint32_t *, int) = picasso__kernels(bf)->blend;
+
+    for (int y = t.y0; y < t.y1; ++y) {
+        int lo, hi;
+        if (!picasso__triangle_span(&t, rows, &lo, &hi)) continue;
+        int sx0 = PICASSO_MAX(lo, cb.x0), sx1 = PICASSO_MIN(hi, cb.x1);
+        if (sx0 >= sx1) continue;
+
+        int64_t a[PICASSO_MESH_ATTRS];
+        for (int k = 0; k < planes; ++k) {
+            a[k] = picasso__to_fixed(p[k].base + p[k].dx * (float)lo + p[k].dy * (float)y);
+            a[k] += step[k] * (sx0 - lo);
+        }
+
+        for (int px = sx0; px < sx1; px += PICASSO_SPAN_CHUNK) {
+            int n = PICASSO_MIN(sx1 - px, PICASSO_SPAN_CHUNK);
+
+            picasso__gouraud_span(row, n, a, step);
+            if (tex) picasso__texture_span(row, n, tex, &a[4], &step[4], tint);
+            else     picasso__span_premultiply(row, n);
+            blend(picasso__get_pixel_u32(bf, px, y), row, n);
+        }
+    }
+}
+
+// --------------------------------------------------------
+// Public API
+// --------------------------------------------------------
+
+void picasso_draw_mesh(picasso_backbuffer *bf, const picasso_vertex *vertices, int vertex_count,
+                       const uint32_t *indices, int index_count, picasso_image *texture)
+{
+    if (!bf || !vertices || vertex_count <= 0 || index_count < 3) return;
+
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_MESH, .mesh = {
+        vertices, indices, texture, vertex_count, index_count });
+
+    if (texture && (!texture->pixels || texture->width <= 0 || texture->height <= 0)) {
+        WARN("Mesh texture has no pixels, drawing vertex colors only");
+        texture = NULL;
+    }
+
+    int triangle_count = index_count / 3;
+    picasso_mesh_vertex *setup = picasso_malloc((size_t)vertex_count * sizeof(*setup) +
+                                                (size_t)triangle_count * sizeof(uint32_t));
+    if (!setup) {
+        ERROR("Out of memory setting up a mesh of %d vertices", vertex_count);
+        return;
+    }
+    uint32_t *visible = (uint32_t *)(setup + vertex_count);
+
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    picasso__setup_vertices(bf, cb, vertices, vertex_count, texture, setup);
+    int count = picasso__cull_triangles(setup, vertex_count, indices, triangle_count, visible);
+
+    for (int t = 0; t < count; ++t) {
+        uint32_t first = visible[t];
+        const picasso_mesh_vertex *tri[3];
+        for (int i = 0; i < 3; ++i)
+            tri[i] = &setup[indices ? indices[first + i] : first + i];
+        picasso__mesh_triangle(bf, cb, tri, texture);
+    }
+
+    picasso_free(setup);
+}
@@ -0,0 +1,578 @@
+#include <stdint.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Paths and the outline rasterizer.
+ *
+ * A path is kept as verbs and points in logical coordinates. Filling scales
+ * it to pixels and flattens the curves into lines, with as many lines per
+ * curve as it takes to stay within PICASSO_PATH_TOLERANCE of it, counted from
+ * the curve's second differences (Wang's formula).
+ *
+ * The lines are rasterized by signed area accumulation. Every line deposits,
+ * in each row it crosses, the area between itself and the right edge of the
+ * row into the cells it passes through, signed by its direction. A running sum
+ * along the row then gives each pixel the exact area of the shape inside it,
+ * as a winding number scaled by PICASSO_COVER_ONE, and the fill rule turns that
+ * into coverage. The deposits are rounded to integers with each row of a line
+ * summing exactly to its height, so the sums don't depend on the order they
+ * are made in. That is what keeps a clipped fill identical to the same pixels
+ * of an unclipped one: cells left of the clip are summed into its first
+ * column, cells right of it can't change anything to their left.
+ *
+ * Rows are rasterized in bands, with an active list of the lines crossing the
+ * band, and only the cells a row touched are swept. Past the last of them the
+ * coverage doesn't change, so the rest of the row is one solid span. */
+
+#define PICASSO_PATH_TOLERANCE 0.2f  // pixels
+#define PICASSO_PATH_MAX_STEPS 256   // lines per curve
+#define PICASSO_COVER_ONE      (1 << 16)
+#define PICASSO_PATH_BAND      32    // rows rasterized at once
+
+// --------------------------------------------------------
+// Building paths
+// --------------------------------------------------------
+
+picasso_path *picasso_create_path(void)
+{
+    picasso_path *path = picasso_calloc(1, sizeof(*path));
+    if (!path) ERROR("Failed to allocate path");
+    return path;
+}
+
+void picasso_destroy_path(picasso_path *path)
+{
+    if (!path) return;
+    picasso_free(path->verbs);
+    picasso_free(path->points);
+    picasso_free(path);
+}
+
+void picasso_path_reset(picasso_path *path)
+{
+    if (!path) return;
+    path->verb_count = 0;
+    path->point_count = 0;
+    path->has_current = false;
+}
+
+static bool picasso__path_push(picasso_path *path, picasso_path_verb verb,
+                               const float *pts, int n)
+{
+    if (path->verb_count == path->verb_capacity) {
+        int capacity = path->verb_capacity ? path->verb_capacity * 2 : 16;
+        uint8_t *verbs = picasso_realloc(path->verbs, (size_t)capacity);
+        if (!verbs) {
+            ERROR("Out of memory growing a path to %d verbs", capacity);
+            return false;
+        }
+        path->verbs = verbs;
+        path->verb_capacity = capacity;
+    }
+    if (path->point_count + n > path->point_capacity) {
+        int capacity = path->point_capacity ? path->point_capacity * 2 : 32;
+        while (capacity < path->point_count + n) capacity *= 2;
+        float *points = picasso_realloc(path->points, (size_t)capacity * 2 * sizeof(float));
+        if (!points) {
+            ERROR("Out of memory growing a path to %d points", capacity);
+            return false;
+        }
+        path->points = points;
+        path->point_capacity = capacity;
+    }
+
+    if (path->point_count == 0 && n > 0) {
+        path->x0 = path->x1 = pts[0];
+        path->y0 = path->y1 = pts[1];
+    }
+    for (int i = 0; i < n; ++i) {
+        float x = pts[2 * i], y = pts[2 * i + 1];
+        path->x0 = fminf(path->x0, x);
+        path->y0 = fminf(path->y0, y);
+        path->x1 = fmaxf(path->x1, x);
+        path->y1 = fmaxf(path->y1, y);
+        path->points[2 * (path->point_count + i)] = x;
+        path->points[2 * (path->point_count + i) + 1] = y;
+    }
+
+    path->verbs[path->verb_count++] = (uint8_t)verb;
+    path->point_count += n;
+    return true;
+}
+
+void picasso_path_move_to(picasso_path *path, float x, float y)
+{
+    if (!path) return;
+    if (!picasso__path_push(path, PICASSO_PATH_MOVE, (float[]){ x, y }, 1)) return;
+    path->start_x = x;
+    path->start_y = y;
+    path->has_current = true;
+}
+
+void picasso_path_line_to(picasso_path *path, float x, float y)
+{
+    if (!path) return;
+    if (!path->has_current) {
+        picasso_path_move_to(path, x, y);
+        return;
+    }
+    picasso__path_push(path, PICASSO_PATH_LINE, (float[]){ x, y }, 1);
+}
+
+void picasso_path_quad_to(picasso_path *path, float cx, float cy, float x, float y)
+{
+    if (!path) return;
+    if (!path->has_current) picasso_path_move_to(path, cx, cy);
+    picasso__path_push(path, PICASSO_PATH_QUAD, (float[]){ cx, cy, x, y }, 2);
+}
+
+void picasso_path_cubic_to(picasso_path *path, float c1x, float c1y,
+                           float c2x, float c2y, float x, float y)
+{
+    if (!path) return;
+    if (!path->has_current) picasso_path_move_to(path, c1x, c1y);
+    picasso__path_push(path, PICASSO_PATH_CUBIC, (float[]){ c1x, c1y, c2x, c2y, x, y }, 3);
+}
+
+void picasso_path_close(picasso_path *path)
+{
+    if (!path || !path->has_current) return;
+    picasso__path_push(path, PICASSO_PATH_CLOSE, NULL, 0);
+}
+
+picasso_draw_bounds picasso__path_bounds(picasso_backbuffer *bf, const picasso_path *path)
+{
+    if (!path || path->point_count == 0) return (picasso_draw_bounds){0};
+
+    // Same limit as the flattening, the curves stay inside their points.
+    // fminf and fmaxf drop a NaN, the clamp macro would keep it
+    const float limit = PICASSO_SUBPIXEL_LIMIT;
+    float x0 = fmaxf(fminf(picasso__to_px_xf(bf, path->x0), limit), -limit);
+    float y0 = fmaxf(fminf(picasso__to_px_yf(bf, path->y0), limit), -limit);
+    float x1 = fmaxf(fminf(picasso__to_px_xf(bf, path->x1), limit), -limit);
+    float y1 = fmaxf(fminf(picasso__to_px_yf(bf, path->y1), limit), -limit);
+
+    return (picasso_draw_bounds){
+        (int)floorf(x0) - 1, (int)floorf(y0) - 1,
+        (int)ceilf(x1) + 1, (int)ceilf(y1) + 1 };
+}
+
+// --------------------------------------------------------
+// Flattening
+// --------------------------------------------------------
+
+void picasso__outline_add(picasso_outline *o, float x0, float y0, float x1, float y1)
+{
+    if (y0 == y1 || o->failed) return;
+    if (isnan(x0) || isnan(y0) || isnan(x1) || isnan(y1)) return;
+
+    if (o->count == o->capacity) {
+        int capacity = o->capacity ? o->capacity * 2 : 256;
+        picasso_segment *segs = picasso_realloc(o->segs, (size_t)capacity * sizeof(*segs));
+        if (!segs) {
+            ERROR("Out of memory flattening an outline of %d lines", o->count);
+            o->failed = true;
+            return;
+        }
+        o->segs = segs;
+        o->capacity = capacity;
+    }
+
+    int dir = 1;
+    if (y0 > y1) {
+        PICASSO_SWAP(x0, x1);
+        PICASSO_SWAP(y0, y1);
+        dir = -1;
+    }
+
+    if (o->count == 0) {
+        o->x0 = o->x1 = x0;
+        o->y0 = y0;
+        o->y1 = y1;
+    }
+    o->x0 = fminf(o->x0, fminf(x0, x1));
+    o->x1 = fmaxf(o->x1, fmaxf(x0, x1));
+    o->y0 = fminf(o->y0, y0);
+    o->y1 = fmaxf(o->y1, y1);
+
+    o->segs[o->count++] = (picasso_segment){ x0, y0, x1, y1, (x1 - x0) / (y1 - y0), dir };
+}
+
+void picasso__outline_free(picasso_outline *o)
+{
+    picasso_free(o->segs);
+    *o = (picasso_outline){0};
+}
+
+// Lines for a curve with second differences of length dd, k is 1/4 for a
+// quadratic and 3/4 for a cubic
+static int picasso__curve_steps(float dd, float k)
+{
+    float n = ceilf(sqrtf(k * dd / PICASSO_PATH_TOLERANCE));
+    if (!(n >= 1.0f)) return 1;
+    return n > PICASSO_PATH_MAX_STEPS ? PICASSO_PATH_MAX_STEPS : (int)n;
+}
+
+void picasso__flatten_path(const picasso_path *path, float scale_x, float scale_y,
+                           picasso_flatten_fn emit, void *ctx)
+{
+    const float limit = PICASSO_SUBPIXEL_LIMIT;
+    const float *pts = path->points;
+    float sx = 0, sy = 0, cx = 0, cy = 0; // contour start and current point
+    float p[8];
+
+    for (int v = 0; v < path->verb_count; ++v) {
+        int n = 0;
+        switch (path->verbs[v]) {
+        case PICASSO_PATH_MOVE:
+        case PICASSO_PATH_LINE:  n = 1; break;
+        case PICASSO_PATH_QUAD:  n = 2; break;
+        case PICASSO_PATH_CUBIC: n = 3; break;
+        default: break;
+        }
+
+        // Current point first, then the verb's points, all in pixels
+        p[0] = cx;
+        p[1] = cy;
+        for (int i = 0; i < n; ++i) {
+            p[2 + 2 * i] = PICASSO_CLAMP(pts[2 * i] * scale_x, -limit, limit);
+            p[3 + 2 * i] = PICASSO_CLAMP(pts[2 * i + 1] * scale_y, -limit, limit);
+        }
+        pts += 2 * n;
+
+        switch (path->verbs[v]) {
+        case PICASSO_PATH_MOVE:
+            sx = p[2];
+            sy = p[3];
+            emit(ctx, PICASSO_PATH_MOVE, sx, sy);
+            break;
+        case PICASSO_PATH_LINE:
+            emit(ctx, PICASSO_PATH_LINE, p[2], p[3]);
+            break;
+        case PICASSO_PATH_QUAD: {
+            float ddx = p[0] - 2 * p[2] + p[4], ddy = p[1] - 2 * p[3] + p[5];
+            int steps = picasso__curve_steps(sqrtf(ddx * ddx + ddy * ddy), 0.25f);
+            for (int i = 1; i < steps; ++i) {
+                float t = (float)i / steps, u = 1 - t;
+                emit(ctx, PICASSO_PATH_LINE,
+                     u * u * p[0] + 2 * u * t * p[2] + t * t * p[4],
+                     u * u * p[1] + 2 * u * t * p[3] + t * t * p[5]);
+            }
+            emit(ctx, PICASSO_PATH_LINE, p[4], p[5]);
+            break;
+        }
+        case PICASSO_PATH_CUBIC: {
+            float d1x = p[0] - 2 * p[2] + p[4], d1y = p[1] - 2 * p[3] + p[5];
+            float d2x = p[2] - 2 * p[4] + p[6], d2y = p[3] - 2 * p[5] + p[7];
+            float dd = fmaxf(sqrtf(d1x * d1x + d1y * d1y), sqrtf(d2x * d2x + d2y * d2y));
+            int steps = picasso__curve_steps(dd, 0.75f);
+            for (int i = 1; i < steps; ++i) {
+                float t = (float)i / steps, u = 1 - t;
+                float a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+                emit(ctx, PICASSO_PATH_LINE,
+                     a * p[0] + b * p[2] + c * p[4] + d * p[6],
+                     a * p[1] + b * p[3] + c * p[5] + d * p[7]);
+            }
+            emit(ctx, PICASSO_PATH_LINE, p[6], p[7]);
+            break;
+        }
+        case PICASSO_PATH_CLOSE:
+            emit(ctx, PICASSO_PATH_CLOSE, sx, sy);
+            cx = sx;
+            cy = sy;
+            continue;
+        }
+
+        cx = p[2 * n];
+        cy = p[2 * n + 1];
+    }
+}
+
+// Flattening for a fill, every contour is closed
+typedef struct {
+    picasso_outline *o;
+    float sx, sy, cx, cy;
+} picasso_fill_sink;
+
+static void picasso__fill_emit(void *ctx, picasso_path_verb verb, float x, float y)
+{
+    picasso_fill_sink *s = ctx;
+    if (verb == PICASSO_PATH_MOVE) {
+        picasso__outline_add(s->o, s->cx, s->cy, s->sx, s->sy);
+        s->sx = x;
+        s->sy = y;
+    } else {
+        picasso__outline_add(s->o, s->cx, s->cy, x, y);
+    }
+    s->cx = x;
+    s->cy = y;
+}
+
+void picasso__path_outline(const picasso_path *path, float scale_x, float scale_y,
+                           picasso_outline *o)
+{
+    picasso_fill_sink sink = { .o = o };
+    picasso__flatten_path(path, scale_x, scale_y, picasso__fill_emit, &sink);
+    // Filling closes whatever is still open
+    picasso__outline_add(o, sink.cx, sink.cy, sink.sx, sink.sy);
+}
+
+// --------------------------------------------------------
+// Coverage
+// --------------------------------------------------------
+
+// One band of rows: the cells and, per row, the range of cells touched
+typedef struct {
+    int32_t *cells;
+    int width;                      // cells per row, the columns [bx0, bx1)
+    int bx0;
+    int lo[PICASSO_PATH_BAND], hi[PICASSO_PATH_BAND];
+} picasso_band;
+
+// Cell x of a row, in pixels. Left of the band it counts for the first
+// column, right of it it can't change any pixel we draw
+static inline void picasso__deposit(picasso_band *b, int32_t *row, int x, int32_t q)
+{
+    x -= b->bx0;
+    if (x >= b->width) return;
+    row[x < 0 ? 0 : x] += q;
+}
+
+/* The part of segment s inside row y, deposited into the band's row r. This
+ * is the usual exact area split: the area right of the line within the row
+ * goes to the cells it crosses, the remainder to the cell after them. Each
+ * deposit is rounded and the last one takes what is left, so a row always
+ * adds up to exactly its height */
+static void picasso__accumulate_row(picasso_band *b, int r, const picasso_segment *s, int y)
+{
+    float ya = fmaxf((float)y, s->y0), yb = fminf((float)(y + 1), s->y1);
+    if (yb <= ya) return;
+
+    float xa = s->x0 + (ya - s->y0) * s->dxdy;
+    float xb = s->x0 + (yb - s->y0) * s->dxdy;
+    float d = (yb - ya) * (float)s->dir;
+    int32_t total = (int32_t)lrintf(d * PICASSO_COVER_ONE);
+
+    float lo = fminf(xa, xb), hi = fmaxf(xa, xb);
+    int x0 = (int)floorf(lo), x1 = (int)ceilf(hi);
+    int32_t *row = &b->cells[r * b->width];
+
+    if (x0 >= b->bx0 + b->width) return;
+    int first = PICASSO_MAX(x0 - b->bx0, 0);
+    int last = PICASSO_CLAMP(x1 - b->bx0, 0, b->width - 1);
+    b->lo[r] = PICASSO_MIN(b->lo[r], first);
+    b->hi[r] = PICASSO_MAX(b->hi[r], last);
+
+    // All of it left of the band, only the total matters
+    if (x1 < b->bx0) {
+        row[0] += total;
+        return;
+    }
+
+    int32_t used = 0, q;
+    if (x1 <= x0 + 1) {
+        float xm = 0.5f * (xa + xb) - (float)x0;
+        q = (int32_t)lrintf(d * (1.0f - xm) * PICASSO_COVER_ONE);
+        picasso__deposit(b, row, x0, q);
+        used = q;
+    } else {
+        float s_inv = 1.0f / (hi - lo);
+        float x0f = lo - (float)x0;
+        float a0 = 0.5f * s_inv * (1.0f - x0f) * (1.0f - x0f);
+        float x1f = hi - (float)x1 + 1.0f;
+        float am = 0.5f * s_inv * x1f * x1f;
+
+        q = (int32_t)lrintf(d * a0 * PICASSO_COVER_ONE);
+        picasso__deposit(b, row, x0, q);
+        used = q;
+
+        if (x1 == x0 + 2) {
+            q = (int32_t)lrintf(d * (1.0f - a0 - am) * PICASSO_COVER_ONE);
+            picasso__deposit(b, row, x0 + 1, q);
+            used += q;
+        } else {
+            float a1 = s_inv * (1.5f - x0f);
+            q = (int32_t)lrintf(d * (a1 - a0) * PICASSO_COVER_ONE);
+            picasso__deposit(b, row, x0 + 1, q);
+            used += q;
+
+            // The cells fully crossed all get the same share. Those left of
+            // the band are summed into its first column in one go
+            int32_t step = (int32_t)lrintf(d * s_inv * PICASSO_COVER_ONE);
+            int m0 = x0 + 2, m1 = x1 - 2;
+            int left = PICASSO_MIN(m1, b->bx0 - 1) - m0 + 1;
+            if (left > 0) {
+                row[0] += step * left;
+                m0 += left;
+            }
+            int visible_end = PICASSO_MIN(m1, b->bx0 + b->width - 1);
+            for (int x = m0; x <= visible_end; ++x)
+                row[x - b->bx0] += step;
+            used += step * (x1 - x0 - 3);
+
+            float a2 = a1 + (float)(x1 - x0 - 3) * s_inv;
+            q = (int32_t)lrintf(d * (1.0f - a2 - am) * PICASSO_COVER_ONE);
+            picasso__deposit(b, row, x1 - 1, q);
+            used += q;
+        }
+    }
+    picasso__deposit(b, row, x1, total - used);
+}
+
+// Winding, scaled by PICASSO_COVER_ONE, to 0-255 coverage
+static inline uint8_t picasso__coverage(int32_t acc, picasso_fill_rule rule)
+{
+    uint32_t v = (uint32_t)(acc < 0 ? -acc : acc);
+    if (rule == PICASSO_FILL_EVEN_ODD) {
+        v &= 2 * PICASSO_COVER_ONE - 1;
+        if (v > PICASSO_COVER_ONE) v = 2 * PICASSO_COVER_ONE - v;
+    } else if (v > PICASSO_COVER_ONE) {
+        v = PICASSO_COVER_ONE;
+    }
+    return (uint8_t)((v * 255 + PICASSO_COVER_ONE / 2) >> 16);
+}
+
+// Solid runs are filled, empty runs skipped, only the edges are masked
+static void picasso__composite_coverage(const picasso_blend_kernels *k, uint32_t *dst,
+                                        const uint8_t *cov, int n, uint32_t src)
+{
+    int i = 0;
+    while (i < n) {
+        int j = i + 1;
+        if (cov[i] == 0) {
+            while (j < n && cov[j] == 0) ++j;
+        } else if (cov[i] == 255) {
+            while (j < n && cov[j] == 255) ++j;
+            k->fill(dst + i, j - i, src);
+        } else {
+            while (j < n && cov[j] != 0 && cov[j] != 255) ++j;
+            k->mask(dst + i, cov + i, j - i, src);
+        }
+        i = j;
+    }
+}
+
+// Sweeps row r of the band into row y of the backbuffer, zeroing its cells
+static void picasso__sweep_row(picasso_backbuffer *bf, picasso_band *b, int r, int y,
+                               picasso_fill_rule rule, uint32_t src)
+{
+    int lo = b->lo[r], hi = b->hi[r];
+    if (lo > hi) return;
+
+    int32_t *row = &b->cells[r * b->width];
+    uint32_t *dst = &bf->pixels[y * bf->width + b->bx0];
+    uint8_t cov[PICASSO_SPAN_CHUNK];
+    const picasso_blend_kernels *k = picasso__kernels(bf);
+    int32_t acc = 0;
+
+    for (int x = lo; x <= hi; x += PICASSO_SPAN_CHUNK) {
+        int n = PICASSO_MIN(PICASSO_SPAN_CHUNK, hi + 1 - x);
+        for (int i = 0; i < n; ++i) {
+            acc += row[x + i];
+            row[x + i] = 0;
+            cov[i] = picasso__coverage(acc, rule);
+        }
+        picasso__composite_coverage(k, dst + x, cov, n, src);
+    }
+
+    // Nothing was deposited further right, the rest of the row is the same
+    uint8_t rest = picasso__coverage(acc, rule);
+    if (rest && hi + 1 < b->width) {
+        if (rest == 255 || bf->blend == PICASSO_BLEND_SRC_OVER) {
+            // Over, partial coverage is the same as scaling the alpha
+            uint32_t a = picasso__mul255(src >> 24, rest);
+            k->fill(dst + hi + 1, b->width - hi - 1, (src & 0x00FFFFFF) | (a << 24));
+        } else {
+            memset(cov, rest, sizeof(cov));
+            for (int x = hi + 1; x < b->width; x += PICASSO_SPAN_CHUNK)
+                k->mask(dst + x, cov, PICASSO_MIN(PICASSO_SPAN_CHUNK, b->width - x), src);
+        }
+    }
+
+    b->lo[r] = b->width;
+    b->hi[r] = -1;
+}
+
+static int picasso__compare_segments(const void *a, const void *b)
+{
+    float ya = ((const picasso_segment *)a)->y0, yb = ((const picasso_segment *)b)->y0;
+    return (ya > yb) - (ya < yb);
+}
+
+void picasso__fill_outline(picasso_backbuffer *bf, picasso_outline *o,
+                           picasso_fill_rule rule, color c)
+{
+    if (o->count == 0 || c.a == 0) return;
+
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    int y0 = PICASSO_MAX(cb.y0, (int)floorf(o->y0));
+    int y1 = PICASSO_MIN(cb.y1, (int)ceilf(o->y1));
+    int x0 = PICASSO_MAX(cb.x0, (int)floorf(o->x0));
+    int x1 = PICASSO_MIN(cb.x1, (int)ceilf(o->x1) + 1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    picasso_band band = { .width = x1 - x0, .bx0 = x0 };
+    band.cells = picasso_calloc((size_t)band.width * PICASSO_PATH_BAND, sizeof(int32_t));
+    int *active = picasso_malloc((size_t)o->count * sizeof(int));
+    if (!band.cells || !active) {
+        ERROR("Out of memory filling an outline of %d lines", o->count);
+        picasso_free(band.cells);
+        picasso_free(active);
+        return;
+    }
+    for (int r = 0; r < PICASSO_PATH_BAND; ++r) {
+        band.lo[r] = band.width;
+        band.hi[r] = -1;
+    }
+
+    qsort(o->segs, (size_t)o->count, sizeof(*o->segs), picasso__compare_segments);
+
+    uint32_t src = color_to_u32(c);
+    int next = 0, active_count = 0;
+    for (int by = y0; by < y1; by += PICASSO_PATH_BAND) {
+        int by1 = PICASSO_MIN(by + PICASSO_PATH_BAND, y1);
+
+        // Drop what ended above the band, add what starts in it
+        int kept = 0;
+        for (int i = 0; i < active_count; ++i)
+            if (o->segs[active[i]].y1 > (float)by) active[kept++] = active[i];
+        active_count = kept;
+        for (; next < o->count && o->segs[next].y0 < (float)by1; ++next)
+            if (o->segs[next].y1 > (float)by) active[active_count++] = next;
+
+        for (int i = 0; i < active_count; ++i) {
+            const picasso_segment *s = &o->segs[active[i]];
+            int r0 = PICASSO_MAX(by, (int)floorf(s->y0));
+            int r1 = PICASSO_MIN(by1, (int)ceilf(s->y1));
+            for (int y = r0; y < r1; ++y)
+                picasso__accumulate_row(&band, y - by, s, y);
+        }
+
+        for (int y = by; y < by1; ++y)
+            picasso__sweep_row(bf, &band, y - by, y, rule, src);
+    }
+
+    picasso_free(active);
+    picasso_free(band.cells);
+}
+
+// --------------------------------------------------------
+// Filling
+// --------------------------------------------------------
+
+void picasso_fill_path(picasso_backbuffer *bf, const picasso_path *path,
+                       picasso_fill_rule rule, color c)
+{
+    if (!bf || !path || path->verb_count == 0 || c.a == 0) return;
+
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_FILL_PATH, .c = c, .path = { path, rule });
+
+    picasso_outline o = {0};
+    picasso__path_outline(path, bf->scale_x, bf->scale_y, &o);
+    if (!o.failed) picasso__fill_outline(bf, &o, rule, c);
+
+    TRACE("Filled path: %d verbs, %d lines", path->verb_count, o.count);
+    picasso__outline_free(&o);
+}
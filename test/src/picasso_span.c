@@ -0,0 +1,1127 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "picasso_internal.h"
+
+/* Span compositor. The kernel set is picked at compile time from what the
+ * compiler targets: AVX2 if enabled (-mavx2), otherwise SSE2 which every
+ * x86_64 has, and NEON on arm64. The scalar kernels are the reference and are
+ * always built.
+ *
+ * The backbuffer is premultiplied, so source-over is the same single
+ * multiply-add for every channel, alpha included:
+ *      out = s + mul255(d, 255 - sa)
+ * where mul255 is x * y / 255 rounded. Solid colors come in straight and are
+ * premultiplied once per span. Intermediate values never exceed 255*255+128,
+ * which fits in the unsigned 16 bit lanes, and the add saturates like packus
+ * does, so a source with color above its alpha can't spill into the next
+ * channel.
+ *
+ * The other blend modes are one expression per channel each, which every
+ * backend expands into a kernel of its own, see Blend modes below. */
+
+#if !defined(PICASSO_NO_SIMD)
+#  if defined(__AVX2__)
+#    define PICASSO_SPAN_AVX2 1
+#    include <immintrin.h>
+#  elif defined(__SSE2__)
+#    define PICASSO_SPAN_SSE2 1
+#    include <emmintrin.h>
+#    if defined(__SSSE3__)
+#      include <tmmintrin.h>
+#    endif
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define PICASSO_SPAN_NEON 1
+#    include <arm_neon.h>
+#  endif
+#endif
+
+// Effective alpha of a color scaled by coverage, 0-255
+#define PICASSO_MASK_ALPHA(a, cov) picasso__mul255((a), (cov))
+
+// --------------------------------------------------------
+// Scalar reference kernels
+// --------------------------------------------------------
+void picasso__span_fill_scalar(uint32_t *dst, int n, uint32_t src)
+{
+    uint32_t sa = src >> 24;
+    if (n <= 0 || sa == 0) return;
+
+    uint32_t pre = picasso__premultiply(src);
+    if (sa == 255) {
+        for (int i = 0; i < n; ++i) dst[i] = pre;
+        return;
+    }
+
+    // Source term is constant over the span, do it once
+    uint32_t inv = 255 - sa;
+    uint32_t pr = (pre >>  0) & 0xFF;
+    uint32_t pg = (pre >>  8) & 0xFF;
+    uint32_t pb = (pre >> 16) & 0xFF;
+
+    for (int i = 0; i < n; ++i) {
+        uint32_t d = dst[i];
+        uint32_t r = pr + picasso__mul255((d >>  0) & 0xFF, inv);
+        uint32_t g = pg + picasso__mul255((d >>  8) & 0xFF, inv);
+        uint32_t b = pb + picasso__mul255((d >> 16) & 0xFF, inv);
+        uint32_t a = sa + picasso__mul255((d >> 24)       , inv);
+        dst[i] = r | (g << 8) | (b << 16) | (a << 24);
+    }
+}
+
+void picasso__span_blend_scalar(uint32_t *dst, const uint32_t *src, int n)
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = picasso__over(dst[i], src[i]);
+}
+
+// Coverage scales the alpha, then the color is premultiplied by that
+void picasso__span_mask_scalar(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src)
+{
+    uint32_t rgb = src & 0x00FFFFFF;
+    uint32_t sa  = src >> 24;
+
+    for (int i = 0; i < n; ++i) {
+        uint32_t a = PICASSO_MASK_ALPHA(sa, coverage[i]);
+        dst[i] = picasso__blend_pixel(dst[i], rgb | (a << 24));
+    }
+}
+
+void picasso__span_premultiply_scalar(uint32_t *px, int n)
+{
+    for (int i = 0; i < n; ++i)
+        px[i] = picasso__premultiply(px[i]);
+}
+
+void picasso__span_modulate_scalar(uint32_t *px, int n, uint32_t c)
+{
+    for (int i = 0; i < n; ++i)
+        px[i] = picasso__modulate(px[i], c);
+}
+
+void picasso__span_downsample_scalar(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        uint32_t a = row0[2 * i], b = row0[2 * i + 1], c = row1[2 * i], d = row1[2 * i + 1];
+        uint32_t out = 0;
+        for (int s = 0; s < 32; s += 8) {
+            uint32_t sum = ((a >> s) & 0xFF) + ((b >> s) & 0xFF) + ((c >> s) & 0xFF) + ((d >> s) & 0xFF);
+            out |= ((sum + 2) >> 2) << s;
+        }
+        dst[i] = out;
+    }
+}
+
+/* Rows first, then columns, each rounded. Every step stays below 256 * 256,
+ * which is what lets the SIMD version use unsigned 16 bit lanes */
+void picasso__span_bilinear_scalar(uint32_t *dst, const uint32_t *row0, const uint32_t *row1,
+                                   const int32_t *x, const uint16_t *fx, int n, uint32_t fy)
+{
+    uint32_t wy = 256 - fy;
+    for (int i = 0; i < n; ++i) {
+        uint32_t a = row0[x[i]], b = row0[x[i] + 1], c = row1[x[i]], d = row1[x[i] + 1];
+        uint32_t wx = 256 - fx[i], out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t l = (((a >> shift) & 0xFF) * wy + ((c >> shift) & 0xFF) * fy + 128) >> 8;
+            uint32_t r = (((b >> shift) & 0xFF) * wy + ((d >> shift) & 0xFF) * fy + 128) >> 8;
+            out |= ((l * wx + r * fx[i] + 128) >> 8) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+void picasso__span_rgb_to_rgba_scalar(uint32_t *dst, const uint8_t *src, int n)
+{
+    for (int i = 0; i < n; ++i, src += 3)
+        dst[i] = 0xFF000000u | ((uint32_t)src[2] << 16) | ((uint32_t)src[1] << 8) | src[0];
+}
+
+/* Clamped before rounding, and rounded to nearest even like cvtps2dq and
+ * vcvtnq do, so every backend lands on the same byte */
+void picasso__span_distance_scalar(uint8_t *coverage, const uint16_t *dist, int n, float edge,
+                                   float slope)
+{
+    for (int i = 0; i < n; ++i) {
+        float v = ((float)dist[i] - edge) * slope;
+        v = v < 0 ? 0 : v > 255 ? 255 : v;
+        coverage[i] = (uint8_t)lrintf(v);
+    }
+}
+
+// --------------------------------------------------------
+// Blend modes
+// --------------------------------------------------------
+/* Every blend mode as one expression per channel of the premultiplied source
+ * and destination, s and d, with their alphas sa and da. The alpha channel
+ * goes through the same expression, which gives the right alpha for every
+ * mode. Each backend defines the operations for its own lanes: MUL is
+ * x * y / 255 rounded and INV is 255 - x. No expression goes below 0, above
+ * 255 the result saturates. Source-over is in here too, for
+ * picasso__span_composite, but draws with the kernels above */
+#define PICASSO_BLEND_MODES(X)                                                        \
+    X(SRC_OVER, src_over, ADD(s, MUL(d, INV(sa))))                                    \
+    PICASSO_OTHER_BLEND_MODES(X)
+
+#define PICASSO_OTHER_BLEND_MODES(X)                                                  \
+    X(SRC,      src,      s)                                                          \
+    X(CLEAR,    clear,    ZERO)                                                       \
+    X(SRC_IN,   src_in,   MUL(s, da))                                                 \
+    X(SRC_OUT,  src_out,  MUL(s, INV(da)))                                            \
+    X(SRC_ATOP, src_atop, ADD(MUL(s, da), MUL(d, INV(sa))))                           \
+    X(DST_OVER, dst_over, ADD(d, MUL(s, INV(da))))                                    \
+    X(DST_IN,   dst_in,   MUL(d, sa))                                                 \
+    X(DST_OUT,  dst_out,  MUL(d, INV(sa)))                                            \
+    X(DST_ATOP, dst_atop, ADD(MUL(d, sa), MUL(s, INV(da))))                           \
+    X(XOR,      xor,      ADD(MUL(s, INV(da)), MUL(d, INV(sa))))                      \
+    X(ADD,      add,      ADD(s, d))                                                  \
+    X(MULTIPLY, multiply, ADD(MUL(s, d), ADD(MUL(s, INV(da)), MUL(d, INV(sa)))))      \
+    X(SCREEN,   screen,   SUB(ADD(s, d), MUL(s, d)))                                  \
+    X(DARKEN,   darken,   SUB(ADD(s, d), HIGHER(MUL(s, da), MUL(d, sa))))             \
+    X(LIGHTEN,  lighten,  SUB(ADD(s, d), LOWER(MUL(s, da), MUL(d, sa))))
+
+// The result where coverage is c, and what was there where it isn't
+static inline uint32_t picasso__lerp255(uint32_t d, uint32_t r, uint32_t c)
+{
+    uint32_t v = picasso__mul255(r, c) + picasso__mul255(d, 255 - c);
+    return v > 255 ? 255 : v;
+}
+
+#define MUL(x, y)       picasso__mul255((x), (y))
+#define INV(x)          (255 - (x))
+#define ADD(x, y)       ((x) + (y))
+#define SUB(x, y)       ((x) - (y))
+#define LOWER(x, y)     PICASSO_MIN((x), (y))
+#define HIGHER(x, y)    PICASSO_MAX((x), (y))
+#define ZERO            0u
+
+#define PICASSO_COMPOSITE_SCALAR(NAME, name, expr)                                    \
+    static void picasso__composite_##name##_scalar(uint32_t *dst, const uint32_t *src,  \
+                                                   const uint8_t *coverage, int n)    \
+    {                                                                                  \
+        for (int i = 0; i < n; ++i) {                                                  \
+            uint32_t c = coverage ? coverage[i] : 255;                                 \
+            if (c == 0) continue;                                                      \
+            uint32_t sp = src[i], dp = dst[i], out = 0;                                \
+            uint32_t sa = sp >> 24, da = dp >> 24;                                     \
+            (void)sa; (void)da;                                                        \
+            for (int shift = 0; shift < 32; shift += 8) {                              \
+                uint32_t s = (sp >> shift) & 0xFF, d = (dp >> shift) & 0xFF;           \
+                (void)s;                                                               \
+                uint32_t r = PICASSO_MIN((uint32_t)(expr), 255u);                      \
+                out |= (c == 255 ? r : picasso__lerp255(d, r, c)) << shift;            \
+            }                                                                          \
+            dst[i] = out;                                                              \
+        }                                                                              \
+    }
+PICASSO_BLEND_MODES(PICASSO_COMPOSITE_SCALAR)
+#undef PICASSO_COMPOSITE_SCALAR
+
+#undef MUL
+#undef INV
+#undef ADD
+#undef SUB
+#undef LOWER
+#undef HIGHER
+#undef ZERO
+
+// --------------------------------------------------------
+// SSE2 / AVX2 kernels
+// --------------------------------------------------------
+#if defined(PICASSO_SPAN_SSE2) || defined(PICASSO_SPAN_AVX2)
+
+// x * y / 255 rounded, in 16 bit lanes
+static inline __m128i picasso__mul255_epu16(__m128i x, __m128i y)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// The alpha of each of 2 unpacked pixels in all 4 of its lanes
+static inline __m128i picasso__alpha_epu16(__m128i s)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3,3,3,3)),
+                               _MM_SHUFFLE(3,3,3,3));
+}
+
+// 2 premultiplied pixels unpacked to 16 bit lanes, not yet saturated
+static inline __m128i picasso__over2_epu16(__m128i s, __m128i d)
+{
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), picasso__alpha_epu16(s));
+    return _mm_add_epi16(s, picasso__mul255_epu16(d, inv));
+}
+
+// 4 pixels with per pixel alpha
+static inline __m128i picasso__over4_sse2(__m128i s, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i lo = picasso__over2_epu16(_mm_unpacklo_epi8(s, zero),
+                                      _mm_unpacklo_epi8(d, zero));
+    __m128i hi = picasso__over2_epu16(_mm_unpackhi_epi8(s, zero),
+                                      _mm_unpackhi_epi8(d, zero));
+    return _mm_packus_epi16(lo, hi);
+}
+
+// 4 pixels under a constant premultiplied source, inv = 255 - sa
+static inline __m128i picasso__fill4_sse2(__m128i pre, __m128i inv, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i lo = _mm_add_epi16(pre, picasso__mul255_epu16(_mm_unpacklo_epi8(d, zero), inv));
+    __m128i hi = _mm_add_epi16(pre, picasso__mul255_epu16(_mm_unpackhi_epi8(d, zero), inv));
+    return _mm_packus_epi16(lo, hi);
+}
+
+#endif
+
+#if defined(PICASSO_SPAN_AVX2)
+
+static inline __m256i picasso__mul255_epu16_x8(__m256i x, __m256i y)
+{
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, y), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+static inline __m256i picasso__over4_epu16_x8(__m256i s, __m256i d)
+{
+    __m256i sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3,3,3,3)),
+                                        _MM_SHUFFLE(3,3,3,3));
+    __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(255), sa);
+    return _mm256_add_epi16(s, picasso__mul255_epu16_x8(d, inv));
+}
+
+// 8 pixels with per pixel alpha. unpack/pack work per 128 bit lane so the
+// pixel order comes back out unchanged
+static inline __m256i picasso__over8_avx2(__m256i s, __m256i d)
+{
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i lo = picasso__over4_epu16_x8(_mm256_unpacklo_epi8(s, zero),
+                                         _mm256_unpacklo_epi8(d, zero));
+    __m256i hi = picasso__over4_epu16_x8(_mm256_unpackhi_epi8(s, zero),
+                                         _mm256_unpackhi_epi8(d, zero));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+static inline __m256i picasso__fill8_avx2(__m256i pre, __m256i inv, __m256i d)
+{
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i lo = _mm256_add_epi16(pre, picasso__mul255_epu16_x8(_mm256_unpacklo_epi8(d, zero), inv));
+    __m256i hi = _mm256_add_epi16(pre, picasso__mul255_epu16_x8(_mm256_unpackhi_epi8(d, zero), inv));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+#endif
+
+#if defined(PICASSO_SPAN_SSE2) || defined(PICASSO_SPAN_AVX2)
+
+void picasso__span_fill(uint32_t *dst, int n, uint32_t src)
+{
+    uint32_t sa = src >> 24;
+    if (n <= 0 || sa == 0) return;
+
+    uint32_t p = picasso__premultiply(src);
+    int i = 0;
+    if (sa == 255) {
+#if defined(PICASSO_SPAN_AVX2)
+        __m256i v8 = _mm256_set1_epi32((int)p);
+        for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i *)(dst + i), v8);
+#endif
+        __m128i v = _mm_set1_epi32((int)p);
+        for (; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i *)(dst + i), v);
+        for (; i < n; ++i) dst[i] = p;
+        return;
+    }
+
+    short inv = (short)(255 - sa);
+    short pr = (short)((p >>  0) & 0xFF);
+    short pg = (short)((p >>  8) & 0xFF);
+    short pb = (short)((p >> 16) & 0xFF);
+    short pa = (short)sa;
+
+#if defined(PICASSO_SPAN_AVX2)
+    __m256i pre8 = _mm256_set_epi16(pa, pb, pg, pr, pa, pb, pg, pr,
+                                    pa, pb, pg, pr, pa, pb, pg, pr);
+    __m256i inv8 = _mm256_set1_epi16(inv);
+    for (; i + 8 <= n; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), picasso__fill8_avx2(pre8, inv8, d));
+    }
+#endif
+    __m128i pre = _mm_set_epi16(pa, pb, pg, pr, pa, pb, pg, pr);
+    __m128i vinv = _mm_set1_epi16(inv);
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), picasso__fill4_sse2(pre, vinv, d));
+    }
+    if (i < n) picasso__span_fill_scalar(dst + i, n - i, src);
+}
+
+void picasso__span_blend(uint32_t *dst, const uint32_t *src, int n)
+{
+    int i = 0;
+#if defined(PICASSO_SPAN_AVX2)
+    const __m256i amask8 = _mm256_set1_epi32((int)0xFF000000);
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i a = _mm256_and_si256(s, amask8);
+
+        // Whole block opaque or transparent, skip the math
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, amask8)) == -1) {
+            _mm256_storeu_si256((__m256i *)(dst + i), s);
+            continue;
+        }
+        if (_mm256_testz_si256(a, a)) continue;
+
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), picasso__over8_avx2(s, d));
+    }
+#endif
+    const __m128i amask = _mm_set1_epi32((int)0xFF000000);
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i a = _mm_and_si128(s, amask);
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, amask)) == 0xFFFF) {
+            _mm_storeu_si128((__m128i *)(dst + i), s);
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128())) == 0xFFFF)
+            continue;
+
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), picasso__over4_sse2(s, d));
+    }
+    if (i < n) picasso__span_blend_scalar(dst + i, src + i, n - i);
+}
+
+/* Coverage times alpha gives the alpha of each pixel. Spread over the 4 lanes
+ * of its pixel, it scales the color with 255 in its alpha lane, which is the
+ * premultiplied source. Then it is the same per pixel blend as span_blend.
+ *
+ * Masks are mostly empty or full, so coverage is looked at 16 bytes at a
+ * time first: blocks with none skip the pixels, and fully covered ones of an
+ * opaque color are stored straight */
+void picasso__span_mask(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src)
+{
+    uint32_t sa = src >> 24;
+    if (n <= 0 || sa == 0) return;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi8(-1);
+    const __m128i solid = _mm_set1_epi32((int)src);
+    const __m128i color = _mm_unpacklo_epi8(_mm_set1_epi32((int)(src | 0xFF000000u)), zero);
+    const __m128i vsa = _mm_set1_epi16((short)sa);
+#if defined(PICASSO_SPAN_AVX2)
+    const __m256i color8 = _mm256_broadcastsi128_si256(color);
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                            4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+#endif
+
+    int i = 0;
+    while (i < n) {
+        int block = PICASSO_MIN(n - i, 16);
+        if (block == 16) {
+            __m128i c = _mm_loadu_si128((const __m128i *)(coverage + i));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(c, zero));
+            if (mask == 0xFFFF) {
+                i += 16;
+                continue;
+            }
+            if (sa == 255 && _mm_movemask_epi8(_mm_cmpeq_epi8(c, full)) == 0xFFFF) {
+                for (int k = 0; k < 16; k += 4) _mm_storeu_si128((__m128i *)(dst + i + k), solid);
+                i += 16;
+                continue;
+            }
+        }
+        int end = i + block;
+
+#if defined(PICASSO_SPAN_AVX2)
+        for (; i + 8 <= end; i += 8) {
+            __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(coverage + i)));
+            a = _mm_packus_epi16(picasso__mul255_epu16(a, vsa), zero);
+            if (_mm_cvtsi128_si64(a) == 0) continue;
+
+            // Each pixel's alpha in all 4 of its bytes, then unpacked like d
+            __m256i a8 = _mm256_shuffle_epi8(_mm256_broadcastq_epi64(a), spread);
+            __m256i zero8 = _mm256_setzero_si256();
+            __m256i s_lo = picasso__mul255_epu16_x8(color8, _mm256_unpacklo_epi8(a8, zero8));
+            __m256i s_hi = picasso__mul255_epu16_x8(color8, _mm256_unpackhi_epi8(a8, zero8));
+
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i lo = picasso__over4_epu16_x8(s_lo, _mm256_unpacklo_epi8(d, zero8));
+            __m256i hi = picasso__over4_epu16_x8(s_hi, _mm256_unpackhi_epi8(d, zero8));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+        }
+#endif
+        for (; i + 4 <= end; i += 4) {
+            uint32_t cov4;
+            memcpy(&cov4, coverage + i, 4);
+            if (cov4 == 0) continue;
+            if (cov4 == 0xFFFFFFFFu && sa == 255) {
+                _mm_storeu_si128((__m128i *)(dst + i), solid);
+                continue;
+            }
+
+            __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)cov4), zero);
+            a = picasso__mul255_epu16(a, vsa);
+            a = _mm_unpacklo_epi16(a, a);
+            __m128i s_lo = picasso__mul255_epu16(color, _mm_unpacklo_epi32(a, a));
+            __m128i s_hi = picasso__mul255_epu16(color, _mm_unpackhi_epi32(a, a));
+
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i lo = picasso__over2_epu16(s_lo, _mm_unpacklo_epi8(d, zero));
+            __m128i hi = picasso__over2_epu16(s_hi, _mm_unpackhi_epi8(d, zero));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+        }
+        if (i < end) {
+            picasso__span_mask_scalar(dst + i, coverage + i, end - i, src);
+            i = end;
+        }
+    }
+}
+
+// Color lanes times alpha, the alpha lane times 255
+void picasso__span_premultiply(uint32_t *px, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32((int)0xFF000000);
+    const __m128i alpha_lane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i v255 = _mm_and_si128(alpha_lane, _mm_set1_epi16(255));
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(px + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, amask), amask)) == 0xFFFF)
+            continue;
+
+        __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+        __m128i f_lo = _mm_or_si128(_mm_andnot_si128(alpha_lane, picasso__alpha_epu16(lo)), v255);
+        __m128i f_hi = _mm_or_si128(_mm_andnot_si128(alpha_lane, picasso__alpha_epu16(hi)), v255);
+        lo = picasso__mul255_epu16(lo, f_lo);
+        hi = picasso__mul255_epu16(hi, f_hi);
+        _mm_storeu_si128((__m128i *)(px + i), _mm_packus_epi16(lo, hi));
+    }
+    if (i < n) picasso__span_premultiply_scalar(px + i, n - i);
+}
+
+// 16 bit products divided by 255 rounding down, like PICASSO_DIV255
+void picasso__span_modulate(uint32_t *px, int n, uint32_t c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i m = _mm_unpacklo_epi8(_mm_set1_epi32((int)c), zero);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(px + i));
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), m);
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), m);
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *)(px + i), _mm_packus_epi16(lo, hi));
+    }
+    if (i < n) picasso__span_modulate_scalar(px + i, n - i, c);
+}
+
+/* Four pixels out of eight from each row. The rows are added in 16 bit lanes,
+ * where each register holds two pixels, and then the two halves of every
+ * register, which are the two neighbors */
+void picasso__span_downsample(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i sum[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(row0 + 2 * i + 4 * k));
+            __m128i b = _mm_loadu_si128((const __m128i *)(row1 + 2 * i + 4 * k));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            sum[k] = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+            sum[k] = _mm_srli_epi16(_mm_add_epi16(sum[k], two), 2);
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(sum[0], sum[1]));
+    }
+    if (i < n) picasso__span_downsample_scalar(dst + i, row0 + 2 * i, row1 + 2 * i, n - i);
+}
+
+/* Two pixels at a time. Both texel pairs of a pixel are neighbors, so each
+ * row is one 8 byte load, mixed down the rows in 16 bit lanes, then the left
+ * and right halves are weighted and added across */
+void picasso__span_bilinear(uint32_t *dst, const uint32_t *row0, const uint32_t *row1,
+                            const int32_t *x, const uint16_t *fx, int n, uint32_t fy)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i wy0 = _mm_set1_epi16((short)(256 - fy));
+    const __m128i wy1 = _mm_set1_epi16((short)fy);
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i v[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i t = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(row0 + x[i + k])), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(row1 + x[i + k])), zero);
+            __m128i m = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(t, wy0),
+                                                    _mm_mullo_epi16(b, wy1)), round);
+            short r = (short)fx[i + k], l = (short)(256 - r);
+            __m128i wx = _mm_set_epi16(r, r, r, r, l, l, l, l);
+            v[k] = _mm_mullo_epi16(_mm_srli_epi16(m, 8), wx);
+        }
+        __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(v[0], v[1]), _mm_unpackhi_epi64(v[0], v[1]));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 8);
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(sum, zero));
+    }
+    if (i < n) picasso__span_bilinear_scalar(dst + i, row0, row1, x + i, fx + i, n - i, fy);
+}
+
+/* With SSSE3 (every AVX2 build has it) one shuffle spreads 4 pixels out of 12
+ * bytes. Plain SSE2 has no byte shuffle, there each pixel is one unaligned 4
+ * byte load with the alpha forced on. Both read a little past the pixels they
+ * convert, so the last ones are left to the scalar loop */
+void picasso__span_rgb_to_rgba(uint32_t *dst, const uint8_t *src, int n)
+{
+    int i = 0;
+#if defined(__SSSE3__)
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    for (; i + 6 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_shuffle_epi8(v, spread), alpha));
+    }
+#else
+    for (; i + 2 <= n; ++i) {
+        uint32_t v;
+        memcpy(&v, src + 3 * i, sizeof(v));
+        dst[i] = v | 0xFF000000u;
+    }
+#endif
+    if (i < n) picasso__span_rgb_to_rgba_scalar(dst + i, src + 3 * i, n - i);
+}
+
+/* Eight distances at a time, widened to 32 bit floats. A ramp needs more
+ * range and precision than 16 bit lanes have once the field is scaled up a
+ * lot, and floats round the same as the scalar kernel */
+void picasso__span_distance(uint8_t *coverage, const uint16_t *dist, int n, float edge, float slope)
+{
+    const __m128 e = _mm_set1_ps(edge), k = _mm_set1_ps(slope);
+    const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255);
+
+    int i = 0;
+#if defined(PICASSO_SPAN_AVX2)
+    const __m256 e8 = _mm256_set1_ps(edge), k8 = _mm256_set1_ps(slope);
+    const __m256 lo8 = _mm256_setzero_ps(), hi8 = _mm256_set1_ps(255);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v[2];
+        for (int h = 0; h < 2; ++h) {
+            __m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(dist + i + 8 * h)));
+            __m256 f = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(d), e8), k8);
+            __m256i c = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(f, lo8), hi8));
+            v[h] = _mm_packs_epi32(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1));
+        }
+        _mm_storeu_si128((__m128i *)(coverage + i), _mm_packus_epi16(v[0], v[1]));
+    }
+#endif
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dist + i));
+        __m128i c[2];
+        for (int h = 0; h < 2; ++h) {
+            __m128i w = h ? _mm_unpackhi_epi16(d, zero) : _mm_unpacklo_epi16(d, zero);
+            __m128 f = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(w), e), k);
+            c[h] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(f, lo), hi));
+        }
+        __m128i v = _mm_packs_epi32(c[0], c[1]);
+        _mm_storel_epi64((__m128i *)(coverage + i), _mm_packus_epi16(v, zero));
+    }
+    if (i < n) picasso__span_distance_scalar(coverage + i, dist + i, n - i, edge, slope);
+}
+
+/* Blend modes, 2 pixels per expression. AVX2 builds use these as well, the
+ * modes other than source-over are rare enough not to need a wider copy */
+static inline __m128i picasso__lerp_epu16(__m128i d, __m128i r, __m128i c)
+{
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), c);
+    return _mm_add_epi16(picasso__mul255_epu16(r, c), picasso__mul255_epu16(d, inv));
+}
+
+#define MUL(x, y)       picasso__mul255_epu16((x), (y))
+#define INV(x)          _mm_sub_epi16(v255, (x))
+#define ADD(x, y)       _mm_add_epi16((x), (y))
+#define SUB(x, y)       _mm_sub_epi16((x), (y))
+#define LOWER(x, y)     _mm_min_epi16((x), (y))
+#define HIGHER(x, y)    _mm_max_epi16((x), (y))
+#define ZERO            _mm_setzero_si128()
+
+// Coverage is spread over the 4 lanes of its pixel, like the pixels are
+#define PICASSO_COMPOSITE(NAME, name, expr)                                           \
+    static inline __m128i picasso__##name##_epu16(__m128i s, __m128i d)               \
+    {                                                                                  \
+        const __m128i v255 = _mm_set1_epi16(255);                                     \
+        __m128i sa = picasso__alpha_epu16(s), da = picasso__alpha_epu16(d);           \
+        (void)s; (void)d; (void)sa; (void)da;                                          \
+        return _mm_min_epi16(expr, v255);                                             \
+    }                                                                                  \
+    static void picasso__composite_##name(uint32_t *dst, const uint32_t *src,         \
+                                          const uint8_t *coverage, int n)              \
+    {                                                                                  \
+        const __m128i zero = _mm_setzero_si128();                                     \
+        int i = 0;                                                                     \
+        for (; i + 4 <= n; i += 4) {                                                   \
+            uint32_t cov4 = 0xFFFFFFFFu;                                               \
+            if (coverage) memcpy(&cov4, coverage + i, 4);                              \
+            if (cov4 == 0) continue;                                                   \
+                                                                                       \
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));                   \
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));                   \
+            __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero); \
+            __m128i lo = picasso__##name##_epu16(_mm_unpacklo_epi8(s, zero), d_lo);   \
+            __m128i hi = picasso__##name##_epu16(_mm_unpackhi_epi8(s, zero), d_hi);   \
+            if (cov4 != 0xFFFFFFFFu) {                                                 \
+                __m128i c = _mm_cvtsi32_si128((int)cov4);                              \
+                c = _mm_unpacklo_epi8(c, c);                                           \
+                c = _mm_unpacklo_epi16(c, c);                                          \
+                lo = picasso__lerp_epu16(d_lo, lo, _mm_unpacklo_epi8(c, zero));       \
+                hi = picasso__lerp_epu16(d_hi, hi, _mm_unpackhi_epi8(c, zero));       \
+            }                                                                          \
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));         \
+        }                                                                              \
+        if (i < n)                                                                     \
+            picasso__composite_##name##_scalar(dst + i, src + i,                       \
+                                               coverage ? coverage + i : NULL, n - i); \
+    }
+PICASSO_BLEND_MODES(PICASSO_COMPOSITE)
+#undef PICASSO_COMPOSITE
+
+#undef MUL
+#undef INV
+#undef ADD
+#undef SUB
+#undef LOWER
+#undef HIGHER
+#undef ZERO
+
+const char *picasso__span_backend(void)
+{
+#if defined(PICASSO_SPAN_AVX2)
+    return "avx2";
+#else
+    return "sse2";
+#endif
+}
+
+// --------------------------------------------------------
+// NEON kernels
+// --------------------------------------------------------
+#elif defined(PICASSO_SPAN_NEON)
+
+// x * y / 255 rounded, narrowed back to bytes
+static inline uint8x8_t picasso__mul255_neon(uint8x8_t x, uint8x8_t y)
+{
+    uint16x8_t t = vaddq_u16(vmull_u8(x, y), vdupq_n_u16(128));
+    return vshrn_n_u16(vsraq_n_u16(t, t, 8), 8);
+}
+
+/* vld4 splits 8 pixels into r, g, b, a planes, so per pixel alpha is just
+ * another vector and there is no shuffling at all */
+static inline uint8x8x4_t picasso__over8_neon(uint8x8x4_t s, uint8x8x4_t d)
+{
+    uint8x8_t inv = vmvn_u8(s.val[3]);       // 255 - sa
+    uint8x8x4_t o;
+
+    for (int c = 0; c < 4; ++c)
+        o.val[c] = vqadd_u8(s.val[c], picasso__mul255_neon(d.val[c], inv));
+    return o;
+}
+
+void picasso__span_fill(uint32_t *dst, int n, uint32_t src)
+{
+    uint32_t sa = src >> 24;
+    if (n <= 0 || sa == 0) return;
+
+    uint32_t p = picasso__premultiply(src);
+    int i = 0;
+    if (sa == 255) {
+        uint32x4_t v = vdupq_n_u32(p);
+        for (; i + 4 <= n; i += 4) vst1q_u32(dst + i, v);
+        for (; i < n; ++i) dst[i] = p;
+        return;
+    }
+
+    uint8x8_t inv = vdup_n_u8((uint8_t)(255 - sa));
+    uint8x8_t pre[4] = {
+        vdup_n_u8((uint8_t)(p >>  0)),
+        vdup_n_u8((uint8_t)(p >>  8)),
+        vdup_n_u8((uint8_t)(p >> 16)),
+        vdup_n_u8((uint8_t)sa),
+    };
+
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t d = vld4_u8((const uint8_t *)(dst + i));
+        for (int c = 0; c < 4; ++c)
+            d.val[c] = vqadd_u8(pre[c], picasso__mul255_neon(d.val[c], inv));
+        vst4_u8((uint8_t *)(dst + i), d);
+    }
+    if (i < n) picasso__span_fill_scalar(dst + i, n - i, src);
+}
+
+void picasso__span_blend(uint32_t *dst, const uint32_t *src, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t s = vld4_u8((const uint8_t *)(src + i));
+
+        if (vget_lane_u64(vreinterpret_u64_u8(vmvn_u8(s.val[3])), 0) == 0) {
+            vst1q_u32(dst + i,     vld1q_u32(src + i));
+            vst1q_u32(dst + i + 4, vld1q_u32(src + i + 4));
+            continue;
+        }
+        if (vget_lane_u64(vreinterpret_u64_u8(s.val[3]), 0) == 0) continue;
+
+        uint8x8x4_t d = vld4_u8((const uint8_t *)(dst + i));
+        vst4_u8((uint8_t *)(dst + i), picasso__over8_neon(s, d));
+    }
+    if (i < n) picasso__span_blend_scalar(dst + i, src + i, n - i);
+}
+
+// 8 pixels of coverage times a straight color over dst
+static inline void picasso__mask8_neon(uint32_t *dst, uint8x8_t c, const uint8x8_t rgb[3], uint8x8_t sa)
+{
+    if (vget_lane_u64(vreinterpret_u64_u8(c), 0) == 0) return;
+
+    uint8x8x4_t s;
+    s.val[3] = picasso__mul255_neon(c, sa);
+    for (int k = 0; k < 3; ++k) s.val[k] = picasso__mul255_neon(rgb[k], s.val[3]);
+    uint8x8x4_t d = vld4_u8((const uint8_t *)dst);
+    vst4_u8((uint8_t *)dst, picasso__over8_neon(s, d));
+}
+
+void picasso__span_mask(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src)
+{
+    uint32_t sa = src >> 24;
+    if (n <= 0 || sa == 0) return;
+
+    uint8x8_t rgb[3] = {
+        vdup_n_u8((uint8_t)(src >>  0)),
+        vdup_n_u8((uint8_t)(src >>  8)),
+        vdup_n_u8((uint8_t)(src >> 16)),
+    };
+    uint8x8_t vsa = vdup_n_u8((uint8_t)sa);
+    uint32x4_t solid = vdupq_n_u32(src);
+
+    // Empty and, for opaque colors, full blocks of 16 as in the SSE2 kernel
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t c16 = vld1q_u8(coverage + i);
+        if (vmaxvq_u8(c16) == 0) continue;
+        if (sa == 255 && vminvq_u8(c16) == 255) {
+            for (int k = 0; k < 16; k += 4) vst1q_u32(dst + i + k, solid);
+            continue;
+        }
+        for (int h = 0; h < 16; h += 8)
+            picasso__mask8_neon(dst + i + h, vld1_u8(coverage + i + h), rgb, vsa);
+    }
+    for (; i + 8 <= n; i += 8) picasso__mask8_neon(dst + i, vld1_u8(coverage + i), rgb, vsa);
+    if (i < n) picasso__span_mask_scalar(dst + i, coverage + i, n - i, src);
+}
+
+void picasso__span_premultiply(uint32_t *px, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t v = vld4_u8((const uint8_t *)(px + i));
+        if (vget_lane_u64(vreinterpret_u64_u8(vmvn_u8(v.val[3])), 0) == 0) continue;
+        for (int c = 0; c < 3; ++c) v.val[c] = picasso__mul255_neon(v.val[c], v.val[3]);
+        vst4_u8((uint8_t *)(px + i), v);
+    }
+    if (i < n) picasso__span_premultiply_scalar(px + i, n - i);
+}
+
+void picasso__span_modulate(uint32_t *px, int n, uint32_t c)
+{
+    uint8x8_t m[4];
+    for (int k = 0; k < 4; ++k) m[k] = vdup_n_u8((uint8_t)(c >> (8 * k)));
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t v = vld4_u8((const uint8_t *)(px + i));
+        for (int k = 0; k < 4; ++k) {
+            uint16x8_t t = vmull_u8(v.val[k], m[k]);
+            v.val[k] = vshrn_n_u16(vaddq_u16(vaddq_u16(t, vdupq_n_u16(1)), vshrq_n_u16(t, 8)), 8);
+        }
+        vst4_u8((uint8_t *)(px + i), v);
+    }
+    if (i < n) picasso__span_modulate_scalar(px + i, n - i, c);
+}
+
+// Channels apart, the neighbors are added pairwise and the rows on top
+void picasso__span_downsample(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x16x4_t a = vld4q_u8((const uint8_t *)(row0 + 2 * i));
+        uint8x16x4_t b = vld4q_u8((const uint8_t *)(row1 + 2 * i));
+        uint8x8x4_t out;
+        for (int k = 0; k < 4; ++k) {
+            uint16x8_t sum = vaddq_u16(vpaddlq_u8(a.val[k]), vpaddlq_u8(b.val[k]));
+            out.val[k] = vrshrn_n_u16(sum, 2);
+        }
+        vst4_u8((uint8_t *)(dst + i), out);
+    }
+    if (i < n) picasso__span_downsample_scalar(dst + i, row0 + 2 * i, row1 + 2 * i, n - i);
+}
+
+// Same steps as the SSE2 version, two pixels at a time
+void picasso__span_bilinear(uint32_t *dst, const uint32_t *row0, const uint32_t *row1,
+                            const int32_t *x, const uint16_t *fx, int n, uint32_t fy)
+{
+    const uint16x8_t round = vdupq_n_u16(128);
+    const uint16x8_t wy0 = vdupq_n_u16((uint16_t)(256 - fy));
+    const uint16x8_t wy1 = vdupq_n_u16((uint16_t)fy);
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint16x4_t h[2];
+        for (int k = 0; k < 2; ++k) {
+            uint16x8_t t = vmovl_u8(vld1_u8((const uint8_t *)(row0 + x[i + k])));
+            uint16x8_t b = vmovl_u8(vld1_u8((const uint8_t *)(row1 + x[i + k])));
+            uint16x8_t m = vshrq_n_u16(vaddq_u16(vmlaq_u16(vmulq_u16(t, wy0), b, wy1), round), 8);
+            uint16x8_t wx = vcombine_u16(vdup_n_u16((uint16_t)(256 - fx[i + k])),
+                                         vdup_n_u16(fx[i + k]));
+            uint16x8_t v = vmulq_u16(m, wx);
+            h[k] = vadd_u16(vget_low_u16(v), vget_high_u16(v));
+        }
+        uint16x8_t sum = vshrq_n_u16(vaddq_u16(vcombine_u16(h[0], h[1]), round), 8);
+        vst1_u8((uint8_t *)(dst + i), vmovn_u16(sum));
+    }
+    if (i < n) picasso__span_bilinear_scalar(dst + i, row0, row1, x + i, fx + i, n - i, fy);
+}
+
+// vld3 splits 16 pixels into r, g, b planes, vst4 puts them back with alpha
+void picasso__span_rgb_to_rgba(uint32_t *dst, const uint8_t *src, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x3_t v = vld3q_u8(src + 3 * i);
+        uint8x16x4_t out = { { v.val[0], v.val[1], v.val[2], vdupq_n_u8(0xFF) } };
+        vst4q_u8((uint8_t *)(dst + i), out);
+    }
+    if (i < n) picasso__span_rgb_to_rgba_scalar(dst + i, src + 3 * i, n - i);
+}
+
+// Same as SSE2, vcvtnq rounds to nearest even too
+void picasso__span_distance(uint8_t *coverage, const uint16_t *dist, int n, float edge, float slope)
+{
+    const float32x4_t e = vdupq_n_f32(edge), k = vdupq_n_f32(slope);
+    const float32x4_t lo = vdupq_n_f32(0), hi = vdupq_n_f32(255);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t d = vld1q_u16(dist + i);
+        uint16x4_t c[2];
+        for (int h = 0; h < 2; ++h) {
+            uint32x4_t w = vmovl_u16(h ? vget_high_u16(d) : vget_low_u16(d));
+            float32x4_t f = vmulq_f32(vsubq_f32(vcvtq_f32_u32(w), e), k);
+            c[h] = vqmovun_s32(vcvtnq_s32_f32(vminq_f32(vmaxq_f32(f, lo), hi)));
+        }
+        vst1_u8(coverage + i, vqmovn_u16(vcombine_u16(c[0], c[1])));
+    }
+    if (i < n) picasso__span_distance_scalar(coverage + i, dist + i, n - i, edge, slope);
+}
+
+/* Blend modes, 8 pixels per expression. Each channel is a plane of its own,
+ * widened to 16 bits, and the alphas are just the fourth plane */
+static inline uint16x8_t picasso__mul255_u16(uint16x8_t x, uint16x8_t y)
+{
+    uint16x8_t t = vaddq_u16(vmulq_u16(x, y), vdupq_n_u16(128));
+    return vshrq_n_u16(vsraq_n_u16(t, t, 8), 8);
+}
+
+#define MUL(x, y)       picasso__mul255_u16((x), (y))
+#define INV(x)          vsubq_u16(v255, (x))
+#define ADD(x, y)       vaddq_u16((x), (y))
+#define SUB(x, y)       vsubq_u16((x), (y))
+#define LOWER(x, y)     vminq_u16((x), (y))
+#define HIGHER(x, y)    vmaxq_u16((x), (y))
+#define ZERO            vdupq_n_u16(0)
+
+#define PICASSO_COMPOSITE(NAME, name, expr)                                           \
+    static void picasso__composite_##name(uint32_t *dst, const uint32_t *src,         \
+                                          const uint8_t *coverage, int n)              \
+    {                                                                                  \
+        const uint16x8_t v255 = vdupq_n_u16(255);                                     \
+        int i = 0;                                                                     \
+        for (; i + 8 <= n; i += 8) {                                                   \
+            uint8x8_t cov = vdup_n_u8(255);                                            \
+            if (coverage) {                                                            \
+                cov = vld1_u8(coverage + i);                                           \
+                if (vget_lane_u64(vreinterpret_u64_u8(cov), 0) == 0) continue;         \
+            }                                                                          \
+            uint16x8_t c = vmovl_u8(cov);                                              \
+                                                                                       \
+            uint8x8x4_t sv = vld4_u8((const uint8_t *)(src + i));                      \
+            uint8x8x4_t dv = vld4_u8((const uint8_t *)(dst + i));                      \
+            uint16x8_t sa = vmovl_u8(sv.val[3]), da = vmovl_u8(dv.val[3]);             \
+            (void)sa; (void)da;                                                        \
+            for (int k = 0; k < 4; ++k) {                                              \
+                uint16x8_t s = vmovl_u8(sv.val[k]), d = vmovl_u8(dv.val[k]);           \
+                (void)s;                                                               \
+                uint16x8_t r = vminq_u16(expr, v255);                                  \
+                r = vaddq_u16(MUL(r, c), MUL(d, INV(c)));                              \
+                dv.val[k] = vqmovn_u16(r);                                             \
+            }                                                                          \
+            vst4_u8((uint8_t *)(dst + i), dv);                                         \
+        }                                                                              \
+        if (i < n)                                                                     \
+            picasso__composite_##name##_scalar(dst + i, src + i,                       \
+                                               coverage ? coverage + i : NULL, n - i); \
+    }
+PICASSO_BLEND_MODES(PICASSO_COMPOSITE)
+#undef PICASSO_COMPOSITE
+
+#undef MUL
+#undef INV
+#undef ADD
+#undef SUB
+#undef LOWER
+#undef HIGHER
+#undef ZERO
+
+const char *picasso__span_backend(void)
+{
+    return "neon";
+}
+
+// --------------------------------------------------------
+// No SIMD, the reference kernels are the kernels
+// --------------------------------------------------------
+#else
+
+void picasso__span_fill(uint32_t *dst, int n, uint32_t src)
+{
+    picasso__span_fill_scalar(dst, n, src);
+}
+void picasso__span_blend(uint32_t *dst, const uint32_t *src, int n)
+{
+    picasso__span_blend_scalar(dst, src, n);
+}
+void picasso__span_mask(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src)
+{
+    picasso__span_mask_scalar(dst, coverage, n, src);
+}
+void picasso__span_bilinear(uint32_t *dst, const uint32_t *row0, const uint32_t *row1,
+                            const int32_t *x, const uint16_t *fx, int n, uint32_t fy)
+{
+    picasso__span_bilinear_scalar(dst, row0, row1, x, fx, n, fy);
+}
+void picasso__span_rgb_to_rgba(uint32_t *dst, const uint8_t *src, int n)
+{
+    picasso__span_rgb_to_rgba_scalar(dst, src, n);
+}
+void picasso__span_distance(uint8_t *coverage, const uint16_t *dist, int n, float edge, float slope)
+{
+    picasso__span_distance_scalar(coverage, dist, n, edge, slope);
+}
+void picasso__span_premultiply(uint32_t *px, int n)
+{
+    picasso__span_premultiply_scalar(px, n);
+}
+void picasso__span_modulate(uint32_t *px, int n, uint32_t c)
+{
+    picasso__span_modulate_scalar(px, n, c);
+}
+void picasso__span_downsample(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int n)
+{
+    picasso__span_downsample_scalar(dst, row0, row1, n);
+}
+
+#define PICASSO_COMPOSITE(NAME, name, expr)                                           \
+    static void picasso__composite_##name(uint32_t *dst, const uint32_t *src,         \
+                                          const uint8_t *coverage, int n)              \
+    {                                                                                  \
+        picasso__composite_##name##_scalar(dst, src, coverage, n);                     \
+    }
+PICASSO_BLEND_MODES(PICASSO_COMPOSITE)
+#undef PICASSO_COMPOSITE
+
+const char *picasso__span_backend(void)
+{
+    return "scalar";
+}
+
+#endif
+
+// --------------------------------------------------------
+// Blend mode dispatch
+// --------------------------------------------------------
+typedef void (*picasso_composite_fn)(uint32_t *dst, const uint32_t *src,
+                                     const uint8_t *coverage, int n);
+
+#define PICASSO_ENTRY(NAME, name, expr) [PICASSO_BLEND_##NAME] = picasso__composite_##name,
+static const picasso_composite_fn picasso__composite[PICASSO_BLEND_COUNT] = {
+    PICASSO_BLEND_MODES(PICASSO_ENTRY)
+};
+#undef PICASSO_ENTRY
+
+#define PICASSO_ENTRY(NAME, name, expr) [PICASSO_BLEND_##NAME] = picasso__composite_##name##_scalar,
+static const picasso_composite_fn picasso__composite_scalar[PICASSO_BLEND_COUNT] = {
+    PICASSO_BLEND_MODES(PICASSO_ENTRY)
+};
+#undef PICASSO_ENTRY
+
+void picasso__span_composite(uint32_t *dst, const uint32_t *src, const uint8_t *coverage,
+                             int n, picasso_blend_mode mode)
+{
+    if (n > 0 && (unsigned)mode < PICASSO_BLEND_COUNT)
+        picasso__composite[mode](dst, src, coverage, n);
+}
+
+void picasso__span_composite_scalar(uint32_t *dst, const uint32_t *src, const uint8_t *coverage,
+                                    int n, picasso_blend_mode mode)
+{
+    if (n > 0 && (unsigned)mode < PICASSO_BLEND_COUNT)
+        picasso__composite_scalar[mode](dst, src, coverage, n);
+}
+
+/* Solid colors go through the same row kernels, against a row of the
+ * premultiplied color that is filled once. Unlike source-over, a transparent
+ * color still changes things in most modes */
+static void picasso__composite_solid(picasso_composite_fn fn, uint32_t *dst,
+                                     const uint8_t *coverage, int n, uint32_t src)
+{
+    uint32_t row[PICASSO_SPAN_CHUNK];
+    uint32_t pre = picasso__premultiply(src);
+    for (int i = 0; i < PICASSO_MIN(n, PICASSO_SPAN_CHUNK); ++i) row[i] = pre;
+
+    for (int i = 0; i < n; i += PICASSO_SPAN_CHUNK)
+        fn(dst + i, row, coverage ? coverage + i : NULL, PICASSO_MIN(n - i, PICASSO_SPAN_CHUNK));
+}
+
+#define PICASSO_MODE_KERNELS(NAME, name, expr)                                             \
+    static void picasso__fill_##name(uint32_t *dst, int n, uint32_t src)                    \
+    {                                                                                        \
+        picasso__composite_solid(picasso__composite_##name, dst, NULL, n, src);             \
+    }                                                                                        \
+    static void picasso__blend_##name(uint32_t *dst, const uint32_t *src, int n)            \
+    {                                                                                        \
+        picasso__composite_##name(dst, src, NULL, n);                                       \
+    }                                                                                        \
+    static void picasso__mask_##name(uint32_t *dst, const uint8_t *coverage, int n,         \
+                                     uint32_t src)                                           \
+    {                                                                                        \
+        picasso__composite_solid(picasso__composite_##name, dst, coverage, n, src);         \
+    }
+PICASSO_OTHER_BLEND_MODES(PICASSO_MODE_KERNELS)
+#undef PICASSO_MODE_KERNELS
+
+#define PICASSO_ENTRY(NAME, name, expr) \
+    [PICASSO_BLEND_##NAME] = { picasso__fill_##name, picasso__blend_##name, picasso__mask_##name },
+const picasso_blend_kernels picasso__blend_kernels[PICASSO_BLEND_COUNT] = {
+    [PICASSO_BLEND_SRC_OVER] = { picasso__span_fill, picasso__span_blend, picasso__span_mask },
+    PICASSO_OTHER_BLEND_MODES(PICASSO_ENTRY)
+};
+#undef PICASSO_ENTRY
@@ -0,0 +1,406 @@
+#include <stdint.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Sprite atlases and batched sprites.
+ *
+ * The atlas is packed with a skyline: the top edge of everything placed so
+ * far, as a list of horizontal segments. Images go in tallest first, each at
+ * the spot along the skyline where its bottom ends up lowest, which keeps the
+ * packing tight for the many similar sized images of a sprite sheet.
+ *
+ * A sprite is a nearest sampled blit of an atlas cell, so one draw only
+ * needs a few things worked out per sprite: its pixel rect (which is also its
+ * exact bounds) and the source step. Every row is either read straight from
+ * the atlas, when the sprite is unscaled, unflipped and untinted, or gathered
+ * through a column table into a scratch row, and then written with the copy,
+ * alpha test or blend kernel.
+ *
+ * Recorded, consecutive sprites that stay close together share a command.
+ * Scattered ones (particles) get a command each, so the tiled submit bins
+ * them into the tiles they touch instead of every tile replaying the whole
+ * batch. */
+
+// Recorded runs of sprites are kept within this many pixels on either side
+#define PICASSO_SPRITE_RUN (2 * PICASSO_TILE_SIZE)
+
+// --------------------------------------------------------
+// Packing
+// --------------------------------------------------------
+
+typedef struct {
+    int x, y, width;
+} picasso_skyline_node;
+
+typedef struct {
+    int index, width, height;
+} picasso_pack_item;
+
+// Tallest first, then widest
+static int picasso__compare_items(const void *a, const void *b)
+{
+    const picasso_pack_item *p = a, *q = b;
+    if (p->height != q->height) return q->height - p->height;
+    if (p->width != q->width) return q->width - p->width;
+    return p->index - q->index;
+}
+
+/* Where an item w wide lands with its left edge on node i: the top of the
+ * highest node under it. -1 when it would stick out on the right */
+static int picasso__skyline_fit(const picasso_skyline_node *nodes, int i, int w, int atlas_w)
+{
+    if (nodes[i].x + w > atlas_w) return -1;
+
+    int y = 0;
+    for (int left = w; left > 0; left -= nodes[i++].width)
+        y = PICASSO_MAX(y, nodes[i].y);
+    return y;
+}
+
+// Raises the skyline over [x, x + w) to y, the new node goes in at i
+static void picasso__skyline_add(picasso_skyline_node *nodes, int *count, int i,
+                                 int x, int y, int w)
+{
+    memmove(&nodes[i + 1], &nodes[i], (size_t)(*count - i) * sizeof(*nodes));
+    nodes[i] = (picasso_skyline_node){ x, y, w };
+    (*count)++;
+
+    // The nodes it covers shrink or go
+    while (i + 1 < *count && nodes[i + 1].x < x + w) {
+        picasso_skyline_node *n = &nodes[i + 1];
+        int cut = x + w - n->x;
+        if (cut < n->width) {
+            n->x += cut;
+            n->width -= cut;
+            break;
+        }
+        memmove(n, n + 1, (size_t)(*count - i - 2) * sizeof(*nodes));
+        (*count)--;
+    }
+
+    // Neighbors at the same height become one
+    for (int k = 0; k + 1 < *count;) {
+        if (nodes[k].y == nodes[k + 1].y) {
+            nodes[k].width += nodes[k + 1].width;
+            memmove(&nodes[k + 1], &nodes[k + 2], (size_t)(*count - k - 2) * sizeof(*nodes));
+            (*count)--;
+        } else {
+            ++k;
+        }
+    }
+}
+
+/* Places every item, tallest first, and returns the height used. The
+ * skyline starts as one node across the whole width and gains at most one
+ * node per item */
+static int picasso__pack(picasso_pack_item *items, int count, int atlas_w, picasso_rect *rects)
+{
+    picasso_skyline_node *nodes = picasso_malloc((size_t)(count + 1) * sizeof(*nodes));
+    if (!nodes) return -1;
+    int node_count = 1;
+    nodes[0] = (picasso_skyline_node){ 0, 0, atlas_w };
+    int height = 0;
+
+    qsort(items, (size_t)count, sizeof(*items), picasso__compare_items);
+    for (int k = 0; k < count; ++k) {
+        const picasso_pack_item *it = &items[k];
+        if (it->width == 0) {
+            rects[it->index] = (picasso_rect){0};
+            continue;
+        }
+
+        int best = -1, best_y = 0;
+        for (int i = 0; i < node_count; ++i) {
+            int y = picasso__skyline_fit(nodes, i, it->width, atlas_w);
+            if (y >= 0 && (best < 0 || y < best_y)) {
+                best = i;
+                best_y = y;
+            }
+        }
+        // The atlas is at least as wide as the widest item, node 0 always fits
+        int x = nodes[best].x;
+        rects[it->index] = (picasso_rect){ x, best_y, it->width, it->height };
+        picasso__skyline_add(nodes, &node_count, best, x, best_y + it->height, it->width);
+        height = PICASSO_MAX(height, best_y + it->height);
+    }
+
+    picasso_free(nodes);
+    return height;
+}
+
+// --------------------------------------------------------
+// Atlases
+// --------------------------------------------------------
+
+// Alpha kind of the cells only, the gaps between them are transparent
+static picasso_alpha picasso__cells_alpha(const picasso_atlas *atlas)
+{
+    const picasso_image *img = atlas->image;
+    bool opaque = true;
+    for (int i = 0; i < atlas->count; ++i) {
+        const picasso_rect *r = &atlas->rects[i];
+        for (int y = r->y; y < r->y + r->height; ++y) {
+            const uint8_t *a = &img->pixels[y * img->row_stride + r->x * 4 + 3];
+            for (int x = 0; x < r->width; ++x, a += 4) {
+                if (*a == 255) continue;
+                if (*a != 0) return PICASSO_ALPHA_BLEND;
+                opaque = false;
+            }
+        }
+    }
+    return opaque ? PICASSO_ALPHA_OPAQUE : PICASSO_ALPHA_MASK;
+}
+
+picasso_atlas *picasso_create_atlas(picasso_image *const *images, int count)
+{
+    if (!images || count <= 0) return NULL;
+
+    picasso_atlas *atlas = picasso_calloc(1, sizeof(picasso_atlas));
+    picasso_pack_item *items = picasso_malloc((size_t)count * sizeof(*items));
+    if (!atlas || !items) goto fail;
+    atlas->rects = picasso_calloc((size_t)count, sizeof(picasso_rect));
+    if (!atlas->rects) goto fail;
+    atlas->count = count;
+
+    // Wide enough for the widest image, and about square
+    int64_t area = 0;
+    int max_w = 1;
+    for (int i = 0; i < count; ++i) {
+        const picasso_image *img = images[i];
+        bool valid = img && img->pixels && img->channels >= 1 && img->channels <= 4;
+        if (!valid) WARN("Atlas image %d is missing, its rect stays empty", i);
+        items[i] = (picasso_pack_item){ i, valid ? img->width : 0, valid ? img->height : 0 };
+        area += (int64_t)items[i].width * items[i].height;
+        max_w = PICASSO_MAX(max_w, items[i].width);
+    }
+    int width = PICASSO_MAX(max_w, (int)ceil(sqrt((double)area)));
+    if (width > PICASSO_MAX_DIM) {
+        ERROR("Atlas of %d images would be wider than %d", count, PICASSO_MAX_DIM);
+        goto fail;
+    }
+
+    int height = picasso__pack(items, count, width, atlas->rects);
+    if (height < 0 || height > PICASSO_MAX_DIM) {
+        ERROR("Failed to pack %d images into an atlas %d wide", count, width);
+        goto fail;
+    }
+
+    atlas->image = picasso_alloc_image(width, PICASSO_MAX(height, 1), 4);
+    if (!atlas->image) goto fail;
+
+    // Every cell converted to premultiplied backbuffer pixels
+    for (int i = 0; i < count; ++i) {
+        const picasso_rect *r = &atlas->rects[i];
+        picasso_image *img = images[i];
+        for (int y = 0; y < r->height; ++y) {
+            for (int x = 0; x < r->width; ++x) {
+                color c = get_color_u8(picasso__get_pixel_u8(img, x, y), img->channels);
+                uint32_t p = color_to_u32(c);
+                if (!img->premultiplied) p = picasso__premultiply(p);
+                memcpy(picasso__get_pixel_u8(atlas->image, r->x + x, r->y + y), &p, sizeof(p));
+            }
+        }
+    }
+    atlas->image->premultiplied = true;
+    atlas->image->alpha = picasso__cells_alpha(atlas);
+
+    DEBUG("Packed %d images into a %dx%d atlas, %.0f%% used", count, width, height,
+          height ? 100.0 * (double)area / ((double)width * height) : 0.0);
+    picasso_free(items);
+    return atlas;
+
+fail:
+    picasso_free(items);
+    picasso_destroy_atlas(atlas);
+    return NULL;
+}
+
+void picasso_destroy_atlas(picasso_atlas *atlas)
+{
+    if (!atlas) return;
+    picasso_free_image(atlas->image);
+    picasso_free(atlas->rects);
+    picasso_free(atlas);
+}
+
+// --------------------------------------------------------
+// Drawing
+// --------------------------------------------------------
+
+/* The source rect clamped to the atlas and the pixels it is drawn to. False
+ * when the sprite draws nothing */
+static bool picasso__sprite_rects(const picasso_backbuffer *bf, const picasso_image *img,
+                                  const picasso_sprite *s, picasso_rect *src, picasso_rect *px)
+{
+    // Same clamping as picasso_blit
+    *src = s->src;
+    picasso__normalize_rect(src);
+    if (src->x < 0) src->x = 0;
+    if (src->y < 0) src->y = 0;
+    if (src->x + src->width > img->width) src->width = img->width - src->x;
+    if (src->y + src->height > img->height) src->height = img->height - src->y;
+    if (src->width <= 0 || src->height <= 0) return false;
+
+    float scale = s->scale > 0.0f ? s->scale : 1.0f; // NaN is 1 too
+    float x = picasso__to_px_xf(bf, s->x), y = picasso__to_px_yf(bf, s->y);
+    float w = (float)src->width * scale * bf->scale_x;
+    float h = (float)src->height * scale * bf->scale_y;
+
+    // Far out or NaN positions and sizes draw nothing, and keep the ints safe
+    const float limit = PICASSO_SUBPIXEL_LIMIT;
+    if (!(fabsf(x) <= limit && fabsf(y) <= limit && w <= limit && h <= limit))
+        return false;
+
+    *px = (picasso_rect){ (int)lroundf(x), (int)lroundf(y), (int)lroundf(w), (int)lroundf(h) };
+    return px->width > 0 && px->height > 0;
+}
+
+// Texel under the center of pixel i, in [0, size)
+static inline int picasso__sprite_texel(int i, int64_t step, int size)
+{
+    int64_t t = ((int64_t)i * step + step / 2) >> 16;
+    return t < size ? (int)t : size - 1;
+}
+
+picasso_draw_bounds picasso__sprite_bounds(picasso_backbuffer *bf, const picasso_atlas *atlas,
+                                           const picasso_sprite *sprites, int count)
+{
+    picasso_draw_bounds b = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+    for (int i = 0; i < count; ++i) {
+        picasso_rect src, px;
+        if (!picasso__sprite_rects(bf, atlas->image, &sprites[i], &src, &px)) continue;
+        b.x0 = PICASSO_MIN(b.x0, px.x);
+        b.y0 = PICASSO_MIN(b.y0, px.y);
+        b.x1 = PICASSO_MAX(b.x1, px.x + px.width);
+        b.y1 = PICASSO_MAX(b.y1, px.y + px.height);
+    }
+    return b.x0 < b.x1 ? b : (picasso_draw_bounds){0};
+}
+
+/* Records runs of sprites that stay within PICASSO_SPRITE_RUN of each other
+ * as one command. A sprite that would stretch the run starts the next one */
+static void picasso__record_sprites(picasso_backbuffer *bf, const picasso_atlas *atlas,
+                                    const picasso_sprite *sprites, int count)
+{
+    int first = 0;
+    picasso_draw_bounds run = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+    for (int i = 0; i < count; ++i) {
+        picasso_rect src, px;
+        if (!picasso__sprite_rects(bf, atlas->image, &sprites[i], &src, &px)) continue;
+
+        picasso_draw_bounds u = {
+            PICASSO_MIN(run.x0, px.x), PICASSO_MIN(run.y0, px.y),
+            PICASSO_MAX(run.x1, px.x + px.width), PICASSO_MAX(run.y1, px.y + px.height) };
+        bool fits = (int64_t)u.x1 - u.x0 <= PICASSO_SPRITE_RUN &&
+                    (int64_t)u.y1 - u.y0 <= PICASSO_SPRITE_RUN;
+        if (!fits && run.x0 < run.x1) {
+            picasso__record(bf, &(picasso_cmd){ .type = PICASSO_CMD_SPRITES,
+                                                .sprites = { atlas, sprites + first, i - first } });
+            first = i;
+            u = (picasso_draw_bounds){ px.x, px.y, px.x + px.width, px.y + px.height };
+        }
+        run = u;
+    }
+    if (run.x0 < run.x1)
+        picasso__record(bf, &(picasso_cmd){ .type = PICASSO_CMD_SPRITES,
+                                            .sprites = { atlas, sprites + first, count - first } });
+}
+
+void picasso_draw_sprites(picasso_backbuffer *bf, const picasso_atlas *atlas,
+                          const picasso_sprite *sprites, int count)
+{
+    if (!bf || !bf->pixels || !atlas || !atlas->image || !sprites || count <= 0) return;
+    const picasso_image *img = atlas->image;
+    if (img->channels != 4 || !img->premultiplied) {
+        WARN("Sprites need an atlas from picasso_create_atlas");
+        return;
+    }
+
+    if (bf->cmdlist && bf->cmdlist->recording) {
+        picasso__record_sprites(bf, atlas, sprites, count);
+        return;
+    }
+    if (bf->track_damage)
+        picasso__damage_cmd(bf, &(picasso_cmd){ .type = PICASSO_CMD_SPRITES,
+                                                .sprites = { atlas, sprites, count } });
+
+    picasso_draw_bounds cb = picasso__clip_bounds(bf);
+    const picasso_blend_kernels *kernels = picasso__kernels(bf);
+    bool over = bf->blend == PICASSO_BLEND_SRC_OVER;
+
+    // Column table and row for sprites that can't be read in place, grown
+    // to the widest one drawn
+    int32_t *cols = NULL;
+    uint32_t *row = NULL;
+    int scratch = 0;
+
+    for (int i = 0; i < count; ++i) {
+        const picasso_sprite *s = &sprites[i];
+        picasso_rect src, px;
+        if (!picasso__sprite_rects(bf, img, s, &src, &px)) continue;
+        if (px.x >= cb.x1 || px.y >= cb.y1 || px.x + px.width <= cb.x0 || px.y + px.height <= cb.y0)
+            continue;
+
+        picasso_draw_bounds b = {
+            PICASSO_MAX(px.x, cb.x0), PICASSO_MAX(px.y, cb.y0),
+            PICASSO_MIN(px.x + px.width, cb.x1), PICASSO_MIN(px.y + px.height, cb.y1) };
+        int n = b.x1 - b.x0;
+
+        uint32_t tint = color_to_u32(s->tint);
+        bool tinted = tint != 0xFFFFFFFFu;
+        bool flip_x = s->flags & PICASSO_SPRITE_FLIP_X;
+        bool flip_y = s->flags & PICASSO_SPRITE_FLIP_Y;
+        int64_t step_x = ((int64_t)src.width << 16) / px.width;
+        int64_t step_y = ((int64_t)src.height << 16) / px.height;
+
+        // An opaque tint keeps opaque texels opaque and empty ones empty
+        picasso_write_fn write = kernels->blend;
+        if (over && s->tint.a == 255 && img->alpha == PICASSO_ALPHA_OPAQUE)
+            write = picasso__write_copy;
+        else if (over && s->tint.a == 255 && img->alpha == PICASSO_ALPHA_MASK)
+            write = picasso__write_test;
+
+        bool in_place = !tinted && !flip_x && step_x == 1 << 16 && img->layout == PICASSO_LAYOUT_LINEAR;
+        if (!in_place) {
+            if (n > scratch) {
+                int32_t *grown = picasso_realloc(cols, (size_t)n * (sizeof(int32_t) + sizeof(uint32_t)));
+                if (!grown) {
+                    ERROR("Out of memory drawing a sprite %d wide", n);
+                    break;
+                }
+                cols = grown;
+                scratch = n;
+            }
+            row = (uint32_t *)(cols + scratch);
+
+            // Nearest texel of every column, the same as picasso_blit picks,
+            // counted in texels from the start of the row. Flipped, the
+            // columns are taken from the other end
+            for (int k = 0; k < n; ++k) {
+                int i = b.x0 - px.x + k;
+                int x = src.x + picasso__sprite_texel(flip_x ? px.width - 1 - i : i, step_x, src.width);
+                cols[k] = (int32_t)(picasso__col_offset(img, x) / sizeof(uint32_t));
+            }
+        }
+        uint32_t tint_px = picasso__premultiply(tint);
+
+        for (int y = b.y0; y < b.y1; ++y) {
+            int i = y - px.y;
+            int sy = src.y + picasso__sprite_texel(flip_y ? px.height - 1 - i : i, step_y, src.height);
+            const uint32_t *texels = (const uint32_t *)&img->pixels[picasso__row_offset(img, sy)];
+            uint32_t *dst = picasso__get_pixel_u32(bf, b.x0, y);
+
+            if (in_place) {
+                write(dst, texels + src.x + (b.x0 - px.x), n);
+                continue;
+            }
+            for (int k = 0; k < n; ++k) row[k] = texels[cols[k]];
+            if (tinted) picasso__span_modulate(row, n, tint_px);
+            write(dst, row, n);
+        }
+    }
+
+    picasso_free(cols);
+}
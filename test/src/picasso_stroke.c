@@ -0,0 +1,318 @@
+#include <stdint.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Strokes, turned into outlines and filled with the path rasterizer.
+ *
+ * Every contour of the flattened path becomes one closed loop: along its left
+ * side, around the end cap, back along the right side and around the start
+ * cap. The right side is just the left side of the reversed contour, so both
+ * are built by the same walk. A closed contour becomes two loops instead, the
+ * left side forwards and the right side backwards, which wind opposite ways
+ * and leave the inside empty.
+ *
+ * At a corner the outer side gets the join (miter, round or bevel). The inner
+ * side goes through the corner point itself, which makes a small loop that
+ * the nonzero fill covers anyway. That keeps every loop a single outline, so
+ * the parts of a stroke never overlap at its edges and the anti-aliasing
+ * along them is exact. */
+
+#define PICASSO_STROKE_TOLERANCE 0.2f  // pixels, for round joins and caps
+#define PICASSO_STROKE_MIN_DIST2 1e-6f // closer points are merged, squared pixels
+#define PICASSO_DEFAULT_MITER    4.0f
+
+typedef struct {
+    picasso_outline *o;
+    const picasso_stroke_style *style;
+    float h;           // half the width, in pixels
+    float arc_step;    // radians per line of round joins and caps
+    float miter_cos;   // miters are beveled when the half angle cosine is below this
+
+    float *pts;        // the current contour, x, y pairs
+    int count, capacity;
+
+    bool has_segment;  // a line was drawn, even one too short to keep a point
+
+    float fx, fy, lx, ly; // first and last point of the loop being emitted
+    bool in_loop;
+} picasso_stroker;
+
+// --------------------------------------------------------
+// Loops
+// --------------------------------------------------------
+
+static inline void picasso__loop_to(picasso_stroker *st, float x, float y)
+{
+    if (!st->in_loop) {
+        st->fx = st->lx = x;
+        st->fy = st->ly = y;
+        st->in_loop = true;
+        return;
+    }
+    picasso__outline_add(st->o, st->lx, st->ly, x, y);
+    st->lx = x;
+    st->ly = y;
+}
+
+static inline void picasso__loop_close(picasso_stroker *st)
+{
+    if (st->in_loop) picasso__outline_add(st->o, st->lx, st->ly, st->fx, st->fy);
+    st->in_loop = false;
+}
+
+// Points on the circle of radius h around (cx, cy), from direction (vx, vy)
+// turning by angle, without the first point and with the last
+static void picasso__arc(picasso_stroker *st, float cx, float cy, float vx, float vy, float angle)
+{
+    int steps = (int)ceilf(fabsf(angle) / st->arc_step);
+    if (steps < 1) steps = 1;
+    float step = angle / (float)steps, c = cosf(step), s = sinf(step);
+
+    for (int i = 0; i < steps; ++i) {
+        float x = vx * c - vy * s;
+        vy = vx * s + vy * c;
+        vx = x;
+        picasso__loop_to(st, cx + vx * st->h, cy + vy * st->h);
+    }
+}
+
+// --------------------------------------------------------
+// Joins and caps
+// --------------------------------------------------------
+
+// Unit direction from a to b, the points are never closer than MIN_DIST
+static inline void picasso__direction(const float *a, const float *b, float *dx, float *dy)
+{
+    float x = b[0] - a[0], y = b[1] - a[1];
+    float inv = 1.0f / sqrtf(x * x + y * y);
+    *dx = x * inv;
+    *dy = y * inv;
+}
+
+/* The left side around corner p, coming in along d0 and leaving along d1.
+ * The left normal of (dx, dy) is (-dy, dx) */
+static void picasso__join(picasso_stroker *st, const float *p, float d0x, float d0y,
+                          float d1x, float d1y)
+{
+    float h = st->h;
+    float n0x = -d0y, n0y = d0x, n1x = -d1y, n1y = d1x;
+    float cross = d0x * d1y - d0y * d1x, dot = d0x * d1x + d0y * d1y;
+
+    picasso__loop_to(st, p[0] + n0x * h, p[1] + n0y * h);
+
+    // Turning left, this is the inner side
+    if (cross > 0) {
+        picasso__loop_to(st, p[0], p[1]);
+    } else if (cross < 0 || dot < 0) {
+        switch (st->style->join) {
+        case PICASSO_JOIN_ROUND:
+            // Always turning right, a U-turn goes around the front. cross is
+            // 0 or less here, and fabsf keeps an exact U-turn's +0 from
+            // flipping atan2f to -pi and the arc to the back
+            picasso__arc(st, p[0], p[1], n0x, n0y, -atan2f(fabsf(cross), dot));
+            return;
+        case PICASSO_JOIN_MITER: {
+            float mx = n0x + n1x, my = n0y + n1y;
+            float len = sqrtf(mx * mx + my * my);
+            float cos_half = len * 0.5f; // the angle between the bisector and a normal
+            if (cos_half > st->miter_cos) {
+                float k = h / (cos_half * len);
+                picasso__loop_to(st, p[0] + mx * k, p[1] + my * k);
+            }
+            break;
+        }
+        case PICASSO_JOIN_BEVEL:
+            break;
+        }
+    }
+
+    picasso__loop_to(st, p[0] + n1x * h, p[1] + n1y * h);
+}
+
+// From the left of end point p to its right, leaving along (dx, dy)
+static void picasso__cap(picasso_stroker *st, const float *p, float dx, float dy)
+{
+    float h = st->h;
+    switch (st->style->cap) {
+    case PICASSO_CAP_ROUND:
+        picasso__arc(st, p[0], p[1], -dy, dx, -(float)M_PI);
+        break;
+    case PICASSO_CAP_SQUARE:
+        picasso__loop_to(st, p[0] + (dx - dy) * h, p[1] + (dy + dx) * h);
+        picasso__loop_to(st, p[0] + (dx + dy) * h, p[1] + (dy - dx) * h);
+        break;
+    case PICASSO_CAP_BUTT:
+        break;
+    }
+}
+
+// --------------------------------------------------------
+// Contours
+// --------------------------------------------------------
+
+/* The left side of the contour, walked backwards when reversed. Open, it
+ * starts at the left of the first point and ends at the left of the last.
+ * Closed, every point is a corner */
+static void picasso__side(picasso_stroker *st, bool closed, bool reversed)
+{
+    int n = st->count;
+    #define PT(i) (&st->pts[2 * (reversed ? n - 1 - (i) : (i))])
+
+    float dx, dy, px, py;
+    if (!closed) {
+        picasso__direction(PT(0), PT(1), &dx, &dy);
+        picasso__loop_to(st, PT(0)[0] - dy * st->h, PT(0)[1] + dx * st->h);
+        for (int i = 1; i < n - 1; ++i) {
+            picasso__direction(PT(i), PT(i + 1), &px, &py);
+            picasso__join(st, PT(i), dx, dy, px, py);
+            dx = px;
+            dy = py;
+        }
+        picasso__loop_to(st, PT(n - 1)[0] - dy * st->h, PT(n - 1)[1] + dx * st->h);
+    } else {
+        picasso__direction(PT(n - 1), PT(0), &dx, &dy);
+        for (int i = 0; i < n; ++i) {
+            picasso__direction(PT(i), PT((i + 1) % n), &px, &py);
+            picasso__join(st, PT(i), dx, dy, px, py);
+            dx = px;
+            dy = py;
+        }
+    }
+    #undef PT
+}
+
+static void picasso__stroke_contour(picasso_stroker *st, bool closed)
+{
+    int n = st->count;
+    if (n == 0) return;
+
+    // A closed contour ending where it started has that point twice
+    if (closed && n > 1) {
+        float dx = st->pts[2 * n - 2] - st->pts[0], dy = st->pts[2 * n - 1] - st->pts[1];
+        if (dx * dx + dy * dy < PICASSO_STROKE_MIN_DIST2) n = --st->count;
+    }
+
+    // A lone point only shows its caps, as a dot or a square, and only if
+    // a line got it there. Just a move draws nothing
+    if (n == 1) {
+        if (!st->has_segment) return;
+        const float *p = st->pts;
+        if (st->style->cap == PICASSO_CAP_ROUND) {
+            picasso__loop_to(st, p[0] + st->h, p[1]);
+            picasso__arc(st, p[0], p[1], 1, 0, 2 * (float)M_PI);
+        } else if (st->style->cap == PICASSO_CAP_SQUARE) {
+            picasso__loop_to(st, p[0] - st->h, p[1] - st->h);
+            picasso__loop_to(st, p[0] + st->h, p[1] - st->h);
+            picasso__loop_to(st, p[0] + st->h, p[1] + st->h);
+            picasso__loop_to(st, p[0] - st->h, p[1] + st->h);
+        }
+        picasso__loop_close(st);
+        return;
+    }
+
+    if (closed && n > 2) {
+        picasso__side(st, true, false);
+        picasso__loop_close(st);
+        picasso__side(st, true, true);
+        picasso__loop_close(st);
+        return;
+    }
+
+    float dx, dy;
+    picasso__side(st, false, false);
+    picasso__direction(&st->pts[2 * n - 4], &st->pts[2 * n - 2], &dx, &dy);
+    picasso__cap(st, &st->pts[2 * n - 2], dx, dy);
+    picasso__side(st, false, true);
+    picasso__direction(&st->pts[2], &st->pts[0], &dx, &dy);
+    picasso__cap(st, &st->pts[0], dx, dy);
+    picasso__loop_close(st);
+}
+
+static void picasso__stroke_emit(void *ctx, picasso_path_verb verb, float x, float y)
+{
+    picasso_stroker *st = ctx;
+
+    if (verb == PICASSO_PATH_MOVE || verb == PICASSO_PATH_CLOSE) {
+        picasso__stroke_contour(st, verb == PICASSO_PATH_CLOSE);
+        st->count = 0;
+        st->has_segment = false;
+    } else if (st->count > 0) {
+        st->has_segment = true;
+        float dx = x - st->pts[2 * st->count - 2], dy = y - st->pts[2 * st->count - 1];
+        if (dx * dx + dy * dy < PICASSO_STROKE_MIN_DIST2) return;
+    }
+
+    if (st->count == st->capacity) {
+        int capacity = st->capacity ? st->capacity * 2 : 64;
+        float *pts = picasso_realloc(st->pts, (size_t)capacity * 2 * sizeof(float));
+        if (!pts) {
+            ERROR("Out of memory stroking a contour of %d points", st->count);
+            st->o->failed = true;
+            return;
+        }
+        st->pts = pts;
+        st->capacity = capacity;
+    }
+    st->pts[2 * st->count] = x;
+    st->pts[2 * st->count + 1] = y;
+    st->count++;
+}
+
+// --------------------------------------------------------
+// Stroking
+// --------------------------------------------------------
+
+float picasso__stroke_margin(float half_width, const picasso_stroke_style *style)
+{
+    // Below one width a miter limit bevels every corner
+    float k = 1.0f;
+    if (style->join == PICASSO_JOIN_MITER)
+        k = fmaxf(style->miter_limit > 0 ? style->miter_limit : PICASSO_DEFAULT_MITER, 1.0f);
+    if (style->cap == PICASSO_CAP_SQUARE)
+        k = fmaxf(k, (float)M_SQRT2);
+    return half_width * k + 1.0f;
+}
+
+void picasso__stroke(picasso_backbuffer *bf, const picasso_path *path, float scale_x,
+                     float scale_y, float half_width, const picasso_stroke_style *style,
+                     color c)
+{
+    if (!(half_width > 0) || path->verb_count == 0 || c.a == 0) return;
+
+    picasso_outline o = {0};
+    float limit = style->miter_limit > 0 ? style->miter_limit : PICASSO_DEFAULT_MITER;
+    picasso_stroker st = {
+        .o = &o,
+        .style = style,
+        .h = half_width,
+        // A chord of an arc of radius h is within the tolerance of it
+        .arc_step = half_width > PICASSO_STROKE_TOLERANCE
+                  ? 2.0f * acosf(1.0f - PICASSO_STROKE_TOLERANCE / half_width)
+                  : (float)M_PI / 2,
+        // Inner to outer corner the miter is 2h / cos(half angle) long, and
+        // the limit is in widths
+        .miter_cos = 1.0f / limit,
+    };
+
+    picasso__flatten_path(path, scale_x, scale_y, picasso__stroke_emit, &st);
+    picasso__stroke_contour(&st, false);
+
+    if (!o.failed) picasso__fill_outline(bf, &o, PICASSO_FILL_NONZERO, c);
+
+    picasso_free(st.pts);
+    picasso__outline_free(&o);
+}
+
+void picasso_stroke_path(picasso_backbuffer *bf, const picasso_path *path,
+                         const picasso_stroke_style *style, color c)
+{
+    if (!bf || !path || !style || path->verb_count == 0 || c.a == 0) return;
+
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_STROKE_PATH, .c = c,
+                   .stroke = { path, *style });
+
+    float h = style->width * (bf->scale_x + bf->scale_y) * 0.25f;
+    picasso__stroke(bf, path, bf->scale_x, bf->scale_y, h, style, c);
+}
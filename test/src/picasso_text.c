@@ -0,0 +1,1102 @@
+#define STB_TRUETYPE_IMPLEMENTATION
+#define STBTT_malloc(x, u) ((void)(u), picasso_malloc(x))
+#define STBTT_free(x, u)   ((void)(u), picasso_free(x))
+
+#include <stdint.h>
+#include <string.h>
+#include <blackbox.h>
+
+#include "picasso_internal.h"
+
+/* Text, through stb_truetype.
+ *
+ * Rasterizing an outline is by far the slowest part of drawing a glyph, so
+ * every glyph is rasterized once into a glyph cache shared by all fonts and
+ * drawn from there as coverage, through the mask kernel of the blend mode.
+ * Glyphs are keyed by font, pixel size, codepoint and one of
+ * PICASSO_GLYPH_SUBPIXEL horizontal offsets: pens advance by fractions of a
+ * pixel, and a glyph snapped to whole pixels visibly wobbles along a line.
+ *
+ * The cache is an A8 atlas cut into shelves, rows as high as the glyphs in
+ * them (rounded up to PICASSO_GLYPH_ROUND) that fill up left to right. When no
+ * shelf of its height has room for a glyph and there is no room for a new
+ * shelf, the shelves drawn from longest ago are emptied and reused. Evicting
+ * whole shelves keeps the packing trivial, and it frees room for glyphs of
+ * the same height, which is what comes next.
+ *
+ * Before any of that, text is laid out: decoded, kerned and broken into
+ * lines. The advances of the first 256 codepoints are read out of the font
+ * once, and kerning pairs once each, since walking the hmtx, kern and GPOS
+ * tables is what laying out costs. Laid out text goes into a layout cache
+ * keyed by the bytes of the string (not the pointer, strings get rewritten in
+ * place), the font, the size and the wrap width. A string drawn every frame
+ * costs a hash of its bytes.
+ *
+ * Recorded text is replayed on the render threads, which only look glyphs
+ * up. Recording lays the text out and rasterizes the missing glyphs right
+ * away, and pins both until the submit so text recorded later in the frame
+ * can't evict them. */
+
+#define PICASSO_GLYPH_ATLAS    1024  // width and height of the atlas
+#define PICASSO_GLYPH_ROUND    4     // shelf heights are multiples of this
+#define PICASSO_GLYPH_SUBPIXEL 4     // horizontal offsets per pixel
+#define PICASSO_GLYPH_SHELVES  (PICASSO_GLYPH_ATLAS / PICASSO_GLYPH_ROUND)
+#define PICASSO_LAYOUT_CACHE   4096  // layouts kept, more while pinned
+#define PICASSO_LAYOUT_BUCKETS 8192
+
+typedef struct {
+    uint32_t font, codepoint;
+    float size;          // pixel height
+    int subpixel;
+} picasso_glyph_key;
+
+typedef struct {
+    picasso_glyph_key key;
+    int x, y, w, h;      // in the atlas, w and h are 0 for blank glyphs
+    int xoff, yoff;      // top left from the pen on the baseline
+    int shelf;           // -1 for blank glyphs
+    int next;            // in the bucket, or the free list
+} picasso_glyph;
+
+typedef struct {
+    int y, height;
+    int x;               // the next free column
+    uint64_t used;       // tick it was last drawn from
+} picasso_shelf;
+
+typedef struct {
+    picasso_image *atlas;
+
+    picasso_glyph *glyphs;
+    int capacity, count, free_glyph;
+    int *buckets;        // power of two many chains, -1 ends them
+    int bucket_count;
+
+    picasso_shelf shelves[PICASSO_GLYPH_SHELVES];
+    int shelf_count, top;
+
+    uint64_t tick;       // one per drawn or recorded text
+    uint64_t pinned;     // shelves used at or after this tick stay
+    bool recording;      // text was recorded since the last submit
+    bool full;           // warned about the atlas being full
+
+    int fonts;           // alive, the cache goes with the last one
+    uint32_t next_id;
+} picasso_glyph_cache;
+
+static picasso_glyph_cache picasso__cache;
+
+typedef struct {
+    picasso_text_layout *buckets[PICASSO_LAYOUT_BUCKETS];
+    picasso_text_layout *oldest, *newest;
+    int count;
+    picasso_laid_glyph *scratch;  // layouts are built here, then copied
+    size_t scratch_capacity;
+} picasso_layout_cache;
+
+static picasso_layout_cache picasso__layouts;
+
+// --------------------------------------------------------
+// Glyph cache
+// --------------------------------------------------------
+
+static uint32_t picasso__glyph_hash(picasso_glyph_key k)
+{
+    uint32_t size;
+    memcpy(&size, &k.size, sizeof(size));
+    uint32_t h = k.font * 0x9E3779B1u ^ k.codepoint * 0x85EBCA77u ^ size * 0xC2B2AE3Du ^
+                 (uint32_t)k.subpixel;
+    return h ^ (h >> 15);
+}
+
+static bool picasso__glyph_key_eq(picasso_glyph_key a, picasso_glyph_key b)
+{
+    return a.font == b.font && a.codepoint == b.codepoint && a.size == b.size &&
+           a.subpixel == b.subpixel;
+}
+
+static void picasso__cache_free(void)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    picasso_free_image(c->atlas);
+    picasso_free(c->glyphs);
+    picasso_free(c->buckets);
+    int fonts = c->fonts;
+    uint32_t next_id = c->next_id;
+    *c = (picasso_glyph_cache){ .fonts = fonts, .next_id = next_id };
+}
+
+static bool picasso__cache_init(void)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    if (c->atlas) return true;
+
+    c->atlas = picasso_alloc_image(PICASSO_GLYPH_ATLAS, PICASSO_GLYPH_ATLAS, 1);
+    c->bucket_count = 256;
+    c->buckets = picasso_malloc((size_t)c->bucket_count * sizeof(int));
+    if (!c->atlas || !c->buckets) {
+        ERROR("Out of memory creating the glyph cache");
+        picasso__cache_free();
+        return false;
+    }
+    memset(c->buckets, 0xFF, (size_t)c->bucket_count * sizeof(int));
+    c->free_glyph = -1;
+    return true;
+}
+
+// Looks a glyph up, never changes the cache, so render threads can too
+static const picasso_glyph *picasso__glyph_find(picasso_glyph_key k)
+{
+    const picasso_glyph_cache *c = &picasso__cache;
+    if (!c->buckets) return NULL;
+
+    for (int i = c->buckets[picasso__glyph_hash(k) & (c->bucket_count - 1)]; i >= 0;
+         i = c->glyphs[i].next) {
+        if (picasso__glyph_key_eq(c->glyphs[i].key, k)) return &c->glyphs[i];
+    }
+    return NULL;
+}
+
+// Unlinks every glyph of the shelf (or, with shelf -1, of the font)
+static void picasso__glyphs_drop(int shelf, uint32_t font)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    for (int b = 0; b < c->bucket_count; ++b) {
+        for (int *link = &c->buckets[b]; *link >= 0;) {
+            picasso_glyph *g = &c->glyphs[*link];
+            if (shelf >= 0 ? g->shelf == shelf : g->key.font == font) {
+                int i = *link;
+                *link = g->next;
+                g->next = c->free_glyph;
+                c->free_glyph = i;
+                c->count--;
+            } else {
+                link = &g->next;
+            }
+        }
+    }
+}
+
+static bool picasso__glyphs_rehash(int bucket_count)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    int *buckets = picasso_malloc((size_t)bucket_count * sizeof(int));
+    if (!buckets) return false;
+    memset(buckets, 0xFF, (size_t)bucket_count * sizeof(int));
+
+    for (int b = 0; b < c->bucket_count; ++b) {
+        for (int i = c->buckets[b], next; i >= 0; i = next) {
+            next = c->glyphs[i].next;
+            int *chain = &buckets[picasso__glyph_hash(c->glyphs[i].key) & (bucket_count - 1)];
+            c->glyphs[i].next = *chain;
+            *chain = i;
+        }
+    }
+    picasso_free(c->buckets);
+    c->buckets = buckets;
+    c->bucket_count = bucket_count;
+    return true;
+}
+
+// A new entry, linked in under its key
+static picasso_glyph *picasso__glyph_insert(picasso_glyph_key k)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    if (c->count >= c->bucket_count && !picasso__glyphs_rehash(c->bucket_count * 2)) return NULL;
+
+    if (c->free_glyph < 0) {
+        int capacity = c->capacity ? c->capacity * 2 : 256;
+        picasso_glyph *glyphs = picasso_realloc(c->glyphs, (size_t)capacity * sizeof(*glyphs));
+        if (!glyphs) return NULL;
+        for (int i = capacity - 1; i >= c->capacity; --i) {
+            glyphs[i].next = c->free_glyph;
+            c->free_glyph = i;
+        }
+        c->glyphs = glyphs;
+        c->capacity = capacity;
+    }
+
+    int i = c->free_glyph;
+    picasso_glyph *g = &c->glyphs[i];
+    c->free_glyph = g->next;
+    c->count++;
+
+    *g = (picasso_glyph){ .key = k, .shelf = -1 };
+    int *chain = &c->buckets[picasso__glyph_hash(k) & (c->bucket_count - 1)];
+    g->next = *chain;
+    *chain = i;
+    return g;
+}
+
+// The shelf right below one, -1 if that is the free space at the top
+static int picasso__shelf_below(int s)
+{
+    const picasso_glyph_cache *c = &picasso__cache;
+    int y = c->shelves[s].y + c->shelves[s].height;
+    for (int b = 0; b < c->shelf_count; ++b) {
+        if (c->shelves[b].height && c->shelves[b].y == y) return b;
+    }
+    return -1;
+}
+
+// A slot for a new shelf, emptied ones (height 0) first
+static int picasso__shelf_slot(void)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    for (int s = 0; s < c->shelf_count; ++s) {
+        if (!c->shelves[s].height) return s;
+    }
+    return c->shelf_count++;
+}
+
+/* Room for a w x h glyph: on a shelf of its height, on a new shelf, or on the
+ * least recently used run of unpinned shelves that together are high enough,
+ * emptied and cut to the height, the rest left as an empty shelf. A single
+ * shelf is a run too, but merging neighbours means a size shelves were never
+ * cut for still finds room once the atlas has filled up with smaller ones.
+ * -1 if there is none */
+static int picasso__shelf_place(int w, int h)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    int height = (h + PICASSO_GLYPH_ROUND - 1) / PICASSO_GLYPH_ROUND * PICASSO_GLYPH_ROUND;
+    if (w > PICASSO_GLYPH_ATLAS || height > PICASSO_GLYPH_ATLAS) return -1;
+
+    for (int s = 0; s < c->shelf_count; ++s) {
+        if (c->shelves[s].height == height && PICASSO_GLYPH_ATLAS - c->shelves[s].x >= w) return s;
+    }
+    if (c->top + height <= PICASSO_GLYPH_ATLAS) {
+        int s = picasso__shelf_slot();
+        c->shelves[s] = (picasso_shelf){ c->top, height, 0, 0 };
+        c->top += height;
+        return s;
+    }
+
+    int lru = -1, lru_total = 0;
+    uint64_t lru_used = 0;
+    for (int s = 0; s < c->shelf_count; ++s) {
+        if (!c->shelves[s].height) continue;
+        int total = 0;
+        uint64_t used = 0;
+        for (int r = s; r >= 0 && total < height; r = picasso__shelf_below(r)) {
+            if (c->shelves[r].used >= c->pinned) break;
+            total += c->shelves[r].height;
+            if (c->shelves[r].used > used) used = c->shelves[r].used;
+            if (c->shelves[r].y + c->shelves[r].height == c->top) total += PICASSO_GLYPH_ATLAS - c->top;
+        }
+        if (total < height) continue;
+        if (lru < 0 || used < lru_used || (used == lru_used && total < lru_total)) {
+            lru = s;
+            lru_total = total;
+            lru_used = used;
+        }
+    }
+    if (lru < 0) return -1;
+
+    int y = c->shelves[lru].y, end = y;
+    for (int r = lru, next; r >= 0 && end - y < height; r = next) {
+        next = picasso__shelf_below(r);
+        end += c->shelves[r].height;
+        if (end == c->top) {
+            end = PICASSO_GLYPH_ATLAS;
+            c->top = y + height;
+        }
+        picasso__glyphs_drop(r, 0);
+        c->shelves[r].height = 0;
+    }
+    c->shelves[lru] = (picasso_shelf){ y, height, 0, 0 };
+    if (end - y > height && c->top != y + height) {
+        int rest = picasso__shelf_slot();
+        c->shelves[rest] = (picasso_shelf){ y + height, end - y - height, 0, 0 };
+    }
+    return lru;
+}
+
+// A cached glyph, marked as drawn from now
+static const picasso_glyph *picasso__glyph_use(picasso_glyph_key k)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    const picasso_glyph *g = picasso__glyph_find(k);
+    if (g && g->shelf >= 0) c->shelves[g->shelf].used = c->tick;
+    return g;
+}
+
+/* A new glyph with room for w x h pixels in the atlas, none when w or h is 0.
+ * NULL when it doesn't fit */
+static picasso_glyph *picasso__glyph_add(picasso_glyph_key k, int w, int h, int xoff, int yoff)
+{
+    picasso_glyph_cache *c = &picasso__cache;
+    int shelf = -1;
+    if (w > 0 && h > 0) {
+        shelf = picasso__shelf_place(w, h);
+        if (shelf < 0) {
+            if (!c->full) WARN("Glyph cache is full, %dx%d glyph not drawn", w, h);
+            c->full = true;
+            return NULL;
+        }
+    }
+    picasso_glyph *g = picasso__glyph_insert(k);
+    if (!g) {
+        ERROR("Out of memory caching a glyph");
+        return NULL;
+    }
+
+    g->xoff = xoff;
+    g->yoff = yoff;
+    if (shelf >= 0) {
+        picasso_shelf *sh = &c->shelves[shelf];
+        g->shelf = shelf;
+        g->x = sh->x;
+        g->y = sh->y;
+        g->w = w;
+        g->h = h;
+        sh->x += w;
+        sh->used = c->tick;
+    }
+    return g;
+}
+
+/* The glyph of a codepoint at a pixel size and offset, rasterized into the
+ * atlas if it isn't there yet. NULL when it doesn't fit */
+static const picasso_glyph *picasso__glyph_get(const picasso_font *font, uint32_t codepoint,
+                                               float size, float scale, int subpixel)
+{
+    picasso_glyph_key k = { font->id, codepoint, size, subpixel };
+    const picasso_glyph *found = picasso__glyph_use(k);
+    if (found) return found;
+
+    int index = stbtt_FindGlyphIndex(&font->info, (int)codepoint);
+    float shift = (float)subpixel / PICASSO_GLYPH_SUBPIXEL;
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBoxSubpixel(&font->info, index, scale, scale, shift, 0, &x0, &y0, &x1, &y1);
+
+    picasso_glyph *g = picasso__glyph_add(k, x1 - x0, y1 - y0, x0, y0);
+    if (g && g->w > 0) {
+        picasso_image *atlas = picasso__cache.atlas;
+        stbtt_MakeGlyphBitmapSubpixel(&font->info, &atlas->pixels[g->y * atlas->row_stride + g->x],
+                                      g->w, g->h, atlas->row_stride, scale, scale, shift, 0, index);
+    }
+    return g;
+}
+
+void picasso__glyphs_unpin(void)
+{
+    picasso__cache.recording = false;
+}
+
+// --------------------------------------------------------
+// Kerning and advances
+// --------------------------------------------------------
+
+static picasso_glyph_metrics picasso__glyph_metrics(const picasso_font *font, uint32_t codepoint)
+{
+    if (codepoint < 256) return font->latin1[codepoint];
+
+    picasso_glyph_metrics m = { stbtt_FindGlyphIndex(&font->info, (int)codepoint), 0 };
+    stbtt_GetGlyphHMetrics(&font->info, m.index, &m.advance, NULL);
+    return m;
+}
+
+static bool picasso__kern_grow(picasso_kern_cache *k)
+{
+    int capacity = k->capacity ? k->capacity * 2 : 256;
+    uint32_t *pairs = picasso_malloc((size_t)capacity * sizeof(*pairs));
+    int16_t *kerns = picasso_malloc((size_t)capacity * sizeof(*kerns));
+    if (!pairs || !kerns) {
+        picasso_free(pairs);
+        picasso_free(kerns);
+        return false;
+    }
+    memset(pairs, 0xFF, (size_t)capacity * sizeof(*pairs));
+
+    for (int i = 0; i < k->capacity; ++i) {
+        if (k->pairs[i] == UINT32_MAX) continue;
+        uint32_t slot = (k->pairs[i] * 0x9E3779B1u) >> 16 & (uint32_t)(capacity - 1);
+        while (pairs[slot] != UINT32_MAX) slot = (slot + 1) & (uint32_t)(capacity - 1);
+        pairs[slot] = k->pairs[i];
+        kerns[slot] = k->kerns[i];
+    }
+    picasso_free(k->pairs);
+    picasso_free(k->kerns);
+    k->pairs = pairs;
+    k->kerns = kerns;
+    k->capacity = capacity;
+    return true;
+}
+
+// Kerning between two glyphs in font units, from the font only the first time
+static int picasso__kern_advance(const picasso_font *font, int first, int second)
+{
+    picasso_kern_cache *k = font->kern;
+    if (!k) return 0;
+    if (k->count * 2 >= k->capacity && !picasso__kern_grow(k))
+        return stbtt_GetGlyphKernAdvance(&font->info, first, second);
+
+    uint32_t pair = (uint32_t)first << 16 | (uint32_t)second;
+    uint32_t slot = (pair * 0x9E3779B1u) >> 16 & (uint32_t)(k->capacity - 1);
+    for (; k->pairs[slot] != UINT32_MAX; slot = (slot + 1) & (uint32_t)(k->capacity - 1)) {
+        if (k->pairs[slot] == pair) return k->kerns[slot];
+    }
+    int kern = stbtt_GetGlyphKernAdvance(&font->info, first, second);
+    k->pairs[slot] = pair;
+    k->kerns[slot] = (int16_t)kern;
+    k->count++;
+    return kern;
+}
+
+// --------------------------------------------------------
+// Laying text out
+// --------------------------------------------------------
+
+/* Lays the text out into the scratch glyphs and fills in everything of l but
+ * its key and glyphs. Kerned, a newline starts a line, and with a wrap width a
+ * glyph that would end past it moves the word it is in down a line, or, when
+ * the word is all there is on the line, starts the next line itself. Spaces
+ * never wrap, they hang past the end of the line */
+static bool picasso__layout_lines(const picasso_font *font, const char *utf8, size_t length,
+                                  picasso_text_layout *l)
+{
+    picasso_layout_cache *lc = &picasso__layouts;
+    if (length > lc->scratch_capacity) {
+        size_t capacity = PICASSO_MAX(length, lc->scratch_capacity * 2);
+        picasso_laid_glyph *scratch = picasso_realloc(lc->scratch, capacity * sizeof(*scratch));
+        if (!scratch) return false;
+        lc->scratch = scratch;
+        lc->scratch_capacity = capacity;
+    }
+    picasso_laid_glyph *out = lc->scratch;
+
+    float scale = l->scale, wrap = l->wrap;
+    float pen = 0, width = 0;
+    float line_width = 0;   // the furthest the pen got on the line
+    float ink = 0;          // the end of its last glyph that isn't a space
+    float break_ink = 0;    // ink before the last space
+    int count = 0, line = 0, start = 0, brk = -1, prev = -1;
+    const char *brk_at = NULL;  // the bytes after the last space
+
+    const char *end = utf8 + length;
+    while (utf8 < end) {
+        const char *at = utf8;
+        uint32_t cp = picasso__utf8_next(&utf8);
+        if (cp == '\n') {
+            width = PICASSO_MAX(width, line_width);
+            line++;
+            pen = line_width = ink = 0;
+            start = count;
+            brk = prev = -1;
+            continue;
+        }
+
+        picasso_glyph_metrics m = picasso__glyph_metrics(font, cp);
+        float x = pen;
+        if (prev >= 0) x += (float)picasso__kern_advance(font, prev, m.index) * scale;
+        float advance = (float)m.advance * scale;
+
+        if (wrap > 0 && cp != ' ' && x + advance > wrap && count > start) {
+            // Lay the word out again on the next line, from the start of it
+            // or from this glyph. Kerned from scratch, it comes out exactly
+            // like the same word starting a line
+            width = PICASSO_MAX(width, brk > start ? break_ink : line_width);
+            if (brk > start) {
+                count = brk;
+                at = brk_at;
+            }
+            utf8 = at;
+            line++;
+            start = count;
+            pen = line_width = ink = 0;
+            brk = prev = -1;
+            continue;
+        }
+
+        out[count++] = (picasso_laid_glyph){ cp, x, line };
+        pen = x + advance;
+        line_width = PICASSO_MAX(line_width, pen);
+        if (cp == ' ') {
+            brk = count;
+            brk_at = utf8;
+            break_ink = ink;
+        } else {
+            ink = pen;
+        }
+        prev = m.index;
+    }
+
+    l->count = count;
+    l->lines = line + 1;
+    l->width = PICASSO_MAX(width, line_width);
+    return true;
+}
+
+// --------------------------------------------------------
+// Layout cache
+// --------------------------------------------------------
+
+static uint32_t picasso__layout_hash(uint32_t font, const char *utf8, size_t length, float size,
+                                     float wrap)
+{
+    // FNV-1a over the bytes, then the rest of the key mixed in
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; ++i) h = (h ^ (uint8_t)utf8[i]) * 16777619u;
+    uint32_t s, w;
+    memcpy(&s, &size, sizeof(s));
+    memcpy(&w, &wrap, sizeof(w));
+    h ^= font * 0x9E3779B1u ^ s * 0x85EBCA77u ^ w * 0xC2B2AE3Du;
+    return h ^ (h >> 15);
+}
+
+static void picasso__layout_free(picasso_text_layout *l)
+{
+    picasso_layout_cache *lc = &picasso__layouts;
+    picasso_text_layout **link = &lc->buckets[l->hash & (PICASSO_LAYOUT_BUCKETS - 1)];
+    while (*link != l) link = &(*link)->next;
+    *link = l->next;
+
+    if (l->older) l->older->newer = l->newer;
+    else lc->oldest = l->newer;
+    if (l->newer) l->newer->older = l->older;
+    else lc->newest = l->older;
+    lc->count--;
+    picasso_free(l);
+}
+
+// Frees the layouts of a font, or with font 0 all of them
+static void picasso__layouts_drop(uint32_t font)
+{
+    picasso_layout_cache *lc = &picasso__layouts;
+    for (picasso_text_layout *l = lc->oldest, *newer; l; l = newer) {
+        newer = l->newer;
+        if (!font || l->font == font) picasso__layout_free(l);
+    }
+    if (!font) {
+        picasso_free(lc->scratch);
+        lc->scratch = NULL;
+        lc->scratch_capacity = 0;
+    }
+}
+
+/* The text laid out at a pixel size and wrap width, from the cache or laid
+ * out now. The least recently used layout makes room once there are
+ * PICASSO_LAYOUT_CACHE of them, unless recorded text still needs it */
+static const picasso_text_layout *picasso__text_layout(const picasso_font *font, const char *utf8,
+                                                       float size, float wrap)
+{
+    picasso_layout_cache *lc = &picasso__layouts;
+    const picasso_glyph_cache *c = &picasso__cache;
+    if (!(size > 0)) return NULL;
+
+    size_t length = strlen(utf8);
+    uint32_t hash = picasso__layout_hash(font->id, utf8, length, size, wrap);
+    picasso_text_layout **bucket = &lc->buckets[hash & (PICASSO_LAYOUT_BUCKETS - 1)];
+    picasso_text_layout *l = *bucket;
+    while (l && !(l->hash == hash && l->font == font->id && l->size == size && l->wrap == wrap &&
+                  l->length == length && memcmp(l->text, utf8, length) == 0))
+        l = l->next;
+
+    if (l) {
+        // To the newest end
+        if (l != lc->newest) {
+            if (l->older) l->older->newer = l->newer;
+            else lc->oldest = l->newer;
+            l->newer->older = l->older;
+            l->older = lc->newest;
+            l->newer = NULL;
+            lc->newest->newer = l;
+            lc->newest = l;
+        }
+        l->used = c->tick;
+        return l;
+    }
+
+    if (lc->count >= PICASSO_LAYOUT_CACHE && (!c->recording || lc->oldest->used < c->pinned))
+        picasso__layout_free(lc->oldest);
+
+    picasso_text_layout key = {
+        .scale = stbtt_ScaleForPixelHeight(&font->info, size),
+        .wrap = wrap,
+    };
+    if (!picasso__layout_lines(font, utf8, length, &key)) {
+        ERROR("Out of memory laying text out");
+        return NULL;
+    }
+    size_t glyphs = (size_t)key.count * sizeof(picasso_laid_glyph);
+    l = picasso_malloc(sizeof(*l) + glyphs + length + 1);
+    if (!l) {
+        ERROR("Out of memory laying text out");
+        return NULL;
+    }
+    *l = key;
+    l->hash = hash;
+    l->font = font->id;
+    l->size = size;
+    l->line = (float)(font->ascent - font->descent + font->line_gap) * l->scale;
+    l->glyphs = (picasso_laid_glyph *)(l + 1);
+    memcpy(l->glyphs, lc->scratch, glyphs);
+    l->text = (char *)l->glyphs + glyphs;
+    memcpy(l->text, utf8, length + 1);
+    l->length = length;
+    l->used = c->tick;
+
+    l->next = *bucket;
+    *bucket = l;
+    l->older = lc->newest;
+    if (lc->newest) lc->newest->newer = l;
+    else lc->oldest = l;
+    lc->newest = l;
+    lc->count++;
+    return l;
+}
+
+// --------------------------------------------------------
+// Walking laid out text
+// --------------------------------------------------------
+
+// Called with every glyph of the text and where its top left goes, in pixels
+typedef void (*picasso_glyph_fn)(void *ctx, const picasso_glyph *g, int x, int y);
+
+/* Walks the laid out text, calling fn (if any) with every glyph that has
+ * pixels. Glyphs come from the cache, and are added to it when prepare is
+ * set. A glyph that isn't cached is skipped */
+static void picasso__text_walk(const picasso_backbuffer *bf, const picasso_font *font,
+                               const picasso_text_layout *layout, float x, float y, bool prepare,
+                               picasso_glyph_fn fn, void *ctx)
+{
+    float left = x * bf->scale_x, top = y * bf->scale_y;
+    for (int i = 0; i < layout->count; ++i) {
+        const picasso_laid_glyph *lg = &layout->glyphs[i];
+
+        // The pen to the nearest subpixel offset
+        float q = floorf((left + lg->x) * PICASSO_GLYPH_SUBPIXEL + 0.5f);
+        int ix = (int)floorf(q / PICASSO_GLYPH_SUBPIXEL);
+        int sub = (int)(q - (float)ix * PICASSO_GLYPH_SUBPIXEL);
+
+        picasso_glyph_key k = { layout->font, lg->codepoint, layout->size, sub };
+        const picasso_glyph *g = prepare
+            ? picasso__glyph_get(font, lg->codepoint, layout->size, layout->scale, sub)
+            : picasso__glyph_find(k);
+        if (!g || !fn || g->w == 0) continue;
+
+        float baseline = top + (float)lg->line * layout->line;
+        fn(ctx, g, ix + g->xoff, (int)lroundf(baseline) + g->yoff);
+    }
+}
+
+static void picasso__bounds_glyph(void *ctx, const picasso_glyph *g, int x, int y)
+{
+    picasso_draw_bounds *b = ctx;
+    b->x0 = PICASSO_MIN(b->x0, x);
+    b->y0 = PICASSO_MIN(b->y0, y);
+    b->x1 = PICASSO_MAX(b->x1, x + g->w);
+    b->y1 = PICASSO_MAX(b->y1, y + g->h);
+}
+
+picasso_draw_bounds picasso__text_bounds(const picasso_backbuffer *bf, const picasso_font *font,
+                                         const picasso_text_layout *layout, float x, float y)
+{
+    picasso_draw_bounds b = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+    picasso__text_walk(bf, font, layout, x, y, false, picasso__bounds_glyph, &b);
+    return b.x0 < b.x1 ? b : (picasso_draw_bounds){0};
+}
+
+// --------------------------------------------------------
+// Drawing
+// --------------------------------------------------------
+
+typedef struct {
+    picasso_backbuffer *bf;
+    uint32_t src;
+} picasso_text_draw;
+
+static void picasso__draw_glyph(void *ctx, const picasso_glyph *g, int x, int y)
+{
+    picasso_text_draw *d = ctx;
+    const picasso_image *atlas = picasso__cache.atlas;
+    picasso__draw_mask(d->bf, &atlas->pixels[g->y * atlas->row_stride + g->x], g->w, g->h,
+                       atlas->row_stride, x, y, d->src);
+}
+
+void picasso__draw_text(picasso_backbuffer *bf, const picasso_font *font,
+                        const picasso_text_layout *layout, float x, float y, color c, bool prepare)
+{
+    if (!bf || !bf->pixels || !font || !layout) return;
+
+    // Replays only look glyphs up, the missing ones are rasterized now
+    if (prepare) picasso__text_walk(bf, font, layout, x, y, true, NULL, NULL);
+
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_TEXT, .c = c,
+                   .text = { font, layout, x, y });
+
+    if (!picasso__cache.atlas) return;
+    picasso_text_draw d = {
+        .bf = bf,
+        .src = color_to_u32(c),
+    };
+    picasso__text_walk(bf, font, layout, x, y, false, picasso__draw_glyph, &d);
+}
+
+/* Starts drawing text: everything it uses from here on is kept until the
+ * submit when recording */
+static bool picasso__text_begin(const picasso_backbuffer *bf)
+{
+    picasso_glyph_cache *cache = &picasso__cache;
+    if (!picasso__cache_init()) return false;
+    cache->tick++;
+    if (!cache->recording) cache->pinned = cache->tick;
+    if (bf->cmdlist && bf->cmdlist->recording) cache->recording = true;
+    return true;
+}
+
+void picasso_draw_text_wrapped(picasso_backbuffer *bf, const picasso_font *font, const char *utf8,
+                               float x, float y, float wrap_width, color c)
+{
+    if (!bf || !bf->pixels || !font || !utf8 || !picasso__text_begin(bf)) return;
+
+    const picasso_text_layout *layout = picasso__text_layout(
+        font, utf8, font->size * bf->scale_y, PICASSO_MAX(wrap_width, 0) * bf->scale_y);
+    picasso__draw_text(bf, font, layout, x, y, c, true);
+}
+
+void picasso_draw_text(picasso_backbuffer *bf, const picasso_font *font, const char *utf8,
+                       float x, float y, color c)
+{
+    picasso_draw_text_wrapped(bf, font, utf8, x, y, 0, c);
+}
+
+// --------------------------------------------------------
+// Distance field glyphs
+// --------------------------------------------------------
+
+/* Signed distance fields: every texel holds how far its center is from the
+ * outline, PICASSO_SDF_EDGE on it, more inside. The field is baked once per
+ * glyph at PICASSO_SDF_SIZE and sampled bilinearly at any other size, the
+ * distance scaling along with it, and a linear ramp across the outline
+ * turns it back into coverage. Ramps further out draw outlines and glows
+ * from the same samples, as far as the PICASSO_SDF_PAD texels of field
+ * around each glyph reach. The fields live in the glyph atlas, keyed at
+ * PICASSO_SDF_SIZE with subpixel offset -1 */
+
+#define PICASSO_SDF_SIZE  48    // pixel height the fields are baked at
+#define PICASSO_SDF_PAD   8     // texels of field around every glyph
+#define PICASSO_SDF_EDGE  128   // field value on the outline, 16 per texel
+#define PICASSO_SDF_CHUNK 256   // pixels sampled at a time
+
+// The field of a codepoint, baked into the atlas if it isn't there yet
+static const picasso_glyph *picasso__sdf_glyph_get(const picasso_font *font, uint32_t codepoint)
+{
+    picasso_glyph_key k = { font->id, codepoint, PICASSO_SDF_SIZE, -1 };
+    const picasso_glyph *found = picasso__glyph_use(k);
+    if (found) return found;
+
+    float scale = stbtt_ScaleForPixelHeight(&font->info, PICASSO_SDF_SIZE);
+    int index = stbtt_FindGlyphIndex(&font->info, (int)codepoint);
+    int w = 0, h = 0, xoff = 0, yoff = 0;
+    uint8_t *field = stbtt_GetGlyphSDF(&font->info, scale, index, PICASSO_SDF_PAD, PICASSO_SDF_EDGE,
+                                       (float)PICASSO_SDF_EDGE / PICASSO_SDF_PAD, &w, &h, &xoff, &yoff);
+
+    picasso_glyph *g = picasso__glyph_add(k, field ? w : 0, field ? h : 0, xoff, yoff);
+    if (g && g->w > 0) {
+        picasso_image *atlas = picasso__cache.atlas;
+        for (int row = 0; row < h; ++row)
+            memcpy(&atlas->pixels[(g->y + row) * atlas->row_stride + g->x], field + row * w, (size_t)w);
+    }
+    stbtt_FreeSDF(field, NULL);
+    return g;
+}
+
+// Called with every field and where its top left goes, in fractional pixels,
+// s pixels per texel
+typedef void (*picasso_sdf_fn)(void *ctx, const picasso_glyph *g, float x, float y, float s);
+
+// picasso__text_walk for fields. They are sampled, so the pen isn't rounded
+static void picasso__sdf_walk(const picasso_backbuffer *bf, const picasso_font *font,
+                              const picasso_text_layout *layout, float x, float y, bool prepare,
+                              picasso_sdf_fn fn, void *ctx)
+{
+    float left = x * bf->scale_x, top = y * bf->scale_y;
+    float s = layout->size / PICASSO_SDF_SIZE;
+    for (int i = 0; i < layout->count; ++i) {
+        const picasso_laid_glyph *lg = &layout->glyphs[i];
+        picasso_glyph_key k = { layout->font, lg->codepoint, PICASSO_SDF_SIZE, -1 };
+        const picasso_glyph *g = prepare ? picasso__sdf_glyph_get(font, lg->codepoint)
+                                         : picasso__glyph_find(k);
+        if (!g || !fn || g->w == 0) continue;
+
+        // On a whole pixel like picasso_draw_text, stems stay as sharp
+        float baseline = (float)lroundf(top + (float)lg->line * layout->line);
+        fn(ctx, g, left + lg->x + (float)g->xoff * s, baseline + (float)g->yoff * s, s);
+    }
+}
+
+typedef struct {
+    float edge, slope;   // picasso__span_distance ramp
+    float reach;         // pixels past the outline it covers
+    uint32_t src;
+} picasso_sdf_pass;
+
+/* Glow, outline and fill, in that order. Each is drawn under the whole text
+ * before the next, so the outline of a glyph never covers the fill of its
+ * kerned neighbor */
+typedef struct {
+    picasso_backbuffer *bf;
+    picasso_draw_bounds cb;
+    void (*mask)(uint32_t *dst, const uint8_t *coverage, int n, uint32_t src);
+    picasso_sdf_pass passes[3];
+    int pass_count, pass;
+} picasso_sdf_draw;
+
+/* A pass for text at s pixels per texel: a ramp from coverage 0 at distance
+ * d0 (in pixels, negative outside) to 255 at d1, in field samples with 4
+ * bits of fraction, which are 256 per texel of distance. Bilinear samples
+ * blur the field by up to a texel, which the pass reaches past d0 too */
+static picasso_sdf_pass picasso__sdf_ramp(float s, float d0, float d1, color c)
+{
+    float per_pixel = 256.0f / s;
+    return (picasso_sdf_pass){
+        .edge = (float)(PICASSO_SDF_EDGE * 16) + d0 * per_pixel,
+        .slope = 255.0f / ((d1 - d0) * per_pixel),
+        .reach = 1 + s - d0,
+        .src = color_to_u32(c),
+    };
+}
+
+static picasso_sdf_draw picasso__sdf_setup(const picasso_backbuffer *bf,
+                                           const picasso_text_layout *layout, color c,
+                                           const picasso_text_effects *effects)
+{
+    float s = layout->size / PICASSO_SDF_SIZE;
+    // The field ends PICASSO_SDF_PAD texels out, and a ramp needs half a pixel
+    float far = PICASSO_SDF_PAD * s - 0.5f;
+    picasso_sdf_draw d = {0};
+
+    if (effects && effects->glow_width > 0 && effects->glow.a > 0) {
+        float glow = PICASSO_MIN(effects->glow_width * bf->scale_y, far);
+        d.passes[d.pass_count++] = picasso__sdf_ramp(s, -glow, 0, effects->glow);
+    }
+    if (effects && effects->outline_width > 0 && effects->outline.a > 0) {
+        float outline = PICASSO_MIN(effects->outline_width * bf->scale_y, far - 0.5f);
+        d.passes[d.pass_count++] = picasso__sdf_ramp(s, -outline - 0.5f, -outline + 0.5f,
+                                                     effects->outline);
+    }
+    d.passes[d.pass_count++] = picasso__sdf_ramp(s, -0.5f, 0.5f, c);
+    return d;
+}
+
+/* Pixels of a field drawn at x, y: its box, less the padding the passes don't
+ * reach into */
+static picasso_draw_bounds picasso__sdf_box(const picasso_glyph *g, float x, float y, float s,
+                                            float reach)
+{
+    float inset = PICASSO_MAX(0.0f, PICASSO_SDF_PAD * s - reach);
+    return (picasso_draw_bounds){
+        (int)floorf(x + inset), (int)floorf(y + inset),
+        (int)ceilf(x + (float)g->w * s - inset), (int)ceilf(y + (float)g->h * s - inset),
+    };
+}
+
+// The first pass reaches furthest
+static void picasso__bounds_sdf(void *ctx, const picasso_glyph *g, float x, float y, float s)
+{
+    picasso_sdf_draw *d = ctx;
+    picasso_draw_bounds box = picasso__sdf_box(g, x, y, s, d->passes[0].reach);
+    if (box.x0 >= box.x1 || box.y0 >= box.y1) return;
+    d->cb.x0 = PICASSO_MIN(d->cb.x0, box.x0);
+    d->cb.y0 = PICASSO_MIN(d->cb.y0, box.y0);
+    d->cb.x1 = PICASSO_MAX(d->cb.x1, box.x1);
+    d->cb.y1 = PICASSO_MAX(d->cb.y1, box.y1);
+}
+
+/* Samples the field under every pixel of the box into distances, then runs
+ * the pass over them. Texel coordinates are 16.16 fixed point, stepped from
+ * the corner of the box whatever the clip, so tiles sample exactly what the
+ * whole glyph would */
+static void picasso__draw_sdf_glyph(void *ctx, const picasso_glyph *g, float x, float y, float s)
+{
+    picasso_sdf_draw *d = ctx;
+    const picasso_sdf_pass *pass = &d->passes[d->pass];
+    picasso_draw_bounds box = picasso__sdf_box(g, x, y, s, pass->reach);
+    int x0 = PICASSO_MAX(box.x0, d->cb.x0), x1 = PICASSO_MIN(box.x1, d->cb.x1);
+    int y0 = PICASSO_MAX(box.y0, d->cb.y0), y1 = PICASSO_MIN(box.y1, d->cb.y1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    // Texel centers are at whole coordinates
+    int64_t step = (int64_t)lroundf(65536.0f / s);
+    int64_t u0 = (int64_t)lroundf(((float)box.x0 + 0.5f - x) / s * 65536.0f - 32768.0f);
+    int64_t v0 = (int64_t)lroundf(((float)box.y0 + 0.5f - y) / s * 65536.0f - 32768.0f);
+    int64_t umax = (int64_t)(g->w - 1) << 16, vmax = (int64_t)(g->h - 1) << 16;
+
+    const picasso_image *atlas = picasso__cache.atlas;
+    const uint8_t *field = &atlas->pixels[g->y * atlas->row_stride + g->x];
+    uint16_t dist[PICASSO_SDF_CHUNK], fx[PICASSO_SDF_CHUNK];
+    int32_t tx[PICASSO_SDF_CHUNK];
+    uint8_t coverage[PICASSO_SDF_CHUNK];
+    uint32_t column[PICASSO_GLYPH_ATLAS + 1];
+
+    for (int cx = x0; cx < x1; cx += PICASSO_SDF_CHUNK) {
+        int n = PICASSO_MIN(PICASSO_SDF_CHUNK, x1 - cx);
+        // Columns are the same on every row
+        for (int i = 0; i < n; ++i) {
+            int64_t u = PICASSO_CLAMP(u0 + (cx + i - box.x0) * step, 0, umax);
+            tx[i] = (int32_t)(u >> 16);
+            fx[i] = (uint16_t)(u >> 8 & 0xFF);
+        }
+        int t0 = tx[0], t1 = tx[n - 1] + 1;  // the texels they sample
+
+        for (int py = y0; py < y1; ++py) {
+            int64_t v = PICASSO_CLAMP(v0 + (py - box.y0) * step, 0, vmax);
+            int ty = (int)(v >> 16);
+            uint32_t fy = (uint32_t)(v >> 8) & 0xFF;
+            const uint8_t *row0 = field + ty * atlas->row_stride;
+            const uint8_t *row1 = field + PICASSO_MIN(ty + 1, g->h - 1) * atlas->row_stride;
+
+            // Down the texel columns the pixels use first, there are fewer of
+            // them than pixels when scaling up. The last texel pairs with a
+            // copy of itself, weighted 0
+            int end = PICASSO_MIN(t1, g->w - 1);
+            for (int t = t0; t <= end; ++t) column[t] = row0[t] * (256 - fy) + row1[t] * fy;
+            column[end + 1] = column[end];
+            for (int i = 0; i < n; ++i) {
+                uint32_t a = column[tx[i]], b = column[tx[i] + 1];
+                dist[i] = (uint16_t)((a * (256u - fx[i]) + b * fx[i] + 2048) >> 12);
+            }
+            picasso__span_distance(coverage, dist, n, pass->edge, pass->slope);
+            d->mask(picasso__get_pixel_u32(d->bf, cx, py), coverage, n, pass->src);
+        }
+    }
+}
+
+picasso_draw_bounds picasso__text_sdf_bounds(const picasso_backbuffer *bf, const picasso_font *font,
+                                             const picasso_text_layout *layout, float x, float y,
+                                             color c, const picasso_text_effects *effects)
+{
+    picasso_sdf_draw d = picasso__sdf_setup(bf, layout, c, effects);
+    d.cb = (picasso_draw_bounds){ INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+    picasso__sdf_walk(bf, font, layout, x, y, false, picasso__bounds_sdf, &d);
+    return d.cb.x0 < d.cb.x1 ? d.cb : (picasso_draw_bounds){0};
+}
+
+void picasso__draw_text_sdf(picasso_backbuffer *bf, const picasso_font *font,
+                            const picasso_text_layout *layout, float x, float y, color c,
+                            const picasso_text_effects *effects, bool prepare)
+{
+    if (!bf || !bf->pixels || !font || !layout) return;
+
+    if (prepare) picasso__sdf_walk(bf, font, layout, x, y, true, NULL, NULL);
+
+    picasso_text_effects none = {0};
+    PICASSO_RECORD(bf, .type = PICASSO_CMD_TEXT_SDF, .c = c,
+                   .text_sdf = { font, layout, x, y, effects ? *effects : none });
+
+    if (!picasso__cache.atlas) return;
+    picasso_sdf_draw d = picasso__sdf_setup(bf, layout, c, effects);
+    d.bf = bf;
+    d.cb = picasso__clip_bounds(bf);
+    d.mask = picasso__kernels(bf)->mask;
+    for (d.pass = 0; d.pass < d.pass_count; ++d.pass)
+        picasso__sdf_walk(bf, font, layout, x, y, false, picasso__draw_sdf_glyph, &d);
+}
+
+void picasso_draw_text_sdf(picasso_backbuffer *bf, const picasso_font *font, const char *utf8,
+                           float x, float y, color c, const picasso_text_effects *effects)
+{
+    if (!bf || !bf->pixels || !font || !utf8 || !picasso__text_begin(bf)) return;
+
+    const picasso_text_layout *layout = picasso__text_layout(font, utf8, font->size * bf->scale_y, 0);
+    picasso__draw_text_sdf(bf, font, layout, x, y, c, effects, true);
+}
+
+// --------------------------------------------------------
+// Fonts
+// --------------------------------------------------------
+
+picasso_font *picasso_create_font(const uint8_t *data, size_t size, int index, float pixel_height)
+{
+    if (!data || size == 0) return NULL;
+
+    picasso_font *font = picasso_calloc(1, sizeof(*font));
+    if (!font) return NULL;
+    font->data = picasso_malloc(size);
+    if (!font->data) {
+        picasso_free(font);
+        return NULL;
+    }
+    memcpy(font->data, data, size);
+
+    int offset = stbtt_GetFontOffsetForIndex(font->data, index);
+    if (offset < 0 || !stbtt_InitFont(&font->info, font->data, offset)) {
+        ERROR("Font %d of the file is not a TrueType font", index);
+        picasso_free(font->data);
+        picasso_free(font);
+        return NULL;
+    }
+    font->size = pixel_height;
+    font->kerning = font->info.kern || font->info.gpos;
+    if (font->kerning) font->kern = picasso_calloc(1, sizeof(*font->kern));
+    stbtt_GetFontVMetrics(&font->info, &font->ascent, &font->descent, &font->line_gap);
+    for (uint32_t cp = 0; cp < 256; ++cp) {
+        picasso_glyph_metrics *m = &font->latin1[cp];
+        m->index = stbtt_FindGlyphIndex(&font->info, (int)cp);
+        stbtt_GetGlyphHMetrics(&font->info, m->index, &m->advance, NULL);
+    }
+    font->id = ++picasso__cache.next_id;
+    picasso__cache.fonts++;
+    return font;
+}
+
+picasso_font *picasso_load_font(const char *path, float pixel_height)
+{
+    picasso_reader *reader = picasso_read_entire_file(path);
+    if (!reader) {
+        ERROR("Failed to read font %s", path);
+        return NULL;
+    }
+    picasso_font *font = picasso_create_font(reader->fp, reader->size, 0, pixel_height);
+    picasso_reader_free(reader);
+    return font;
+}
+
+void picasso_destroy_font(picasso_font *font)
+{
+    if (!font) return;
+
+    if (picasso__cache.buckets) picasso__glyphs_drop(-1, font->id);
+    picasso__layouts_drop(font->id);
+    if (--picasso__cache.fonts == 0) {
+        picasso__cache_free();
+        picasso__layouts_drop(0);
+    }
+    if (font->kern) {
+        picasso_free(font->kern->pairs);
+        picasso_free(font->kern->kerns);
+        picasso_free(font->kern);
+    }
+    picasso_free(font->data);
+    picasso_free(font);
+}
+
+void picasso_font_set_size(picasso_font *font, float pixel_height)
+{
+    if (font) font->size = pixel_height;
+}
+
+picasso_font_metrics picasso_font_get_metrics(const picasso_font *font)
+{
+    if (!font) return (picasso_font_metrics){0};
+
+    float scale = stbtt_ScaleForPixelHeight(&font->info, font->size);
+    return (picasso_font_metrics){ font->ascent * scale, font->descent * scale,
+                                   font->line_gap * scale };
+}
+
+picasso_text_extent picasso_measure_text(const picasso_font *font, const char *utf8, float wrap_width)
+{
+    if (!font || !utf8) return (picasso_text_extent){0};
+
+    const picasso_text_layout *l = picasso__text_layout(font, utf8, font->size,
+                                                        PICASSO_MAX(wrap_width, 0));
+    if (!l) return (picasso_text_extent){0};
+    return (picasso_text_extent){ l->width, (float)l->lines * l->line, l->lines };
+}
+
+float picasso_text_width(const picasso_font *font, const char *utf8)
+{
+    return picasso_measure_text(font, utf8, 0).width;
+}
@@ -7,12 +7,11 @@
 #define WIDTH 800
 #define HEIGHT 600
 
-#define RADIUS 5
-#define CIRCLE_COLOR CYAN
 #define GRID_COUNT 10
-#define GRID_PAD 0.5/GRID_COUNT
+#define GRID_PAD (1.0f/GRID_COUNT)
 #define GRID_SIZE ((GRID_COUNT - 1)*GRID_PAD)
-#define Z_START 0.25
+#define CUBE_HALF (0.3f*GRID_PAD)
+#define CUBE_COUNT (GRID_COUNT*GRID_COUNT*GRID_COUNT)
 
 void render3d(picasso_backbuffer *bf, float *angle, double dt);
 
@@ -27,6 +26,7 @@ int main(void)
                         CANOPY_WINDOW_STYLE_CLOSABLE);
 
     picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_attach_depth(bf, 32);
 
     float angle = 0;
     while(!window_should_close(win))
@@ -37,6 +37,7 @@ int main(void)
         if(should_render_frame())
         {
             picasso_clear_backbuffer(bf);
+            picasso_clear_depth(bf);
 
             render3d(bf, &angle, get_delta_time());
 
@@ -50,56 +51,74 @@ int main(void)
     return 0;
 }
 
-// In order to work conceptually with a 3d grid it makes sense to normalize the
-// coords Therefore we can say that z = 0 is the screen, and screen positive
-// (or negative) is visable
-void render3d(picasso_backbuffer *bf, float *angle, double dt)
-{
-    *angle += 0.25*M_PI*dt;
+// Every point of the grid is a small cube. Each face gets its own vertices so
+// it can be shaded flat, and is wound counter-clockwise seen from outside so
+// the faces turned away can be culled
+static picasso_vertex3d vertices[CUBE_COUNT*24];
+static uint32_t indices[CUBE_COUNT*36];
 
+static void build_cubes(void)
+{
+    // Per face: the offset to its center, then the two half edges
+    const float faces[6][3][3] = {
+        { {  1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+        { { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+        { { 0,  1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },
+        { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+        { { 0, 0,  1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+        { { 0, 0, -1 }, { 0, 1, 0 }, { 1, 0, 0 } },
+    };
+    const float shade[6] = { 0.8f, 0.6f, 1.0f, 0.4f, 0.9f, 0.5f };
+    const float su[4] = { -1, 1, 1, -1 }, sv[4] = { -1, -1, 1, 1 };
+
+    int nv = 0, ni = 0;
     for( int ix = 0; ix < GRID_COUNT; ++ix){
         for( int iy = 0; iy < GRID_COUNT; ++iy){
             for( int iz = 0; iz < GRID_COUNT; ++iz){
-                float x = ix*GRID_PAD - GRID_SIZE/2; //-- these are now from -1 to 1
-                float y = iy*GRID_PAD - GRID_SIZE/2;
-                float z = Z_START + iz*GRID_PAD;
-
-                float cx = 0.0;
-                float cz = Z_START + GRID_SIZE/2;
-
-                float dx = x - cx; // finding the dist between them
-                float dz = z - cz;
-
-                float a = atan2f(dz, dx); // angle between them
-                float m = sqrtf(dx*dx + dz*dz); //magnitude
-
-                dx = cosf(a + *angle)*m; // turn into cosine and sine
-                dz = sinf(a + *angle)*m;
-
-                x = dx + cx; // turn them back into coordinated on the "screen"
-                z = dz + cz;
-
-                x /= z;
-                y /= z;
-
-                color c = {
-                    .r = ix*255/GRID_COUNT,
-                    .g = iy*255/GRID_COUNT,
-                    .b = iz*255/GRID_COUNT,
-                    .a = 255,
-                };
-                // (-1, (..), 1 plus one is 0-2 and then divided by 2 is 0-1 *times width = 0-width! Normalized!
-                float depth_factor = 1.0f - (z - Z_START) / GRID_SIZE;
-                depth_factor = PICASSO_CLAMP(depth_factor, 0.0f, 1.0f);
-
-                // Reduce variation — blend toward a neutral midpoint like 0.75
-                depth_factor = 0.75f + 0.25f * depth_factor;
-                depth_factor = 1.0f / (1.0f + 2.0f * (z - Z_START));
-                depth_factor = PICASSO_CLAMP(depth_factor, 0.75f, 1.0f); // keep it gentle
-                z = fmaxf(z, Z_START + 0.05f); // avoid z getting too small
-                float radius = RADIUS * depth_factor;
-                picasso_fill_circle_aa(bf, (x + 1) / 2 * WIDTH, (y + 1) / 2 * HEIGHT, radius, c);
+                float cx = ix*GRID_PAD - GRID_SIZE/2;
+                float cy = iy*GRID_PAD - GRID_SIZE/2;
+                float cz = iz*GRID_PAD - GRID_SIZE/2;
+
+                for( int f = 0; f < 6; ++f){
+                    color c = {
+                        .r = ix*255/GRID_COUNT*shade[f],
+                        .g = iy*255/GRID_COUNT*shade[f],
+                        .b = iz*255/GRID_COUNT*shade[f],
+                        .a = 255,
+                    };
+                    uint32_t base = nv;
+                    for( int k = 0; k < 4; ++k){
+                        float p[3];
+                        for( int i = 0; i < 3; ++i)
+                            p[i] = (faces[f][0][i] + su[k]*faces[f][1][i] + sv[k]*faces[f][2][i])*CUBE_HALF;
+                        vertices[nv++] = (picasso_vertex3d){ cx + p[0], cy + p[1], cz + p[2], c, 0, 0 };
+                    }
+                    indices[ni++] = base; indices[ni++] = base + 1; indices[ni++] = base + 2;
+                    indices[ni++] = base; indices[ni++] = base + 2; indices[ni++] = base + 3;
+                }
             }
         }
     }
 }
+
+// The camera sits in front of the grid and the grid spins around its own
+// center, the depth buffer sorts out which cube is in front
+void render3d(picasso_backbuffer *bf, float *angle, double dt)
+{
+    static bool built = false;
+    if (!built) {
+        build_cubes();
+        built = true;
+    }
+
+    *angle += 0.25*M_PI*dt;
+
+    picasso_mat4 proj = picasso_mat4_perspective(0.9f, (float)bf->width/bf->height, 0.1f, 10.0f);
+    picasso_mat4 view = picasso_mat4_mul(picasso_mat4_translate(0.0f, 0.0f, -1.9f),
+                                         picasso_mat4_rotate_x(0.35f));
+    picasso_mat4 mvp = picasso_mat4_mul(picasso_mat4_mul(proj, view),
+                                        picasso_mat4_rotate_y(*angle));
+
+    picasso_draw_mesh3d(bf, &mvp, vertices, CUBE_COUNT*24, indices, CUBE_COUNT*36,
+                        NULL, PICASSO_3D_CULL_BACK);
+}
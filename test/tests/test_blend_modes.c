@@ -0,0 +1,198 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso blend modes
+*
+*   Description:
+*       Fills a rect in every blend mode over a known backbuffer and checks
+*       the result against the compositing formulas in floating point. Then
+*       builds a glow the old way, adding an image into the pixels by hand,
+*       and with one additive blit, which have to agree, and punches an
+*       anti-aliased hole with DST_OUT. Times a full screen fill and blit in
+*       every mode.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include <string.h>
+#include <math.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define FRAMES  20
+
+static const char *mode_name[PICASSO_BLEND_COUNT] = {
+    "src over", "src", "clear", "src in", "src out", "src atop", "dst over",
+    "dst in", "dst out", "dst atop", "xor", "add", "multiply", "screen",
+    "darken", "lighten",
+};
+
+// One channel of premultiplied s over d with alphas sa and da, all 0..1
+static float expected(picasso_blend_mode mode, float s, float d, float sa, float da)
+{
+    switch (mode) {
+    case PICASSO_BLEND_SRC_OVER: return s + d * (1 - sa);
+    case PICASSO_BLEND_SRC:      return s;
+    case PICASSO_BLEND_CLEAR:    return 0;
+    case PICASSO_BLEND_SRC_IN:   return s * da;
+    case PICASSO_BLEND_SRC_OUT:  return s * (1 - da);
+    case PICASSO_BLEND_SRC_ATOP: return s * da + d * (1 - sa);
+    case PICASSO_BLEND_DST_OVER: return d + s * (1 - da);
+    case PICASSO_BLEND_DST_IN:   return d * sa;
+    case PICASSO_BLEND_DST_OUT:  return d * (1 - sa);
+    case PICASSO_BLEND_DST_ATOP: return d * sa + s * (1 - da);
+    case PICASSO_BLEND_XOR:      return s * (1 - da) + d * (1 - sa);
+    case PICASSO_BLEND_ADD:      return fminf(s + d, 1);
+    case PICASSO_BLEND_MULTIPLY: return s * d + s * (1 - da) + d * (1 - sa);
+    case PICASSO_BLEND_SCREEN:   return s + d - s * d;
+    case PICASSO_BLEND_DARKEN:   return s + d - fmaxf(s * da, d * sa);
+    case PICASSO_BLEND_LIGHTEN:  return s + d - fminf(s * da, d * sa);
+    default:                     return d;
+    }
+}
+
+static uint32_t pixel_at(picasso_backbuffer *bf, int x, int y)
+{
+    return bf->pixels[y * bf->width + x];
+}
+
+static void fill_pixels(picasso_backbuffer *bf, uint32_t p)
+{
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i) bf->pixels[i] = p;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+
+    Window *win = create_window("Picasso blend modes", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    if (!bf || !ref) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    // Every mode, with translucent and opaque colors over a translucent and
+    // an opaque destination (premultiplied, as the backbuffer is)
+    const color sources[] = { { 200, 40, 90, 160 }, { 30, 220, 120, 255 }, { 90, 90, 250, 0 } };
+    const uint32_t dests[] = { 0x80406020u, 0xFF20A0E0u, 0x00000000u };
+    for (int mode = 0; mode < PICASSO_BLEND_COUNT; ++mode) {
+        for (size_t si = 0; si < sizeof(sources) / sizeof(sources[0]); ++si) {
+            for (size_t di = 0; di < sizeof(dests) / sizeof(dests[0]); ++di) {
+                fill_pixels(bf, dests[di]);
+                bf->blend = (picasso_blend_mode)mode;
+                picasso_fill_rect(bf, &(picasso_rect){ 10, 10, 20, 20 }, sources[si]);
+                bf->blend = PICASSO_BLEND_SRC_OVER;
+
+                color c = sources[si];
+                float sa = c.a / 255.0f, da = (dests[di] >> 24) / 255.0f;
+                float s[4] = { c.r / 255.0f * sa, c.g / 255.0f * sa, c.b / 255.0f * sa, sa };
+                uint32_t got = pixel_at(bf, (int)(20 * bf->scale_x), (int)(20 * bf->scale_y));
+                for (int ch = 0; ch < 4; ++ch) {
+                    float d = ((dests[di] >> (8 * ch)) & 0xFF) / 255.0f;
+                    int want = (int)lroundf(expected((picasso_blend_mode)mode, s[ch], d, sa, da) * 255.0f);
+                    int have = (int)((got >> (8 * ch)) & 0xFF);
+                    if (have < want - 2 || have > want + 2) {
+                        ERROR("%s of %08x over %08x is %08x, channel %d should be %d",
+                              mode_name[mode], color_to_u32(c), dests[di], got, ch, want);
+                        failed = 1;
+                        break;
+                    }
+                }
+                // Outside the rect nothing changes
+                if (pixel_at(bf, 0, 0) != dests[di]) {
+                    ERROR("%s changed a pixel outside of the rect", mode_name[mode]);
+                    failed = 1;
+                }
+            }
+        }
+    }
+    if (!failed) INFO("Every blend mode matches its formula");
+
+    // A glow: a soft white blob added onto the scene. By hand it is a pass
+    // over the image and every pixel under it
+    picasso_image *glow = picasso_alloc_image(128, 128, 4);
+    foreach_pixel_u8(glow, {
+        float dx = (_x - 63.5f) / 64.0f;
+        float dy = (_y - 63.5f) / 64.0f;
+        uint8_t v = (uint8_t)(255.0f * fmaxf(0.0f, 1.0f - sqrtf(dx * dx + dy * dy)));
+        pixel[0] = pixel[1] = pixel[2] = pixel[3] = v; // premultiplied already
+    });
+    glow->premultiplied = true;
+    picasso_image_update_alpha(glow);
+
+    int gx = (int)(100 * bf->scale_x), gy = (int)(80 * bf->scale_y);
+    int gw = (int)(128 * bf->scale_x), gh = (int)(128 * bf->scale_y);
+    fill_pixels(ref, 0xFF402010u);
+    for (int y = 0; y < gh; ++y) {
+        for (int x = 0; x < gw; ++x) {
+            uint8_t *g = picasso__get_pixel_u8(glow, (2 * x + 1) * 128 / (2 * gw),
+                                               (2 * y + 1) * 128 / (2 * gh));
+            uint32_t *d = &ref->pixels[(gy + y) * ref->width + gx + x];
+            uint32_t out = 0;
+            for (int ch = 0; ch < 4; ++ch) {
+                uint32_t v = ((*d >> (8 * ch)) & 0xFF) + g[ch];
+                out |= (v > 255 ? 255 : v) << (8 * ch);
+            }
+            *d = out;
+        }
+    }
+    fill_pixels(bf, 0xFF402010u);
+    bf->blend = PICASSO_BLEND_ADD;
+    picasso_blit(bf, glow, (picasso_rect){ 0, 0, 128, 128 }, (picasso_rect){ 100, 80, 128, 128 });
+    bf->blend = PICASSO_BLEND_SRC_OVER;
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Additive blit differs from adding by hand");
+        failed = 1;
+    }
+
+    // A hole, anti-aliased at its edge
+    fill_pixels(bf, 0xFF808080u);
+    bf->blend = PICASSO_BLEND_DST_OUT;
+    picasso_fill_circle_aa(bf, 300, 300, 40, BLACK);
+    bf->blend = PICASSO_BLEND_SRC_OVER;
+    uint32_t center = pixel_at(bf, (int)(300 * bf->scale_x), (int)(300 * bf->scale_y));
+    uint32_t outside = pixel_at(bf, (int)(300 * bf->scale_x), (int)(250 * bf->scale_y));
+    if (center != 0 || outside != 0xFF808080u) {
+        ERROR("DST_OUT hole is %08x inside and %08x outside", center, outside);
+        failed = 1;
+    }
+    if (!failed) INFO("Additive glow and erasing work like doing it by hand");
+
+    // Whole screen fills and blits in every mode
+    picasso_image *img = picasso_alloc_image(WIDTH, HEIGHT, 4);
+    foreach_pixel_u8(img, {
+        pixel[0] = (uint8_t)_x;
+        pixel[1] = (uint8_t)_y;
+        pixel[2] = (uint8_t)(_x ^ _y);
+        pixel[3] = (uint8_t)(_x + _y);
+    });
+    picasso_image_update_alpha(img);
+    picasso_image_premultiply(img);
+    picasso_rect screen = { 0, 0, WIDTH, HEIGHT };
+    for (int mode = 0; mode < PICASSO_BLEND_COUNT; ++mode) {
+        bf->blend = (picasso_blend_mode)mode;
+        double t0 = get_time();
+        for (int i = 0; i < FRAMES; ++i) picasso_fill_rect(bf, &screen, SET_ALPHA(TEAL, 60));
+        double t1 = get_time();
+        for (int i = 0; i < FRAMES; ++i) picasso_blit(bf, img, screen, screen);
+        double t2 = get_time();
+        INFO("%-9s fill %.2f ms, blit %.2f ms", mode_name[mode],
+             (t1 - t0) * 1e3 / FRAMES, (t2 - t1) * 1e3 / FRAMES);
+    }
+    bf->blend = PICASSO_BLEND_SRC_OVER;
+
+    picasso_free_image(img);
+    picasso_free_image(glow);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
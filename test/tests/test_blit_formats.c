@@ -0,0 +1,129 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso blit kernels per source format
+*
+*   Description:
+*       Checks picasso_image_update_alpha sorts images into opaque, mask and
+*       blended, then blits images of every channel count and alpha kind at
+*       several scales and with every filter, once with the alpha kind known
+*       (copy and alpha test kernels) and once unknown (always blended). Both
+*       have to come out the same. Times full screen blits of a 24 bit and an
+*       opaque 32 bit image against a translucent one.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define FRAMES  50
+
+static const char *alpha_name[] = { "unknown", "opaque", "mask", "blend" };
+
+// Random colors, and alpha that is all 255, 0 or 255, or anything
+static picasso_image *random_image(int w, int h, int channels, picasso_alpha kind)
+{
+    picasso_image *img = picasso_alloc_image(w, h, channels);
+    for (int i = 0; i < img->row_stride * h; ++i) img->pixels[i] = (uint8_t)rng();
+    if (channels == 2 || channels == 4) {
+        for (int i = 0; i < w * h; ++i) {
+            uint8_t *a = &img->pixels[i * channels + channels - 1];
+            if (kind == PICASSO_ALPHA_OPAQUE) *a = 255;
+            else if (kind == PICASSO_ALPHA_MASK) *a = rng() % 2 ? 255 : 0;
+        }
+    }
+    return img;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x68E31DA4u);
+
+    Window *win = create_window("Picasso blit formats", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    if (!bf || !ref) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    // Every channel count and alpha kind, scaled up, down, unscaled and
+    // flipped, with every filter
+    const picasso_rect dst_rects[] = {
+        { 13, 7, 61, 45 }, { 100, 50, 300, 200 }, { 5, 300, 25, 19 },
+        { 700, 590, -230, -170 }, { -20, -10, 250, 90 },
+    };
+    for (int channels = 1; channels <= 4; ++channels) {
+        for (int kind = PICASSO_ALPHA_OPAQUE; kind <= PICASSO_ALPHA_BLEND; ++kind) {
+            if ((channels == 1 || channels == 3) && kind != PICASSO_ALPHA_OPAQUE) continue;
+
+            picasso_image *img = random_image(61, 45, channels, (picasso_alpha)kind);
+            if (img->alpha != PICASSO_ALPHA_OPAQUE && img->alpha != PICASSO_ALPHA_UNKNOWN) {
+                ERROR("%d channel image starts out %s", channels, alpha_name[img->alpha]);
+                failed = 1;
+            }
+            picasso_image_update_alpha(img);
+            if (img->alpha != (picasso_alpha)kind) {
+                ERROR("%d channel image is %s, expected %s", channels,
+                      alpha_name[img->alpha], alpha_name[kind]);
+                failed = 1;
+            }
+
+            for (size_t r = 0; r < sizeof(dst_rects) / sizeof(dst_rects[0]); ++r) {
+                for (int f = PICASSO_FILTER_NEAREST; f <= PICASSO_FILTER_BOX; ++f) {
+                    picasso_rect src_r = { (int)r, 2 * (int)r, 61 - 3 * (int)r, 45 - (int)r };
+                    noise(bf, false);
+                    picasso_blit_ex(bf, img, src_r, dst_rects[r], f);
+
+                    img->alpha = PICASSO_ALPHA_UNKNOWN;
+                    noise(ref, false);
+                    picasso_blit_ex(ref, img, src_r, dst_rects[r], f);
+                    img->alpha = (picasso_alpha)kind;
+
+                    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+                        ERROR("%d channel %s image into rect %zu, filter %d, differs from blending",
+                              channels, alpha_name[kind], r, f);
+                        failed = 1;
+                    }
+                }
+            }
+            picasso_free_image(img);
+        }
+    }
+    if (!failed) INFO("Copy and alpha test blits match blending for every format");
+
+    // Whole screen images, as backgrounds are
+    const struct { int channels; picasso_alpha kind; const char *name; } cases[] = {
+        { 3, PICASSO_ALPHA_OPAQUE, "24 bit" },
+        { 4, PICASSO_ALPHA_OPAQUE, "32 bit opaque" },
+        { 4, PICASSO_ALPHA_BLEND,  "32 bit translucent" },
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        picasso_image *img = random_image(bf->width, bf->height, cases[c].channels, cases[c].kind);
+        picasso_image_update_alpha(img);
+        picasso_image_premultiply(img); // as loaded images are
+        picasso_rect all = { 0, 0, img->width, img->height };
+        picasso_rect screen = { 0, 0, WIDTH, HEIGHT };
+
+        double t0 = get_time();
+        for (int i = 0; i < FRAMES; ++i) picasso_blit(bf, img, all, screen);
+        INFO("%-18s %dx%d blit %.2f ms", cases[c].name, img->width, img->height,
+             (get_time() - t0) * 1e3 / FRAMES);
+        picasso_free_image(img);
+    }
+
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -3,7 +3,7 @@
  *   CANOPY [Example] - Picasso Color conversion testing
  *
  *   Description:
- *       Attempts to convert RGB to YCrCb - chrominance and luminance
+ *       Converts RGB to YCbCr - luminance and chrominance
  *   Controls:
  *       [Close Window] - Exit application
  *
@@ -12,6 +12,7 @@
 #include "canopy.h"
 
 #include <math.h>
+#include <string.h>
 #include <blackbox.h>
 
 #define WIDTH 1200
@@ -34,33 +35,18 @@ int main(void)
     picasso_image *red_chrominance= picasso_alloc_image(bmp->width, bmp->height, 4);
     picasso_image *blue_chrominance= picasso_alloc_image(bmp->width, bmp->height, 4);
 
-    picasso_copy(bmp, grayscale);
-    picasso_copy(bmp, red_chrominance);
-    picasso_copy(bmp, blue_chrominance);
-
-    //    foreach_pixel_u8(grayscale, { // Handeled in copy now
-    //            color p = get_color_u8(pixel, grayscale->channels);
-    //            uint8_t Y = (76 * p.r + 150 * p.g + 29 * p.b) >> 8;
-    //           // float Y  = (0.299f * p.r) + (0.587f * p.g) + (0.114f * p.b);
-    //            uint8_t v = PICASSO_CLAMP(Y, 0, 255);
-    //            pixel = &v;
-    //    });
-    foreach_pixel_u8(red_chrominance, {
-            color p = get_color_u8(pixel, red_chrominance->channels);
-            float Cr = 128.0f + (0.5f * p.r) - (0.418688f * p.g) - (0.081312f * p.b);
-            uint8_t v = (uint8_t)PICASSO_CLAMP(Cr, 0, 255);
-            pixel[0] = v;
-            pixel[1] = pixel[2] = 0;
-            });
-    foreach_pixel_u8(blue_chrominance, {
-            color p = get_color_u8(pixel, blue_chrominance->channels);
-            float Cb = 128.0f - (0.168736f * p.r) - (0.331264f * p.g) + (0.5f * p.b);
-            uint8_t v = (uint8_t)PICASSO_CLAMP(Cb, 0, 255);
-            pixel[0] = pixel[1] = 0;
-            pixel[2] = v;
-            });
+    picasso_copy(bmp, grayscale); // BT.601 luma, the Y below
 
+    // Y, Cb and Cr planes in one go, then Cr shown as red and Cb as blue
+    picasso_image *ycbcr[3];
+    for (int i = 0; i < 3; ++i) ycbcr[i] = picasso_alloc_image(bmp->width, bmp->height, 1);
+    picasso_rgb_to_ycbcr(bmp, ycbcr, PICASSO_YCBCR_BT601);
 
+    picasso_image *none   = picasso_alloc_image(bmp->width, bmp->height, 1);
+    picasso_image *opaque = picasso_alloc_image(bmp->width, bmp->height, 1);
+    memset(opaque->pixels, 255, (size_t)opaque->height * opaque->row_stride);
+    picasso_merge_planes((picasso_image *[]){ ycbcr[2], none, none, opaque }, red_chrominance);
+    picasso_merge_planes((picasso_image *[]){ none, none, ycbcr[1], opaque }, blue_chrominance);
 
     set_fps(24);
 
@@ -0,0 +1,275 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso color conversion
+*
+*   Description:
+*       Checks the color kernels against their scalar references byte for
+*       byte at every length, YCbCr in all four spaces and HSV against the
+*       textbook float formulas, round trips, splitting and merging planes,
+*       and that whole images come out the same as row ranges of them. Then
+*       times a 1080p frame through YCbCr and HSV against converting it pixel
+*       by pixel in floats.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "picasso_internal.h"
+#include "test_random.h"
+#include <math.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define COUNT   1000
+#define WIDTH   1920
+#define HEIGHT  1080
+#define FRAMES  10
+
+static bool same_pixels(const picasso_image *a, const picasso_image *b)
+{
+    return memcmp(a->pixels, b->pixels, (size_t)a->height * a->row_stride) == 0;
+}
+
+static const float luma_weights[4][2] = { { 0.299f, 0.114f }, { 0.299f, 0.114f },
+                                          { 0.2126f, 0.0722f }, { 0.2126f, 0.0722f } };
+
+// YCbCr the way the standards write it down
+static void reference_ycbcr(int space, float r, float g, float b, float out[3])
+{
+    float kr = luma_weights[space][0], kb = luma_weights[space][1];
+    bool limited = space == PICASSO_YCBCR_BT601_LIMITED || space == PICASSO_YCBCR_BT709_LIMITED;
+    float y = kr * r + (1 - kr - kb) * g + kb * b;
+    float cb = (b - y) / (2 * (1 - kb)), cr = (r - y) / (2 * (1 - kr));
+    out[0] = limited ? 16 + y * 219 / 255 : y;
+    out[1] = 128 + (limited ? cb * 224 / 255 : cb);
+    out[2] = 128 + (limited ? cr * 224 / 255 : cr);
+}
+
+// HSV with hue in degrees, scaled to 0-256
+static void reference_hsv(float r, float g, float b, float out[3])
+{
+    float hi = fmaxf(r, fmaxf(g, b)), lo = fminf(r, fminf(g, b)), d = hi - lo;
+    float h = 0;
+    if (d > 0) {
+        if (hi == r)      h = fmodf((g - b) / d + 6, 6);
+        else if (hi == g) h = (b - r) / d + 2;
+        else              h = (r - g) / d + 4;
+    }
+    out[0] = h * 256 / 6;
+    out[1] = hi > 0 ? 255 * d / hi : 0;
+    out[2] = hi;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x1F83D9ABu);
+    int failed = 0;
+
+    // Every kernel at every length up to a few steps and from odd offsets,
+    // the same bytes as the scalar loop
+    static uint8_t in[4][COUNT + 16], out[3][COUNT + 16], ref[3][COUNT + 16];
+    static uint8_t packed[4 * (COUNT + 16)], packed_ref[4 * (COUNT + 16)];
+    for (int c = 0; c < 4; ++c)
+        for (int i = 0; i < COUNT + 16; ++i) in[c][i] = (uint8_t)rng();
+    // Grays, blacks and ties between the largest channels, where hue and
+    // saturation divide by 0 or pick a side
+    for (int i = 0; i < COUNT; i += 7) in[1][i] = in[0][i];
+    for (int i = 0; i < COUNT; i += 11) in[2][i] = in[1][i] = in[0][i];
+    for (int i = 0; i < COUNT; i += 13) in[2][i] = in[1][i] = in[0][i] = 0;
+
+    bool kernels = true;
+    for (int n = 0; n <= 100 && kernels; ++n) {
+        int len = n < 70 ? n : COUNT - (100 - n), at = n % 5;
+        for (int space = 0; space < 4; ++space) {
+            for (int k = 0; k < 3; ++k) {
+                const picasso_color_weights *w[2] = { &picasso__ycbcr_weights[space][k],
+                                                      &picasso__rgb_weights[space][k] };
+                for (int d = 0; d < 2; ++d) {
+                    picasso__color_dot3(out[0], in[0] + at, in[1] + at, in[2] + at, len, w[d]);
+                    picasso__color_dot3_scalar(ref[0], in[0] + at, in[1] + at, in[2] + at, len, w[d]);
+                    kernels = kernels && memcmp(out[0], ref[0], (size_t)len) == 0;
+                }
+            }
+        }
+        picasso__color_rgb_to_hsv(out[0], out[1], out[2], in[0] + at, in[1] + at, in[2] + at, len);
+        picasso__color_rgb_to_hsv_scalar(ref[0], ref[1], ref[2], in[0] + at, in[1] + at, in[2] + at, len);
+        for (int c = 0; c < 3; ++c) kernels = kernels && memcmp(out[c], ref[c], (size_t)len) == 0;
+        picasso__color_hsv_to_rgb(out[0], out[1], out[2], in[0] + at, in[1] + at, in[2] + at, len);
+        picasso__color_hsv_to_rgb_scalar(ref[0], ref[1], ref[2], in[0] + at, in[1] + at, in[2] + at, len);
+        for (int c = 0; c < 3; ++c) kernels = kernels && memcmp(out[c], ref[c], (size_t)len) == 0;
+
+        for (int channels = 1; channels <= 4; ++channels) {
+            const uint8_t *planes[4] = { in[0] + at, in[1] + at, in[2] + at, in[3] + at };
+            picasso__color_merge(packed, channels, planes, len);
+            picasso__color_merge_scalar(packed_ref, channels, planes, len);
+            kernels = kernels && memcmp(packed, packed_ref, (size_t)len * channels) == 0;
+            uint8_t back[4][COUNT + 16];
+            uint8_t *split[4] = { back[0], back[1], back[2], back[3] };
+            picasso__color_split(split, packed + at, channels, len - at > 0 ? len - at : 0);
+            uint8_t *split_ref[4] = { ref[0], ref[1], ref[2], out[0] };
+            picasso__color_split_scalar(split_ref, packed + at, channels, len - at > 0 ? len - at : 0);
+            for (int c = 0; c < channels; ++c)
+                kernels = kernels && memcmp(split[c], split_ref[c], (size_t)(len - at > 0 ? len - at : 0)) == 0;
+        }
+        if (!kernels) ERROR("Color kernels differ from the scalar ones at %d pixels", len);
+    }
+    failed |= !kernels;
+
+    // Every color of a 64 level cube against the formulas, and there and back
+    bool formulas = true;
+    for (int space = 0; space < 4; ++space) {
+        float worst = 0, worst_back = 0;
+        for (int i = 0; i < 64 * 64 * 64; ++i) {
+            uint8_t r = (uint8_t)(i % 64 * 255 / 63), g = (uint8_t)(i / 64 % 64 * 255 / 63);
+            uint8_t b = (uint8_t)(i / 4096 * 255 / 63);
+            uint8_t ycc[3], rgb[3];
+            for (int k = 0; k < 3; ++k)
+                picasso__color_dot3(&ycc[k], &r, &g, &b, 1, &picasso__ycbcr_weights[space][k]);
+            for (int k = 0; k < 3; ++k)
+                picasso__color_dot3(&rgb[k], &ycc[0], &ycc[1], &ycc[2], 1, &picasso__rgb_weights[space][k]);
+            float want[3];
+            reference_ycbcr(space, r, g, b, want);
+            for (int k = 0; k < 3; ++k) worst = fmaxf(worst, fabsf(ycc[k] - want[k]));
+            worst_back = fmaxf(worst_back, fmaxf(abs(rgb[0] - r), fmaxf(abs(rgb[1] - g), abs(rgb[2] - b))));
+        }
+        // Rounded once from weights a little off, and limited range has fewer
+        // levels to come back from
+        bool limited = space == PICASSO_YCBCR_BT601_LIMITED || space == PICASSO_YCBCR_BT709_LIMITED;
+        if (worst > 0.55f || worst_back > (limited ? 3 : 2)) {
+            ERROR("YCbCr space %d is off by %.2f, by %.0f back to RGB", space, worst, worst_back);
+            formulas = false;
+        }
+    }
+    float worst_hsv[3] = { 0 }, worst_hsv_back = 0;
+    for (int i = 0; i < 64 * 64 * 64; ++i) {
+        uint8_t r = (uint8_t)(i % 64 * 255 / 63), g = (uint8_t)(i / 64 % 64 * 255 / 63);
+        uint8_t b = (uint8_t)(i / 4096 * 255 / 63);
+        uint8_t hsv[3], rgb[3];
+        picasso__color_rgb_to_hsv(&hsv[0], &hsv[1], &hsv[2], &r, &g, &b, 1);
+        picasso__color_hsv_to_rgb(&rgb[0], &rgb[1], &rgb[2], &hsv[0], &hsv[1], &hsv[2], 1);
+        float want[3];
+        reference_hsv(r, g, b, want);
+        float dh = fabsf(hsv[0] - want[0]);
+        worst_hsv[0] = fmaxf(worst_hsv[0], fminf(dh, 256 - dh));
+        for (int k = 1; k < 3; ++k) worst_hsv[k] = fmaxf(worst_hsv[k], fabsf(hsv[k] - want[k]));
+        worst_hsv_back = fmaxf(worst_hsv_back, fmaxf(abs(rgb[0] - r), fmaxf(abs(rgb[1] - g), abs(rgb[2] - b))));
+    }
+    // Hue has 43 steps to a side of the hexagon, each some 6 levels of the
+    // channel in between, half of which can be off on the way back
+    if (worst_hsv[0] > 0.51f || worst_hsv[1] > 0.51f || worst_hsv[2] > 0 || worst_hsv_back > 4) {
+        ERROR("HSV is off by %.2f, %.2f, %.2f, by %.0f back to RGB", worst_hsv[0], worst_hsv[1],
+              worst_hsv[2], worst_hsv_back);
+        formulas = false;
+    }
+    failed |= !formulas;
+    if (kernels && formulas) INFO("Color kernels match the scalar ones and the formulas");
+
+    // Whole images, and the same images a few rows at a time
+    picasso_image *rgb = picasso_alloc_image(333, 77, 3), *rgba = picasso_alloc_image(333, 77, 4);
+    picasso_image *back = picasso_alloc_image(333, 77, 4), *rows = picasso_alloc_image(333, 77, 4);
+    picasso_image *gray = picasso_alloc_image(333, 77, 1), *copied = picasso_alloc_image(333, 77, 1);
+    picasso_image *planes[4], *row_planes[4];
+    for (int c = 0; c < 4; ++c) {
+        planes[c] = picasso_alloc_image(333, 77, 1);
+        row_planes[c] = picasso_alloc_image(333, 77, 1);
+    }
+    noise_fill(rgb);
+    noise_fill(rgba);
+    bool images = true;
+    for (int space = 0; space < 4; ++space) {
+        images &= picasso_rgb_to_ycbcr(rgba, planes, space);
+        for (int y = 0; y < 77; y += 20)
+            images &= picasso_rgb_to_ycbcr_rows(rgba, row_planes, space, y, PICASSO_MIN(y + 20, 77));
+        for (int c = 0; c < 3; ++c) images &= same_pixels(planes[c], row_planes[c]);
+        images &= picasso_ycbcr_to_rgb(planes, back, space);
+        images &= back->alpha == PICASSO_ALPHA_OPAQUE;
+        for (int y = 0; y < 77; y += 20)
+            images &= picasso_ycbcr_to_rgb_rows(planes, rows, space, y, PICASSO_MIN(y + 20, 77));
+        images &= same_pixels(back, rows);
+        images &= picasso_luma(rgb, gray, space);
+        picasso_rgb_to_ycbcr(rgb, planes, space);
+        images &= same_pixels(gray, planes[0]);
+    }
+    images &= picasso_rgb_to_hsv(rgba, back) && picasso_hsv_to_rgb_rows(back, rows, 0, 77);
+    for (int y = 0; y < 77; y += 30)
+        images &= picasso_rgb_to_hsv_rows(rgba, rows, y, PICASSO_MIN(y + 30, 77));
+    images &= same_pixels(back, rows);
+    for (int channels = 1; channels <= 4; ++channels) {
+        picasso_image *src = picasso_alloc_image(333, 77, channels), *dst = picasso_alloc_image(333, 77, channels);
+        noise_fill(src);
+        images &= picasso_split_planes(src, planes) && picasso_merge_planes_rows(planes, dst, 0, 77);
+        images &= same_pixels(src, dst);
+        picasso_free_image(src);
+        picasso_free_image(dst);
+    }
+    // Gray copies are BT.601 luma
+    picasso_copy(rgb, copied);
+    picasso_luma(rgb, gray, PICASSO_YCBCR_BT601);
+    images &= same_pixels(gray, copied);
+    // And what doesn't fit is turned down
+    images &= !picasso_luma(rgb, rgba, PICASSO_YCBCR_BT601) && !picasso_rgb_to_hsv(rgb, rgba) &&
+              !picasso_luma_rows(rgb, gray, PICASSO_YCBCR_BT601, 10, 78);
+    if (!images) {
+        ERROR("Whole images and row ranges of them don't convert the same");
+        failed = 1;
+    }
+
+    // A captured frame through the analysis conversions, pixel by pixel in
+    // floats like before, and through the kernels
+    picasso_image *frame = picasso_alloc_image(WIDTH, HEIGHT, 3), *hsv = picasso_alloc_image(WIDTH, HEIGHT, 3);
+    picasso_image *big[3];
+    for (int c = 0; c < 3; ++c) big[c] = picasso_alloc_image(WIDTH, HEIGHT, 1);
+    noise_fill(frame);
+    double t0 = get_time();
+    for (int f = 0; f < FRAMES; ++f) {
+        int i = 0;
+        foreach_pixel_u8(frame, {
+            float ycc[3];
+            reference_ycbcr(PICASSO_YCBCR_BT601, pixel[0], pixel[1], pixel[2], ycc);
+            for (int c = 0; c < 3; ++c) big[c]->pixels[i] = (uint8_t)PICASSO_CLAMP(ycc[c] + 0.5f, 0.0f, 255.0f);
+            ++i;
+        });
+    }
+    double t1 = get_time();
+    for (int f = 0; f < FRAMES; ++f) picasso_rgb_to_ycbcr(frame, big, PICASSO_YCBCR_BT601);
+    double t2 = get_time();
+    for (int f = 0; f < FRAMES; ++f) {
+        foreach_pixel_u8(frame, {
+            float v[3];
+            reference_hsv(pixel[0], pixel[1], pixel[2], v);
+            uint8_t *to = picasso__get_pixel_u8(hsv, _x, _y);
+            to[0] = (uint8_t)((int)(v[0] + 0.5f) & 255);
+            to[1] = (uint8_t)(v[1] + 0.5f);
+            to[2] = (uint8_t)v[2];
+        });
+    }
+    double t3 = get_time();
+    for (int f = 0; f < FRAMES; ++f) picasso_rgb_to_hsv(frame, hsv);
+    double t4 = get_time();
+    for (int f = 0; f < FRAMES; ++f) picasso_luma(frame, big[0], PICASSO_YCBCR_BT601);
+    double t5 = get_time();
+    INFO("%dx%d RGB to YCbCr: %.2f ms a frame per pixel in floats, %.2f ms with the %s kernels",
+         WIDTH, HEIGHT, (t1 - t0) * 1e3 / FRAMES, (t2 - t1) * 1e3 / FRAMES, picasso__span_backend());
+    INFO("%dx%d RGB to HSV:   %.2f ms a frame per pixel in floats, %.2f ms with the kernels",
+         WIDTH, HEIGHT, (t3 - t2) * 1e3 / FRAMES, (t4 - t3) * 1e3 / FRAMES);
+    INFO("%dx%d luma:         %.2f ms a frame", WIDTH, HEIGHT, (t5 - t4) * 1e3 / FRAMES);
+
+    for (int c = 0; c < 4; ++c) {
+        picasso_free_image(planes[c]);
+        picasso_free_image(row_planes[c]);
+    }
+    for (int c = 0; c < 3; ++c) picasso_free_image(big[c]);
+    picasso_free_image(frame);
+    picasso_free_image(hsv);
+    picasso_free_image(rgb);
+    picasso_free_image(rgba);
+    picasso_free_image(back);
+    picasso_free_image(rows);
+    picasso_free_image(gray);
+    picasso_free_image(copied);
+    shutdown_jobs();
+    shutdown_log();
+
+    return failed;
+}
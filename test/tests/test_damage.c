@@ -0,0 +1,119 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso damage tracking
+*
+*   Description:
+*       A static dashboard with a cursor moving over it. Every frame the whole
+*       scene is recorded, but only the area around the old and the new
+*       cursor position is redrawn and presented. With the headless backend
+*       each presented frame is checked against a full redraw, and the cost
+*       of a damaged frame is compared to a full one.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   1280
+#define HEIGHT  800
+#define FRAMES  120
+#define CURSOR  20
+
+static void draw_dashboard(picasso_backbuffer *bf, int cursor_x, int cursor_y)
+{
+    picasso_clear_backbuffer(bf);
+
+    // Panels and some content that never changes
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 6; ++col) {
+            picasso_rect panel = { 20 + col * 208, 20 + row * 192, 196, 180 };
+            picasso_fill_rect(bf, &panel, GRAY);
+            picasso_draw_rect(bf, &panel, 2, LIGHT_GRAY);
+            for (int bar = 0; bar < 8; ++bar) {
+                picasso_rect r = { panel.x + 12 + bar * 22, panel.y + 160 - (bar * 37 + col * 11) % 130,
+                                   16, (bar * 37 + col * 11) % 130 };
+                picasso_fill_rect(bf, &r, SET_ALPHA(TEAL, 80));
+            }
+            picasso_fill_circle_aa(bf, panel.x + 160, panel.y + 30, 14, SET_ALPHA(ORANGE, 70));
+        }
+    }
+
+    picasso_fill_circle_aa(bf, cursor_x, cursor_y, CURSOR, SET_ALPHA(PINK, 60));
+}
+
+static picasso_rect cursor_box(int x, int y)
+{
+    return (picasso_rect){ x - CURSOR - 2, y - CURSOR - 2, 2 * CURSOR + 5, 2 * CURSOR + 5 };
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+
+    Window *win = create_window("Picasso damage tracking", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *full = picasso_create_backbuffer(win);
+    if (!bf || !full) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    set_present_capture(win, true);
+
+    size_t size = (size_t)full->width * full->height * sizeof(uint32_t);
+    int mismatches = 0;
+    double damaged_time = 0.0, full_time = 0.0;
+    int old_x = 0, old_y = 0;
+
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        int x = 100 + frame * 9;
+        int y = 100 + (frame * 7) % (HEIGHT - 200);
+
+        // Tell picasso what changed, the first frame is all new
+        if (frame == 0) {
+            picasso_damage_rect(bf, NULL);
+        } else {
+            picasso_rect was = cursor_box(old_x, old_y), is = cursor_box(x, y);
+            picasso_damage_rect(bf, &was);
+            picasso_damage_rect(bf, &is);
+        }
+        old_x = x;
+        old_y = y;
+
+        double t0 = get_time();
+        picasso_begin_commands(bf);
+        draw_dashboard(bf, x, y);
+        picasso_submit_commands(bf, PICASSO_SUBMIT_DAMAGED | PICASSO_SUBMIT_TILED);
+        picasso_present_damage(win, bf);
+        double t1 = get_time();
+
+        draw_dashboard(full, x, y);
+        double t2 = get_time();
+
+        if (frame > 0) {
+            damaged_time += t1 - t0;
+            full_time += t2 - t1;
+        }
+
+        // Only the headless backend hands the presented frame back
+        const uint32_t *presented = get_present_capture(win);
+        if (presented && memcmp(presented, full->pixels, size) != 0) {
+            ERROR("Frame %d differs from a full redraw", frame);
+            mismatches++;
+        }
+    }
+
+    INFO("Average frame: damaged %.3f ms, full redraw %.3f ms",
+         damaged_time * 1e3 / (FRAMES - 1), full_time * 1e3 / (FRAMES - 1));
+    if (get_present_capture(win) && !mismatches)
+        INFO("All %d presented frames match a full redraw", FRAMES);
+
+    picasso_destroy_backbuffer(full);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return mismatches ? 1 : 0;
+}
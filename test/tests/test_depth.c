@@ -0,0 +1,169 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso 3D depth buffer
+*
+*   Description:
+*       Two cubes pushed into each other, over a floor that runs from behind
+*       the camera to the horizon, so it has to be clipped at the near plane.
+*       The tiled renderer must match drawing immediately with 16 and with
+*       32 bit depth, and with 32 bits the frame must not depend on the draw
+*       order. Then times a thousand cubes.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include <math.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define GRID    10
+#define FRAMES  10
+
+typedef struct {
+    picasso_vertex3d v[GRID * GRID * GRID * 24];
+    uint32_t idx[GRID * GRID * GRID * 36];
+    int vertex_count, index_count;
+} mesh;
+
+// Four corners counter-clockwise seen from outside, so back faces can be culled
+static void add_quad(mesh *m, const float c[3], const float u[3], const float v[3], color col)
+{
+    const float su[4] = { -1, 1, 1, -1 }, sv[4] = { -1, -1, 1, 1 };
+    uint32_t base = (uint32_t)m->vertex_count;
+    for (int i = 0; i < 4; ++i) {
+        m->v[m->vertex_count++] = (picasso_vertex3d){
+            .x = c[0] + su[i] * u[0] + sv[i] * v[0],
+            .y = c[1] + su[i] * u[1] + sv[i] * v[1],
+            .z = c[2] + su[i] * u[2] + sv[i] * v[2],
+            .c = col,
+            .u = (su[i] + 1) * 0.5f, .v = (sv[i] + 1) * 0.5f,
+        };
+    }
+    const uint32_t order[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int i = 0; i < 6; ++i) m->idx[m->index_count++] = base + order[i];
+}
+
+// Faces get darker away from the light, so edges stay visible without lighting
+static void add_cube(mesh *m, float x, float y, float z, float h, color col)
+{
+    const float axes[6][3][3] = {
+        { {  h, 0, 0 }, { 0, h, 0 }, { 0, 0, h } }, // +x: center, u, v
+        { { -h, 0, 0 }, { 0, 0, h }, { 0, h, 0 } },
+        { { 0,  h, 0 }, { 0, 0, h }, { h, 0, 0 } },
+        { { 0, -h, 0 }, { h, 0, 0 }, { 0, 0, h } },
+        { { 0, 0,  h }, { h, 0, 0 }, { 0, h, 0 } },
+        { { 0, 0, -h }, { 0, h, 0 }, { h, 0, 0 } },
+    };
+    const float shade[6] = { 0.8f, 0.6f, 1.0f, 0.4f, 0.9f, 0.5f };
+
+    for (int f = 0; f < 6; ++f) {
+        float c[3] = { x + axes[f][0][0], y + axes[f][0][1], z + axes[f][0][2] };
+        color s = { (uint8_t)(col.r * shade[f]), (uint8_t)(col.g * shade[f]),
+                    (uint8_t)(col.b * shade[f]), col.a };
+        add_quad(m, c, axes[f][1], axes[f][2], s);
+    }
+}
+
+static mesh cubes, floor_mesh, grid;
+
+static void draw_scene(picasso_backbuffer *bf, picasso_mat4 vp, float angle, bool reversed)
+{
+    picasso_mat4 spin = picasso_mat4_mul(vp, picasso_mat4_rotate_y(angle));
+
+    picasso_clear_backbuffer(bf);
+    picasso_clear_depth(bf);
+    if (!reversed) {
+        picasso_draw_mesh3d(bf, &vp, floor_mesh.v, floor_mesh.vertex_count, floor_mesh.idx,
+                            floor_mesh.index_count, NULL, PICASSO_3D_CULL_BACK);
+        picasso_draw_mesh3d(bf, &spin, cubes.v, cubes.vertex_count, cubes.idx,
+                            cubes.index_count, NULL, PICASSO_3D_CULL_BACK);
+    } else {
+        // Cube by cube, back to front would be the painter's order, this
+        // is the other way around
+        for (int i = cubes.index_count - 36; i >= 0; i -= 36)
+            picasso_draw_mesh3d(bf, &spin, cubes.v, cubes.vertex_count, &cubes.idx[i],
+                                36, NULL, PICASSO_3D_CULL_BACK);
+        picasso_draw_mesh3d(bf, &vp, floor_mesh.v, floor_mesh.vertex_count, floor_mesh.idx,
+                            floor_mesh.index_count, NULL, PICASSO_3D_CULL_BACK);
+    }
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+
+    Window *win = create_window("Picasso depth buffer", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *a = picasso_create_backbuffer(win);
+    picasso_backbuffer *b = picasso_create_backbuffer(win);
+    if (!a || !b) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+
+    add_cube(&cubes, -0.4f, 0.0f, 0.0f, 0.6f, ORANGE);
+    add_cube(&cubes, 0.4f, 0.2f, 0.3f, 0.5f, TEAL);
+    const float fc[3] = { 0, -0.7f, -20 }, fu[3] = { 30, 0, 0 }, fv[3] = { 0, 0, -26 };
+    add_quad(&floor_mesh, fc, fu, fv, GRAY);
+
+    // Camera a little above the floor, looking slightly down
+    picasso_mat4 proj = picasso_mat4_perspective(1.0f, (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+    picasso_mat4 view = picasso_mat4_mul(picasso_mat4_rotate_x(0.25f),
+                                         picasso_mat4_translate(0.0f, -0.5f, -3.0f));
+    picasso_mat4 vp = picasso_mat4_mul(proj, view);
+    size_t size = (size_t)a->width * a->height * sizeof(uint32_t);
+    int failed = 0;
+
+    const int bits[2] = { 16, 32 };
+    for (int i = 0; i < 2; ++i) {
+        picasso_attach_depth(a, bits[i]);
+        picasso_attach_depth(b, bits[i]);
+
+        draw_scene(a, vp, 0.6f, false);
+        picasso_begin_commands(b);
+        draw_scene(b, vp, 0.6f, false);
+        picasso_submit_commands(b, PICASSO_SUBMIT_TILED | PICASSO_SUBMIT_CULL);
+        if (memcmp(a->pixels, b->pixels, size) != 0) {
+            ERROR("%d bit depth: tiled differs from immediate", bits[i]);
+            failed = 1;
+        }
+    }
+
+    // Where the cubes cut through each other 16 bits can't tell the faces
+    // apart and the first one drawn wins, so only 32 bits is order free
+    draw_scene(b, vp, 0.6f, true);
+    if (memcmp(a->pixels, b->pixels, size) != 0) {
+        ERROR("The frame depends on the draw order");
+        failed = 1;
+    }
+    if (!failed) INFO("Occlusion is independent of the draw order, tiled and immediate match");
+
+    // A thousand cubes, 12k triangles
+    float step = 2.0f / GRID;
+    for (int x = 0; x < GRID; ++x)
+        for (int y = 0; y < GRID; ++y)
+            for (int z = 0; z < GRID; ++z)
+                add_cube(&grid, -1 + (x + 0.5f) * step, -1 + (y + 0.5f) * step, -1 + (z + 0.5f) * step,
+                         step * 0.3f, (color){ x * 255 / GRID, y * 255 / GRID, z * 255 / GRID, 255 });
+
+    double t0 = get_time();
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        picasso_mat4 mvp = picasso_mat4_mul(vp, picasso_mat4_rotate_y(frame * 0.1f));
+        picasso_clear_backbuffer(a);
+        picasso_clear_depth(a);
+        picasso_draw_mesh3d(a, &mvp, grid.v, grid.vertex_count, grid.idx, grid.index_count,
+                            NULL, PICASSO_3D_CULL_BACK);
+    }
+    INFO("%d cubes, %d triangles: %.2f ms per frame", GRID * GRID * GRID,
+         grid.index_count / 3, (get_time() - t0) * 1e3 / FRAMES);
+
+    picasso_destroy_backbuffer(b);
+    picasso_destroy_backbuffer(a);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -0,0 +1,101 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso triangle fill rule
+*
+*   Description:
+*       Covers a rectangle with a jittered triangle mesh, in both windings,
+*       using a half transparent color. With the top-left fill rule every
+*       pixel inside is blended exactly once: a pixel blended twice (shared
+*       edge drawn by both triangles) or never (a crack between them) shows
+*       up as a different value. Also times a fan of long, thin triangles.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define CELLS   16
+#define CELL_W  40
+#define CELL_H  30
+#define ORIGIN  40
+
+// Jitter stays small enough that every quad of the mesh stays convex
+static int jitter(int range)
+{
+    return (int)(rng() % (2 * range + 1)) - range;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x2545F491u);
+
+    Window *win = create_window("Picasso fill rule", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    if (!bf) {
+        ERROR("Failed to create backbuffer");
+        return 1;
+    }
+
+    int px[CELLS + 1][CELLS + 1], py[CELLS + 1][CELLS + 1];
+    for (int j = 0; j <= CELLS; ++j) {
+        for (int i = 0; i <= CELLS; ++i) {
+            bool inner = i > 0 && i < CELLS && j > 0 && j < CELLS;
+            px[j][i] = ORIGIN + i * CELL_W + (inner ? jitter(CELL_W / 6) : 0);
+            py[j][i] = ORIGIN + j * CELL_H + (inner ? jitter(CELL_H / 6) : 0);
+        }
+    }
+
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        bf->pixels[i] = 0xFF000000;
+
+    color half_red = SET_ALPHA(((color){ 0xFF, 0, 0, 0xFF }), 50);
+    for (int j = 0; j < CELLS; ++j) {
+        for (int i = 0; i < CELLS; ++i) {
+            // Alternate the diagonal and the winding
+            picasso_point3 a, b;
+            if ((i + j) % 2) {
+                a = (picasso_point3){ px[j][i], py[j][i], px[j][i+1], py[j][i+1], px[j+1][i+1], py[j+1][i+1] };
+                b = (picasso_point3){ px[j][i], py[j][i], px[j+1][i], py[j+1][i], px[j+1][i+1], py[j+1][i+1] };
+            } else {
+                a = (picasso_point3){ px[j][i], py[j][i], px[j+1][i], py[j+1][i], px[j][i+1], py[j][i+1] };
+                b = (picasso_point3){ px[j][i+1], py[j][i+1], px[j+1][i+1], py[j+1][i+1], px[j+1][i], py[j+1][i] };
+            }
+            picasso_fill_triangle(bf, a, half_red);
+            picasso_fill_triangle(bf, b, half_red);
+        }
+    }
+
+    // Logical to pixels, the mesh covers exactly this rect
+    int x0 = (int)(ORIGIN * bf->scale_x), x1 = (int)((ORIGIN + CELLS * CELL_W) * bf->scale_x);
+    int y0 = (int)(ORIGIN * bf->scale_y), y1 = (int)((ORIGIN + CELLS * CELL_H) * bf->scale_y);
+    uint32_t once = bf->pixels[y0 * bf->width + x0] & 0xFF;
+
+    int wrong = 0;
+    for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x)
+            if ((bf->pixels[y * bf->width + x] & 0xFF) != once) wrong++;
+
+    if (wrong) ERROR("%d pixels inside the mesh were not blended exactly once", wrong);
+    else       INFO("Every pixel of the %d triangle mesh was blended exactly once",
+                    2 * CELLS * CELLS);
+
+    // Long thin triangles, the worst case for a bounding box scan
+    double t0 = get_time();
+    for (int i = 0; i < 2000; ++i) {
+        int x = (int)(rng() % WIDTH), y = (int)(rng() % HEIGHT);
+        picasso_fill_triangle(bf, (picasso_point3){ 0, 0, x, HEIGHT, x + 2, y }, SET_ALPHA(TEAL, 30));
+    }
+    INFO("2000 thin triangles: %.2f ms", (get_time() - t0) * 1e3);
+
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,222 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso blit filters
+*
+*   Description:
+*       Checks what each filter of picasso_blit_ex does on images where the
+*       answer is known: nearest doubles pixels, bilinear keeps a flat image
+*       flat and a 1:1 blit exact, and box, bilinear and trilinear (the last
+*       two through mip levels) shrink a one pixel checkerboard to flat gray
+*       where nearest only ever sees one of the two colors, and the color of
+*       fully transparent texels never shows when filtering, and one texel
+*       magnified more than 65536 times fills every pixel it covers.
+*       Then blits random parts of images of every channel count immediately
+*       and tiled, which have to match, and times a big image scaled down
+*       onto the whole backbuffer with each filter.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define BLITS   200
+
+static const char *filter_name[] = { "nearest", "bilinear", "box", "trilinear" };
+
+static void black(picasso_backbuffer *bf)
+{
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        bf->pixels[i] = 0xFF000000;
+}
+
+static uint32_t pixel_at(picasso_backbuffer *bf, int x, int y)
+{
+    return bf->pixels[y * bf->width + x];
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x2545F491u);
+
+    Window *win = create_window("Picasso blit filters", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    if (!bf || !ref) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    // Sizes below are in pixels, the rects are logical
+    float sx = bf->scale_x, sy = bf->scale_y;
+    int failed = 0;
+
+    // Nearest at twice the size repeats every texel in a 2x2 block
+    picasso_image *small = picasso_alloc_image(16, 16, 4);
+    for (int i = 0; i < 16 * 16 * 4; ++i) small->pixels[i] = (uint8_t)rng();
+    for (int i = 0; i < 16 * 16; ++i) small->pixels[4 * i + 3] = 255;
+    black(bf);
+    picasso_blit(bf, small, (picasso_rect){ 0, 0, 16, 16 },
+                 (picasso_rect){ 0, 0, (int)(32 / sx), (int)(32 / sy) });
+    for (int y = 0; y < 32 && !failed; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            uint32_t expected;
+            memcpy(&expected, &small->pixels[((y / 2) * 16 + x / 2) * 4], 4);
+            if (pixel_at(bf, x, y) != expected) {
+                ERROR("Nearest at (%d, %d) is %08x, expected %08x", x, y, pixel_at(bf, x, y), expected);
+                failed = 1;
+                break;
+            }
+        }
+    }
+
+    // Bilinear at 1:1 samples the texel centers exactly
+    black(bf);
+    picasso_blit_ex(bf, small, (picasso_rect){ 0, 0, 16, 16 },
+                    (picasso_rect){ 0, 0, (int)(16 / sx), (int)(16 / sy) }, PICASSO_FILTER_BILINEAR);
+    if (memcmp(&bf->pixels[0], small->pixels, 16 * 4) != 0) {
+        ERROR("Bilinear at 1:1 changed the image");
+        failed = 1;
+    }
+
+    // A flat color stays flat under every filter and scale
+    picasso_image *flat = picasso_alloc_image(37, 23, 3);
+    for (int i = 0; i < 37 * 23; ++i) {
+        flat->pixels[3 * i] = 200;
+        flat->pixels[3 * i + 1] = 100;
+        flat->pixels[3 * i + 2] = 50;
+    }
+    for (int f = PICASSO_FILTER_NEAREST; f <= PICASSO_FILTER_TRILINEAR; ++f) {
+        for (int size = 5; size < 300; size += 91) {
+            black(bf);
+            picasso_blit_ex(bf, flat, (picasso_rect){ 0, 0, 37, 23 },
+                            (picasso_rect){ 0, 0, size, size }, f);
+            int n = (int)(size * sx);
+            for (int i = 0; i < n; ++i) {
+                if (pixel_at(bf, i, i) != 0xFF3264C8) {
+                    ERROR("Flat image %s at %d is %08x", filter_name[f], size, pixel_at(bf, i, i));
+                    failed = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    // A one pixel checkerboard shrunk 4 times
+    picasso_image *checker = picasso_alloc_image(256, 256, 1);
+    for (int y = 0; y < 256; ++y)
+        for (int x = 0; x < 256; ++x)
+            checker->pixels[y * 256 + x] = (x + y) % 2 ? 255 : 0;
+    for (int f = PICASSO_FILTER_NEAREST; f <= PICASSO_FILTER_TRILINEAR; ++f) {
+        black(bf);
+        picasso_blit_ex(bf, checker, (picasso_rect){ 0, 0, 256, 256 },
+                        (picasso_rect){ 0, 0, (int)(64 / sx), (int)(64 / sy) }, f);
+        int lo = 255, hi = 0;
+        for (int y = 0; y < 64; ++y) {
+            for (int x = 0; x < 64; ++x) {
+                int v = pixel_at(bf, x, y) & 0xFF;
+                lo = PICASSO_MIN(lo, v);
+                hi = PICASSO_MAX(hi, v);
+            }
+        }
+        bool gray = lo == 128 && hi == 128;
+        if (gray != (f != PICASSO_FILTER_NEAREST)) {
+            ERROR("Checkerboard shrunk with %s is %d to %d", filter_name[f], lo, hi);
+            failed = 1;
+        }
+    }
+
+    // Red next to invisible green. Filtered premultiplied, the green has no
+    // weight at all, straight it would tint the edge
+    picasso_image *edge = picasso_alloc_image(2, 1, 4);
+    memcpy(edge->pixels, (uint8_t[]){ 255, 0, 0, 255, 0, 255, 0, 0 }, 8);
+    for (int f = PICASSO_FILTER_BILINEAR; f <= PICASSO_FILTER_TRILINEAR; ++f) {
+        black(bf);
+        picasso_blit_ex(bf, edge, (picasso_rect){ 0, 0, 2, 1 },
+                        (picasso_rect){ 0, 0, (int)(16 / sx), (int)(2 / sy) }, f);
+        for (int x = 0; x < 16; ++x) {
+            if ((pixel_at(bf, x, 0) >> 8) & 0xFF) {
+                ERROR("Transparent green bleeds into %s at %d: %08x", filter_name[f], x, pixel_at(bf, x, 0));
+                failed = 1;
+                break;
+            }
+        }
+    }
+
+    // One texel blown up past 65536 times, where the step rounds down to 0
+    picasso_image *dot = picasso_alloc_image(1, 1, 4);
+    memcpy(dot->pixels, (uint8_t[]){ 50, 100, 200, 255 }, 4);
+    for (int f = PICASSO_FILTER_NEAREST; f <= PICASSO_FILTER_TRILINEAR; ++f) {
+        black(bf);
+        picasso_blit_ex(bf, dot, (picasso_rect){ 0, 0, 1, 1 },
+                        (picasso_rect){ 0, 0, 70000, 10 }, f);
+        for (uint32_t x = 0; x < bf->width; ++x) {
+            if (pixel_at(bf, (int)x, 0) != 0xFFC86432) {
+                ERROR("One texel magnified with %s is %08x at %u", filter_name[f],
+                      pixel_at(bf, (int)x, 0), x);
+                failed = 1;
+                break;
+            }
+        }
+    }
+    if (!failed) INFO("Nearest, bilinear, box and trilinear filters sample what they should");
+
+    // Random parts of images with 1 to 4 channels, immediate and tiled
+    picasso_image *images[4];
+    for (int c = 0; c < 4; ++c) {
+        images[c] = picasso_alloc_image(97 + 31 * c, 131 - 17 * c, c + 1);
+        int bytes = images[c]->row_stride * images[c]->height;
+        for (int i = 0; i < bytes; ++i) images[c]->pixels[i] = (uint8_t)rng();
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        picasso_backbuffer *dst = pass ? bf : ref;
+        rng_seed(0x9E3779B9u);
+        if (pass) picasso_begin_commands(bf);
+        picasso_clear_backbuffer(dst);
+        for (int i = 0; i < BLITS; ++i) {
+            picasso_image *img = images[i % 4];
+            picasso_rect src_r = { (int)(rng() % 40) - 10, (int)(rng() % 40) - 10,
+                                   1 + (int)(rng() % 120), 1 + (int)(rng() % 120) };
+            picasso_rect dst_r = { (int)(rng() % (WIDTH + 100)) - 50,
+                                   (int)(rng() % (HEIGHT + 100)) - 50,
+                                   (int)(rng() % 300) - 40, (int)(rng() % 300) - 40 };
+            picasso_blit_ex(dst, img, src_r, dst_r, (picasso_filter)(i / 4 % 4));
+        }
+        if (pass) picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    }
+    if (memcmp(bf->pixels, ref->pixels, (size_t)bf->width * bf->height * sizeof(uint32_t)) != 0) {
+        ERROR("Tiled blits differ from the immediate ones");
+        failed = 1;
+    }
+
+    // A big photo sized image onto the whole backbuffer
+    picasso_image *big = picasso_alloc_image(2048, 1536, 4);
+    for (int i = 0; i < 2048 * 1536 * 4; ++i) big->pixels[i] = (uint8_t)rng();
+    for (int f = PICASSO_FILTER_NEAREST; f <= PICASSO_FILTER_TRILINEAR; ++f) {
+        double t0 = get_time();
+        for (int k = 0; k < 10; ++k)
+            picasso_blit_ex(bf, big, (picasso_rect){ 0, 0, 2048, 1536 },
+                            (picasso_rect){ 0, 0, WIDTH, HEIGHT }, f);
+        INFO("2048x1536 onto %dx%d, %-8s %.2f ms", bf->width, bf->height,
+             filter_name[f], (get_time() - t0) * 1e2);
+    }
+
+    picasso_free_image(big);
+    for (int c = 0; c < 4; ++c) picasso_free_image(images[c]);
+    picasso_free_image(dot);
+    picasso_free_image(edge);
+    picasso_free_image(checker);
+    picasso_free_image(flat);
+    picasso_free_image(small);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -1,5 +1,3 @@
-#define STB_TRUETYPE_IMPLEMENTATION
-#include "stb_truetype.h"
 #include "picasso.h"
 #include "canopy.h"
 #include <blackbox.h>
@@ -18,63 +16,29 @@ int main(void) {
     // Load font
     const char *font_path = "fonts/LibreBaskerville-Regular.ttf";
 
-    picasso_reader *reader = picasso_read_entire_file(font_path);
-    if (!reader) {
-        FATAL("Failed to read font file");
+    picasso_font *font = picasso_load_font(font_path, 64.0f);
+    if (!font) {
+        FATAL("Failed to load font");
         exit(1);
     }
 
-    stbtt_fontinfo font;
-    if (!stbtt_InitFont(&font, reader->ptr,
-        stbtt_GetFontOffsetForIndex(reader->ptr, 0)))
-    {
-        FATAL("Failed to init font");
-        exit(1);
-    }
-
-    float size = 64.0f;
-    float scale = stbtt_ScaleForPixelHeight(&font, size);
-
-    // Get vertical baseline
-    int ascent, descent, lineGap;
-    stbtt_GetFontVMetrics(&font, &ascent, &descent, &lineGap);
-    int baseline = (int)(ascent * scale);
-
     const char *text = "Hello M B P X A N a b c";
     color c = PURPLE;
-    int x = 10;  // starting x pos
 
     while (!window_should_close(window)) {
         pump_messages();
         if (should_render_frame()) {
             picasso_clear_backbuffer(bf);
 
-            x = 10;  // reset per frame
-            for (const char *p = text; *p; ++p) {
-                int w, h, xoff, yoff;
-                uint8_t *bitmap = stbtt_GetCodepointBitmap(
-                        &font, 0, scale, *p, &w, &h, &xoff, &yoff);
-
-                draw_bitmap_to_backbuffer(bf, bitmap, w, h, x + xoff, 300 -
-                        baseline + yoff, c);
-                stbtt_FreeBitmap(bitmap, NULL);
-
-                // advance x position
-                int ax;
-                stbtt_GetCodepointHMetrics(&font, *p, &ax, 0);
-                x += (int)(ax * scale);
+            // Glyphs are rasterized on the first frame, then drawn from the
+            // glyph cache
+            picasso_draw_text(bf, font, text, 10, 300, c);
 
-                // optional kerning
-                if (*(p + 1)) {
-                    x += (int)(stbtt_GetCodepointKernAdvance(&font,
-                            *p, *(p + 1)) * scale);
-                }
-            }
             swap_backbuffer(window, (framebuffer *)bf);
             present_buffer(window);
         }
     }
-    picasso_reader_free(reader);
+    picasso_destroy_font(font);
     shutdown_log();
     return 0;
 }
@@ -0,0 +1,220 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Canopy jobs and parallel Picasso
+*
+*   Description:
+*       Checks that parallel_for and parallel_for_tiles visit every index and
+*       pixel exactly once, grains and edges included, and that job groups
+*       wait for everything they ran, nested inside jobs too. Then runs the
+*       whole-image operations on an 8K backbuffer, once on one thread and
+*       once on all of them, checks both give the same bytes, and times them.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "picasso_internal.h"
+#include "test_random.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   7680
+#define HEIGHT  4320
+#define COUNT   100003
+
+static atomic_int visits[COUNT];
+
+static void visit(int begin, int end, void *arg)
+{
+    (void)arg;
+    for (int i = begin; i < end; ++i) atomic_fetch_add(&visits[i], 1);
+}
+
+static void visit_tile(int x0, int y0, int x1, int y1, void *arg)
+{
+    int width = *(int *)arg;
+    for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x) atomic_fetch_add(&visits[y * width + x], 1);
+}
+
+static bool visited_once(int n)
+{
+    for (int i = 0; i < n; ++i)
+        if (atomic_load(&visits[i]) != 1) return false;
+    return true;
+}
+
+// A job that runs a group of its own and waits on it
+static atomic_int leaves;
+static void leaf(void *arg)
+{
+    (void)arg;
+    atomic_fetch_add(&leaves, 1);
+}
+
+static void branch(void *arg)
+{
+    (void)arg;
+    job_group *group = create_job_group();
+    for (int i = 0; i < 10; ++i) job_group_run(group, leaf, NULL);
+    job_group_wait(group);
+    free_job_group(group);
+    // parallel_for from inside a job as well
+    parallel_for(0, 1000, 10, visit, NULL);
+}
+
+typedef struct {
+    picasso_image *image, *half, *gray;
+    bmp *encoded;
+    picasso_image *loaded;
+    double ms[6];
+} whole_image_run;
+
+// Every whole-image operation that goes through the job system, timed
+static void run_whole_image(picasso_backbuffer *bf, whole_image_run *r)
+{
+    double t0 = get_time();
+    picasso_clear_backbuffer(bf);
+    double t1 = get_time();
+
+    // Random premultiplied pixels, opaque, clear and in between
+    rng_seed(0x3243F6A8u);
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i) {
+        uint32_t p = rng();
+        bf->pixels[i] = i % 3 ? p | 0xFF000000u : p;
+    }
+    picasso__span_premultiply_scalar(bf->pixels, (int)(bf->width * bf->height));
+
+    double t2 = get_time();
+    r->image = picasso_image_from_backbuffer(bf);
+    double t3 = get_time();
+    r->half = picasso_alloc_image(WIDTH / 2, HEIGHT / 2, 3);
+    r->gray = picasso_alloc_image(WIDTH, HEIGHT, 1);
+    picasso_copy(r->image, r->half);
+    picasso_copy(r->image, r->gray);
+    double t4 = get_time();
+    r->encoded = picasso_create_bmp_from_rgba(r->image->pixels, WIDTH, HEIGHT, 4);
+    picasso_save_to_bmp(r->encoded, "jobs.bmp", 0);
+    double t5 = get_time();
+    r->loaded = picasso_load_bmp("jobs.bmp");
+    double t6 = get_time();
+    picasso_image_premultiply(r->image);
+    double t7 = get_time();
+
+    r->ms[0] = (t1 - t0) * 1e3;
+    r->ms[1] = (t3 - t2) * 1e3;
+    r->ms[2] = (t4 - t3) * 1e3;
+    r->ms[3] = (t5 - t4) * 1e3;
+    r->ms[4] = (t6 - t5) * 1e3;
+    r->ms[5] = (t7 - t6) * 1e3;
+}
+
+static bool same_image(const picasso_image *a, const picasso_image *b)
+{
+    return a && b && a->width == b->width && a->height == b->height && a->alpha == b->alpha &&
+           memcmp(a->pixels, b->pixels, (size_t)a->height * a->row_stride) == 0;
+}
+
+static void free_run(whole_image_run *r)
+{
+    picasso_free_image(r->image);
+    picasso_free_image(r->half);
+    picasso_free_image(r->gray);
+    picasso_free_image(r->loaded);
+    picasso_free(r->encoded->pixels);
+    picasso_free(r->encoded);
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x7F4A7C15u);
+    int failed = 0;
+    int threads = get_job_threads();
+
+    // Every index once, for grains from one to more than the range
+    const int grains[] = { 1, 7, 1000, COUNT * 2 };
+    for (int g = 0; g < 4; ++g) {
+        memset(visits, 0, sizeof(visits));
+        parallel_for(0, COUNT, grains[g], visit, NULL);
+        if (!visited_once(COUNT)) {
+            ERROR("parallel_for with a grain of %d missed or repeated indices", grains[g]);
+            failed = 1;
+        }
+    }
+
+    // Every pixel once, the last row and column of tiles cut short
+    int width = 317, height = 293;
+    memset(visits, 0, sizeof(visits));
+    parallel_for_tiles(width, height, 64, 48, visit_tile, &width);
+    if (!visited_once(width * height)) {
+        ERROR("parallel_for_tiles missed or repeated pixels");
+        failed = 1;
+    }
+
+    // Groups of jobs that run groups and parallel_for themselves, the group
+    // reused after a wait
+    memset(visits, 0, sizeof(visits));
+    job_group *group = create_job_group();
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 50; ++i) job_group_run(group, branch, NULL);
+        job_group_wait(group);
+    }
+    free_job_group(group);
+    bool nested = atomic_load(&leaves) == 2 * 50 * 10;
+    for (int i = 0; i < 1000; ++i) nested = nested && atomic_load(&visits[i]) == 2 * 50;
+    if (!nested) {
+        ERROR("Nested jobs ran %d leaves, not %d", atomic_load(&leaves), 2 * 50 * 10);
+        failed = 1;
+    }
+
+    // Pinned to the cores in order, still the same work
+    int cpus[64];
+    for (int i = 0; i < 64; ++i) cpus[i] = i % threads;
+    set_job_affinity(cpus, threads);
+    memset(visits, 0, sizeof(visits));
+    parallel_for(0, COUNT, 100, visit, NULL);
+    if (!visited_once(COUNT)) {
+        ERROR("parallel_for with pinned threads missed or repeated indices");
+        failed = 1;
+    }
+    set_job_affinity(NULL, 0);
+    if (!failed) INFO("Jobs ran every index, tile and nested job exactly once on %d threads", threads);
+
+    // An 8K frame on a render node: one thread, then all of them
+    Window *win = create_window("Canopy jobs", WIDTH, HEIGHT, CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    if (!bf) {
+        ERROR("Failed to create an 8K backbuffer");
+        return 1;
+    }
+    whole_image_run one, all;
+    set_job_threads(1);
+    run_whole_image(bf, &one);
+    set_job_threads(0);
+    run_whole_image(bf, &all);
+    remove("jobs.bmp");
+
+    if (!same_image(one.image, all.image) || !same_image(one.half, all.half) ||
+        !same_image(one.gray, all.gray) || !same_image(one.loaded, all.loaded) ||
+        memcmp(one.encoded->pixels, all.encoded->pixels, one.encoded->ih.size_image) != 0) {
+        ERROR("Whole-image operations differ between one thread and %d", threads);
+        failed = 1;
+    }
+
+    const char *names[] = { "clear", "from backbuffer", "copy", "BMP encode and save",
+                            "BMP load", "premultiply" };
+    for (int i = 0; i < 6; ++i)
+        INFO("8K %-20s %7.2f ms on one thread, %7.2f ms on %d", names[i], one.ms[i], all.ms[i],
+             threads);
+
+    free_run(&one);
+    free_run(&all);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_jobs();
+    shutdown_log();
+
+    return failed;
+}
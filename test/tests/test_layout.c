@@ -0,0 +1,208 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso tiled image layout
+*
+*   Description:
+*       Lays images of every channel count out in 8x8 blocks and back and
+*       checks nothing moved, then draws the same things from the linear and
+*       the tiled copy: blits with every filter, sprites from a tiled atlas,
+*       a rotated textured mesh and picasso_copy, which all have to match.
+*       Times a big texture drawn turned a quarter, where every pixel of a
+*       row reads a different row of the texture, in both layouts.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <math.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define BLITS   200
+#define FRAMES  10
+
+// A linear image laid out again, same pixels and flags
+static picasso_image *tiled_copy(const picasso_image *img)
+{
+    picasso_image *t = picasso_alloc_image(img->width, img->height, img->channels);
+    memcpy(t->pixels, img->pixels, (size_t)img->row_stride * img->height);
+    t->alpha = img->alpha;
+    t->premultiplied = img->premultiplied;
+    picasso_image_set_layout(t, PICASSO_LAYOUT_TILED);
+    return t;
+}
+
+// A quad over the whole backbuffer with its texture turned by angle, the
+// middle part of it at about one texel per pixel
+static void draw_turned(picasso_backbuffer *bf, picasso_image *tex, float angle)
+{
+    float su = (float)bf->width / (float)tex->width, sv = (float)bf->height / (float)tex->height;
+    if (su > 1) su = 1;
+    if (sv > 1) sv = 1;
+    picasso_vertex v[4];
+    for (int i = 0; i < 4; ++i) {
+        float cx = (i == 1 || i == 2) ? 1.0f : 0.0f, cy = i >= 2 ? 1.0f : 0.0f;
+        float du = (cx - 0.5f) * su, dv = (cy - 0.5f) * sv;
+        v[i] = (picasso_vertex){
+            .x = cx * (float)bf->width / bf->scale_x, .y = cy * (float)bf->height / bf->scale_y,
+            .c = WHITE,
+            .u = 0.5f + du * cosf(angle) - dv * sinf(angle),
+            .v = 0.5f + du * sinf(angle) + dv * cosf(angle),
+        };
+    }
+    picasso_draw_mesh(bf, v, 4, (const uint32_t[]){ 0, 1, 2, 0, 2, 3 }, 6, tex);
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x3C6EF372u);
+
+    Window *win = create_window("Picasso tiled images", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    if (!bf || !ref) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    // Odd sizes, so the last blocks of a row and of a column are partial
+    picasso_image *linear[4], *tiled[4];
+    for (int c = 0; c < 4; ++c) {
+        linear[c] = noise_image(101 + 38 * c, 77 + 11 * c, c + 1);
+        tiled[c] = tiled_copy(linear[c]);
+        picasso_image *back = tiled_copy(linear[c]);
+        picasso_image_set_layout(back, PICASSO_LAYOUT_LINEAR);
+        if (tiled[c]->layout != PICASSO_LAYOUT_TILED || back->row_stride != linear[c]->row_stride ||
+            memcmp(back->pixels, linear[c]->pixels, (size_t)back->row_stride * back->height) != 0) {
+            ERROR("%d channels tiled and back changed the image", c + 1);
+            failed = 1;
+        }
+        for (int y = 0; y < linear[c]->height && !failed; ++y) {
+            for (int x = 0; x < linear[c]->width; ++x) {
+                if (memcmp(picasso__get_pixel_u8(linear[c], x, y), picasso__get_pixel_u8(tiled[c], x, y),
+                           (size_t)(c + 1)) != 0) {
+                    ERROR("%d channels tiled at %d,%d isn't the texel", c + 1, x, y);
+                    failed = 1;
+                    break;
+                }
+            }
+        }
+        picasso_image_update_alpha(tiled[c]);
+        if (tiled[c]->alpha != linear[c]->alpha) {
+            ERROR("%d channels tiled has alpha kind %d, linear %d", c + 1, tiled[c]->alpha, linear[c]->alpha);
+            failed = 1;
+        }
+        picasso_free_image(back);
+    }
+
+    // Random blits of both, immediate and tiled submits alike
+    for (int pass = 0; pass < 2; ++pass) {
+        picasso_image **images = pass ? tiled : linear;
+        picasso_backbuffer *dst = pass ? bf : ref;
+        rng_seed(0x510E527Fu);
+        if (pass) picasso_begin_commands(bf);
+        picasso_clear_backbuffer(dst);
+        for (int i = 0; i < BLITS; ++i) {
+            picasso_image *img = images[i % 4];
+            picasso_rect src_r = { (int)(rng() % 40) - 10, (int)(rng() % 40) - 10,
+                                   1 + (int)(rng() % 150), 1 + (int)(rng() % 120) };
+            picasso_rect dst_r = { (int)(rng() % (WIDTH + 100)) - 50,
+                                   (int)(rng() % (HEIGHT + 100)) - 50,
+                                   (int)(rng() % 300) - 40, (int)(rng() % 300) - 40 };
+            if (i % 8 == 0) dst_r.width = src_r.width, dst_r.height = src_r.height;
+            picasso_blit_ex(dst, img, src_r, dst_r, (picasso_filter)(i / 4 % 4));
+        }
+        if (pass) picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    }
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Blits of tiled images differ from the linear ones");
+        failed = 1;
+    }
+
+    // Sprites, scaled and flipped, from an atlas laid out both ways
+    picasso_atlas *atlas = picasso_create_atlas(linear, 4);
+    picasso_sprite sprites[300];
+    for (int i = 0; i < 300; ++i) {
+        sprites[i] = (picasso_sprite){
+            .x = (float)(rng() % WIDTH), .y = (float)(rng() % HEIGHT),
+            .src = atlas->rects[rng() % 4], .scale = (float)(rng() % 3) * 0.5f,
+            .flags = (int)(rng() % 4), .tint = rng() % 2 ? WHITE : SET_ALPHA(GOLD, 150),
+        };
+    }
+    picasso_clear_backbuffer(ref);
+    picasso_draw_sprites(ref, atlas, sprites, 300);
+    picasso_image_set_layout(atlas->image, PICASSO_LAYOUT_TILED);
+    picasso_clear_backbuffer(bf);
+    picasso_draw_sprites(bf, atlas, sprites, 300);
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Sprites from a tiled atlas differ from the linear one");
+        failed = 1;
+    }
+
+    // A textured mesh at an angle, and shrinking copies
+    for (int c = 0; c < 4; ++c) {
+        picasso_clear_backbuffer(ref);
+        draw_turned(ref, linear[c], 0.3f + (float)c);
+        picasso_clear_backbuffer(bf);
+        draw_turned(bf, tiled[c], 0.3f + (float)c);
+        if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+            ERROR("Mesh textured with %d channels tiled differs from linear", c + 1);
+            failed = 1;
+        }
+
+        picasso_image *a = picasso_alloc_image(23, 19, 4), *b = picasso_alloc_image(23, 19, 4);
+        picasso_image_set_layout(b, PICASSO_LAYOUT_TILED);
+        picasso_copy(linear[c], a);
+        picasso_copy(tiled[c], b);
+        picasso_image_set_layout(b, PICASSO_LAYOUT_LINEAR);
+        if (memcmp(a->pixels, b->pixels, (size_t)a->row_stride * a->height) != 0) {
+            ERROR("Copy of %d channels tiled differs from linear", c + 1);
+            failed = 1;
+        }
+        picasso_free_image(a);
+        picasso_free_image(b);
+    }
+    if (!failed) INFO("Tiled images draw the same as linear ones");
+
+    // Turned a quarter over a 4K backbuffer, a row of it walks down a column
+    // of the texture, far more rows than the cache holds. Tiled, eight of
+    // those texels share a block
+    Window *big_win = create_window("Picasso tiled images 4K", 3840, 2160, CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *big_bf = picasso_create_backbuffer(big_win);
+    picasso_image *big = noise_image(4096, 4096, 4);
+    picasso_image *big_tiled = tiled_copy(big);
+    for (int pass = 0; pass < 2; ++pass) {
+        picasso_image *tex = pass ? big_tiled : big;
+        double t0 = get_time();
+        for (int f = 0; f < FRAMES; ++f) draw_turned(big_bf, tex, (float)M_PI / 2);
+        double t1 = get_time();
+        for (int f = 0; f < FRAMES; ++f) draw_turned(big_bf, tex, 0);
+        double t2 = get_time();
+        INFO("4096x4096 %-6s texture over %dx%d: %.2f ms turned, %.2f ms upright",
+             pass ? "tiled" : "linear", big_bf->width, big_bf->height,
+             (t1 - t0) * 1e3 / FRAMES, (t2 - t1) * 1e3 / FRAMES);
+    }
+
+    picasso_free_image(big_tiled);
+    picasso_free_image(big);
+    picasso_destroy_backbuffer(big_bf);
+    free_window(big_win);
+    picasso_destroy_atlas(atlas);
+    for (int c = 0; c < 4; ++c) {
+        picasso_free_image(tiled[c]);
+        picasso_free_image(linear[c]);
+    }
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -0,0 +1,158 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso coverage masks
+*
+*   Description:
+*       Draws 8 bit coverage masks (a glyph, an antialiased disc, a hard
+*       stencil) at positions that clip them on every side, from inside a
+*       larger mask with its own stride, and checks every pixel against
+*       coverage times alpha blended one by one. Then checks they come out
+*       the same tiled, and times a screen of glyph sized masks against
+*       the bitmap drawing they replace.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "picasso_internal.h"
+#include "test_random.h"
+#include <math.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define MASK    96
+#define FRAMES  20
+
+// What a mask should do: every covered pixel blended on its own
+static void reference_mask(picasso_backbuffer *bf, const uint8_t *mask, int w, int h, int stride,
+                           int x, int y, color c)
+{
+    uint32_t src = color_to_u32(c);
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            int px = x + i, py = y + j;
+            if (px < 0 || px >= (int)bf->width || py < 0 || py >= (int)bf->height) continue;
+            uint32_t a = picasso__mul255(src >> 24, mask[j * stride + i]);
+            uint32_t *dst = picasso__get_pixel_u32(bf, px, py);
+            *dst = picasso__blend_pixel(*dst, (src & 0x00FFFFFF) | a << 24);
+        }
+    }
+}
+
+// What draw_bitmap_to_backbuffer did before: on or off, every pixel checked
+static void bitmap_before(picasso_backbuffer *bf, const uint8_t *bitmap, int w, int h, int xoff,
+                          int yoff, color c)
+{
+    for (int j = 0; j < h; ++j) {
+        for (int i = 0; i < w; ++i) {
+            int x = xoff + i, y = yoff + j;
+            if (x < 0 || x >= (int)bf->width || y < 0 || y >= (int)bf->height) continue;
+            if (bitmap[j * w + i] == 0) continue;
+            uint32_t dst = *picasso__get_pixel_u32(bf, x, y);
+            *picasso__get_pixel_u32(bf, x, y) = picasso__blend_pixel(dst, color_to_u32(c));
+        }
+    }
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x6A09E667u);
+
+    Window *win = create_window("Picasso masks", WIDTH, HEIGHT, CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    picasso_reader *file = picasso_read_entire_file("fonts/LibreBaskerville-Regular.ttf");
+    if (!bf || !ref || !file) {
+        ERROR("Failed to create backbuffers or read the font");
+        return 1;
+    }
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    // Three masks side by side in one: a glyph, a disc with soft edges and
+    // a checkered stencil with only 0 and 255
+    static uint8_t masks[MASK][3 * MASK];
+    stbtt_fontinfo info;
+    stbtt_InitFont(&info, file->fp, stbtt_GetFontOffsetForIndex(file->fp, 0));
+    float scale = stbtt_ScaleForPixelHeight(&info, 90);
+    stbtt_MakeCodepointBitmap(&info, &masks[0][0], MASK, MASK, 3 * MASK, scale, scale, 'g');
+    for (int j = 0; j < MASK; ++j) {
+        for (int i = 0; i < MASK; ++i) {
+            float d = sqrtf((float)((i - MASK / 2) * (i - MASK / 2) + (j - MASK / 2) * (j - MASK / 2)));
+            masks[j][MASK + i] = (uint8_t)(PICASSO_CLAMP(MASK / 2 - 2 - d, 0.0f, 1.0f) * 255.0f);
+            masks[j][2 * MASK + i] = ((i / 24 + j / 24) % 2) * 255;
+        }
+    }
+    const color colors[] = { WHITE, SET_ALPHA(GOLD, 160), SET_ALPHA(BLUE, 40) };
+
+    // Over every edge and corner, and each mask cut out of the others with
+    // their stride
+    const int spots[][2] = { { 100, 100 }, { -40, 200 }, { WIDTH - 50, 300 }, { 300, -60 },
+                             { 400, HEIGHT - 30 }, { -70, -70 }, { WIDTH - 20, HEIGHT - 20 } };
+    for (int m = 0; m < 3; ++m) {
+        noise(ref, true);
+        noise(bf, true);
+        for (int s = 0; s < 7; ++s) {
+            const uint8_t *mask = &masks[0][m * MASK];
+            reference_mask(ref, mask, MASK, MASK, 3 * MASK, spots[s][0], spots[s][1], colors[s % 3]);
+            picasso_draw_mask(bf, mask, MASK, MASK, 3 * MASK, spots[s][0], spots[s][1], colors[s % 3]);
+        }
+        if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+            ERROR("Mask %d differs from coverage blended pixel by pixel", m);
+            failed = 1;
+        }
+    }
+    if (!failed) INFO("Masks blend coverage times alpha, clipped on every side");
+
+    // All over, immediate and tiled
+    static int places[400][3];
+    for (int i = 0; i < 400; ++i) {
+        places[i][0] = (int)(rng() % (WIDTH + MASK)) - MASK;
+        places[i][1] = (int)(rng() % (HEIGHT + MASK)) - MASK;
+        places[i][2] = (int)(rng() % 3);
+    }
+    #define DRAW_MASKS(dst)                                                                    \
+        for (int i = 0; i < 400; ++i)                                                          \
+            picasso_draw_mask((dst), &masks[0][places[i][2] * MASK], MASK, MASK, 3 * MASK,     \
+                              places[i][0], places[i][1], colors[i % 3]);
+    noise(ref, true);
+    DRAW_MASKS(ref);
+    noise(bf, true);
+    picasso_begin_commands(bf);
+    DRAW_MASKS(bf);
+    picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Tiled masks differ from the immediate ones");
+        failed = 1;
+    }
+
+    // A screen of 24 pixel glyphs, mostly empty around the ink, in opaque
+    // and translucent rows
+    static uint8_t glyph[24 * 24];
+    float small = stbtt_ScaleForPixelHeight(&info, 24);
+    stbtt_MakeCodepointBitmap(&info, glyph, 24, 24, 24, small, small, 'g');
+    double t0 = get_time();
+    for (int f = 0; f < FRAMES; ++f)
+        for (int y = 0; y + 24 <= HEIGHT; y += 24)
+            for (int x = 0; x + 24 <= WIDTH; x += 16)
+                draw_bitmap_to_backbuffer(bf, glyph, 24, 24, x, y, colors[y / 24 % 2]);
+    double t1 = get_time();
+    for (int f = 0; f < FRAMES; ++f)
+        for (int y = 0; y + 24 <= HEIGHT; y += 24)
+            for (int x = 0; x + 24 <= WIDTH; x += 16)
+                bitmap_before(bf, glyph, 24, 24, x, y, colors[y / 24 % 2]);
+    double t2 = get_time();
+    INFO("%d glyph masks: %.2f ms a frame, %.2f ms drawn like bitmaps were before",
+         (HEIGHT / 24) * ((WIDTH - 24) / 16 + 1), (t1 - t0) * 1e3 / FRAMES, (t2 - t1) * 1e3 / FRAMES);
+
+    picasso_reader_free(file);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -0,0 +1,133 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso triangle meshes
+*
+*   Description:
+*       Draws a jittered, half transparent grid as one indexed mesh and checks
+*       it comes out exactly like the same triangles drawn one at a time, so
+*       shared edges are still blended once. Then times a 10k triangle mesh
+*       with vertex colors, and the same mesh textured, drawn immediately and
+*       through the tiled renderer.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define GRID_X  100
+#define GRID_Y  50
+#define FRAMES  20
+
+#define VERTEX_COUNT ((GRID_X + 1) * (GRID_Y + 1))
+#define INDEX_COUNT  (GRID_X * GRID_Y * 6)
+
+static picasso_vertex vertices[VERTEX_COUNT];
+static uint32_t indices[INDEX_COUNT];
+
+// A grid over the whole window, two triangles per cell. Inner vertices are
+// moved a little, whole units so the triangles can be drawn as picasso_point3
+static void build_grid(void)
+{
+    float cell_w = (float)WIDTH / GRID_X, cell_h = (float)HEIGHT / GRID_Y;
+
+    for (int j = 0; j <= GRID_Y; ++j) {
+        for (int i = 0; i <= GRID_X; ++i) {
+            bool inner = i > 0 && i < GRID_X && j > 0 && j < GRID_Y;
+            vertices[j * (GRID_X + 1) + i] = (picasso_vertex){
+                .x = (float)(int)(i * cell_w) + (inner ? (float)(rng() % 3) - 1.0f : 0.0f),
+                .y = (float)(int)(j * cell_h) + (inner ? (float)(rng() % 5) - 2.0f : 0.0f),
+                .c = { (uint8_t)(i * 255 / GRID_X), (uint8_t)(j * 255 / GRID_Y), 160, 255 },
+                .u = (float)i / GRID_X,
+                .v = (float)j / GRID_Y,
+            };
+        }
+    }
+
+    int n = 0;
+    for (int j = 0; j < GRID_Y; ++j) {
+        for (int i = 0; i < GRID_X; ++i) {
+            uint32_t a = j * (GRID_X + 1) + i, b = a + 1, c = a + GRID_X + 1, d = c + 1;
+            indices[n++] = a; indices[n++] = b; indices[n++] = d;
+            indices[n++] = a; indices[n++] = d; indices[n++] = c;
+        }
+    }
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x9E3779B9u);
+
+    Window *win = create_window("Picasso meshes", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    picasso_image *texture = picasso_load_bmp("assets/sample1.bmp");
+    if (!bf || !ref) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    if (!texture) WARN("Couldn't load the texture, timing vertex colors only");
+
+    build_grid();
+    size_t size = (size_t)bf->width * bf->height * sizeof(uint32_t);
+
+    // One translucent color, so the mesh takes the flat path and every
+    // triangle should match picasso_fill_triangle() to the bit
+    static picasso_vertex flat[VERTEX_COUNT];
+    color half_teal = SET_ALPHA(TEAL, 50);
+    for (int i = 0; i < VERTEX_COUNT; ++i) {
+        flat[i] = vertices[i];
+        flat[i].c = half_teal;
+    }
+
+    picasso_clear_backbuffer(bf);
+    picasso_clear_backbuffer(ref);
+    picasso_draw_mesh(bf, flat, VERTEX_COUNT, indices, INDEX_COUNT, NULL);
+    for (int i = 0; i < INDEX_COUNT; i += 3) {
+        const picasso_vertex *a = &flat[indices[i]], *b = &flat[indices[i + 1]], *c = &flat[indices[i + 2]];
+        picasso_fill_triangle(ref, (picasso_point3){ (int)a->x, (int)a->y, (int)b->x, (int)b->y,
+                                                     (int)c->x, (int)c->y }, half_teal);
+    }
+    int failed = memcmp(bf->pixels, ref->pixels, size) != 0;
+    if (failed) ERROR("The mesh differs from drawing its triangles one by one");
+    else        INFO("Flat mesh matches %d separate triangles", INDEX_COUNT / 3);
+
+    // Vertex colors and texture, immediate and tiled
+    picasso_image *textures[2] = { NULL, texture };
+    const char *names[2] = { "vertex colors", "textured" };
+    for (int t = 0; t < (texture ? 2 : 1); ++t) {
+        double t0 = get_time();
+        for (int frame = 0; frame < FRAMES; ++frame)
+            picasso_draw_mesh(ref, vertices, VERTEX_COUNT, indices, INDEX_COUNT, textures[t]);
+        double t1 = get_time();
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            picasso_begin_commands(bf);
+            picasso_draw_mesh(bf, vertices, VERTEX_COUNT, indices, INDEX_COUNT, textures[t]);
+            picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+        }
+        double t2 = get_time();
+
+        INFO("%d triangles, %s: %.2f ms immediate, %.2f ms tiled", INDEX_COUNT / 3, names[t],
+             (t1 - t0) * 1e3 / FRAMES, (t2 - t1) * 1e3 / FRAMES);
+
+        // Opaque, so the last frame alone decides the pixels
+        if (memcmp(bf->pixels, ref->pixels, size) != 0) {
+            ERROR("Tiled %s mesh differs from the immediate one", names[t]);
+            failed = 1;
+        }
+    }
+
+    if (texture) picasso_free_image(texture);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
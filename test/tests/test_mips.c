@@ -0,0 +1,257 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso mip levels
+*
+*   Description:
+*       Builds the mip levels of an odd sized image and checks every texel of
+*       every level is the rounded 2x2 average of the level above, and that
+*       blits only build them when they shrink with bilinear or trilinear.
+*       Shrunk by a power of two, bilinear then matches box within rounding,
+*       a checkerboard comes out flat gray at any scale, and a rect that
+*       doesn't line up with the levels doesn't pick up what is next to it.
+*       Tiled blits have to match immediate ones, and picasso_copy shrinks
+*       straight alpha images through the levels too. Times building the
+*       levels and shrinking a big image with each filter.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <stdlib.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define FRAMES  10
+
+static uint32_t pixel_at(picasso_backbuffer *bf, int x, int y)
+{
+    return bf->pixels[y * bf->width + x];
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x6A09E667u);
+
+    Window *win = create_window("Picasso mip levels", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    if (!bf || !ref) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    // Sizes below are in pixels, the rects are logical
+    float sx = bf->scale_x, sy = bf->scale_y;
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    // Premultiplied already, so level 1 averages the bytes of the image
+    picasso_image *odd = noise_image(37, 23, 4);
+    picasso_image_premultiply(odd);
+    picasso_image_build_mips(odd);
+    int levels = 0;
+    for (picasso_image *up = odd, *m = odd->mip; m && !failed; up = m, m = m->mip, ++levels) {
+        int w = up->width > 1 ? up->width / 2 : 1, h = up->height > 1 ? up->height / 2 : 1;
+        if (m->width != w || m->height != h || m->channels != 4 || !m->premultiplied) {
+            ERROR("Level %d is %dx%dx%d under %dx%d", levels + 1, m->width, m->height,
+                  m->channels, up->width, up->height);
+            failed = 1;
+            break;
+        }
+        for (int y = 0; y < h && !failed; ++y) {
+            for (int x = 0; x < w; ++x) {
+                int x0 = up->width > 1 ? 2 * x : 0, x1 = up->width > 1 ? 2 * x + 1 : 0;
+                int y0 = up->height > 1 ? 2 * y : 0, y1 = up->height > 1 ? 2 * y + 1 : 0;
+                for (int c = 0; c < 4; ++c) {
+                    int sum = picasso__get_pixel_u8(up, x0, y0)[c] + picasso__get_pixel_u8(up, x1, y0)[c] +
+                              picasso__get_pixel_u8(up, x0, y1)[c] + picasso__get_pixel_u8(up, x1, y1)[c];
+                    int have = picasso__get_pixel_u8(m, x, y)[c];
+                    if (have != (sum + 2) / 4) {
+                        ERROR("Level %d at %d,%d channel %d is %d, the average %d", levels + 1,
+                              x, y, c, have, (sum + 2) / 4);
+                        failed = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    picasso_image *last = odd;
+    while (last->mip) last = last->mip;
+    if (!failed && (levels != 5 || last->width != 1 || last->height != 1)) {
+        ERROR("37x23 has %d levels down to %dx%d", levels, last->width, last->height);
+        failed = 1;
+    }
+
+    // Only shrinking bilinear and trilinear blits build levels
+    picasso_image_drop_mips(odd);
+    picasso_rect all = { 0, 0, 37, 23 };
+    picasso_blit_ex(bf, odd, all, (picasso_rect){ 0, 0, 80, 50 }, PICASSO_FILTER_BILINEAR);
+    picasso_blit_ex(bf, odd, all, (picasso_rect){ 0, 0, 5, 5 }, PICASSO_FILTER_NEAREST);
+    picasso_blit_ex(bf, odd, all, (picasso_rect){ 0, 0, 5, 5 }, PICASSO_FILTER_BOX);
+    if (odd->mip) {
+        ERROR("Levels built by a blit that doesn't use them");
+        failed = 1;
+    }
+    picasso_blit_ex(bf, odd, all, (picasso_rect){ 0, 0, 5, 5 }, PICASSO_FILTER_TRILINEAR);
+    if (!odd->mip) {
+        ERROR("Shrinking trilinear didn't build the levels");
+        failed = 1;
+    }
+
+    // At a power of two, bilinear reads a level at 1:1, the box average of
+    // the texels it covers but for the rounding at every level
+    picasso_image *noise = noise_image(512, 512, 3);
+    picasso_rect whole = { 0, 0, 512, 512 };
+    picasso_rect thumb = { 0, 0, (int)(64 / sx), (int)(64 / sy) };
+    picasso_clear_backbuffer(bf);
+    picasso_clear_backbuffer(ref);
+    picasso_blit_ex(bf, noise, whole, thumb, PICASSO_FILTER_BILINEAR);
+    picasso_blit_ex(ref, noise, whole, thumb, PICASSO_FILTER_BOX);
+    for (int y = 0; y < 64 && !failed; ++y) {
+        for (int x = 0; x < 64; ++x) {
+            uint32_t a = pixel_at(bf, x, y), b = pixel_at(ref, x, y);
+            for (int c = 0; c < 32; c += 8) {
+                if (abs((int)((a >> c) & 0xFF) - (int)((b >> c) & 0xFF)) > 2) {
+                    ERROR("Bilinear at %d,%d is %08x, box %08x", x, y, a, b);
+                    failed = 1;
+                    y = 64;
+                    break;
+                }
+            }
+            if (failed) break;
+        }
+    }
+
+    // Every level of a one pixel checkerboard is 128
+    picasso_image *checker = picasso_alloc_image(256, 256, 1);
+    for (int y = 0; y < 256; ++y)
+        for (int x = 0; x < 256; ++x)
+            checker->pixels[y * 256 + x] = (x + y) % 2 ? 255 : 0;
+    for (int size = 127; size > 8 && !failed; size -= 23) {
+        for (int f = PICASSO_FILTER_BILINEAR; f <= PICASSO_FILTER_TRILINEAR; f += 2) {
+            picasso_clear_backbuffer(bf);
+            picasso_blit_ex(bf, checker, (picasso_rect){ 0, 0, 256, 256 },
+                            (picasso_rect){ 0, 0, size, size }, f);
+            int n = (int)(size * sx) < (int)(size * sy) ? (int)(size * sx) : (int)(size * sy);
+            for (int i = 0; i < n; ++i) {
+                if (pixel_at(bf, i, i) != 0xFF808080u || pixel_at(bf, n - 1 - i, i) != 0xFF808080u) {
+                    ERROR("Checkerboard shrunk to %d with filter %d is %08x", size, f, pixel_at(bf, i, i));
+                    failed = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    // White then black halves. A rect of the white one that is off the grid
+    // of the deeper levels stays white, it only goes down as far as it lines up
+    picasso_image *halves = picasso_alloc_image(64, 64, 1);
+    for (int y = 0; y < 64; ++y) memset(&halves->pixels[y * 64], 255, 30);
+    for (int x0 = 0; x0 < 4 && !failed; x0 += 2) {
+        picasso_clear_backbuffer(bf);
+        picasso_blit_ex(bf, halves, (picasso_rect){ x0, 0, 30 - x0, 64 },
+                        (picasso_rect){ 0, 0, (int)(4 / sx), (int)(8 / sy) }, PICASSO_FILTER_TRILINEAR);
+        for (int y = 0; y < 8; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                if (pixel_at(bf, x, y) != 0xFFFFFFFFu) {
+                    ERROR("White rect from %d shrunk is %08x at %d,%d", x0, pixel_at(bf, x, y), x, y);
+                    failed = 1;
+                    y = 8;
+                    break;
+                }
+            }
+        }
+    }
+    if (!failed) INFO("Mip levels average, and shrinking through them matches box");
+
+    // Recording builds the levels, the render threads only read them
+    picasso_image *images[4];
+    for (int c = 0; c < 4; ++c) images[c] = noise_image(300 + 77 * c, 250 - 31 * c, c + 1);
+    for (int pass = 0; pass < 2; ++pass) {
+        picasso_backbuffer *dst = pass ? bf : ref;
+        rng_seed(0xBB67AE85u);
+        for (int c = 0; c < 4; ++c) picasso_image_drop_mips(images[c]);
+        if (pass) picasso_begin_commands(bf);
+        picasso_clear_backbuffer(dst);
+        for (int i = 0; i < 200; ++i) {
+            picasso_image *img = images[i % 4];
+            picasso_rect src_r = { (int)(rng() % 64), (int)(rng() % 64),
+                                   32 + (int)(rng() % 200), 32 + (int)(rng() % 180) };
+            picasso_rect dst_r = { (int)(rng() % WIDTH) - 20, (int)(rng() % HEIGHT) - 20,
+                                   1 + (int)(rng() % 120), 1 + (int)(rng() % 120) };
+            picasso_blit_ex(dst, img, src_r, dst_r,
+                            i % 2 ? PICASSO_FILTER_TRILINEAR : PICASSO_FILTER_BILINEAR);
+        }
+        if (pass) {
+            if (!images[0]->mip) {
+                ERROR("Recording a shrinking blit didn't build the levels");
+                failed = 1;
+            }
+            picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+        }
+    }
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Tiled blits through mip levels differ from the immediate ones");
+        failed = 1;
+    }
+
+    // A straight alpha red image with random alpha stays red when copied
+    // small, though the levels are premultiplied
+    picasso_image *red = picasso_alloc_image(256, 256, 4);
+    for (int i = 0; i < 256 * 256; ++i)
+        memcpy(&red->pixels[4 * i], (uint8_t[]){ 255, 0, 0, (uint8_t)(1 + rng() % 255) }, 4);
+    picasso_image_update_alpha(red);
+    picasso_image *small = picasso_alloc_image(20, 20, 4);
+    picasso_copy(red, small);
+    for (int i = 0; i < 20 * 20; ++i) {
+        const uint8_t *p = &small->pixels[4 * i];
+        if (p[0] < 250 || p[1] || p[2] || small->premultiplied) {
+            ERROR("Red copied small is %d %d %d %d", p[0], p[1], p[2], p[3]);
+            failed = 1;
+            break;
+        }
+    }
+    picasso_image *gray = picasso_alloc_image(32, 32, 3);
+    picasso_copy(checker, gray);
+    for (int i = 0; i < 32 * 32 * 3; ++i) {
+        if (gray->pixels[i] != 128) {
+            ERROR("Checkerboard copied small is %d at %d", gray->pixels[i], i / 3);
+            failed = 1;
+            break;
+        }
+    }
+
+    // A photo sized image shrunk to a thumbnail
+    picasso_image *big = noise_image(2048, 2048, 4);
+    picasso_rect big_r = { 0, 0, 2048, 2048 }, big_thumb = { 0, 0, 300, 300 };
+    double t0 = get_time();
+    picasso_image_build_mips(big);
+    INFO("Mip levels of 2048x2048 built in %.2f ms", (get_time() - t0) * 1e3);
+    static const char *name[] = { "nearest", "bilinear", "box", "trilinear" };
+    for (int f = PICASSO_FILTER_NEAREST; f <= PICASSO_FILTER_TRILINEAR; ++f) {
+        t0 = get_time();
+        for (int k = 0; k < FRAMES; ++k) picasso_blit_ex(bf, big, big_r, big_thumb, f);
+        INFO("2048x2048 onto 300x300, %-9s %.3f ms", name[f], (get_time() - t0) * 1e3 / FRAMES);
+    }
+
+    picasso_free_image(big);
+    picasso_free_image(gray);
+    picasso_free_image(small);
+    picasso_free_image(red);
+    for (int c = 0; c < 4; ++c) picasso_free_image(images[c]);
+    picasso_free_image(halves);
+    picasso_free_image(checker);
+    picasso_free_image(noise);
+    picasso_free_image(odd);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -0,0 +1,180 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso paths
+*
+*   Description:
+*       Fills a self intersecting star with both fill rules, so the middle is
+*       filled with nonzero and left empty with even-odd. Checks the coverage
+*       of a rotated square adds up to its area, and of circles made of four
+*       cubics nearly, and that a rect with edges between pixels covers the
+*       edge pixels by the right amount.
+*       Then draws a few hundred random curved shapes immediately and tiled,
+*       which have to match, and times them.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <math.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define SHAPES  300
+
+static void star(picasso_path *p, float cx, float cy, float r)
+{
+    picasso_path_move_to(p, cx, cy - r);
+    for (int i = 1; i < 5; ++i) {
+        float a = (float)i * 4.0f * (float)M_PI / 5.0f;
+        picasso_path_line_to(p, cx + r * sinf(a), cy - r * cosf(a));
+    }
+    picasso_path_close(p);
+}
+
+// The usual four cubic quarter circle, off by 0.03% of the radius
+static void circle(picasso_path *p, float cx, float cy, float r)
+{
+    const float k = 0.5522847f * r;
+    picasso_path_move_to(p, cx + r, cy);
+    picasso_path_cubic_to(p, cx + r, cy + k, cx + k, cy + r, cx, cy + r);
+    picasso_path_cubic_to(p, cx - k, cy + r, cx - r, cy + k, cx - r, cy);
+    picasso_path_cubic_to(p, cx - r, cy - k, cx - k, cy - r, cx, cy - r);
+    picasso_path_cubic_to(p, cx + k, cy - r, cx + r, cy - k, cx + r, cy);
+    picasso_path_close(p);
+}
+
+static void black(picasso_backbuffer *bf)
+{
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        bf->pixels[i] = 0xFF000000;
+}
+
+static uint8_t red_at(picasso_backbuffer *bf, float x, float y)
+{
+    return bf->pixels[(int)(y * bf->scale_y) * bf->width + (int)(x * bf->scale_x)] & 0xFF;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x1B873593u);
+
+    Window *win = create_window("Picasso paths", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    picasso_path *path = picasso_create_path();
+    if (!bf || !ref || !path) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    int failed = 0;
+
+    // Fill rules
+    star(path, 200, 200, 150);
+    black(bf);
+    picasso_fill_path(bf, path, PICASSO_FILL_NONZERO, WHITE);
+    uint8_t nonzero = red_at(bf, 200, 200);
+    black(bf);
+    picasso_fill_path(bf, path, PICASSO_FILL_EVEN_ODD, WHITE);
+    uint8_t even_odd = red_at(bf, 200, 200), point = red_at(bf, 200, 60);
+    if (nonzero != 255 || even_odd != 0 || point != 255) {
+        ERROR("Star fill rules: middle %d nonzero and %d even-odd, point %d",
+              nonzero, even_odd, point);
+        failed = 1;
+    }
+
+    // Coverage adds up to the area, in pixels. Exactly for a polygon, a
+    // circle loses a little to the chords it is flattened into
+    const float side = 100.5f, turn = 0.5f;
+    picasso_path_reset(path);
+    for (int i = 0; i < 4; ++i) {
+        float a = turn + (float)i * (float)M_PI / 2;
+        picasso_path_line_to(path, 400.3f + side * (float)M_SQRT1_2 * cosf(a),
+                             300.6f + side * (float)M_SQRT1_2 * sinf(a));
+    }
+    float r = 100.3f;
+    circle(path, 180.4f, 300.7f, r);
+    circle(path, 620.4f, 300.7f, r);
+
+    black(bf);
+    picasso_fill_path(bf, path, PICASSO_FILL_NONZERO, WHITE);
+    double area[3] = {0};
+    int split0 = (int)(300 * bf->scale_x), split1 = (int)(500 * bf->scale_x);
+    for (uint32_t y = 0; y < bf->height; ++y)
+        for (uint32_t x = 0; x < bf->width; ++x)
+            area[((int)x >= split0) + ((int)x >= split1)] += (bf->pixels[y * bf->width + x] & 0xFF) / 255.0;
+
+    double scale = bf->scale_x * bf->scale_y;
+    double square = side * side * scale, disc = M_PI * r * r * scale;
+    if (fabs(area[1] - square) > 0.5 || fabs(area[0] - disc) > disc * 0.003 ||
+        fabs(area[0] - area[2]) > 0.5) {
+        ERROR("Square covers %.2f pixels, expected %.2f. Circles %.1f and %.1f, expected %.1f",
+              area[1], square, area[0], area[2], disc);
+        failed = 1;
+    }
+
+    // Edges a quarter pixel into the first and last column
+    picasso_path_reset(path);
+    float x0 = 10.75f / bf->scale_x, x1 = 20.25f / bf->scale_x;
+    picasso_path_move_to(path, x0, 10);
+    picasso_path_line_to(path, x1, 10);
+    picasso_path_line_to(path, x1, 30);
+    picasso_path_line_to(path, x0, 30);
+    black(bf);
+    picasso_fill_path(bf, path, PICASSO_FILL_NONZERO, WHITE);
+    uint32_t *row = &bf->pixels[(int)(20 * bf->scale_y) * bf->width];
+    if ((row[10] & 0xFF) != 64 || (row[11] & 0xFF) != 255 ||
+        (row[20] & 0xFF) != 64 || (row[21] & 0xFF) != 0) {
+        ERROR("Rect edge coverage %d %d .. %d %d, expected 64 255 .. 64 0",
+              row[10] & 0xFF, row[11] & 0xFF, row[20] & 0xFF, row[21] & 0xFF);
+        failed = 1;
+    }
+    if (!failed) INFO("Fill rules, areas and edge coverage are right");
+
+    // Random translucent blobs, immediate and tiled
+    static picasso_path *shapes[SHAPES];
+    static color colors[SHAPES];
+    for (int i = 0; i < SHAPES; ++i) {
+        shapes[i] = picasso_create_path();
+        float cx = frand(0, WIDTH), cy = frand(0, HEIGHT), s = frand(10, 120);
+        picasso_path_move_to(shapes[i], cx + frand(-s, s), cy + frand(-s, s));
+        for (int k = 0; k < 4; ++k)
+            picasso_path_cubic_to(shapes[i], cx + frand(-s, s), cy + frand(-s, s),
+                                  cx + frand(-s, s), cy + frand(-s, s),
+                                  cx + frand(-s, s), cy + frand(-s, s));
+        colors[i] = (color){ (uint8_t)frand(0, 255), (uint8_t)frand(0, 255),
+                             (uint8_t)frand(0, 255), (uint8_t)frand(40, 255) };
+    }
+
+    double t0 = get_time();
+    picasso_clear_backbuffer(ref);
+    for (int i = 0; i < SHAPES; ++i)
+        picasso_fill_path(ref, shapes[i], i % 2 ? PICASSO_FILL_EVEN_ODD : PICASSO_FILL_NONZERO, colors[i]);
+    double t1 = get_time();
+    picasso_begin_commands(bf);
+    picasso_clear_backbuffer(bf);
+    for (int i = 0; i < SHAPES; ++i)
+        picasso_fill_path(bf, shapes[i], i % 2 ? PICASSO_FILL_EVEN_ODD : PICASSO_FILL_NONZERO, colors[i]);
+    picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    double t2 = get_time();
+
+    INFO("%d curved shapes: %.2f ms immediate, %.2f ms tiled", SHAPES,
+         (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+    if (memcmp(bf->pixels, ref->pixels, (size_t)bf->width * bf->height * sizeof(uint32_t)) != 0) {
+        ERROR("Tiled paths differ from the immediate ones");
+        failed = 1;
+    }
+
+    for (int i = 0; i < SHAPES; ++i) picasso_destroy_path(shapes[i]);
+    picasso_destroy_path(path);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -0,0 +1,64 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Random numbers for the tests
+*
+*   Description:
+*       A xorshift generator every test seeds for itself, so each run draws
+*       the same scenes, and noise to fill backbuffers and images with before
+*       drawing. Two backbuffers filled with noise() hold the same pixels.
+*
+*******************************************************************************/
+
+#ifndef TEST_RANDOM_H
+#define TEST_RANDOM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "picasso.h"
+
+static uint32_t rng_state = 1;
+
+static inline void rng_seed(uint32_t seed)
+{
+    rng_state = seed ? seed : 1; // xorshift stays at 0 forever
+}
+
+static inline uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Uniform in [lo, hi], 24 bits of it
+static inline float frand(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(rng() & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+/* The same random pixels on every call, opaque or with any alpha. Reseeds
+ * the generator, so what's drawn after it is the same every time too */
+static inline void noise(picasso_backbuffer *bf, bool opaque)
+{
+    rng_seed(0xA54FF53Au);
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        bf->pixels[i] = opaque ? rng() | 0xFF000000u : rng();
+}
+
+// Random bytes over every row of an image, padding included
+static inline void noise_fill(picasso_image *img)
+{
+    for (int i = 0; i < img->height * img->row_stride; ++i) img->pixels[i] = (uint8_t)rng();
+}
+
+// A new image of random bytes, alpha included, with its alpha worked out
+static inline picasso_image *noise_image(int w, int h, int channels)
+{
+    picasso_image *img = picasso_alloc_image(w, h, channels);
+    noise_fill(img);
+    picasso_image_update_alpha(img);
+    return img;
+}
+
+#endif // TEST_RANDOM_H
@@ -0,0 +1,230 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso strokes
+*
+*   Description:
+*       Strokes a square with miter joins and lines with each cap, and checks
+*       the coverage adds up to the area of the outline. Strokes a translucent
+*       zigzag with every join, where no pixel may be blended twice, and
+*       checks round joins at exact U-turns go around the front.
+*       Then times thick lines against the old way of stamping a circle at
+*       every step, and checks random strokes, thick lines and beziers come
+*       out the same immediate and tiled.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <math.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define LINES   1000
+#define STROKES 200
+
+static void black(picasso_backbuffer *bf)
+{
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        bf->pixels[i] = 0xFF000000;
+}
+
+// Coverage of a white stroke on black, in pixels
+static double area_of(picasso_backbuffer *bf)
+{
+    double area = 0;
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        area += (bf->pixels[i] & 0xFF) / 255.0;
+    return area;
+}
+
+static uint8_t max_red(picasso_backbuffer *bf)
+{
+    uint8_t m = 0;
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        if ((bf->pixels[i] & 0xFF) > m) m = bf->pixels[i] & 0xFF;
+    return m;
+}
+
+// The last pixel of row y anything was drawn on
+static int rightmost(picasso_backbuffer *bf, int y)
+{
+    for (int x = (int)bf->width - 1; x >= 0; --x)
+        if (bf->pixels[y * bf->width + x] & 0xFFFFFF) return x;
+    return -1;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x85EBCA6Bu);
+
+    Window *win = create_window("Picasso strokes", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    picasso_path *path = picasso_create_path();
+    if (!bf || !ref || !path) {
+        ERROR("Failed to create backbuffers");
+        return 1;
+    }
+    int failed = 0;
+    double scale = bf->scale_x * bf->scale_y;
+
+    // A square frame, the miters fill the corners exactly
+    picasso_stroke_style style = { .width = 10, .join = PICASSO_JOIN_MITER };
+    picasso_path_move_to(path, 100.3f, 100.6f);
+    picasso_path_line_to(path, 400.3f, 100.6f);
+    picasso_path_line_to(path, 400.3f, 400.6f);
+    picasso_path_line_to(path, 100.3f, 400.6f);
+    picasso_path_close(path);
+    black(bf);
+    picasso_stroke_path(bf, path, &style, WHITE);
+    double frame = area_of(bf), frame_expected = (310.0 * 310.0 - 290.0 * 290.0) * scale;
+    if (fabs(frame - frame_expected) > 1.0) {
+        ERROR("Square frame covers %.2f pixels, expected %.2f", frame, frame_expected);
+        failed = 1;
+    }
+
+    // A slanted line 300 long and 12 wide, with each cap. Round caps lose a
+    // little to the chords of the half circles
+    const double length = 300, width = 12;
+    const double cap_area[3] = { 0, M_PI * 36, 144 };
+    const char *cap_name[3] = { "butt", "round", "square" };
+    for (int cap = PICASSO_CAP_BUTT; cap <= PICASSO_CAP_SQUARE; ++cap) {
+        picasso_path_reset(path);
+        picasso_path_move_to(path, 200.2f, 150.7f);
+        picasso_path_line_to(path, 200.2f + 180.0f, 150.7f + 240.0f);
+        style = (picasso_stroke_style){ .width = (float)width, .cap = cap };
+        black(bf);
+        picasso_stroke_path(bf, path, &style, WHITE);
+
+        double area = area_of(bf), expected = (length * width + cap_area[cap]) * scale;
+        if (fabs(area - expected) > 1.0 + expected * 0.001) {
+            ERROR("Line with %s caps covers %.2f pixels, expected %.2f",
+                  cap_name[cap], area, expected);
+            failed = 1;
+        }
+    }
+
+    // Half transparent white blends to 128 once, more where it overlaps
+    picasso_path_reset(path);
+    picasso_path_move_to(path, 50, 500);
+    for (int i = 1; i < 12; ++i)
+        picasso_path_line_to(path, 50.0f + (float)i * 60.0f, i % 2 ? 300.0f : 500.0f);
+    const char *join_name[3] = { "miter", "round", "bevel" };
+    for (int join = PICASSO_JOIN_MITER; join <= PICASSO_JOIN_BEVEL; ++join) {
+        style = (picasso_stroke_style){ .width = 24, .join = join, .cap = PICASSO_CAP_ROUND };
+        black(bf);
+        picasso_stroke_path(bf, path, &style, (color){ 255, 255, 255, 128 });
+        uint8_t m = max_red(bf);
+        if (m != 128) {
+            ERROR("Zigzag with %s joins blends up to %d, expected 128 everywhere",
+                  join_name[join], m);
+            failed = 1;
+        }
+    }
+    // Exact U-turns, where the round join has to go around the front of the
+    // stroke and not back through it. The curve folds back at x = 80
+    picasso_path_reset(path);
+    picasso_path_move_to(path, 20, 100);
+    picasso_path_line_to(path, 120, 100);
+    picasso_path_line_to(path, 20, 100);
+    style = (picasso_stroke_style){ .width = 20, .join = PICASSO_JOIN_ROUND };
+    black(bf);
+    picasso_stroke_path(bf, path, &style, WHITE);
+    int row = (int)(100 * bf->scale_y), turn = rightmost(bf, row);
+    bool turn_filled = true;
+    for (int x = (int)(25 * bf->scale_x); x < (int)(125 * bf->scale_x); ++x)
+        turn_filled = turn_filled && (bf->pixels[row * bf->width + x] & 0xFF) == 255;
+    black(bf);
+    draw_bezier(bf, (picasso_vec2){ 20, 100 }, (picasso_vec2){ 140, 100 },
+                (picasso_vec2){ 20, 100 }, 0);
+    int fold = rightmost(bf, row);
+    if (!turn_filled || turn < (int)(129 * bf->scale_x) || fold < (int)(80 * bf->scale_x)) {
+        ERROR("U-turns reach x = %d and %d, expected at least %d and %d", turn, fold,
+              (int)(129 * bf->scale_x), (int)(80 * bf->scale_x));
+        failed = 1;
+    }
+    if (!failed) INFO("Stroke areas are right and no pixel is blended twice");
+
+    // Thick lines, stroked against the circles stamped along them
+    static int lines[LINES][4];
+    for (int i = 0; i < LINES; ++i) {
+        float a = frand(0, 2 * (float)M_PI);
+        int x = (int)frand(150, WIDTH - 150), y = (int)frand(150, HEIGHT - 150);
+        lines[i][0] = x - (int)(250 * cosf(a));
+        lines[i][1] = y - (int)(250 * sinf(a));
+        lines[i][2] = x + (int)(250 * cosf(a));
+        lines[i][3] = y + (int)(250 * sinf(a));
+    }
+    color line_color = { 40, 200, 120, 160 };
+
+    double t0 = get_time();
+    for (int i = 0; i < LINES; ++i)
+        picasso_draw_line_thick(ref, lines[i][0], lines[i][1], lines[i][2], lines[i][3], 4,
+                                line_color);
+    double t1 = get_time();
+    for (int i = 0; i < LINES; ++i) {
+        int dx = lines[i][2] - lines[i][0], dy = lines[i][3] - lines[i][1];
+        int steps = (int)sqrtf((float)(dx * dx + dy * dy));
+        for (int k = 0; k <= steps; ++k) {
+            float t = (float)k / (float)steps;
+            picasso_fill_circle_aa(ref, (int)(lines[i][0] + t * dx), (int)(lines[i][1] + t * dy),
+                                   2, line_color);
+        }
+    }
+    double t2 = get_time();
+    INFO("%d thick lines 500 long: %.2f ms stroked, %.2f ms stamping circles", LINES,
+         (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+
+    // Random strokes in every style, immediate and tiled
+    static picasso_path *shapes[STROKES];
+    static picasso_stroke_style styles[STROKES];
+    static color colors[STROKES];
+    for (int i = 0; i < STROKES; ++i) {
+        shapes[i] = picasso_create_path();
+        float cx = frand(0, WIDTH), cy = frand(0, HEIGHT), s = frand(10, 120);
+        picasso_path_move_to(shapes[i], cx + frand(-s, s), cy + frand(-s, s));
+        picasso_path_line_to(shapes[i], cx + frand(-s, s), cy + frand(-s, s));
+        picasso_path_quad_to(shapes[i], cx + frand(-s, s), cy + frand(-s, s),
+                             cx + frand(-s, s), cy + frand(-s, s));
+        picasso_path_cubic_to(shapes[i], cx + frand(-s, s), cy + frand(-s, s),
+                              cx + frand(-s, s), cy + frand(-s, s),
+                              cx + frand(-s, s), cy + frand(-s, s));
+        if (i % 3 == 0) picasso_path_close(shapes[i]);
+        styles[i] = (picasso_stroke_style){ .width = frand(0.5f, 20), .join = i % 3,
+                                            .cap = (i / 3) % 3, .miter_limit = frand(0, 8) };
+        colors[i] = (color){ (uint8_t)frand(0, 255), (uint8_t)frand(0, 255),
+                             (uint8_t)frand(0, 255), (uint8_t)frand(40, 255) };
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        picasso_backbuffer *dst = pass ? bf : ref;
+        if (pass) picasso_begin_commands(bf);
+        picasso_clear_backbuffer(dst);
+        for (int i = 0; i < STROKES; ++i) {
+            picasso_stroke_path(dst, shapes[i], &styles[i], colors[i]);
+            picasso_draw_line_thick(dst, lines[i][0], lines[i][1], lines[i][2], lines[i][3],
+                                    i % 9, colors[i]);
+        }
+        draw_bezier(dst, (picasso_vec2){ 50, 550 }, (picasso_vec2){ 400, -200 },
+                    (picasso_vec2){ 750, 550 }, 0);
+        if (pass) picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    }
+    if (memcmp(bf->pixels, ref->pixels, (size_t)bf->width * bf->height * sizeof(uint32_t)) != 0) {
+        ERROR("Tiled strokes differ from the immediate ones");
+        failed = 1;
+    }
+
+    for (int i = 0; i < STROKES; ++i) picasso_destroy_path(shapes[i]);
+    picasso_destroy_path(path);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
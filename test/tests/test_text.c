@@ -0,0 +1,222 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso text and the glyph cache
+*
+*   Description:
+*       Draws text at fractional positions and sizes, with kerning, newlines
+*       and UTF-8, and checks it against the same glyphs rasterized straight
+*       with stb_truetype. Then runs the glyph atlas full so shelves get
+*       evicted and checks glyphs come back right, and that a recorded HUD
+*       comes out the same tiled. Times a few thousand glyph HUD drawn from
+*       the cache against rasterizing every glyph every frame.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "picasso_internal.h"
+#include "test_random.h"
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define LINES   60
+#define FRAMES  10
+
+/* What picasso_draw_text should draw: the pen kerned from the start of the
+ * line, at x rounded to a quarter pixel, every glyph rasterized right there
+ * and masked in */
+static void reference_text(picasso_backbuffer *bf, const stbtt_fontinfo *info, const char *s,
+                           float x, float y, float size, color c)
+{
+    float scale = stbtt_ScaleForPixelHeight(info, size * bf->scale_y);
+    int ascent, descent, gap;
+    stbtt_GetFontVMetrics(info, &ascent, &descent, &gap);
+    float line = (float)(ascent - descent + gap) * scale;
+
+    float left = x * bf->scale_x, pen = 0, baseline = y * bf->scale_y;
+    int lines = 0;
+    uint32_t prev = 0;
+    while (*s) {
+        uint32_t cp = picasso__utf8_next(&s);
+        if (cp == '\n') {
+            pen = 0;
+            lines++;
+            prev = 0;
+            continue;
+        }
+        if (prev) pen += (float)stbtt_GetCodepointKernAdvance(info, (int)prev, (int)cp) * scale;
+        prev = cp;
+
+        float q = floorf((left + pen) * 4 + 0.5f);
+        int ix = (int)floorf(q / 4);
+        float shift = (q - (float)ix * 4) / 4;
+        int x0, y0, x1, y1;
+        stbtt_GetCodepointBitmapBoxSubpixel(info, (int)cp, scale, scale, shift, 0, &x0, &y0, &x1, &y1);
+        int w = x1 - x0, h = y1 - y0;
+        if (w > 0 && h > 0) {
+            uint8_t *bitmap = malloc((size_t)w * h);
+            stbtt_MakeCodepointBitmapSubpixel(info, bitmap, w, h, w, scale, scale, shift, 0, (int)cp);
+            int gx = ix + x0, gy = (int)lroundf(baseline + (float)lines * line) + y0;
+            for (int r = 0; r < h; ++r) {
+                int py = gy + r, a = gx < 0 ? -gx : 0, b = gx + w > (int)bf->width ? (int)bf->width - gx : w;
+                if (py < 0 || py >= (int)bf->height || a >= b) continue;
+                picasso__span_mask(&bf->pixels[py * bf->width + gx + a], bitmap + r * w + a, b - a,
+                                   color_to_u32(c));
+            }
+            free(bitmap);
+        }
+        int advance, lsb;
+        stbtt_GetCodepointHMetrics(info, (int)cp, &advance, &lsb);
+        pen += (float)advance * scale;
+    }
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x243F6A88u);
+
+    Window *win = create_window("Picasso text", WIDTH, HEIGHT, CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    picasso_font *font = picasso_load_font("fonts/LibreBaskerville-Regular.ttf", 32);
+    if (!bf || !ref || !font) {
+        ERROR("Failed to create backbuffers or load the font");
+        return 1;
+    }
+    picasso_reader *file = picasso_read_entire_file("fonts/LibreBaskerville-Regular.ttf");
+    stbtt_fontinfo info;
+    stbtt_InitFont(&info, file->fp, stbtt_GetFontOffsetForIndex(file->fp, 0));
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    // Kerned pairs, a second line, two and three byte UTF-8 and a stray byte
+    const char *samples[] = {
+        "Hello, AVAWAY To Ty Wa!",
+        "The quick brown fox\njumps over the lazy dog",
+        "W\xc3\xb6rld \xc2\xa9 \xe2\x82\xac 12.50 \xff end",
+    };
+    const float sizes[] = { 11.0f, 17.5f, 32.0f, 63.25f };
+    for (int k = 0; k < 3; ++k) {
+        for (int i = 0; i < 4; ++i) {
+            float x = 10.3f + 7.1f * (float)i, y = 60 + 120.7f * (float)i;
+            color c = i % 2 ? SET_ALPHA(GOLD, 160) : WHITE;
+            picasso_font_set_size(font, sizes[i]);
+            noise(ref, true);
+            reference_text(ref, &info, samples[k], x, y, sizes[i], c);
+            noise(bf, true);
+            picasso_draw_text(bf, font, samples[k], x, y, c);
+            // Drawn from the cache this time
+            noise(bf, true);
+            picasso_draw_text(bf, font, samples[k], x, y, c);
+            if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+                ERROR("\"%s\" at %.2f px differs from stb_truetype", samples[k], sizes[i]);
+                failed = 1;
+            }
+        }
+    }
+
+    picasso_font_set_size(font, 20);
+    float width = picasso_text_width(font, "AVAWAY\nTo");
+    float scale = stbtt_ScaleForPixelHeight(&info, 20);
+    float want = 0;
+    const char *word = "AVAWAY";
+    for (int i = 0; word[i]; ++i) {
+        int advance, lsb;
+        stbtt_GetCodepointHMetrics(&info, word[i], &advance, &lsb);
+        if (i) want += (float)stbtt_GetCodepointKernAdvance(&info, word[i - 1], word[i]) * scale;
+        want += (float)advance * scale;
+    }
+    if (fabsf(width - want) > 0.01f) {
+        ERROR("Width of AVAWAY is %.2f, not %.2f", width, want);
+        failed = 1;
+    }
+    if (!failed) INFO("Text matches stb_truetype glyph by glyph");
+
+    // Every printable ASCII glyph at 60 sizes is far more than the atlas
+    // holds, the shelves drawn longest ago make room
+    char ascii[96];
+    for (int i = 0; i < 95; ++i) ascii[i] = (char)(' ' + i);
+    ascii[95] = 0;
+    for (int s = 10; s < 70; ++s) {
+        picasso_font_set_size(font, (float)s);
+        picasso_draw_text(bf, font, ascii, 0, 300, WHITE);
+    }
+    picasso_font_set_size(font, 17.5f);
+    noise(ref, true);
+    reference_text(ref, &info, samples[0], 40.6f, 200, 17.5f, RED);
+    noise(bf, true);
+    picasso_draw_text(bf, font, samples[0], 40.6f, 200, RED);
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Text differs after the glyph cache evicted");
+        failed = 1;
+    }
+
+    // A HUD, thousands of glyphs in a few sizes and colors
+    static char hud[LINES][64];
+    for (int l = 0; l < LINES; ++l) {
+        int n = 40 + (int)(rng() % 20);
+        for (int i = 0; i < n; ++i) hud[l][i] = (char)(' ' + 1 + rng() % 94);
+        hud[l][n] = 0;
+    }
+    const color colors[] = { WHITE, GOLD, SET_ALPHA(RED, 200), GREEN };
+    #define DRAW_HUD(dst)                                                              \
+        for (int l = 0; l < LINES; ++l) {                                              \
+            picasso_font_set_size(font, l % 3 ? 12.0f : 16.0f);                        \
+            picasso_draw_text((dst), font, hud[l], 4 + (float)(l % 2) * 400,           \
+                              14 + (float)(l / 2) * 19.5f, colors[l % 4]);             \
+        }
+
+    noise(ref, true);
+    DRAW_HUD(ref);
+    noise(bf, true);
+    picasso_begin_commands(bf);
+    DRAW_HUD(bf);
+    picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Tiled text differs from the immediate one");
+        failed = 1;
+    }
+
+    int glyphs = 0;
+    for (int l = 0; l < LINES; ++l) glyphs += (int)strlen(hud[l]);
+    double t0 = get_time();
+    for (int f = 0; f < FRAMES; ++f) { DRAW_HUD(bf); }
+    double t1 = get_time();
+    for (int f = 0; f < FRAMES; ++f) {
+        picasso_begin_commands(bf);
+        DRAW_HUD(bf);
+        picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    }
+    double t2 = get_time();
+    // What drawing text took before: every glyph rasterized every frame
+    for (int f = 0; f < FRAMES; ++f) {
+        for (int l = 0; l < LINES; ++l) {
+            float s = stbtt_ScaleForPixelHeight(&info, l % 3 ? 12.0f : 16.0f);
+            int x = 4 + (l % 2) * 400, y = 14 + (int)((float)(l / 2) * 19.5f);
+            for (const char *p = hud[l]; *p; ++p) {
+                int w, h, xoff, yoff, advance, lsb;
+                uint8_t *bitmap = stbtt_GetCodepointBitmap(&info, 0, s, *p, &w, &h, &xoff, &yoff);
+                draw_bitmap_to_backbuffer(bf, bitmap, w, h, x + xoff, y + yoff, colors[l % 4]);
+                stbtt_FreeBitmap(bitmap, NULL);
+                stbtt_GetCodepointHMetrics(&info, *p, &advance, &lsb);
+                x += (int)((float)advance * s);
+                if (p[1]) x += (int)((float)stbtt_GetCodepointKernAdvance(&info, *p, p[1]) * s);
+            }
+        }
+    }
+    double t3 = get_time();
+    INFO("%d glyphs: %.2f ms cached, %.2f ms cached tiled, %.2f ms rasterized every frame",
+         glyphs, (t1 - t0) * 1e3 / FRAMES, (t2 - t1) * 1e3 / FRAMES, (t3 - t2) * 1e3 / FRAMES);
+
+    picasso_reader_free(file);
+    picasso_destroy_font(font);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
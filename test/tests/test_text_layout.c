@@ -0,0 +1,176 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso text layout and the layout cache
+*
+*   Description:
+*       Wraps a paragraph at a few widths and checks it comes out exactly like
+*       the lines a greedy word wrap picks, drawn one by one. Words longer
+*       than a line are broken, a string rewritten in place is laid out
+*       again, and wrapped text comes out the same tiled. Then times a log
+*       viewer measuring thousands of unchanged lines a frame, from the
+*       layout cache and laid out with stb_truetype every frame.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "picasso_internal.h"
+#include "test_random.h"
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define LOG     3000
+#define FRAMES  10
+
+/* Greedy word wrap through picasso_text_width: as many words on a line as
+ * fit in width. Returns the line count, the lines go into lines[] */
+static int wrap_words(const picasso_font *font, const char *text, float width, char lines[][256])
+{
+    int n = 0;
+    lines[0][0] = 0;
+    while (*text) {
+        const char *word = text;
+        while (*text && *text != ' ') text++;
+        char candidate[256];
+        if (lines[n][0])
+            snprintf(candidate, sizeof(candidate), "%s %.*s", lines[n], (int)(text - word), word);
+        else
+            snprintf(candidate, sizeof(candidate), "%.*s", (int)(text - word), word);
+        if (lines[n][0] && picasso_text_width(font, candidate) > width)
+            snprintf(lines[++n], 256, "%.*s", (int)(text - word), word);
+        else
+            strcpy(lines[n], candidate);
+        while (*text == ' ') text++;
+    }
+    return n + 1;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x3C6EF372u);
+
+    Window *win = create_window("Picasso text layout", WIDTH, HEIGHT, CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    picasso_font *font = picasso_load_font("fonts/LibreBaskerville-Regular.ttf", 18);
+    if (!bf || !ref || !font) {
+        ERROR("Failed to create backbuffers or load the font");
+        return 1;
+    }
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    const char *paragraph =
+        "AVAWAY To Ty Wa. The quick brown fox jumps over the lazy dog, then the lazy dog "
+        "jumps over the quick brown fox. Kerned pairs like AV, To and Wa keep their "
+        "kerning wherever a line happens to break.";
+    float line = picasso_measure_text(font, "A", 0).height;
+
+    // Wrapped, it is the greedy lines drawn one under the other
+    const float widths[] = { 120.5f, 233.0f, 400.25f, 777.0f };
+    for (int w = 0; w < 4; ++w) {
+        static char lines[64][256];
+        int n = wrap_words(font, paragraph, widths[w], lines);
+        noise(ref, true);
+        for (int i = 0; i < n; ++i)
+            picasso_draw_text(ref, font, lines[i], 10.3f, 40 + (float)i * line, WHITE);
+        noise(bf, true);
+        picasso_draw_text_wrapped(bf, font, paragraph, 10.3f, 40, widths[w], WHITE);
+        if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+            ERROR("Paragraph wrapped at %.2f differs from its %d lines drawn one by one", widths[w], n);
+            failed = 1;
+        }
+        picasso_text_extent e = picasso_measure_text(font, paragraph, widths[w]);
+        if (e.lines != n || e.width > widths[w] || fabsf(e.height - (float)n * line) > 0.01f) {
+            ERROR("Paragraph wrapped at %.2f measures %d lines %.2f wide, not %d", widths[w],
+                  e.lines, e.width, n);
+            failed = 1;
+        }
+    }
+
+    // A word longer than the line is broken where it reaches the end
+    const char *word = "Pneumonoultramicroscopicsilicovolcanoconiosis";
+    picasso_text_extent long_word = picasso_measure_text(font, word, 100);
+    if (long_word.lines < 3 || long_word.width > 100) {
+        ERROR("A long word in 100 pixels takes %d lines %.2f wide", long_word.lines, long_word.width);
+        failed = 1;
+    }
+
+    // Laid out by its contents, not where the string is
+    char status[32];
+    strcpy(status, "Frame 1 of 10");
+    float before = picasso_text_width(font, status);
+    strcpy(status, "Frame 10 of 10");
+    if (picasso_text_width(font, status) <= before) {
+        ERROR("A string rewritten in place kept its old layout");
+        failed = 1;
+    }
+    if (!failed) INFO("Wrapped text matches a greedy word wrap");
+
+    // Wrapped paragraphs all over, immediate and tiled
+    #define DRAW_PARAGRAPHS(dst)                                                             \
+        for (int i = 0; i < 12; ++i) {                                                       \
+            picasso_font_set_size(font, i % 2 ? 13.0f : 18.0f);                              \
+            picasso_draw_text_wrapped((dst), font, paragraph, (float)(i % 3) * 260 + 5,      \
+                                      (float)(i / 3) * 150 + 20, 250, i % 2 ? GOLD : WHITE); \
+        }
+    noise(ref, true);
+    DRAW_PARAGRAPHS(ref);
+    noise(bf, true);
+    picasso_begin_commands(bf);
+    DRAW_PARAGRAPHS(bf);
+    picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Tiled wrapped text differs from the immediate one");
+        failed = 1;
+    }
+
+    // A log viewer sizing its scrollbar: every line measured every frame
+    static char log[LOG][96];
+    for (int i = 0; i < LOG; ++i) {
+        int n = snprintf(log[i], sizeof(log[i]), "[%05d] ", i);
+        int len = n + 30 + (int)(rng() % 50);
+        for (int k = n; k < len; ++k) log[i][k] = rng() % 6 ? (char)('a' + rng() % 26) : ' ';
+        log[i][len] = 0;
+    }
+    picasso_font_set_size(font, 12);
+    float widest = 0, widest_stb = 0;
+
+    double t0 = get_time();
+    for (int f = 0; f < FRAMES; ++f)
+        for (int i = 0; i < LOG; ++i) widest = PICASSO_MAX(widest, picasso_text_width(font, log[i]));
+    double t1 = get_time();
+
+    // What it took before: every line laid out with stb_truetype every frame
+    float scale = stbtt_ScaleForPixelHeight(&font->info, 12);
+    for (int f = 0; f < FRAMES; ++f) {
+        for (int i = 0; i < LOG; ++i) {
+            float pen = 0;
+            for (const char *p = log[i]; *p; ++p) {
+                int advance, lsb;
+                if (p != log[i]) pen += (float)stbtt_GetCodepointKernAdvance(&font->info, p[-1], *p) * scale;
+                stbtt_GetCodepointHMetrics(&font->info, *p, &advance, &lsb);
+                pen += (float)advance * scale;
+            }
+            widest_stb = PICASSO_MAX(widest_stb, pen);
+        }
+    }
+    double t2 = get_time();
+    if (widest != widest_stb) {
+        ERROR("The widest log line is %.3f, stb_truetype says %.3f", widest, widest_stb);
+        failed = 1;
+    }
+    INFO("%d log lines measured: %.2f ms from the layout cache, %.2f ms laid out every frame",
+         LOG, (t1 - t0) * 1e3 / FRAMES, (t2 - t1) * 1e3 / FRAMES);
+
+    picasso_destroy_font(font);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso distance field text
+*
+*   Description:
+*       Draws text from signed distance fields at sizes from well below to
+*       well above the size the fields are baked at, and checks it covers
+*       the same pixels as text rasterized at that size. Outlines and glows
+*       reach out from the glyphs, and all of it comes out the same tiled.
+*       Then times zooming text through a new size every frame, rasterized
+*       per size and from the fields.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <math.h>
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH   800
+#define HEIGHT  600
+#define FRAMES  60
+
+static void black(picasso_backbuffer *bf)
+{
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i) bf->pixels[i] = 0xFF000000u;
+}
+
+// Pixels with any red, outside of the given ones if not NULL
+static int count_red(const picasso_backbuffer *bf, const picasso_backbuffer *outside)
+{
+    int n = 0;
+    for (uint32_t i = 0; i < bf->width * bf->height; ++i)
+        n += (bf->pixels[i] & 0xFF) && !(outside && (outside->pixels[i] & 0xFF));
+    return n;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+    rng_seed(0x510E527Fu);
+
+    Window *win = create_window("Picasso distance field text", WIDTH, HEIGHT,
+                                CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(win);
+    picasso_backbuffer *ref = picasso_create_backbuffer(win);
+    picasso_font *font = picasso_load_font("fonts/LibreBaskerville-Regular.ttf", 48);
+    if (!bf || !ref || !font) {
+        ERROR("Failed to create backbuffers or load the font");
+        return 1;
+    }
+    size_t bytes = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    int failed = 0;
+
+    // The same ink as rasterized text, give or take a soft edge
+    const char *sample = "Hello, AVAWAY quick brown fox";
+    const float sizes[] = { 16.0f, 31.5f, 48.0f, 75.25f, 120.0f };
+    for (int i = 0; i < 5; ++i) {
+        picasso_font_set_size(font, sizes[i]);
+        float y = 20 + sizes[i];
+        black(ref);
+        picasso_draw_text(ref, font, sample, 10.25f, y, WHITE);
+        black(bf);
+        picasso_draw_text_sdf(bf, font, sample, 10.25f, y, WHITE, NULL);
+
+        double ink = 0, ink_sdf = 0, diff = 0;
+        for (uint32_t p = 0; p < bf->width * bf->height; ++p) {
+            int a = (int)(ref->pixels[p] & 0xFF), b = (int)(bf->pixels[p] & 0xFF);
+            ink += a;
+            ink_sdf += b;
+            diff += abs(a - b);
+        }
+        if (fabs(ink_sdf - ink) > ink * 0.04 || diff > ink * 0.15) {
+            ERROR("At %.2f px distance field text has %.0f%% of the ink, %.0f%% of it misplaced",
+                  sizes[i], 100 * ink_sdf / ink, 100 * diff / ink);
+            failed = 1;
+        }
+    }
+
+    // An outline rings the glyphs and a glow reaches past it, both under
+    // the fill
+    picasso_font_set_size(font, 60);
+    black(ref);
+    picasso_draw_text_sdf(ref, font, "Outline", 40, 200, RED, NULL);
+    black(bf);
+    picasso_draw_text_sdf(bf, font, "Outline", 40, 200, RED,
+                          &(picasso_text_effects){ .outline = (color){ 0, 0, 255, 255 }, .outline_width = 3 });
+    int outline = 0;
+    for (uint32_t p = 0; p < bf->width * bf->height; ++p)
+        outline += (bf->pixels[p] >> 16 & 0xFF) > 128 && !(ref->pixels[p] & 0xFF);
+    if (count_red(bf, NULL) != count_red(ref, NULL) || outline < count_red(ref, NULL) / 4) {
+        ERROR("Outlined text covers %d red pixels, not %d, with %d outline pixels around",
+              count_red(bf, NULL), count_red(ref, NULL), outline);
+        failed = 1;
+    }
+    black(bf);
+    picasso_draw_text_sdf(bf, font, "Outline", 40, 200, BLACK,
+                          &(picasso_text_effects){ .glow = RED, .glow_width = 6 });
+    if (count_red(bf, ref) < count_red(ref, NULL) / 2) {
+        ERROR("The glow reaches only %d pixels past the glyphs", count_red(bf, ref));
+        failed = 1;
+    }
+    if (!failed) INFO("Distance field text covers what rasterized text does, outlines and glows around it");
+
+    // Sizes, positions and effects all over, immediate and tiled
+    static struct { float size, x, y; picasso_text_effects fx; } lines[40];
+    for (int i = 0; i < 40; ++i) {
+        lines[i].size = 10 + (float)(rng() % 900) / 10.0f;
+        lines[i].x = (float)(rng() % (WIDTH * 10)) / 10.0f - 100;
+        lines[i].y = (float)(rng() % (HEIGHT * 10)) / 10.0f;
+        lines[i].fx = (picasso_text_effects){
+            .outline = SET_ALPHA(BLUE, 200), .outline_width = (float)(rng() % 4),
+            .glow = SET_ALPHA(GOLD, 120), .glow_width = (float)(rng() % 3) * 4,
+        };
+    }
+    #define DRAW_LINES(dst)                                                                    \
+        for (int i = 0; i < 40; ++i) {                                                         \
+            picasso_font_set_size(font, lines[i].size);                                        \
+            picasso_draw_text_sdf((dst), font, "Zoom AVAWAY 0123", lines[i].x, lines[i].y,     \
+                                  i % 2 ? WHITE : SET_ALPHA(GREEN, 180), &lines[i].fx);        \
+        }
+    noise(ref, true);
+    DRAW_LINES(ref);
+    noise(bf, true);
+    picasso_begin_commands(bf);
+    DRAW_LINES(bf);
+    picasso_submit_commands(bf, PICASSO_SUBMIT_TILED);
+    if (memcmp(bf->pixels, ref->pixels, bytes) != 0) {
+        ERROR("Tiled distance field text differs from the immediate one");
+        failed = 1;
+    }
+
+    // Zooming: a new size every frame. The glyphs rasterized per size crowd
+    // everything else out of the glyph cache, the fields are baked once
+    const char *title = "Zoomable canvas";
+    double t0 = get_time();
+    for (int f = 0; f < FRAMES; ++f) {
+        picasso_font_set_size(font, 12 + (float)f * 2.3f);
+        picasso_draw_text(bf, font, title, 10, 300, WHITE);
+    }
+    double t1 = get_time();
+    picasso_draw_text_sdf(bf, font, title, 10, 300, WHITE, NULL);
+    double t2 = get_time();
+    for (int f = 0; f < FRAMES; ++f) {
+        picasso_font_set_size(font, 12 + (float)f * 2.3f);
+        picasso_draw_text_sdf(bf, font, title, 10, 300, WHITE, NULL);
+    }
+    double t3 = get_time();
+    INFO("Zooming through %d sizes: %.2f ms a frame rasterized per size, %.2f ms from fields "
+         "(baked in %.2f ms)", FRAMES, (t1 - t0) * 1e3 / FRAMES, (t3 - t2) * 1e3 / FRAMES,
+         (t2 - t1) * 1e3);
+
+    picasso_destroy_font(font);
+    picasso_destroy_backbuffer(ref);
+    picasso_destroy_backbuffer(bf);
+    free_window(win);
+    shutdown_log();
+
+    return failed;
+}
@@ -0,0 +1,139 @@
+/*******************************************************************************
+*
+*   CANOPY [Example] - Picasso tiled command submission
+*
+*   Description:
+*       Draws the same few thousand overlapping primitives, a few of them in
+*       other blend modes than source-over, immediately, and
+*       then recorded and submitted in every mode: in order, in parallel
+*       tiles, and both again with occlusion culling. All of them have to give
+*       the exact same pixels. Timings for each are printed after the check.
+*
+*******************************************************************************/
+
+#include "canopy.h"
+#include "picasso.h"
+#include "test_random.h"
+#include <string.h>
+#include <blackbox.h>
+
+#define WIDTH       1440
+#define HEIGHT      900
+#define PRIMITIVES  4000
+
+static void draw_scene(picasso_backbuffer *bf, picasso_image *img, picasso_image *background)
+{
+    rng_seed(0xC0FFEEu); // same scene every call
+
+    // The usual overdraw: a clear that the background blit hides completely
+    picasso_clear_backbuffer(bf);
+    picasso_blit_bitmap(bf, background, 0, 0);
+
+    for (int i = 0; i < PRIMITIVES; ++i) {
+        color c = { rng(), rng(), rng(), 64 + rng() % 192 };
+        if (rng() % 3 == 0) c.a = 255; // some opaque panels to cull against
+        int x = (int)(rng() % (WIDTH + 100)) - 50;
+        int y = (int)(rng() % (HEIGHT + 100)) - 50;
+        int w = (int)(rng() % 200) - 40;
+        int h = (int)(rng() % 200) - 40;
+        // Now and then another blend mode, which culling has to respect
+        bf->blend = rng() % 8 ? PICASSO_BLEND_SRC_OVER
+                              : (picasso_blend_mode)(rng() % PICASSO_BLEND_COUNT);
+
+        switch (i % 8) {
+        case 0: picasso_fill_rect(bf, &(picasso_rect){ x, y, w, h }, c); break;
+        case 1: picasso_draw_rect(bf, &(picasso_rect){ x, y, w, h }, 1 + rng() % 8, c); break;
+        case 2: picasso_fill_circle(bf, x, y, PICASSO_ABS(w) / 2, c); break;
+        case 3:
+            picasso_fill_circle_aa(bf, x, y, PICASSO_ABS(h) / 2, c);
+            picasso_draw_circle_aa(bf, x, y, PICASSO_ABS(w) / 2, c);
+            break;
+        case 4: picasso_fill_triangle(bf, (picasso_point3){ x, y, x + w, y + h, x - h, y + w }, c); break;
+        case 5: picasso_draw_line_aa(bf, x, y, x + w * 2, y + h * 2, c); break;
+        case 6: picasso_draw_line(bf, x, y, x + w * 3, y - h, c); break;
+        case 7:
+            picasso_blit(bf, img, (picasso_rect){ 0, 0, img->width, img->height },
+                         (picasso_rect){ x, y, w, h });
+            break;
+        }
+    }
+    bf->blend = PICASSO_BLEND_SRC_OVER;
+}
+
+static bool run_recorded(picasso_backbuffer *bf, picasso_image *img,
+                         picasso_image *background, const uint32_t *reference,
+                         int flags, const char *name)
+{
+    size_t size = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    memset(bf->pixels, 0, size);
+
+    double t0 = get_time();
+    picasso_begin_commands(bf);
+    draw_scene(bf, img, background);
+    double t1 = get_time();
+    picasso_submit_commands(bf, flags);
+    double t2 = get_time();
+
+    bool ok = memcmp(reference, bf->pixels, size) == 0;
+    INFO("%-18s %6.2f ms (+%.2f ms recording) %s", name,
+         (t2 - t1) * 1e3, (t1 - t0) * 1e3, ok ? "OK" : "MISMATCH");
+    return ok;
+}
+
+int main(void)
+{
+    init_log(LOG_DEFAULT);
+
+    Window *window = create_window("Picasso tiled submit", WIDTH, HEIGHT,
+                                   CANOPY_WINDOW_STYLE_DEFAULT);
+    picasso_backbuffer *bf = picasso_create_backbuffer(window);
+    if (!bf) {
+        ERROR("Failed to create backbuffer");
+        return 1;
+    }
+
+    // Generated images, so the test doesn't need any assets
+    picasso_image *img = picasso_alloc_image(64, 64, 4);
+    foreach_pixel_u8(img, {
+        pixel[0] = (uint8_t)(_x * 4);
+        pixel[1] = (uint8_t)(_y * 4);
+        pixel[2] = 128;
+        pixel[3] = (uint8_t)((_x + _y) * 2);
+    });
+    picasso_image *background = picasso_alloc_image(bf->logical_width, bf->logical_height, 3);
+    foreach_pixel_u8(background, {
+        pixel[0] = (uint8_t)_x;
+        pixel[1] = (uint8_t)_y;
+        pixel[2] = (uint8_t)(_x ^ _y);
+    });
+
+    size_t size = (size_t)bf->width * bf->height * sizeof(uint32_t);
+    uint32_t *reference = canopy_malloc(size);
+
+    INFO("%d primitives at %ux%u", PRIMITIVES, bf->width, bf->height);
+
+    double t0 = get_time();
+    draw_scene(bf, img, background);
+    double t1 = get_time();
+    memcpy(reference, bf->pixels, size);
+    INFO("%-18s %6.2f ms", "immediate", (t1 - t0) * 1e3);
+
+    bool ok = true;
+    ok &= run_recorded(bf, img, background, reference,
+                       PICASSO_SUBMIT_IMMEDIATE, "in order");
+    ok &= run_recorded(bf, img, background, reference,
+                       PICASSO_SUBMIT_TILED, "tiled");
+    ok &= run_recorded(bf, img, background, reference,
+                       PICASSO_SUBMIT_CULL, "in order, culled");
+    ok &= run_recorded(bf, img, background, reference,
+                       PICASSO_SUBMIT_TILED | PICASSO_SUBMIT_CULL, "tiled, culled");
+
+    canopy_free(reference);
+    picasso_free_image(background);
+    picasso_free_image(img);
+    picasso_destroy_backbuffer(bf);
+    free_window(window);
+    shutdown_log();
+
+    return ok ? 0 : 1;
+}
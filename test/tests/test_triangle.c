@@ -9,12 +9,6 @@
 #define CENTER_Y (HEIGHT / 2)
 
 static float angle = 0.0f;
-static float _to_px_xf(const picasso_backbuffer *bf, float x) {
-    return x * bf->scale_x;
-}
-static float _to_px_yf(const picasso_backbuffer *bf, float y) {
-    return y * bf->scale_y;
-}
 
 // Basic HSV to RGB conversion
 static color hsv_to_rgb(float h, float s, float v) {
@@ -38,77 +32,63 @@ static color hsv_to_rgb(float h, float s, float v) {
                    (uint8_t)(b * 255),
                           /* a */255};
 }
-// Drop in version from openAI - GPT 5.4. Checking out capabilities. Still crap
-// rotates differently then what i want. I will try something else later.
-// Leaving this here.
+/* The hue follows the angle around the center, in the triangle's own
+ * rotation. Instead of working that out per pixel, the triangle is cut into
+ * thin wedges around its center, the hue is set at the corners of every wedge
+ * and the mesh blends the colors in between. */
+#define RAINBOW_STEPS 24 // wedges per edge
+
+static float local_hue(float dx, float dy, float rotation)
+{
+    // rotate BACK into triangle's local space
+    float s = sinf(-rotation);
+    float c = cosf(-rotation);
+    float hue = (atan2f(dx * s + dy * c, dx * c - dy * s) + M_PI) / (2 * M_PI);
+
+    hue = fmodf(hue, 1.0f);
+    if (hue < 0.0f) hue += 1.0f;
+    return hue;
+}
+
 void picasso_fill_triangle_rainbow(picasso_backbuffer* bf,
                                    picasso_point3 t,
                                    float rotation)
 {
-    // Convert to float + scale
-    float x1 = _to_px_xf(bf, t.x1);
-    float y1 = _to_px_yf(bf, t.y1);
-    float x2 = _to_px_xf(bf, t.x2);
-    float y2 = _to_px_yf(bf, t.y2);
-    float x3 = _to_px_xf(bf, t.x3);
-    float y3 = _to_px_yf(bf, t.y3);
-
-    // Bounding box (correct for floats)
-    int min_x = (int)fmaxf(floorf(fminf(fminf(x1, x2), x3)), 0.0f);
-    int max_x = (int)fminf(ceilf (fmaxf(fmaxf(x1, x2), x3)), bf->width  - 1);
-    int min_y = (int)fmaxf(floorf(fminf(fminf(y1, y2), y3)), 0.0f);
-    int max_y = (int)fminf(ceilf (fmaxf(fmaxf(y1, y2), y3)), bf->height - 1);
-
-    // Triangle center (for your rainbow)
-    float cx = (x1 + x2 + x3) / 3.0f;
-    float cy = (y1 + y2 + y3) / 3.0f;
-
-    // Edge function
-    #define EDGE(ax, ay, bx, by, px, py) \
-        ((px - ax)*(by - ay) - (py - ay)*(bx - ax))
-
-    // Precompute area (for winding)
-    float area = EDGE(x1, y1, x2, y2, x3, y3);
-
-    for (int y = min_y; y <= max_y; ++y) {
-        for (int x = min_x; x <= max_x; ++x) {
-
-            // Sample at pixel center (important!)
-            float px = x + 0.5f;
-            float py = y + 0.5f;
-
-            float w0 = EDGE(x2, y2, x3, y3, px, py);
-            float w1 = EDGE(x3, y3, x1, y1, px, py);
-            float w2 = EDGE(x1, y1, x2, y2, px, py);
-
-            // Inside test (same sign as area)
-            if ((w0 >= 0 && w1 >= 0 && w2 >= 0 && area > 0) ||
-                (w0 <= 0 && w1 <= 0 && w2 <= 0 && area < 0))
-            {
-                float dx = px - cx;
-                float dy = py - cy;
-
-                // rotate pixel BACK into triangle's local space
-                float s = sinf(-rotation);
-                float c = cosf(-rotation);
-
-                float lx = dx * c - dy * s;
-                float ly = dx * s + dy * c;
-
-                float angle_local = atan2f(ly, lx);
-                float hue = (angle_local + M_PI) / (2 * M_PI);
-
-                // FIX: wrap properly
-                hue = fmodf(hue, 1.0f);
-                if (hue < 0.0f) hue += 1.0f;
-
-                color rainbow = hsv_to_rgb(hue, 1.0f, 1.0f);
-                bf->pixels[y * bf->width + x] = color_to_u32(rainbow);
-            }
+    static picasso_vertex vertices[2 * 3 * RAINBOW_STEPS];
+    static uint32_t indices[3 * 3 * RAINBOW_STEPS];
+    const int rim = 3 * RAINBOW_STEPS;
+
+    float cx = (t.x1 + t.x2 + t.x3) / 3.0f;
+    float cy = (t.y1 + t.y2 + t.y3) / 3.0f;
+    const float px[3] = { t.x1, t.x2, t.x3 };
+    const float py[3] = { t.y1, t.y2, t.y3 };
+
+    // Points along the edges first
+    for (int e = 0; e < 3; ++e) {
+        for (int k = 0; k < RAINBOW_STEPS; ++k) {
+            float f = (float)k / RAINBOW_STEPS;
+            float x = px[e] + (px[(e + 1) % 3] - px[e]) * f;
+            float y = py[e] + (py[(e + 1) % 3] - py[e]) * f;
+            vertices[e * RAINBOW_STEPS + k] = (picasso_vertex){
+                .x = x, .y = y,
+                .c = hsv_to_rgb(local_hue(x - cx, y - cy, rotation), 1.0f, 1.0f) };
         }
     }
 
-    #undef EDGE
+    // Every wedge gets its own center, colored like the middle of its edge
+    for (int i = 0; i < rim; ++i) {
+        const picasso_vertex *a = &vertices[i], *b = &vertices[(i + 1) % rim];
+        float mx = (a->x + b->x) * 0.5f, my = (a->y + b->y) * 0.5f;
+        vertices[rim + i] = (picasso_vertex){
+            .x = cx, .y = cy,
+            .c = hsv_to_rgb(local_hue(mx - cx, my - cy, rotation), 1.0f, 1.0f) };
+
+        indices[3 * i + 0] = rim + i;
+        indices[3 * i + 1] = i;
+        indices[3 * i + 2] = (i + 1) % rim;
+    }
+
+    picasso_draw_mesh(bf, vertices, 2 * rim, indices, 3 * rim, NULL);
 }
 
 // Rotate triangle around its center